@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "i2c_bus.h"
+
+// Deep-sleep duty cycle for battery deployments. Between wakes only the RTC domain of the
+// ESP32 is powered; the AXP192 keeps counting charge, so the drain of whole cycles, sleep
+// included, is measured rather than guessed. What must outlive a cycle (the fetch schedule,
+// the awake-time and charge accounts) is kept in RTC memory, which a power-on clears.
+// Single-task: called from setup() and loop().
+
+enum class WakeCause : uint8_t { PowerOn, Timer, Touch };
+
+struct DutyCycleStats {
+  uint32_t cycles = 0;         // timer wakes since power-on
+  uint32_t awakeMsLast = 0;    // the latest timer wake, boot to sleep
+  uint32_t awakeMsAvg = 0;     // over the timer wakes so far
+  uint32_t sleepSecLast = 0;
+  uint32_t nextFetchUnix = 0;  // as last scheduled, 0 for the next wake
+  uint16_t drainMaX10 = 0;     // average battery drain, 0 until known
+  bool measured = false;       // drain from the coulomb counter rather than estimated
+  uint16_t batteryDaysX10 = 0;  // at that drain from the current charge, 0 until known
+};
+
+// Why this boot happened; validates the retained state and drops it after a power-on.
+// `wakePin` (active low) is armed as the touch wakeup before each sleep.
+WakeCause dutyCycleBegin(uint8_t wakePin);
+
+// Charge accounting: the first AXP192 reading after a wake closes the previous cycle.
+void dutyCycleNotePower(const PowerReading& reading, uint8_t batteryPct);
+
+// Whether the forecast is due at `unixSec` (0 when the clock is unset, which counts as due).
+bool dutyCycleFetchDue(uint32_t unixSec);
+
+// Records the time awake and the schedule, then enters deep sleep for `sleepSec` or until
+// the wake pin goes low. `nextFetchUnix` is when the forecast is due next, 0 if at the next
+// wake; `timerWake` tells a timer pass from an interactive session. Does not return on the
+// device.
+void dutyCycleSleep(uint32_t sleepSec, uint32_t nextFetchUnix, bool timerWake);
+
+DutyCycleStats dutyCycleStats();
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// BME680 on the Grove port (Wire, GPIO 32/33). The internal bus (Wire1: touch, AXP, RTC)
+// is not touched by the sensor task.
+static constexpr size_t kEnvHistory = 120;  // 20 min at 10 s per sample
+
+// One forced-mode measurement.
+struct EnvSample {
+  uint32_t ms = 0;  // millis() when the measurement completed
+  int16_t tempC100 = 0;
+  uint16_t humidityPermille = 0;
+  uint32_t pressurePa = 0;
+  uint32_t gasOhm = 0;  // 0 when the gas reading was not valid
+};
+
+struct EnvStats {
+  bool present = false;   // sensor answered at its address
+  uint32_t samples = 0;   // completed measurements
+  uint32_t missed = 0;    // scheduled slots skipped because the task was a period behind
+  uint32_t late = 0;      // measurements started noticeably after their slot
+  uint32_t errors = 0;    // failed begin/read transactions
+  uint32_t maxLagMs = 0;  // worst start delay after a slot
+  uint32_t periodMs = 0;
+};
+
+// Starts the sampling task. Measurements run on a fixed schedule of `periodMs`; the
+// heater and conversion time is spent blocked in that task, never in the caller's.
+bool envSensorStart(uint32_t periodMs);
+
+bool envLatest(EnvSample& out);  // false until the first sample
+EnvStats envStats();
+
+// The last kEnvHistory samples, numbered from 0 at boot (EnvStats::samples is the next
+// number). Copies up to `maxCount` of them, oldest first, from number `next` on (or from
+// the oldest still held, if that one was overwritten) and moves `next` past the last one.
+size_t envHistory(uint32_t& next, EnvSample* out, size_t maxCount);
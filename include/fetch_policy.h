@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+
+// When to fetch next, and what to send so an unchanged resource is not downloaded again.
+//
+// A good fetch (new data, or 304 Not Modified) schedules the next one at the next slot of a
+// wall-clock grid when the time is known (see setSlots()), else a refresh period later.
+// Consecutive failures back off exponentially from the minimum retry delay up to the
+// refresh period, with "equal jitter": half of each delay is fixed, the other half random,
+// so many stations that lost the same server do not come back in lockstep. A Retry-After
+// from the server is honoured when it asks for longer.
+//
+// The validators (ETag, Last-Modified) of the last full response go out as If-None-Match /
+// If-Modified-Since; they are dropped whenever the request itself changes. Not thread-safe:
+// one task owns the policy and publishes stats() copies.
+
+enum class FetchOutcome : uint8_t { Updated, NotModified, Failed };
+
+struct FetchPolicyStats {
+  uint32_t attempts = 0;
+  uint32_t updated = 0;
+  uint32_t notModified = 0;
+  uint32_t failures = 0;
+  uint16_t failStreak = 0;       // consecutive failures up to now
+  uint16_t successPermille = 0;  // good outcomes among the last kFetchHistory
+  uint32_t lastGoodMs = 0;       // millis() of the last good outcome, if hasGood
+  uint32_t retryMs = 0;          // delay chosen after the last outcome
+  bool hasGood = false;
+};
+
+static constexpr uint8_t kFetchHistory = 32;
+static constexpr size_t kFetchEtagMax = 72;          // including the terminator
+static constexpr size_t kFetchLastModifiedMax = 32;  // "Sun, 06 Nov 1994 08:49:37 GMT"
+static constexpr uint32_t kFetchSlotMinGapSec = 120;
+
+class FetchPolicy {
+ public:
+  FetchPolicy(uint32_t refreshMs, uint32_t retryMinMs)
+      : refreshMs_(refreshMs), retryMinMs_(retryMinMs) {}
+
+  // Seeds the jitter; any non-zero value, e.g. from esp_random().
+  void seed(uint32_t seed) { rng_ = seed ? seed : 1; }
+
+  // Slots fall `offsetSec` past each multiple of `periodSec` in UTC, moved by a random but
+  // fixed share of `spreadSec` so a fleet of stations does not arrive in the same second.
+  // Seed first.
+  void setSlots(uint32_t periodSec, uint32_t offsetSec, uint32_t spreadSec);
+  // Seconds from `unixSec` to the next slot at least kFetchSlotMinGapSec away; the refresh
+  // period when no slots are set.
+  uint32_t slotDelaySec(uint32_t unixSec) const;
+
+  // Records how a fetch ended at `nowMs` and returns the delay until the next one.
+  // `retryAfterMs` is the server's Retry-After, 0 if it sent none; `unixSec` the wall-clock
+  // time, 0 if unknown.
+  uint32_t record(FetchOutcome outcome, uint32_t nowMs, uint32_t retryAfterMs = 0,
+                  uint32_t unixSec = 0);
+
+  // Data restored from elsewhere (a cache) that was good at `goodAtMs`.
+  void noteGood(uint32_t goodAtMs);
+
+  // Validators for the next request; empty when there are none.
+  const char* etag() const { return etag_; }
+  const char* lastModified() const { return lastModified_; }
+  // Keeps the validators of a full response. One too long to store is dropped.
+  void setValidators(const char* etag, const char* lastModified);
+  void clearValidators();
+
+  const FetchPolicyStats& stats() const { return stats_; }
+
+ private:
+  uint32_t nextRandom();
+  uint32_t backoffMs();
+
+  uint32_t refreshMs_;
+  uint32_t retryMinMs_;
+  uint32_t slotPeriodSec_ = 0;  // 0: no slots
+  uint32_t slotShiftSec_ = 0;   // offset plus this station's spread
+  uint32_t rng_ = 1;
+  uint32_t history_ = 0;  // one bit per outcome, 1 = good, newest in bit 0
+  uint8_t historyLen_ = 0;
+  FetchPolicyStats stats_;
+  char etag_[kFetchEtagMax] = "";
+  char lastModified_[kFetchLastModifiedMax] = "";
+};
+
+// Parses a Retry-After value in delta-seconds; the HTTP-date form (and anything else) gives 0.
+uint32_t fetchParseRetryAfterMs(const char* value);
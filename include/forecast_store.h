@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Fixed-capacity forecast in structure-of-arrays layout.
+//
+// Temperatures are tenths of a degree Celsius in int16_t; WMO weather codes are reduced
+// to a 4-bit condition class (all the UI distinguishes) and packed two per byte.
+// Series share one start time and a fixed step, so no per-point timestamps are kept.
+//
+// RAM budget (per copy):
+//   current                         8 B
+//   daily  (7):  min+max 28 B, cond 4 B, precip 7 B      ~ 40 B
+//   hourly (48): temp 96 B, cond 24 B, precip 48 B       ~170 B
+//   headers/counters                                     ~ 16 B
+//   ----------------------------------------------------------------
+//   total                                                <= 256 B (static_assert below)
+
+static constexpr uint8_t kForecastDays = 7;
+static constexpr uint8_t kForecastHours = 48;
+
+static constexpr int16_t kTempUnknown = INT16_MIN;
+static constexpr uint8_t kPrecipUnknown = 0xFF;
+
+enum class WxCond : uint8_t {
+  Unknown = 0,
+  Clear,
+  MostlyClear,
+  Cloudy,
+  Fog,
+  Drizzle,
+  Rain,
+  Snow,
+  Showers,
+  SnowShowers,
+  Thunder,
+};
+
+struct ForecastStore {
+  // Current conditions.
+  uint32_t currentTime = 0;  // unix seconds
+  int16_t currentTempC10 = kTempUnknown;
+  WxCond currentCond = WxCond::Unknown;
+
+  int32_t utcOffsetSec = 0;  // local time = unix + utcOffsetSec
+
+  // Daily series, day 0 starts at local midnight `dailyStart`.
+  uint32_t dailyStart = 0;
+  uint8_t dayCount = 0;
+  int16_t dailyMinC10[kForecastDays];
+  int16_t dailyMaxC10[kForecastDays];
+  uint8_t dailyPrecipPct[kForecastDays];
+  uint8_t dailyCondPacked[(kForecastDays + 1) / 2];
+
+  // Hourly series, one point per hour from `hourlyStart`.
+  uint32_t hourlyStart = 0;
+  uint8_t hourCount = 0;
+  int16_t hourlyTempC10[kForecastHours];
+  uint8_t hourlyPrecipPct[kForecastHours];
+  uint8_t hourlyCondPacked[(kForecastHours + 1) / 2];
+
+  WxCond dailyCond(uint8_t i) const { return unpackCond(dailyCondPacked, i); }
+  WxCond hourlyCond(uint8_t i) const { return unpackCond(hourlyCondPacked, i); }
+  void setDailyCond(uint8_t i, WxCond c) { packCond(dailyCondPacked, i, c); }
+  void setHourlyCond(uint8_t i, WxCond c) { packCond(hourlyCondPacked, i, c); }
+
+  bool hasData() const { return currentTime != 0; }
+
+ private:
+  static WxCond unpackCond(const uint8_t* packed, uint8_t i) {
+    const uint8_t b = packed[i >> 1];
+    return static_cast<WxCond>((i & 1) ? (b >> 4) : (b & 0x0F));
+  }
+  static void packCond(uint8_t* packed, uint8_t i, WxCond c) {
+    const uint8_t v = static_cast<uint8_t>(c) & 0x0F;
+    uint8_t& b = packed[i >> 1];
+    b = (i & 1) ? static_cast<uint8_t>((b & 0x0F) | (v << 4))
+                : static_cast<uint8_t>((b & 0xF0) | v);
+  }
+};
+
+static_assert(sizeof(ForecastStore) <= 256, "ForecastStore exceeds its RAM budget");
+
+void forecastClear(ForecastStore& fc);
+
+int16_t tempToC10(float c);
+WxCond wmoToCond(int code);
+const char* condShortText(WxCond c);  // "Mostly clear"
+const char* condAbbrev(WxCond c);     // <= 4 chars, for narrow columns
+
+// Formats the footer ticker line from the store ("DK: 12°C Cloudy | Today 8–14°C Rain").
+// Returns false (and leaves `out` empty) when the store holds no data.
+bool forecastFormatTicker(const ForecastStore& fc, const char* label, char* out, size_t len);
+
+// Formats a C10 temperature rounded to whole degrees ("-3"); "--" when unknown.
+void formatTempC10(int16_t c10, char* out, size_t len);
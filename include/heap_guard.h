@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Heap health over time, and (in debug builds) a check that loop() runs allocation-free once
+// it reaches steady state.
+//
+// HEAP_GUARD=1 counts every malloc/calloc/realloc made by the watched task. The image must
+// be linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (see the heapguard env in
+// platformio.ini), which routes every reference to those functions through this module.
+// Allocations made directly with heap_caps_malloc() or inside newlib are not seen.
+#ifndef HEAP_GUARD
+#define HEAP_GUARD 0
+#endif
+
+struct HeapStats {
+  uint32_t freeBytes = 0;
+  uint32_t minFreeBytes = 0;      // low-water mark since boot
+  uint32_t largestBlock = 0;      // biggest single allocation possible now
+  uint32_t largestBlockMin = 0;   // its low-water mark over heapSample() calls: fragmentation
+  uint32_t watchedAllocs = 0;     // allocations by the watched task since boot (HEAP_GUARD)
+  uint32_t steadyViolations = 0;  // steady-state passes that allocated (HEAP_GUARD)
+};
+
+// Watches the calling task (loop()) from now on.
+void heapGuardWatch();
+
+// Allocations the watched task has made so far; 0 without HEAP_GUARD.
+uint32_t heapGuardAllocs();
+
+// Closes one pass of the watched task that started at `allocsAtStart`. A steady-state pass
+// that allocated is counted and logged with the caller of its last allocation.
+void heapGuardEndPass(uint32_t allocsAtStart, bool steady);
+
+// Refreshes the low-water marks; call periodically.
+void heapSample();
+HeapStats heapStats();
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "forecast_store.h"
+
+// Small HTTP server for the station's own data, running while the STA link is up:
+//   GET /api/current    current conditions and the room sensor, JSON
+//   GET /api/forecast   daily and hourly forecast of the home site, JSON
+//   GET /metrics        Prometheus text format
+//
+// One task multiplexes a few non-blocking sockets with select(); further connections wait
+// in the listen backlog until a slot frees up. Each slot has one buffer: it holds the
+// request, then the response a buffer's worth of pieces at a time, formatted whenever the
+// socket is writable and sent with Connection: close. A slow reader only waits for itself,
+// no response is ever held in memory whole and nothing is allocated per request.
+
+// What loop() owns and the API serves; loop() publishes a fresh copy about once a second.
+struct ApiState {
+  char label[8];
+  ForecastStore forecast;
+  int weatherStatus;  // HTTP code of the last fetch, <0 client error, 0 none yet
+
+  uint32_t fetches;           // completed weather fetches
+  uint32_t fetchFailures;     // of which did not produce a forecast
+  uint32_t fetchNotModified;  // of which confirmed the forecast unchanged (304)
+  uint32_t fetchMsLast;
+  uint64_t fetchMsTotal;
+  uint16_t fetchSuccessPermille;  // over the last few fetches
+  uint16_t fetchFailStreak;
+  bool dataGood;  // dataGoodMs holds the millis() of the last good fetch
+  uint32_t dataGoodMs;
+
+  int8_t rssi;
+  uint32_t wifiJoinMs;  // time to IP of the current link; 0 if not measured
+  bool wifiJoinFast;    // joined on the cached AP and channel
+  uint8_t batteryPct;
+  bool charging;
+
+  bool dutyCycle;            // the deep-sleep duty cycle is on; the rest is 0 if not
+  uint32_t dutyCycles;       // timer wakes since power-on
+  uint32_t dutyAwakeMsLast;  // the latest timer wake, boot to sleep
+  uint32_t dutyAwakeMsAvg;
+  uint16_t dutyDrainMaX10;  // 0 until known
+  uint16_t dutyBatteryDaysX10;
+
+  uint32_t loopWakeups;
+  uint64_t loopBlockedUs;  // time loop() spent waiting for work
+  uint64_t loopBusyUs;     // time loop() spent running
+  uint32_t loopBusyUsMax;  // longest single pass
+
+  uint32_t frames;
+  uint64_t frameUsTotal;
+  uint32_t frameUsMax;
+  uint32_t latencyUsLast;  // input to photon
+};
+
+struct HttpApiStats {
+  uint32_t requests = 0;
+  uint32_t notFound = 0;
+  uint32_t badRequests = 0;   // malformed, oversized or not GET
+  uint32_t timeouts = 0;      // clients closed before sending a full request
+  uint32_t sendFailures = 0;  // responses cut short: the client left or read too slowly
+  uint32_t clients = 0;       // open right now
+  uint64_t bytesSent = 0;
+  uint32_t handleUsMax = 0;  // most time spent formatting one response
+};
+
+// Creates the server task; it listens only between httpApiSetEnabled(true) and (false).
+bool httpApiStart();
+void httpApiSetEnabled(bool enabled);
+
+void httpApiPublish(const ApiState& st);
+HttpApiStats httpApiStats();
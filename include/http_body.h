@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+
+// Read-only view of one HTTP/1.1 response body on a kept-alive connection.
+// Handles both Content-Length and chunked framing, so a pull parser can read the
+// body directly and the remaining bytes can be drained before the socket is reused.
+class HttpBodyStream : public Stream {
+ public:
+  // contentLength < 0 and !chunked means "read until the server closes".
+  HttpBodyStream(Stream& raw, int contentLength, bool chunked,
+                 const std::atomic<bool>* cancel = nullptr);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char* dst, size_t n) override;
+  using Stream::readBytes;
+  size_t write(uint8_t) override { return 0; }
+
+  // Consumes whatever is left of the body (and the chunked trailer). Returns true
+  // when the body ended cleanly and the connection can carry another request.
+  bool drain();
+
+  bool complete() const { return done_; }
+  bool failed() const { return failed_; }
+
+ private:
+  int rawRead();
+  bool beginChunk();
+
+  Stream& raw_;
+  const std::atomic<bool>* cancel_;
+  bool chunked_;
+  bool untilClose_;
+  bool firstChunk_ = true;
+  bool done_ = false;
+  bool failed_ = false;
+  size_t remaining_ = 0;
+  int peeked_ = -1;
+};
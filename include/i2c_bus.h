@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Owner of the Core2's internal I2C bus (Wire1: AXP192 power, BM8563 RTC, FT6336U touch).
+// One task performs every transaction on it: periodic register reads, batched per device
+// and published as snapshots, and library calls that use the bus themselves (M5.update(),
+// backlight changes), which callers hand over and wait for. The BME680 sits on the Grove
+// bus (Wire) and keeps its own task.
+
+// Scheduling classes, highest priority first. Each class has its own pending slot, and the
+// bus task serves waiting hand-overs in class order between device batches: a touch
+// request waits only for the batch or call already on the bus, never behind queued power
+// or RTC work.
+enum class I2cClass : uint8_t { Touch = 0, Power = 1, Rtc = 2, Count = 3 };
+
+static constexpr uint8_t kI2cClassCount = static_cast<uint8_t>(I2cClass::Count);
+
+// AXP192 status (0x00), battery ADCs (0x78-0x7D) and coulomb counters (0xB0-0xB7), read
+// back to back.
+struct PowerReading {
+  uint32_t ms = 0;  // millis() when read
+  uint16_t batteryMv = 0;
+  uint16_t chargeMa = 0;     // latest ADC sample, 0.5 mA resolution
+  uint16_t dischargeMa = 0;
+  uint32_t coulombIn = 0;    // counts since the counter was enabled, see kAxpCoulombMah
+  uint32_t coulombOut = 0;
+  bool charging = false;
+  bool externalPower = false;  // VBUS or ACIN present
+};
+
+// Charge per coulomb-counter count at the AXP192's default 25 Hz ADC rate:
+// 65536 * 0.5 mA / 3600 / 25 mAh.
+static constexpr float kAxpCoulombMah = 65536 * 0.5f / 3600 / 25;
+
+// BM8563 registers 0x02-0x08 in one burst. `valid` is false when the chip flags a voltage
+// drop (time lost) or returns out-of-range fields.
+struct RtcReading {
+  uint32_t ms = 0;  // millis() when read
+  bool valid = false;
+  uint16_t year = 0;
+  uint8_t month = 0;
+  uint8_t date = 0;
+  uint8_t weekDay = 0;
+  uint8_t hours = 0;
+  uint8_t minutes = 0;
+  uint8_t seconds = 0;
+};
+
+struct I2cClassStats {
+  uint32_t jobs = 0;            // batches and handed-over calls
+  uint32_t transactions = 0;    // register reads issued by the scheduler itself
+  uint32_t errors = 0;          // NACKs and short reads
+  uint64_t busUs = 0;           // time this class held the bus
+  uint64_t latencyUsTotal = 0;  // due/requested until done, summed over jobs
+  uint32_t latencyUsMax = 0;
+};
+
+struct I2cStats {
+  I2cClassStats cls[kI2cClassCount];
+};
+
+// Reads every device once, publishes the results and starts the bus task.
+bool i2cBusStart(uint32_t powerPeriodMs, uint32_t rtcPeriodMs);
+
+// Latest readings; false until the first successful read.
+bool i2cPower(PowerReading& out);
+bool i2cRtc(RtcReading& out);
+// Snapshot versions, to notice new readings without copying them.
+uint32_t i2cPowerVersion();
+
+// Runs `fn(arg)` on the bus task in class `cls` and returns once it finished. Callers of
+// the same class take turns. Before i2cBusStart(), or when called from the bus task, it
+// runs in place.
+void i2cBusRun(I2cClass cls, void (*fn)(void*), void* arg);
+
+I2cStats i2cStats();
+const char* i2cClassName(I2cClass cls);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Home Assistant integration over MQTT 3.1.1 (plain TCP, QoS 0).
+//
+// A task owns the broker connection. On every connect it announces the entities with
+// retained discovery configs under homeassistant/ and marks the device online on
+// <node>/status, whose last will is "offline". Each queued reading becomes one retained
+// JSON message on <node>/state that every entity picks its field from.
+//
+// Readings queue in RAM while the broker is unreachable (the oldest are dropped once the
+// queue is full) and drain at MQTT_DRAIN_PER_S messages per second after a reconnect,
+// several PUBLISH packets per send(), so a backlog neither floods the broker nor holds the
+// Wi-Fi stack busy.
+
+// Backlog drain rate after a reconnect; override with a build flag.
+#ifndef MQTT_DRAIN_PER_S
+#define MQTT_DRAIN_PER_S 5
+#endif
+
+static constexpr size_t kMqttQueueLen = 240;  // 4 h at the default 60 s publish period
+static constexpr uint32_t kMqttBurst = 8;     // messages that may go out back to back
+
+struct MqttConfig {
+  const char* host;  // empty disables the publisher
+  uint16_t port;
+  const char* user;  // empty for anonymous
+  const char* pass;
+  const char* nodeId;  // topic prefix and unique_id base; the strings must outlive the task
+};
+
+// One state message. Unknown values are sent as null; room fields only when `room` is set.
+struct MqttReading {
+  uint32_t ms = 0;             // millis() when queued
+  int16_t outdoorC10 = INT16_MIN;
+  const char* condition = nullptr;  // static text, e.g. condShortText()
+  uint8_t batteryPct = 0;
+  bool charging = false;
+  int8_t rssi = 0;  // 0 while not associated
+  bool room = false;  // the room fields below are valid
+  int16_t roomC100 = 0;
+  uint16_t roomPermille = 0;
+  uint32_t roomPa = 0;
+  uint32_t roomGasOhm = 0;  // 0 when not valid
+};
+
+struct MqttStats {
+  bool connected = false;
+  uint32_t connects = 0;
+  uint32_t connectFailures = 0;
+  uint32_t published = 0;  // PUBLISH packets sent, discovery included
+  uint32_t batches = 0;    // send() calls that carried them
+  uint64_t bytesSent = 0;
+  uint32_t dropped = 0;   // readings lost to a full queue
+  uint32_t queued = 0;    // waiting right now
+  uint32_t queueMax = 0;  // high-water mark
+  uint32_t drainMsLast = 0;  // reconnect until the backlog was empty
+};
+
+// Creates the publisher task; it connects only between mqttSetOnline(true) and (false).
+bool mqttStart(const MqttConfig& cfg);
+void mqttSetOnline(bool online);
+
+// Queues a reading; false if the publisher is not running. Never blocks on the network.
+bool mqttQueue(const MqttReading& r);
+
+MqttStats mqttStats();
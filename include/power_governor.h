@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "i2c_bus.h"
+
+// CPU clock and sleep policy, following the backlight: full speed while the user is
+// interacting, a slow clock and automatic light sleep while dimmed. Light sleep needs a
+// framework built with power management and tickless idle (CONFIG_PM_ENABLE,
+// CONFIG_FREERTOS_USE_TICKLESS_IDLE); without it only the clock is scaled. Battery current
+// is measured per mode from the AXP192 readings the I2C bus task already takes.
+// Single-task: everything except powerWakeFromIsr() is called from loop().
+
+// The Core2's built-in cell.
+#ifndef BATTERY_CAPACITY_MAH
+#define BATTERY_CAPACITY_MAH 390
+#endif
+
+enum class PowerMode : uint8_t { Active = 0, Dimmed = 1, Count = 2 };
+
+static constexpr uint8_t kPowerModeCount = static_cast<uint8_t>(PowerMode::Count);
+
+struct PowerModeStats {
+  uint32_t ms = 0;     // time spent in the mode since boot
+  uint16_t avgMa = 0;  // average battery discharge, 0 until measured
+};
+
+struct PowerGovernorStats {
+  PowerMode mode = PowerMode::Active;
+  uint16_t cpuMhz = 0;
+  bool lightSleep = false;     // automatic light sleep available (used while dimmed)
+  bool externalPower = false;  // USB present: the battery is not being drained
+  uint16_t nowMa = 0;          // latest discharge sample
+  uint32_t runtimeMin = 0;     // estimated battery runtime at the measured mix, 0 if unknown
+  PowerModeStats modes[kPowerModeCount];
+};
+
+// Probes the framework's power management, arms `wakePin` (active low) as a light-sleep
+// wakeup source and enters PowerMode::Active.
+void powerGovernorBegin(uint8_t wakePin);
+
+// Switches clock and sleep policy; a no-op when already in `mode`.
+void powerSetMode(PowerMode mode);
+PowerMode powerMode();
+
+// Attributes a new AXP192 reading to the mode that was active since the previous one.
+// `batteryPct` is the charge level derived from the same reading.
+void powerNoteReading(const PowerReading& reading, uint8_t batteryPct);
+
+PowerGovernorStats powerGovernorStats();
+const char* powerModeName(PowerMode mode);
+
+// Call from the wake pin's ISR. While dimmed the pin is level-triggered so it can end a
+// light sleep; the first interrupt puts it back to falling edge until the next dim.
+void powerWakeFromIsr();
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Per-scope cycle histograms for the loop and render tasks. Build with -DPROFILER=0 to
+// compile the scopes, the Diagnostics tab and the serial command out entirely.
+#ifndef PROFILER
+#define PROFILER 1
+#endif
+
+enum class ProfScope : uint8_t {
+  Loop,      // one loop() pass after it wakes
+  Touch,     // touchTick(), including M5.update() and inputTick()
+  M5Update,  // M5.update() alone: touch controller and AXP reads over I2C
+  Wifi,
+  Input,
+  Compose,  // uiCompose()
+  Render,   // renderFrame() on the render task
+  Ticker,   // uiDrawFooterTicker()
+  Weather,
+  Power,
+  Count,
+};
+
+static constexpr uint8_t kProfScopeCount = static_cast<uint8_t>(ProfScope::Count);
+
+// Quantiles are upper bounds of log-spaced buckets (4 per octave), so they read at most
+// 25% high; max is exact.
+struct ProfSummary {
+  const char* name;
+  uint32_t count;
+  uint32_t p50Cycles;
+  uint32_t p99Cycles;
+  uint32_t maxCycles;
+};
+
+// Adds one sample to a scope's histogram. Does nothing while profiling is switched off.
+void profRecord(ProfScope scope, uint32_t cycles);
+
+void profSetEnabled(bool enabled);
+bool profEnabled();
+void profReset();
+ProfSummary profSummary(ProfScope scope);
+
+// Cycles as microseconds at the current CPU clock: "12.3" below 100 us, "1234" above.
+void profFormatUs(uint32_t cycles, char* out, size_t len);
+
+// Writes one line per scope: count, p50, p99 and max in microseconds.
+void profDump(Print& out);
+
+// Times the enclosing block with ESP.getCycleCount(). Switched off, the cost is the two
+// counter reads and a call that returns at once.
+class ProfTimer {
+ public:
+  explicit ProfTimer(ProfScope scope) : scope_(scope), start_(ESP.getCycleCount()) {}
+  ~ProfTimer() { profRecord(scope_, ESP.getCycleCount() - start_); }
+  ProfTimer(const ProfTimer&) = delete;
+  ProfTimer& operator=(const ProfTimer&) = delete;
+
+ private:
+  ProfScope scope_;
+  uint32_t start_;
+};
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+
+#if PROFILER
+#define PROF_SCOPE(scope) ProfTimer PROF_CONCAT(profTimer_, __LINE__)(scope)
+#else
+#define PROF_SCOPE(scope) \
+  do {                    \
+  } while (0)
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-capacity ring that overwrites its oldest entry when full. No allocation and no
+// locking: callers that share one across tasks guard it themselves.
+template <typename T, size_t N>
+class RingBuffer {
+  static_assert(N > 0, "RingBuffer needs a non-zero capacity");
+
+ public:
+  void push(const T& value) {
+    items_[head_] = value;
+    head_ = (head_ + 1) % N;
+    if (size_ < N) size_++;
+  }
+
+  // Drops the oldest entry, if any.
+  void popOldest() {
+    if (size_ > 0) size_--;
+  }
+
+  void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  static constexpr size_t capacity() { return N; }
+
+  // i = 0 is the oldest entry, size() - 1 the newest.
+  const T& at(size_t i) const { return items_[(head_ + N - size_ + i) % N]; }
+  const T& newest() const { return at(size_ - 1); }
+
+ private:
+  T items_[N] = {};
+  size_t head_ = 0;  // next slot to write
+  size_t size_ = 0;
+};
@@ -12,6 +12,55 @@
 #define WEATHER_LATITUDE 55.6761f
 #define WEATHER_LONGITUDE 12.5683f
 
+// Optional: several sites instead, fetched in one request; the Forecast view and the
+// ticker rotate through them every WEATHER_ROTATE_MS (default 15000). The first is the
+// home site (history, HTTP API, MQTT). Up to WEATHER_LOCATIONS_MAX (12); labels <= 7 chars.
+// Editable at runtime over serial ("loc"), which takes precedence from then on.
+// #define WEATHER_LOCATIONS "DK:55.6761,12.5683;BER:52.52,13.405;OSL:59.9139,10.7522"
+// #define WEATHER_ROTATE_MS 15000
+
+// Optional: time zone of the top-bar clock, as a POSIX TZ string (default Copenhagen), and
+// how many minutes past the hour and half hour (UTC) forecasts are fetched (default 5).
+// #define TIME_ZONE "CET-1CEST,M3.5.0,M10.5.0/3"
+// #define WEATHER_FETCH_OFFSET_MIN 5
+
+// Optional: footer ticker frame rate and scroll speed (defaults: 30 fps, 40 px/s).
+// #define TICKER_FPS 30
+// #define TICKER_SPEED_PX_S 40
+
+// Optional: repaint the whole screen on every UI pass instead of only changed regions
+// (for comparing the "[UI] px/s" serial log against the dirty-rectangle compositor).
+// #define UI_COMPOSITOR_FULL_FRAME
+
+// Optional: wake loop() every 10 ms as the original polling loop did, instead of only on
+// touch/Wi-Fi/worker events and deadlines (compare the "[Loop]" serial log).
+// #define LOOP_POLLING
+
+// Optional: BME680 sample period in ms (default 10000). Missed and late samples show up in
+// the "[Env]" serial log.
+// #define ENV_SAMPLE_MS 10000
+
+// Optional: how often the open history segments are saved to flash, in ms (default
+// 300000). Shorter loses less on power loss but raises the "[TS]" write amplification.
+// #define TS_CHECKPOINT_MS 300000
+
+// Optional: battery duty cycle (default 0 = off). The station deep-sleeps and wakes every
+// DUTY_CYCLE_MIN minutes, and when the forecast is due, to sample, fetch, redraw once and
+// sleep again; a touch wakes it into the normal interactive mode, which sleeps again after
+// 30 s dimmed. DUTY_CYCLE_BACKLIGHT (default 0) lights the panel on timer wakes; build flag
+// DUTY_CYCLE_SLEEP_MA (default 3) is the sleep drain assumed until one is measured.
+// #define DUTY_CYCLE_MIN 10
+// #define DUTY_CYCLE_BACKLIGHT 0
+
+// Optional: Home Assistant over MQTT (off while MQTT_HOST is empty). Entities appear via
+// MQTT discovery; readings queue while offline. Build flag MQTT_DRAIN_PER_S (default 5)
+// sets how fast a backlog is sent after reconnecting.
+// #define MQTT_HOST "192.168.1.10"
+// #define MQTT_PORT 1883
+// #define MQTT_USER ""
+// #define MQTT_PASS ""
+// #define MQTT_PUBLISH_MS 60000
+
 // Optional: password for the Core2 setup AP ("Core2-Setup"). Must be 8..63 chars.
 // Leave empty to keep the setup AP open.
 #define PORTAL_AP_PASS "Edw52Lmao"
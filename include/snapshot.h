@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+// Double-buffered snapshot with a sequence counter (seqlock over two slots).
+//
+// One writer at a time publishes complete values; any number of readers on either core
+// copy the latest one without locks and without disabling interrupts. The writer never
+// waits for readers. A reader only retries if the writer lapped it (two publishes while it
+// was copying), which at weather-update rates does not happen in practice.
+//
+// seq_ is 2n while version n is published and stable, and 2n+1 while version n+1 is being
+// written into the other slot. Version n lives in slots_[n & 1].
+template <typename T>
+class Snapshot {
+  static_assert(std::is_trivially_copyable<T>::value, "Snapshot<T> copies T as raw memory");
+
+ public:
+  // Writer side. Not safe to call from two tasks concurrently.
+  void publish(const T& value) {
+    const uint32_t s = seq_.load(std::memory_order_relaxed) & ~1u;
+    seq_.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slots_[((s >> 1) + 1) & 1] = value;
+    seq_.store(s + 2, std::memory_order_release);
+  }
+
+  // Reader side. Copies the latest complete value and returns its version (0 = never
+  // published). Returns early without copying when `knownVersion` is already current.
+  uint32_t read(T& out, uint32_t knownVersion = UINT32_MAX) const {
+    for (;;) {
+      const uint32_t s1 = seq_.load(std::memory_order_acquire);
+      const uint32_t n = s1 >> 1;
+      if (n == knownVersion) return n;
+      out = slots_[n & 1];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint32_t s2 = seq_.load(std::memory_order_relaxed);
+      // slots_[n & 1] is only rewritten once the writer starts version n + 2 (seq 2n + 3).
+      if (s2 - 2 * n < 3) return n;
+      retries_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  uint32_t version() const { return seq_.load(std::memory_order_acquire) >> 1; }
+  uint32_t retries() const { return retries_.load(std::memory_order_relaxed); }
+
+ private:
+  T slots_[2] = {};
+  std::atomic<uint32_t> seq_{0};
+  mutable std::atomic<uint32_t> retries_{0};
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Cooperative scheduler for loop(): jobs are callbacks due at a millis() time, one-shot or
+// periodic, run by timerRun() on the task that calls it. Nothing here is thread-safe; every
+// call belongs to that one task.
+//
+// A hierarchical timer wheel holds the jobs: four levels of 64 slots at 1, 64, 4096 and
+// 262144 ms, so starting, stopping and expiring a job are O(1). Jobs further out than the
+// wheel's ~4.6 h are parked in its last slot and re-filed when they reach it. Advancing the
+// wheel costs one step per occupied 1 ms slot or per 64 ms window crossed. Times compare by
+// signed difference, so millis() wrapping after ~49.7 days is harmless.
+//
+// Each job keeps its lateness (how long after its due time it actually ran) since the last
+// timerReport().
+
+using TimerFn = void (*)(uint32_t nowMs);
+
+struct TimerJobStats {
+  uint32_t runs = 0;
+  uint32_t lateMsTotal = 0;
+  uint32_t lateMsMax = 0;
+};
+
+// Owned by the caller, usually as a static; the wheel links it in while it is armed.
+struct TimerJob {
+  TimerJob(const char* name, TimerFn fn) : name(name), fn(fn) {}
+  TimerJob(const TimerJob&) = delete;
+  TimerJob& operator=(const TimerJob&) = delete;
+
+  const char* name;
+  TimerFn fn;
+  TimerJobStats stats;
+
+  // Wheel state.
+  uint32_t dueMs = 0;
+  uint32_t periodMs = 0;  // 0 for one-shot
+  uint32_t readyPass = 0;
+  uint16_t slot = UINT16_MAX;  // UINT16_MAX while not armed
+  TimerJob* prev = nullptr;
+  TimerJob* next = nullptr;
+  TimerJob* nextKnown = nullptr;  // every job ever started, for timerReport()
+  bool known = false;
+};
+
+// True once `nowMs` has reached `dueMs`, across millis() wrap-around.
+inline bool timeReached(uint32_t nowMs, uint32_t dueMs) {
+  return static_cast<int32_t>(nowMs - dueMs) >= 0;
+}
+
+// Arms `job` to run `delayMs` from now (or at `dueMs`), then every `periodMs` if non-zero.
+// An armed job is moved. A periodic job that falls more than a period behind skips the
+// missed runs. Due times that have already passed run on the next timerRun().
+void timerStart(TimerJob& job, uint32_t delayMs, uint32_t periodMs = 0);
+void timerStartAt(TimerJob& job, uint32_t dueMs, uint32_t periodMs = 0);
+void timerStop(TimerJob& job);
+bool timerArmed(const TimerJob& job);
+
+// Runs every job due by `nowMs`, in due order. Jobs started from a callback with a due time
+// already passed wait for the next call, so a job that re-arms itself cannot spin.
+// Returns the number of jobs run.
+uint32_t timerRun(uint32_t nowMs);
+
+// When the earliest armed job is due (possibly already); false when nothing is armed.
+bool timerNextDue(uint32_t& dueMs);
+
+// Writes one line with each job's runs and average / maximum lateness since the previous
+// report, then starts a new window.
+void timerReport(Print& out);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Gorilla-style encoding of one fixed-size time-series segment.
+//
+// A point is a uint32 timestamp (seconds) and up to kTsMaxCols int32 values. Inside the
+// bit stream the first point is stored raw; after that:
+//   timestamp  delta-of-delta: '0' (same step), '10'+7 bits, '110'+9 bits, '1110'+12 bits,
+//              or '1111' + the raw 32-bit delta
+//   value      XOR with the previous value of its column: '0' (unchanged), '10' + the
+//              meaningful bits inside the previous leading/trailing-zero window, or
+//              '11' + 5-bit leading zeros + 5-bit length-1 + the meaningful bits
+// Values are fixed-point integers, so a slowly drifting sensor XORs to a few low bits.
+// Timestamps must increase strictly.
+
+static constexpr uint8_t kTsMaxCols = 3;
+static constexpr size_t kTsSegmentBytes = 1024;
+static constexpr uint16_t kTsSegmentMagic = 0x5453;  // "TS"
+
+struct TsSegmentHeader {
+  uint16_t magic;
+  uint8_t cols;
+  uint8_t reserved;
+  uint16_t count;  // points in the segment
+  uint16_t bits;   // used bits of the payload
+  uint32_t firstTs;
+  uint32_t lastTs;
+  uint32_t crc;  // CRC32 over the preceding header bytes and the used payload bytes
+};
+
+static constexpr size_t kTsPayloadBytes = kTsSegmentBytes - sizeof(TsSegmentHeader);
+
+struct TsSegment {
+  TsSegmentHeader hdr;
+  uint8_t payload[kTsPayloadBytes];
+
+  size_t usedBytes() const { return sizeof(hdr) + (hdr.bits + 7u) / 8u; }
+};
+static_assert(sizeof(TsSegment) == kTsSegmentBytes, "TsSegment must fill a segment exactly");
+
+// Encoder/decoder state after a point. Kept separately so an encoder can pick up a
+// segment restored from flash by decoding it once.
+struct TsCodecState {
+  uint32_t bitPos = 0;
+  uint16_t count = 0;
+  uint32_t prevTs = 0;
+  int64_t prevDelta = 0;
+  int32_t prev[kTsMaxCols] = {};
+  uint8_t lead[kTsMaxCols] = {};
+  uint8_t trail[kTsMaxCols] = {};
+  bool window[kTsMaxCols] = {};  // lead/trail hold a reusable XOR window
+};
+
+class TsEncoder {
+ public:
+  // Starts an empty segment in `seg` with `cols` values per point.
+  void reset(TsSegment* seg, uint8_t cols);
+  // Continues appending to an existing segment; false if it does not decode cleanly.
+  bool resume(TsSegment* seg);
+
+  // False if the point does not fit (seal the segment and start a new one) or its
+  // timestamp is not after the previous one.
+  bool append(uint32_t ts, const int32_t* values);
+
+  uint16_t count() const { return st_.count; }
+  uint32_t bits() const { return st_.bitPos; }
+
+ private:
+  void putBits(uint32_t v, uint8_t n);
+
+  TsSegment* seg_ = nullptr;
+  TsCodecState st_;
+};
+
+class TsDecoder {
+ public:
+  explicit TsDecoder(const TsSegment& seg) : seg_(seg) {}
+
+  // Next point in order; false at the end of the segment or on a corrupt stream.
+  bool next(uint32_t& ts, int32_t* values);
+
+  bool corrupt() const { return corrupt_; }
+  const TsCodecState& state() const { return st_; }
+
+ private:
+  bool getBits(uint8_t n, uint32_t& out);
+
+  const TsSegment& seg_;
+  TsCodecState st_;
+  bool corrupt_ = false;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Append-only station history on LittleFS.
+//
+// Each series has three tiers: raw points, hourly and daily rollups (mean, min, max).
+// A tier is a file of fixed-size ts_codec segments plus an index of their time ranges; the
+// open segment lives in RAM and is checkpointed to a tail file every TS_CHECKPOINT_MS.
+// When a file reaches its segment limit it becomes the previous generation and a new one
+// starts, so each tier holds between one and two files' worth of history.
+//
+// A background task owns the files: it drains appends, seals full segments and compacts
+// completed hours and days into the rollup tiers. Queries run in the caller's task, read
+// the index and then only the segments that overlap the range, one at a time.
+//
+// Timestamps are RTC seconds since 2000-01-01 and must increase within a series.
+
+#ifndef TS_CHECKPOINT_MS
+#define TS_CHECKPOINT_MS 300000
+#endif
+
+// Values are fixed-point integers in the unit noted.
+enum class TsSeries : uint8_t {
+  RoomTemp = 0,  // °C x100
+  RoomHumidity,  // ‰ RH
+  RoomPressure,  // Pa
+  RoomGas,       // ohm
+  OutdoorTemp,   // °C x10, from the forecast's current conditions
+  Count,
+};
+
+enum class TsTier : uint8_t { Raw = 0, Hourly, Daily, Count };
+
+struct TsPoint {
+  uint32_t ts;   // raw: sample time; rollups: start of the hour/day
+  int32_t mean;  // raw: the value itself
+  int32_t min;
+  int32_t max;
+};
+
+struct TsSummary {
+  uint32_t count = 0;
+  int32_t mean = 0;
+  int32_t min = 0;
+  int32_t max = 0;
+};
+
+struct TsStats {
+  bool mounted = false;
+  uint32_t points = 0;     // raw points stored
+  uint32_t rollups = 0;    // hourly and daily points written by compaction
+  uint32_t dropped = 0;    // appends lost to a full queue
+  uint32_t rejected = 0;   // appends at or before the series' last timestamp
+  uint32_t segments = 0;   // segments sealed
+  uint32_t checkpoints = 0;
+  uint32_t encodedBytes = 0;  // compressed point data
+  uint32_t rawBytes = 0;      // the same points as a 4-byte timestamp + 4 bytes per value
+  uint32_t fsBytes = 0;       // bytes written to files (segments, indexes, tails)
+  uint32_t fsBlocks = 0;      // estimated 4 KB flash blocks programmed for those writes
+  uint32_t fsUsed = 0;
+  uint32_t fsTotal = 0;
+  uint32_t queryUsLast = 0;
+  uint32_t queryUsMax = 0;
+};
+
+using TsVisitFn = void (*)(const TsPoint& p, void* ctx);
+
+// Mounts LittleFS (formatting it if needed), restores every tier and starts the task.
+bool tsStart();
+
+// Queues a raw point; false if the store is not running or the queue is full.
+bool tsAppend(TsSeries series, uint32_t ts, int32_t value);
+
+// Stores queued points and checkpoints the open segments now, e.g. before deep sleep, which
+// loses RAM. Blocks while the task is writing.
+void tsFlush();
+
+// Calls `fn` for each point of the tier in [fromTs, toTs), oldest first. Returns the
+// number of points visited, or -1 if the store is not running. Blocks while the task is
+// writing.
+int tsQuery(TsSeries series, TsTier tier, uint32_t fromTs, uint32_t toTs, TsVisitFn fn,
+            void* ctx);
+
+// Tier for a span: raw up to 6 hours, hourly up to 60 days, then daily. Rollup tiers end
+// at the last completed hour or day.
+TsTier tsTierFor(uint32_t spanSec);
+
+// Mean/min/max over [fromTs, toTs) using tsTierFor(); false if there are no points.
+bool tsSummarize(TsSeries series, uint32_t fromTs, uint32_t toTs, TsSummary& out);
+
+TsStats tsStats();
+
+#ifdef PIO_UNIT_TESTING
+// Loses the open segments and the queue and restores every tier from the files, as a reboot
+// does. For the unit tests, which cannot restart the process.
+void tsRestart();
+#endif
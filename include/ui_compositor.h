@@ -0,0 +1,163 @@
+#pragma once
+
+#include <M5Core2.h>
+
+// Send composited bands with DMA (needs TFT_eSPI's ESP32 DMA support in the display
+// driver). Build with -DUI_RENDER_DMA=0 to fall back to blocking pushImage().
+#ifndef UI_RENDER_DMA
+#define UI_RENDER_DMA 1
+#endif
+
+struct Rect {
+  int16_t x = 0;
+  int16_t y = 0;
+  int16_t w = 0;
+  int16_t h = 0;
+
+  constexpr Rect() = default;
+  constexpr Rect(int16_t x_, int16_t y_, int16_t w_, int16_t h_) : x(x_), y(y_), w(w_), h(h_) {}
+
+  bool contains(int16_t px, int16_t py) const {
+    return px >= x && py >= y && px < (x + w) && py < (y + h);
+  }
+  bool empty() const { return w <= 0 || h <= 0; }
+  int32_t area() const { return empty() ? 0 : static_cast<int32_t>(w) * h; }
+  bool intersects(const Rect& o) const {
+    return !empty() && !o.empty() && x < o.x + o.w && o.x < x + w && y < o.y + o.h &&
+           o.y < y + h;
+  }
+  bool operator==(const Rect& o) const { return x == o.x && y == o.y && w == o.w && h == o.h; }
+  bool operator!=(const Rect& o) const { return !(*this == o); }
+};
+
+Rect rectUnion(const Rect& a, const Rect& b);
+Rect rectIntersect(const Rect& a, const Rect& b);
+
+enum class TextAlign : uint8_t { Left = 0, Centre = 1 };
+
+enum class WidgetKind : uint8_t {
+  None = 0,
+  Fill,     // solid rectangle
+  Text,     // one line of text, left-aligned or centred in its bounds
+  Tab,      // top-bar tab
+  Pill,     // rounded status pill with centred label
+  InfoRow,  // muted label + value
+  Button,   // rounded outlined button
+  Battery,  // battery gauge with optional charging bolt
+  Custom,   // caller-drawn; repainted when its content version changes
+};
+
+// Draws a custom widget into `g`, whose pixel (0,0) is screen position (ox, oy).
+using CustomDrawFn = void (*)(TFT_eSPI& g, const Rect& bounds, int16_t ox, int16_t oy);
+
+// Everything that determines a widget's pixels. Two equal contents draw identically, so
+// the compositor compares them byte-wise to decide what is dirty.
+struct WidgetContent {
+  WidgetKind kind;
+  uint8_t font;
+  TextAlign align;
+  uint8_t flags;
+  Rect bounds;
+  uint16_t colors[4];  // meaning depends on kind, see Compositor::draw()
+  int16_t param;       // InfoRow: value x; Battery: percent
+  uint32_t version;    // Custom: content version
+  CustomDrawFn fn;
+  char label[16];
+  char text[48];
+};
+
+// Frame description: the widgets of one UI pass in painting order. Built by the UI task
+// and handed to the render task by value, so it holds no pointers into UI state other
+// than custom draw functions.
+class UiFrame {
+ public:
+  static constexpr uint8_t kMaxWidgets = 48;
+
+  void clear() { count_ = 0; }
+  uint8_t count() const { return count_; }
+  const WidgetContent& widget(uint8_t i) const { return widgets_[i]; }
+
+  void fill(const Rect& r, uint16_t color);
+  void text(const Rect& r, const char* s, uint8_t font, uint16_t fg, uint16_t bg,
+            TextAlign align = TextAlign::Left);
+  void tab(const Rect& r, const char* label, uint16_t fg, uint16_t bg);
+  void pill(const Rect& r, const char* label, uint16_t fg, uint16_t bg);
+  void infoRow(const Rect& r, int16_t valueX, const char* label, const char* value,
+               uint16_t labelFg, uint16_t valueFg, uint16_t bg);
+  void button(const Rect& r, const char* label, uint16_t fill, uint16_t outline, uint16_t fg);
+  void battery(const Rect& r, uint8_t pct, bool charging, uint16_t level, uint16_t outline,
+               uint16_t trough, uint16_t bolt);
+  void custom(const Rect& r, CustomDrawFn fn, uint32_t version);
+
+ private:
+  WidgetContent& add(WidgetKind kind, const Rect& r);
+
+  WidgetContent widgets_[kMaxWidgets];
+  WidgetContent overflow_;  // sink for widgets past kMaxWidgets
+  uint8_t count_ = 0;
+};
+
+// Retained widget list with damage tracking.
+//
+// render() compares each widget of a frame with the one in the same position of the
+// previous frame. Widgets whose content differs (or that appeared or disappeared) add their
+// old and new bounds to the damage list. Overlapping and nearby damage rectangles are
+// merged, and only those are repainted: every intersecting widget is composited into a
+// band buffer that goes to the panel as one SPI window per band.
+//
+// With UI_RENDER_DMA each band is copied into one of two DMA buffers and sent without
+// waiting, so the next band is drawn while the previous one is still transferring.
+// Not thread-safe: one task owns the compositor and the panel.
+class Compositor {
+ public:
+  static constexpr uint8_t kMaxDamage = 16;
+  static constexpr int16_t kBandRows = 24;
+
+  bool begin(TFT_eSPI* lcd, uint16_t bg);
+
+  // Paints the damage between the previous frame and `frame`; returns pixels pushed.
+  // Returns once every transfer has finished.
+  uint32_t render(const UiFrame& frame);
+
+  void invalidate(const Rect& r);
+  void invalidateAll();
+
+  // True if the last render() repainted any part of `r` (e.g. to redraw an overlay).
+  bool lastFrameTouched(const Rect& r) const;
+
+  // Lets other direct pushes (the ticker) count towards the pixel statistics.
+  void notePush(uint32_t pixels) {
+    pixelsPushed_ += pixels;
+    pushes_++;
+  }
+  uint32_t pixelsPushed() const { return pixelsPushed_; }
+  uint32_t pushes() const { return pushes_; }
+  bool dmaEnabled() const { return dmaBuf_[1] != nullptr; }
+
+ private:
+  void declare(const WidgetContent& c);
+  void addDamage(const Rect& r);
+  void mergeDamage();
+  void flushRect(const Rect& r);
+  void pushBand(const Rect& band);
+  void draw(TFT_eSPI& g, const WidgetContent& c, int16_t ox, int16_t oy);
+
+  TFT_eSPI* lcd_ = nullptr;
+  TFT_eSprite* band_ = nullptr;
+  uint16_t* dmaBuf_[2] = {nullptr, nullptr};
+  uint8_t dmaNext_ = 0;
+  uint16_t bg_ = 0;
+  Rect screen_;
+
+  WidgetContent widgets_[UiFrame::kMaxWidgets];
+  uint8_t count_ = 0;     // widgets on screen after the last render()
+  uint8_t declared_ = 0;  // widgets declared so far in this render()
+
+  Rect damage_[kMaxDamage];
+  uint8_t damageCount_ = 0;
+  Rect flushed_[kMaxDamage];
+  uint8_t flushedCount_ = 0;
+
+  uint32_t pixelsPushed_ = 0;
+  uint32_t pushes_ = 0;
+};
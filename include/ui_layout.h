@@ -0,0 +1,146 @@
+#pragma once
+
+#include "ui_compositor.h"
+
+// Declarative view layouts. A view is a constexpr table of rows; layoutRows() places them
+// at compile time, and layoutCompose() turns the placed table into widgets of a UiFrame.
+// What changed between two frames, and what gets repainted, is the compositor's job, so a
+// view described this way needs no drawing or diffing code of its own.
+//
+// Rows stack top to bottom, each taking `advance` pixels. Alternatives share vertical
+// space: rows between when() markers are placed from the same y, the first marker whose
+// predicate holds is drawn, and the block ends at endWhen() below its tallest alternative.
+
+// The Core2 panel in its default landscape rotation.
+static constexpr int16_t kLayoutScreenW = 320;
+static constexpr int16_t kLayoutScreenH = 240;
+static constexpr int16_t kLayoutMarginX = 12;
+static constexpr int16_t kLayoutValueX = 108;  // InfoRow value column
+static constexpr int16_t kLayoutLineH = 18;    // font 2 line
+static constexpr int16_t kLayoutTitleH = 26;   // font 4 line
+static constexpr int16_t kLayoutInfoRowH = 24;
+
+enum class RowKind : uint8_t {
+  Text,     // one line in font 2 (or 4): fixed text, or bind()
+  InfoRow,  // muted label, bound value
+  Pill,     // full-width status pill: bind() label on a tint() background
+  When,     // starts an alternative; `when` null means otherwise
+  EndWhen,  // closes the alternatives
+};
+
+// Palette slots, resolved when composing; the colors themselves are set up at runtime.
+enum class UiColor : uint8_t { Text = 0, Muted = 1, Count = 2 };
+
+// Writes a row's text into `buf` (or returns a string that outlives the call).
+using RowBind = const char* (*)(char* buf, size_t len);
+using RowTint = uint16_t (*)();
+using RowPred = bool (*)();
+
+struct RowSpec {
+  RowKind kind = RowKind::Text;
+  uint8_t font = 2;
+  int16_t h = 0;        // drawn height
+  int16_t advance = 0;  // y step to the next row
+  UiColor color = UiColor::Muted;
+  const char* text = nullptr;  // Text: fixed text; InfoRow: label
+  RowBind bind = nullptr;
+  RowTint tint = nullptr;
+  RowPred when = nullptr;
+};
+
+struct RowPlaced {
+  RowSpec spec;
+  Rect bounds;
+};
+
+template <size_t N>
+struct Layout {
+  RowPlaced rows[N];
+  int16_t bottom = 0;  // y below the last row
+};
+
+// Row constructors for the tables.
+constexpr RowSpec rowText(const char* s, UiColor c = UiColor::Muted,
+                          int16_t advance = kLayoutLineH) {
+  return RowSpec{RowKind::Text, 2, kLayoutLineH, advance, c, s, nullptr, nullptr, nullptr};
+}
+constexpr RowSpec rowText(RowBind b, UiColor c = UiColor::Muted,
+                          int16_t advance = kLayoutLineH) {
+  return RowSpec{RowKind::Text, 2, kLayoutLineH, advance, c, nullptr, b, nullptr, nullptr};
+}
+constexpr RowSpec rowTitle(const char* s, int16_t advance) {
+  return RowSpec{
+      RowKind::Text, 4, kLayoutTitleH, advance, UiColor::Text, s, nullptr, nullptr, nullptr};
+}
+constexpr RowSpec rowInfo(const char* label, RowBind value) {
+  return RowSpec{RowKind::InfoRow,
+                 2,
+                 kLayoutLineH,
+                 kLayoutInfoRowH,
+                 UiColor::Text,
+                 label,
+                 value,
+                 nullptr,
+                 nullptr};
+}
+constexpr RowSpec rowPill(int16_t h, int16_t advance, RowBind label, RowTint bg) {
+  return RowSpec{RowKind::Pill, 2, h, advance, UiColor::Text, nullptr, label, bg, nullptr};
+}
+constexpr RowSpec when(RowPred p) {
+  return RowSpec{RowKind::When, 0, 0, 0, UiColor::Muted, nullptr, nullptr, nullptr, p};
+}
+constexpr RowSpec otherwise() { return when(nullptr); }
+constexpr RowSpec endWhen() {
+  return RowSpec{RowKind::EndWhen, 0, 0, 0, UiColor::Muted, nullptr, nullptr, nullptr, nullptr};
+}
+
+// Places `spec` from y = `top`. Evaluated at compile time for constexpr tables.
+template <size_t N>
+constexpr Layout<N> layoutRows(const RowSpec (&spec)[N], int16_t top) {
+  Layout<N> out{};
+  int16_t y = top;
+  int16_t caseTop = top;
+  int16_t caseBottom = top;
+  bool inCase = false;
+  for (size_t i = 0; i < N; i++) {
+    const RowSpec& s = spec[i];
+    out.rows[i].spec = s;
+    switch (s.kind) {
+      case RowKind::When:
+        if (inCase) {
+          caseBottom = y > caseBottom ? y : caseBottom;
+        } else {
+          caseTop = caseBottom = y;
+          inCase = true;
+        }
+        y = caseTop;
+        break;
+      case RowKind::EndWhen:
+        y = y > caseBottom ? y : caseBottom;
+        inCase = false;
+        break;
+      case RowKind::Pill:
+        out.rows[i].bounds = Rect{kLayoutMarginX, y, kLayoutScreenW - 2 * kLayoutMarginX, s.h};
+        y += s.advance;
+        break;
+      case RowKind::Text:
+      case RowKind::InfoRow:
+        out.rows[i].bounds = Rect{kLayoutMarginX, y, kLayoutScreenW - kLayoutMarginX, s.h};
+        y += s.advance;
+        break;
+    }
+  }
+  out.bottom = y;
+  return out;
+}
+
+// Emits the rows of a placed layout, skipping alternatives whose predicate fails.
+// `palette` is indexed by UiColor.
+void layoutCompose(UiFrame& frame, const RowPlaced* rows, size_t count, const uint16_t* palette,
+                   uint16_t bg);
+
+template <size_t N>
+void layoutCompose(UiFrame& frame, const Layout<N>& layout, const uint16_t* palette,
+                   uint16_t bg) {
+  layoutCompose(frame, layout.rows, N, palette, bg);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <ctime>
+
+#include "i2c_bus.h"
+
+// Wall-clock time for the station. SNTP sets it while the network is up; after a reboot the
+// BM8563 RTC, which every sync writes back, stands in until SNTP answers again. The clock
+// counts from a base (Unix seconds at a millis() instant), published as a Snapshot, so
+// reading it is cheap, lock-free and safe from any task.
+
+enum class ClockSource : uint8_t { None, Rtc, Ntp };
+
+struct WallClockStats {
+  ClockSource source = ClockSource::None;
+  uint32_t syncs = 0;        // SNTP updates since boot
+  uint32_t lastSyncMs = 0;   // millis() of the latest, if syncs > 0
+  int32_t lastStepMs = 0;    // how far the latest moved the clock; 0 when it was unset
+  uint32_t rtcWrites = 0;
+};
+
+// Sets the POSIX time zone for local time (e.g. "CET-1CEST,M3.5.0,M10.5.0/3") and seeds the
+// clock from the RTC when it holds a plausible time. Call after i2cBusStart().
+void wallClockBegin(const char* tz);
+
+// Starts SNTP; call once the network is up. Later calls do nothing.
+void wallClockStartSync();
+
+// Copies a fresh SNTP time to the RTC and keeps the base close to millis(). Call every few
+// minutes from any task but the bus task.
+void wallClockTick();
+
+// Unix time; false while the clock is unset.
+bool wallClockNow(uint32_t& unixSec);
+// Local time in the configured zone; false while the clock is unset.
+bool wallClockLocal(tm& out);
+
+WallClockStats wallClockStats();
+const char* clockSourceName(ClockSource source);
+
+// Days since 1970-01-01 of a proleptic Gregorian date.
+int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d);
+// Unix seconds of the time an RTC reading shows, as of when it was read (`rtc.ms`).
+uint32_t rtcUnixSec(const RtcReading& rtc);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "forecast_store.h"
+
+// Last decoded forecast of each site, persisted in NVS so the footer has data right after
+// boot. Each slot is a small header (magic, version, timestamp, the site's coordinates), the
+// raw ForecastStore and a CRC32; anything that does not validate is ignored and the next
+// fetch overwrites it.
+struct WeatherCacheEntry {
+  ForecastStore forecast;
+  int32_t latE4 = 0;  // site the forecast was fetched for
+  int32_t lonE4 = 0;
+  uint32_t savedAtSec = 0;  // RTC seconds (since 2000-01-01) when the entry was written
+};
+
+bool weatherCacheSave(uint8_t slot, const WeatherCacheEntry& entry);
+bool weatherCacheLoad(uint8_t slot, WeatherCacheEntry& entry);
+
+uint32_t crc32Update(uint32_t crc, const void* data, size_t len);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Forecast sites, all fetched in one Open-Meteo request (comma-separated coordinates).
+//
+// The list is edited at runtime ("loc" serial commands) and kept in NVS. Text form, as
+// typed and as logged: "DK:55.6761,12.5683;BER:52.52,13.405". Coordinates are held in
+// 1e-4 degrees, the precision the request uses, so a site compares equal to the forecast
+// fetched for it.
+
+#ifndef WEATHER_LOCATIONS_MAX
+#define WEATHER_LOCATIONS_MAX 12
+#endif
+
+static constexpr uint8_t kWeatherLocationsMax = WEATHER_LOCATIONS_MAX;
+static constexpr size_t kWeatherLabelMax = 8;      // including the terminator
+static constexpr size_t kWeatherSiteTextMax = 28;  // "LABEL:-90.0000,-180.0000;"
+
+struct WeatherLocation {
+  char label[kWeatherLabelMax] = "";
+  int32_t latE4 = 0;
+  int32_t lonE4 = 0;
+
+  bool sameSite(int32_t lat, int32_t lon) const { return latE4 == lat && lonE4 == lon; }
+};
+
+struct WeatherLocations {
+  uint8_t count = 0;
+  WeatherLocation at[kWeatherLocationsMax];
+};
+
+// Parses one or more "LABEL:lat,lon" entries separated by ';' and appends them to `list`.
+// On any error `list` is left as it was and `error` says why.
+bool weatherLocationsParse(const char* text, WeatherLocations& list, const char*& error);
+
+// Removes the site with this label (case-insensitive). Returns false if there is none.
+bool weatherLocationsRemove(WeatherLocations& list, const char* label);
+
+// Writes the list in its text form; returns the length snprintf() would have produced.
+int weatherLocationsFormat(const WeatherLocations& list, char* out, size_t len);
+
+// Writes "&latitude=a,b,...&longitude=a,b,..." for the forecast URL.
+int weatherLocationsQuery(const WeatherLocations& list, char* out, size_t len);
+
+// NVS. Load fails (and leaves `list` untouched) when nothing valid was saved; clearing
+// falls back to the build's default list on the next boot.
+bool weatherLocationsSave(const WeatherLocations& list);
+bool weatherLocationsLoad(WeatherLocations& list);
+bool weatherLocationsClear();
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "forecast_store.h"
+
+// Per-parse resource accounting, reported after every fetch.
+struct WeatherParseStats {
+  size_t bytesRead = 0;     // raw JSON bytes consumed from the stream
+  size_t bytesSkipped = 0;  // of those, series elements past the store's capacity
+  size_t docPeakBytes = 0;  // high-water mark of the filtered JsonDocument
+  uint32_t parseMs = 0;
+  uint8_t locations = 0;    // forecasts handed to the sink
+  const char* error = "";   // ArduinoJson error string; empty on success
+};
+
+// Receives each decoded forecast; `index` is the site's position in the request.
+using WeatherForecastSink = void (*)(uint8_t index, const ForecastStore& fc);
+
+// Parses the response body straight from `in` (no intermediate String) and keeps
+// only the fields the UI displays. Series elements past the store's capacity are
+// dropped as they stream in, before the document stores them, so memory use does
+// not grow with forecast_days or forecast_hours. Expects `timeformat=unixtime`.
+//
+// A request for several coordinates is answered with a JSON array of per-site objects.
+// They are decoded one at a time into the same document and handed to `sink` as they
+// complete, so neither the document nor the scratch forecast grows with the number of
+// sites. Returns true when all `expected` sites were decoded.
+bool weatherParseStream(Stream& in,
+                        uint8_t expected,
+                        WeatherForecastSink sink,
+                        WeatherParseStats& stats);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Where the station last joined its network, so the next join can go straight to the same
+// access point and channel instead of scanning, and skip DHCP while the lease it got is
+// recent. Kept in RTC memory, which survives resets and deep sleep, and in NVS, which also
+// survives power loss; NVS is written only when the access point or address changes.
+
+struct WifiFastRecord {
+  char ssid[33] = "";
+  uint8_t bssid[6] = {};
+  uint8_t channel = 0;
+  uint32_t ip = 0;  // as IPAddress converts; 0 when no lease is known
+  uint32_t gateway = 0;
+  uint32_t subnet = 0;
+  uint32_t dns = 0;
+  uint32_t leaseUnix = 0;  // Unix time DHCP handed out `ip`; 0 if unknown
+};
+
+// The RTC copy when it is intact, else the NVS one. False when neither validates.
+bool wifiFastLoad(WifiFastRecord& rec);
+void wifiFastSave(const WifiFastRecord& rec);
+// Drops both copies, e.g. when the saved credentials are erased.
+void wifiFastForget();
@@ -0,0 +1,625 @@
+// Host benchmarks for the firmware's hot paths, built by [env:native] against the stand-ins
+// in native/hal. Each result is one JSON object per line on stdout:
+//
+//   {"bench":"ui_full_frame/status","iters":2000,"ns_per_iter":41250,
+//    "pixels_per_iter":76800.0,"spi_tx_per_iter":38.0,"allocs_per_iter":0.0}
+//
+// pixels and SPI transactions are what the panel would have received; ns are host time and
+// only meaningful relative to another run on the same machine. allocs are heap allocations
+// made on the benchmark thread (built with HEAP_GUARD); the steady-state paths should show
+// none. The parser benchmarks add the JSON document's peak, the stack one parse used and the
+// series bytes dropped past the store, "doc_peak_bytes", "stack_peak_bytes" and
+// "skipped_bytes"; the loop() ones the wakeup counters /metrics exports, as "wakeups_per_s",
+// "blocked_pct", "busy_us_per_s" and "busy_us_max"; the history queries the points they
+// summarized, as "points"; the HTTP load runs frame times and scrape counts, as
+// "frame_us_avg", "frame_us_max", "scrapers", "responses" and "incomplete". The firmware's
+// own tasks are not started, except the history store's and the API server's: every
+// benchmark drives main.cpp's functions directly. The run fails if any API response arrived
+// incomplete.
+
+// `pio test -e native` links this directory into each test program too, which brings its
+// own main() and needs none of the benchmarks.
+#ifndef PIO_UNIT_TESTING
+
+#include "../../src/main.cpp"
+
+#include <hal.h>
+
+#include <lwip/sockets.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "open_meteo_payload.h"
+
+namespace {
+
+constexpr uint32_t kMinIters = 50;
+constexpr uint64_t kMinRunNs = 200ULL * 1000 * 1000;
+
+// Extra fields for the next result line, e.g. ,"doc_peak_bytes":5120; set by a prep.
+char gBenchExtra[160] = "";
+
+uint64_t wallNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Prints one result line; the panel counters and gBenchExtra are consumed.
+void report(const char* name, uint32_t iters, uint64_t elapsedNs, uint32_t allocs) {
+  printf("{\"bench\":\"%s\",\"iters\":%u,\"ns_per_iter\":%llu,"
+         "\"pixels_per_iter\":%.1f,\"spi_tx_per_iter\":%.1f,\"allocs_per_iter\":%.1f%s}\n",
+         name,
+         iters,
+         static_cast<unsigned long long>(elapsedNs / iters),
+         static_cast<double>(M5.Lcd.pixelsWritten()) / iters,
+         static_cast<double>(M5.Lcd.transactions()) / iters,
+         static_cast<double>(allocs) / iters,
+         gBenchExtra);
+  fflush(stdout);
+  gBenchExtra[0] = '\0';
+}
+
+// Runs `fn(i)` for at least kMinIters iterations and kMinRunNs, then reports per-iteration
+// cost. `prep` runs once before the timed loop, outside the measurement.
+template <typename Prep, typename Fn>
+void bench(const char* name, Prep prep, Fn fn) {
+  prep();
+  M5.Lcd.resetCounters();
+  const uint32_t allocs0 = heapGuardAllocs();
+  const uint64_t t0 = wallNs();
+  uint64_t elapsed = 0;
+  uint32_t iters = 0;
+  while (iters < kMinIters || elapsed < kMinRunNs) {
+    fn(iters++);
+    elapsed = wallNs() - t0;
+  }
+  report(name, iters, elapsed, heapGuardAllocs() - allocs0);
+}
+
+// The host has no task high-water mark, so stack use is found by painting: the probe's
+// frame covers the stack just below its caller, which `fn` then runs over.
+constexpr size_t kStackProbeBytes = 64 * 1024;
+constexpr uint8_t kStackPaint = 0xA5;
+
+// The scan reads what the previous call and `fn` left in the array, so it is uninitialized
+// on purpose.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((noinline)) size_t stackProbe(bool scan) {
+  volatile uint8_t area[kStackProbeBytes];
+  if (!scan) {
+    for (size_t i = 0; i < kStackProbeBytes; i++) area[i] = kStackPaint;
+    return 0;
+  }
+  size_t untouched = 0;  // the stack grows down: area[0] is the deepest byte
+  while (untouched < kStackProbeBytes && area[untouched] == kStackPaint) untouched++;
+  return kStackProbeBytes - untouched;
+}
+#pragma GCC diagnostic pop
+
+template <typename Fn>
+size_t stackUsed(Fn fn) {
+  stackProbe(false);
+  fn();
+  return stackProbe(true);
+}
+
+// What renderTaskMain() does with a newly published frame.
+void benchRender() {
+  static RenderStats stats;
+  static uint32_t version = 0;
+  static uint32_t lastInputUs = 0;
+  version = gRenderFrame.read(gRenderCopy, version);
+  renderFrame(stats, lastInputUs);
+}
+
+const char* viewName(View v) {
+  switch (v) {
+    case View::Status:
+      return "status";
+    case View::Forecast:
+      return "forecast";
+    case View::WiFi:
+      return "wifi";
+    case View::About:
+      return "about";
+#if PROFILER
+    case View::Diagnostics:
+      return "diagnostics";
+#endif
+  }
+  return "?";
+}
+
+// The parts of setup() the benchmarks need, with the link up and one forecast fetched so
+// every view has content. Fills in the request URL the worker would use.
+void benchSetup(WiFiClientSecure& client, HTTPClient& https, char* url, size_t urlLen) {
+  M5.begin();
+  gLoopEvents = xEventGroupCreate();
+  WiFi.onEvent(wifiOnEvent);
+  i2cBusStart(kBatterySampleMs, kRtcSyncMs);
+  batterySampleTick();
+  wallClockBegin(TIME_ZONE);
+  uiInit();
+  weatherSitesBegin();
+  weatherPolicyBegin();
+  weatherShowSite(0);
+  weatherWorkerSync(url, urlLen);
+
+  hal::wifiScript(1200, WL_CONNECTED);
+  wifiStartConnecting();
+  hal::clockAdvance(1200);
+  wifiTick();
+
+  hal::httpRespond(200, kOpenMeteoPayload);
+  weatherHandleRequest(client, https, url);
+  uiCompose();
+  benchRender();
+}
+
+void benchUi() {
+  char name[48];
+  for (uint8_t i = 0; i < kViewCount; i++) {
+    const View v = static_cast<View>(i);
+    snprintf(name, sizeof(name), "ui_full_frame/%s", viewName(v));
+    bench(
+        name,
+        [v] { gView = v; },
+        [](uint32_t) {
+          uiCompose();
+          gCompositor.invalidateAll();
+          benchRender();
+        });
+  }
+
+  // Battery level flips every frame: only the gauge should reach the panel.
+  bench(
+      "ui_dynamic/battery",
+      [] { gView = View::Status; },
+      [](uint32_t i) {
+        gBatteryPctCached = i & 1 ? 64 : 65;  // as batterySampleTick() takes a new reading
+        uiCompose();
+        benchRender();
+      });
+
+  // Nothing changed since the previous frame: the cost of composing and diffing alone.
+  bench(
+      "ui_dynamic/unchanged", [] {}, [](uint32_t) {
+        uiCompose();
+        benchRender();
+      });
+
+  // One render-task tick of a scrolling ticker at TICKER_FPS.
+  bench(
+      "footer_ticker/scroll",
+      [] {
+        snprintf(gTickerText,
+                 sizeof(gTickerText),
+                 "DK: 12%sC Cloudy | Today 8-14%sC Rain 85%% | Tomorrow 7-13%sC Partly cloudy",
+                 "\xC2\xB0",
+                 "\xC2\xB0",
+                 "\xC2\xB0");
+        gTickerDirty = true;
+        uiDrawFooterTicker(true);
+      },
+      [](uint32_t) {
+        hal::clockAdvance(kTickerFrameMs);
+        uiDrawFooterTicker(false);
+      });
+}
+
+// One untimed parse of `raw` for the memory figures on the benchmark's line.
+void parseMemory(const std::shared_ptr<const std::string>& raw, uint8_t sites) {
+  WeatherParseStats stats;
+  const size_t stackBytes = stackUsed([&] {
+    WiFiClient in;
+    in.setResponse(raw);
+    weatherParseStream(in, sites, [](uint8_t, const ForecastStore&) {}, stats);
+  });
+  snprintf(gBenchExtra,
+           sizeof(gBenchExtra),
+           ",\"doc_peak_bytes\":%zu,\"stack_peak_bytes\":%zu,\"skipped_bytes\":%zu",
+           stats.docPeakBytes,
+           stackBytes,
+           stats.bytesSkipped);
+}
+
+void benchParse(const char* name, const std::shared_ptr<const std::string>& raw, uint8_t sites) {
+  bench(
+      name,
+      [&] { parseMemory(raw, sites); },
+      [&](uint32_t) {
+        WiFiClient in;
+        in.setResponse(raw);
+        WeatherParseStats stats;
+        weatherParseStream(in, sites, [](uint8_t, const ForecastStore&) {}, stats);
+      });
+}
+
+void benchWeather(WiFiClientSecure& client, HTTPClient& https, const char* url) {
+  // The parser alone, reading the body from memory.
+  benchParse("weather_parse/open_meteo", std::make_shared<const std::string>(kOpenMeteoPayload), 1);
+
+  // Ten sites in one response, as a batched request returns them: per-site cost should
+  // match the single-site case, with the same document peak.
+  static constexpr uint8_t kSites = 10;
+  auto batch = std::make_shared<std::string>("[");
+  for (uint8_t i = 0; i < kSites; i++) {
+    if (i) *batch += ",";
+    *batch += kOpenMeteoPayload;
+  }
+  *batch += "]";
+  benchParse("weather_parse/open_meteo_x10", batch, kSites);
+
+  // From one day to Open-Meteo's longest forecast: time grows with the payload, the document
+  // and stack peaks should not once the series outgrow the store.
+  static constexpr struct {
+    uint8_t days;
+    uint16_t hours;
+  } kSizes[] = {{1, 24}, {3, 72}, {7, 168}, {16, 384}};
+  for (const auto& size : kSizes) {
+    char name[48];
+    snprintf(name,
+             sizeof(name),
+             "weather_parse/days%u_hours%u",
+             static_cast<unsigned>(size.days),
+             static_cast<unsigned>(size.hours));
+    benchParse(name,
+               std::make_shared<const std::string>(openMeteoPayload(size.days, size.hours)),
+               1);
+  }
+
+  // The whole fetch on a kept-alive connection: request, framing, parse, publish.
+  bench(
+      "weather_fetch/content_length",
+      [] { hal::httpRespond(200, kOpenMeteoPayload); },
+      [&](uint32_t) { weatherHandleRequest(client, https, url); });
+  bench(
+      "weather_fetch/chunked",
+      [] { hal::httpRespond(200, kOpenMeteoPayload, 512); },
+      [&](uint32_t) { weatherHandleRequest(client, https, url); });
+
+  // Conditional requests against an unchanged resource: the priming fetch stores the
+  // validators, every timed one should come back 304 with nothing to parse. The conditional
+  // headers go through String, as on the device, so these few allocations are expected.
+  bench(
+      "weather_fetch/not_modified",
+      [&] {
+        hal::httpRespond(200, kOpenMeteoPayload);
+        hal::httpValidators("\"om-1\"", "Tue, 14 Oct 2025 09:00:00 GMT");
+        weatherHandleRequest(client, https, url);
+      },
+      [&](uint32_t) { weatherHandleRequest(client, https, url); });
+  hal::httpValidators("", "");
+  gWeatherPolicy.clearValidators();
+
+  // A server answering 503 with Retry-After: the failure path, backoff and its log line.
+  bench(
+      "weather_fetch/failure_backoff",
+      [] { hal::httpFailNext(UINT32_MAX, 503, 120); },
+      [&](uint32_t) { weatherHandleRequest(client, https, url); });
+  hal::httpFailNext(0, 0);
+  weatherHandleRequest(client, https, url);  // ends the failure streak
+}
+
+void benchWifi() {
+  // Connected and nothing happening: the per-pass cost loop() pays forever.
+  bench(
+      "wifi_tick/steady", [] {}, [](uint32_t) { wifiTick(); });
+
+  // Link lost, then back 1.2 s later: drop detection, a directed join to the cached AP and
+  // the Connected edge, which refreshes the cache.
+  bench(
+      "wifi_tick/reconnect",
+      [] { hal::wifiScript(1200, WL_CONNECTED); },
+      [](uint32_t) {
+        hal::wifiDrop();
+        wifiTick();
+        hal::clockAdvance(1200);
+        wifiTick();
+      });
+
+  // The AP changes channel every time: the directed join misses and a full one follows.
+  bench(
+      "wifi_tick/reconnect_moved_ap", [] {}, [](uint32_t i) {
+        hal::wifiApChannel(i % 2 ? 6 : 11);
+        hal::wifiDrop();
+        wifiTick();
+        hal::clockAdvance(1200);
+        wifiTick();
+        hal::clockAdvance(1200);
+        wifiTick();
+      });
+  hal::wifiApChannel(6);
+}
+
+// One M5.update() handed to the I2C bus task and waited for, as touchTick() does.
+void benchI2c() {
+  bench(
+      "i2c/touch_handover", [] {}, [](uint32_t) {
+        i2cBusRun(I2cClass::Touch, [](void*) { M5.update(); }, nullptr);
+      });
+}
+
+// The scheduler with a job table the size of loop()'s: one pass is finding the next due
+// job, sleeping until then (the clock jumps) and running what is due.
+void benchTimer() {
+  static constexpr uint32_t kPeriodsMs[] = {
+      10, 20, 1000, 1000, 1000, 1000, 10000, 15000, 20001, 45000, 60000, 600000, 1800000};
+  static constexpr size_t kJobs = sizeof(kPeriodsMs) / sizeof(kPeriodsMs[0]);
+  static uint32_t runs = 0;
+  static TimerJob* jobs[kJobs];
+  bench(
+      "timer_wheel/next_run",
+      [] {
+        // loop()'s own jobs stay out of the way.
+        timerStop(gJobSiteRotate);
+        timerStop(gJobConnectTimeout);
+        for (size_t i = 0; i < kJobs; i++) {
+          jobs[i] = new TimerJob("bench", [](uint32_t) { runs++; });
+          timerStart(*jobs[i], kPeriodsMs[i], kPeriodsMs[i]);
+        }
+      },
+      [](uint32_t) {
+        uint32_t dueMs = 0;
+        if (!timerNextDue(dueMs)) return;
+        const int32_t untilMs = static_cast<int32_t>(dueMs - millis());
+        if (untilMs > 0) hal::clockAdvance(untilMs);
+        timerRun(millis());
+      });
+
+  // Moving an armed job, as every touch poll does with the dim timeout.
+  bench(
+      "timer_wheel/restart", [] {}, [](uint32_t i) {
+        timerStart(*jobs[i % kJobs], kDimAfterMs + 1);
+      });
+  // Stopped but not freed: the scheduler keeps every job it has seen for timerReport().
+  for (TimerJob* job : jobs) timerStop(*job);
+}
+
+// The top bar's clock: wall time to local broken-down time, once per composed frame.
+void benchClock() {
+  bench(
+      "wall_clock/local_time", [] {}, [](uint32_t) {
+        tm local;
+        wallClockLocal(local);
+      });
+}
+
+// loop() itself, idle with the link up, for kLoopBenchMs of real time: polling every 10 ms
+// as before the event group, then blocking until an event or the next due job. Iterations
+// are loop() passes. The jobs are the periodic ones setup() arms.
+void benchLoopIdle(const char* name, bool polling) {
+  static constexpr uint32_t kLoopBenchMs = 5000;
+  gLoopPolling = polling;
+  hal::pin(kTouchIntPin, HIGH);  // no finger: the controller's interrupt line idles high
+  timerStop(gJobTouch);
+  timerStart(gJobDim, kDimAfterMs + 1);
+  timerStart(gJobWeather, 0);
+  timerStartAt(gJobUiStats, gridNext(kUiStatsMs), kUiStatsMs);
+  timerStart(gJobHistoryReport, 0, kHistoryReportMs);
+  timerStartAt(gJobClock, gridNext(kClockTickMs), kClockTickMs);
+  liveRearm(gJobUiRefresh);
+  liveRearm(gJobHistory);
+  liveRearm(gJobApi);
+  liveRearm(gJobSerial);
+
+  M5.Lcd.resetCounters();
+  const uint32_t wakeups0 = gLoopWakeupsTotal;
+  const uint64_t blocked0 = gLoopBlockedUsTotal;
+  const uint64_t busy0 = gLoopBusyUsTotal;
+  gLoopBusyUsMax = 0;
+  const uint32_t allocs0 = heapGuardAllocs();
+  const uint64_t t0 = wallNs();
+  const uint32_t endMs = millis() + kLoopBenchMs;
+  while (!timeReached(millis(), endMs)) loop();
+  const uint64_t elapsed = wallNs() - t0;
+
+  const uint32_t wakeups = gLoopWakeupsTotal - wakeups0;
+  const double sec = elapsed / 1e9;
+  const uint64_t blockedUs = gLoopBlockedUsTotal - blocked0;
+  snprintf(gBenchExtra,
+           sizeof(gBenchExtra),
+           ",\"wakeups_per_s\":%.2f,\"blocked_pct\":%.2f,\"busy_us_per_s\":%.1f,"
+           "\"busy_us_max\":%u",
+           wakeups / sec,
+           blockedUs / (sec * 1e4),
+           (gLoopBusyUsTotal - busy0) / sec,
+           static_cast<unsigned>(gLoopBusyUsMax));
+  report(name, max<uint32_t>(wakeups, 1), elapsed, heapGuardAllocs() - allocs0);
+  gLoopPolling = false;
+}
+
+// historyReport()'s day and week summaries over a store holding eight days of room
+// temperature at the sensor's cadence. Both spans read the hourly tier.
+void benchTsdb() {
+  static constexpr uint32_t kEndTs = 820000000;  // 2025-12-27, RTC seconds since 2000
+  static constexpr uint32_t kStepSec = ENV_SAMPLE_MS / 1000;
+  static constexpr uint32_t kPoints = 8 * 86400UL / kStepSec;
+  tsStart();
+  const uint32_t points0 = tsStats().points;
+  for (uint32_t i = 0; i < kPoints; i++) {
+    // A daily swing of a few degrees in 0.01 °C steps.
+    const uint32_t minute = i * kStepSec / 60 % 1440;
+    const int32_t c100 = 2000 + static_cast<int32_t>(minute < 720 ? minute : 1440 - minute) / 2;
+    tsAppend(TsSeries::RoomTemp, kEndTs - (kPoints - i) * kStepSec, c100);
+    if (i % 16 == 15 && i + 1 < kPoints) tsFlush();
+  }
+  // The last point goes through the task, which compacts the completed hours and days in
+  // the same pass; the first query waits for that pass.
+  while (tsStats().points < points0 + kPoints) delay(1);
+
+  static constexpr struct {
+    const char* name;
+    uint32_t spanSec;
+  } kQueries[] = {{"tsdb/query_day", 86400UL}, {"tsdb/query_week", 7 * 86400UL}};
+  static uint32_t spanSec = 0;
+  static TsSummary sum;
+  for (const auto& q : kQueries) {
+    spanSec = q.spanSec;
+    bench(
+        q.name,
+        [] {
+          tsSummarize(TsSeries::RoomTemp, kEndTs - spanSec, kEndTs, sum);
+          snprintf(gBenchExtra,
+                   sizeof(gBenchExtra),
+                   ",\"points\":%u",
+                   static_cast<unsigned>(sum.count));
+        },
+        [](uint32_t) { tsSummarize(TsSeries::RoomTemp, kEndTs - spanSec, kEndTs, sum); });
+  }
+}
+
+// ----- HTTP API under load -----
+
+constexpr uint8_t kScrapers = 12;  // three times the server's client slots
+constexpr uint32_t kScrapeBenchMs = 3000;
+constexpr const char* kScrapePaths[] = {"/metrics", "/api/current", "/api/forecast"};
+
+std::atomic<bool> gScraping{false};
+std::atomic<uint32_t> gScrapes{0};
+std::atomic<uint32_t> gScrapesIncomplete{0};
+
+// One request on a fresh connection, read to the server's close. Complete means a 200 with
+// the body's known last line.
+bool scrapeOnce(const char* path) {
+  const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) return false;
+  const timeval tv = {5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(HTTP_API_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  std::string resp;
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+    char req[64];
+    const int len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: bench\r\n\r\n", path);
+    if (send(fd, req, len, 0) == len) {
+      char buf[1024];
+      int n;
+      while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) resp.append(buf, n);
+      if (n < 0) resp.clear();  // timed out before the close
+    }
+  }
+  close(fd);
+
+  const size_t body = resp.find("\r\n\r\n");
+  if (resp.compare(0, 17, "HTTP/1.1 200 OK\r\n") != 0 || body == std::string::npos) return false;
+  if (strcmp(path, "/metrics") != 0) return resp.compare(resp.size() - 2, 2, "}\n") == 0;
+  const size_t lastLine = resp.rfind('\n', resp.size() - 2) + 1;
+  return resp.back() == '\n' &&
+         resp.compare(lastLine, 30, "core2_http_handle_max_seconds ") == 0;
+}
+
+void scraperMain(uint8_t id) {
+  for (uint32_t i = id; gScraping.load(); i++) {
+    if (!scrapeOnce(kScrapePaths[i % 3])) gScrapesIncomplete++;
+    gScrapes++;
+  }
+}
+
+// Renders full frames back to back for kScrapeBenchMs, as the render task would with every
+// frame dirty, and reports the render_frame_seconds figures /metrics would show.
+void renderWhile(const char* name, uint32_t scrapers) {
+  RenderStats stats;
+  uint32_t lastInputUs = 0;
+  M5.Lcd.resetCounters();
+  const uint32_t allocs0 = heapGuardAllocs();
+  const uint32_t scrapes0 = gScrapes;
+  const uint32_t incomplete0 = gScrapesIncomplete;
+  const uint64_t t0 = wallNs();
+  const uint32_t endMs = millis() + kScrapeBenchMs;
+  while (!timeReached(millis(), endMs)) {
+    uiCompose();
+    gCompositor.invalidateAll();
+    gRenderFrame.read(gRenderCopy);
+    renderFrame(stats, lastInputUs);
+  }
+  const uint64_t elapsed = wallNs() - t0;
+  snprintf(gBenchExtra,
+           sizeof(gBenchExtra),
+           ",\"frame_us_avg\":%u,\"frame_us_max\":%u,\"scrapers\":%u,\"responses\":%u,"
+           "\"incomplete\":%u",
+           static_cast<unsigned>(stats.frameUsTotal / max<uint32_t>(stats.frames, 1)),
+           static_cast<unsigned>(stats.frameUsMax),
+           static_cast<unsigned>(scrapers),
+           static_cast<unsigned>(gScrapes - scrapes0),
+           static_cast<unsigned>(gScrapesIncomplete - incomplete0));
+  report(name, max<uint32_t>(stats.frames, 1), elapsed, heapGuardAllocs() - allocs0);
+}
+
+// Frame times alone, then with kScrapers clients fetching /metrics and /api/* as fast as
+// they can: more than the server has slots, so some wait in the listen backlog. Returns
+// false if any response was cut short or none arrived.
+bool benchHttpLoad() {
+  httpApiStart();
+  httpApiSetEnabled(true);
+  apiTick(millis());
+  renderWhile("http_api/render_idle", 0);
+
+  gScraping = true;
+  std::vector<std::thread> scrapers;
+  for (uint8_t i = 0; i < kScrapers; i++) scrapers.emplace_back(scraperMain, i);
+  renderWhile("http_api/render_scraped", kScrapers);
+  gScraping = false;
+  for (std::thread& t : scrapers) t.join();
+  httpApiSetEnabled(false);
+
+  if (gScrapes == 0 || gScrapesIncomplete != 0) {
+    fprintf(stderr,
+            "http_api: %u of %u responses incomplete\n",
+            static_cast<unsigned>(gScrapesIncomplete),
+            static_cast<unsigned>(gScrapes));
+    return false;
+  }
+  return true;
+}
+
+#if PROFILER
+// What a PROF_SCOPE adds to every instrumented call, recording and paused.
+void benchProfiler() {
+  bench(
+      "profiler/scope", [] { profSetEnabled(true); }, [](uint32_t) {
+        PROF_SCOPE(ProfScope::Loop);
+      });
+  bench(
+      "profiler/scope_paused", [] { profSetEnabled(false); }, [](uint32_t) {
+        PROF_SCOPE(ProfScope::Loop);
+      });
+  profSetEnabled(true);
+}
+#endif
+
+}  // namespace
+
+int main() {
+  hal::serialQuiet(true);
+  heapGuardWatch();
+
+  WiFiClientSecure client;
+  HTTPClient https;
+  char url[kWeatherUrlMax] = "";
+
+  benchSetup(client, https, url, sizeof(url));
+  benchUi();
+  benchWeather(client, https, url);
+  benchWifi();
+  benchI2c();
+  benchTimer();
+  benchClock();
+  benchLoopIdle("loop_idle/polling", true);
+  benchLoopIdle("loop_idle/events", false);
+  benchTsdb();
+  const bool httpOk = benchHttpLoad();
+#if PROFILER
+  benchProfiler();
+#endif
+  return httpOk ? 0 : 1;
+}
+#endif  // PIO_UNIT_TESTING
@@ -0,0 +1,86 @@
+#pragma once
+
+// Open-Meteo /v1/forecast response for Copenhagen as the firmware requests it (7 days,
+// 48 hours, timeformat=unixtime), including the unit blocks and metadata the parser's
+// filter skips. 2035 bytes.
+
+static const char kOpenMeteoPayload[] = R"json(
+{"latitude":55.68,"longitude":12.56,"generationtime_ms":0.1779794692993164,
+"utc_offset_seconds":7200,"timezone":"Europe/Copenhagen","timezone_abbreviation":"GMT+2",
+"elevation":14.0,"current_units":{"time":"unixtime","interval":"seconds",
+"temperature_2m":"°C","weather_code":"wmo code"},"current":{"time":1760609700,"interval":900,
+"temperature_2m":12.6,"weather_code":3},"hourly_units":{"time":"unixtime",
+"temperature_2m":"°C","weather_code":"wmo code","precipitation_probability":"%"},
+"hourly":{"time":[1760608800,1760612400,1760616000,1760619600,1760623200,1760626800,
+1760630400,1760634000,1760637600,1760641200,1760644800,1760648400,1760652000,1760655600,
+1760659200,1760662800,1760666400,1760670000,1760673600,1760677200,1760680800,1760684400,
+1760688000,1760691600,1760695200,1760698800,1760702400,1760706000,1760709600,1760713200,
+1760716800,1760720400,1760724000,1760727600,1760731200,1760734800,1760738400,1760742000,
+1760745600,1760749200,1760752800,1760756400,1760760000,1760763600,1760767200,1760770800,
+1760774400,1760778000],"temperature_2m":[14.0,13.9,13.5,13.0,12.4,11.6,10.8,10.0,9.3,8.6,8.1,
+7.8,7.6,7.7,8.0,8.4,9.0,9.7,10.5,11.2,11.9,12.5,12.9,13.2,13.3,13.1,12.8,12.3,11.7,10.9,10.1,
+9.3,8.5,7.9,7.4,7.1,6.9,7.0,7.3,7.7,8.3,9.0,9.7,10.5,11.2,11.8,12.2,12.5],"weather_code":[3,3,
+2,1,61,61,80,3,3,3,2,1,61,61,80,3,3,3,2,1,61,61,80,3,3,3,2,1,61,61,80,3,3,3,2,1,61,61,80,3,3,
+3,2,1,61,61,80,3],"precipitation_probability":[40,47,55,62,68,73,77,79,79,78,76,72,67,60,53,
+45,37,29,22,15,9,5,1,0,0,1,4,9,14,21,28,36,44,52,59,66,71,75,78,79,79,77,74,69,63,56,48,40]},
+"daily_units":{"time":"unixtime","temperature_2m_max":"°C","temperature_2m_min":"°C",
+"weather_code":"wmo code","precipitation_probability_max":"%"},"daily":{"time":[1760565600,
+1760652000,1760738400,1760824800,1760911200,1760997600,1761084000],"temperature_2m_max":[14.2,
+12.8,13.5,11.9,15.1,12.4,10.7],"temperature_2m_min":[8.1,7.4,6.9,5.8,7.7,6.2,5.1],
+"weather_code":[3,61,2,80,0,45,63],"precipitation_probability_max":[20,85,10,65,0,15,90]}})json";
+
+#include <string>
+
+// A response of the same shape for `days` daily and `hours` hourly entries (Open-Meteo allows
+// up to 16 days and 384 hours), with values cycling like the recorded ones: for showing that
+// the parser's memory does not follow the payload size.
+inline std::string openMeteoPayload(uint8_t days, uint16_t hours) {
+  static constexpr uint8_t kCodes[] = {3, 3, 2, 1, 61, 61, 80};
+  static constexpr uint8_t kPrecip[] = {40, 55, 68, 77, 79, 72, 60, 45, 29, 15, 5, 0};
+  static constexpr double kHourlyStart = 1760608800;
+  static constexpr double kDailyStart = 1760565600;
+  std::string s =
+      "{\"latitude\":55.68,\"longitude\":12.56,\"generationtime_ms\":0.1779794692993164,"
+      "\"utc_offset_seconds\":7200,\"timezone\":\"Europe/Copenhagen\","
+      "\"timezone_abbreviation\":\"GMT+2\",\"elevation\":14.0,\"current_units\":{"
+      "\"time\":\"unixtime\",\"interval\":\"seconds\",\"temperature_2m\":\"\xC2\xB0"
+      "C\",\"weather_code\":\"wmo code\"},\"current\":{\"time\":1760609700,\"interval\":900,"
+      "\"temperature_2m\":12.6,\"weather_code\":3},\"hourly_units\":{\"time\":\"unixtime\","
+      "\"temperature_2m\":\"\xC2\xB0"
+      "C\",\"weather_code\":\"wmo code\",\"precipitation_probability\":\"%\"},\"hourly\":{";
+  // "name":[...] with `n` values of `value(i)` printed by `fmt`.
+  auto series = [&s](const char* name, uint16_t n, const char* fmt, auto value, bool last) {
+    char num[24];
+    s += "\"";
+    s += name;
+    s += "\":[";
+    for (uint16_t i = 0; i < n; i++) {
+      snprintf(num, sizeof(num), fmt, value(i));
+      if (i) s += ",";
+      s += num;
+    }
+    s += last ? "]" : "],";
+  };
+  series("time", hours, "%.0f", [](uint16_t i) { return kHourlyStart + i * 3600.0; }, false);
+  series("temperature_2m", hours, "%.1f", [](uint16_t i) { return 7 + i * 7 % 70 / 10.0; }, false);
+  series("weather_code", hours, "%.0f", [](uint16_t i) { return 1.0 * kCodes[i % 7]; }, false);
+  series("precipitation_probability",
+         hours,
+         "%.0f",
+         [](uint16_t i) { return 1.0 * kPrecip[i % 12]; },
+         true);
+  s += "},\"daily_units\":{\"time\":\"unixtime\",\"temperature_2m_max\":\"\xC2\xB0"
+       "C\",\"temperature_2m_min\":\"\xC2\xB0"
+       "C\",\"weather_code\":\"wmo code\",\"precipitation_probability_max\":\"%\"},\"daily\":{";
+  series("time", days, "%.0f", [](uint16_t i) { return kDailyStart + i * 86400.0; }, false);
+  series("temperature_2m_max", days, "%.1f", [](uint16_t i) { return 11.0 + i % 5; }, false);
+  series("temperature_2m_min", days, "%.1f", [](uint16_t i) { return 5.0 + i % 4; }, false);
+  series("weather_code", days, "%.0f", [](uint16_t i) { return 1.0 * kCodes[(i + 3) % 7]; }, false);
+  series("precipitation_probability_max",
+         days,
+         "%.0f",
+         [](uint16_t i) { return 1.0 * kPrecip[i * 5 % 12]; },
+         true);
+  s += "}}";
+  return s;
+}
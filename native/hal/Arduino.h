@@ -0,0 +1,209 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino-ESP32 core and FreeRTOS the firmware uses.
+// Tasks are threads, millis() runs on the host clock plus a scriptable offset, and Serial
+// goes to stderr so benchmark results on stdout stay machine-readable.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+using std::max;
+using std::min;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void yield();
+
+// ----- String / Print / Stream -----
+
+class String {
+ public:
+  String(const char* s = "") : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+
+  const char* c_str() const { return s_.c_str(); }
+  size_t length() const { return s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  bool equalsIgnoreCase(const String& o) const;
+
+  String& operator=(const char* s) {
+    s_ = s ? s : "";
+    return *this;
+  }
+  String& operator+=(const char* s) {
+    s_ += s;
+    return *this;
+  }
+  String& operator+=(const String& s) {
+    s_ += s.s_;
+    return *this;
+  }
+  String operator+(const char* s) const { return String(s_ + s); }
+  String operator+(const String& s) const { return String(s_ + s.s_); }
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator!=(const String& o) const { return s_ != o.s_; }
+  bool operator==(const char* o) const { return s_ == o; }
+
+ private:
+  std::string s_;
+};
+
+inline String operator+(const char* a, const String& b) { return String(a) + b; }
+
+class Print {
+ public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* data, size_t n);
+  virtual void flush() {}
+
+  int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t println(const char* s) { return print(s) + print("\n"); }
+  size_t println(const String& s) { return println(s.c_str()); }
+  size_t println() { return print("\n"); }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char* buffer, size_t length);
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    return readBytes(reinterpret_cast<char*>(buffer), length);
+  }
+  void setTimeout(unsigned long ms) { timeout_ = ms; }
+
+ protected:
+  unsigned long timeout_ = 1000;
+};
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud) { (void)baud; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* data, size_t n) override;
+};
+
+extern HardwareSerial Serial;
+
+// ----- ESP -----
+
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+uint32_t esp_random();  // fixed sequence, so runs repeat
+// Sets TZ and starts SNTP; see esp_sntp.h.
+void configTzTime(const char* tz, const char* server1, const char* server2 = nullptr,
+                  const char* server3 = nullptr);
+
+struct EspClass {
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getCpuFreqMHz() { return getCpuFrequencyMhz(); }
+  uint32_t getCycleCount() { return micros() * getCpuFrequencyMhz(); }
+  void restart() { std::exit(0); }
+};
+
+extern EspClass ESP;
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define ESP_OK 0
+typedef int esp_err_t;
+
+// ----- GPIO -----
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define FALLING 0x02
+#define digitalPinToInterrupt(p) (p)
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+
+// ----- FreeRTOS -----
+
+struct HalTask;
+struct HalQueue;
+struct HalSemaphore;
+struct HalEventGroup;
+
+typedef HalTask* TaskHandle_t;
+typedef HalQueue* QueueHandle_t;
+typedef HalSemaphore* SemaphoreHandle_t;
+typedef HalEventGroup* EventGroupHandle_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+#define portYIELD_FROM_ISR() \
+  do {                       \
+  } while (0)
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stack,
+                                   void* param, UBaseType_t prio, TaskHandle_t* out,
+                                   BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+BaseType_t xPortGetCoreID();
+void xTaskNotifyGive(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks);
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void* item);
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t q, void* item, TickType_t ticks);
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s);
+
+EventGroupHandle_t xEventGroupCreate();
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits);
+EventBits_t xEventGroupSetBitsFromISR(EventGroupHandle_t g, EventBits_t bits, BaseType_t* woken);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t ticks);
+
+struct portMUX_TYPE {
+  std::mutex m;
+};
+#define portMUX_INITIALIZER_UNLOCKED \
+  {}
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) { mux->m.lock(); }
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) { mux->m.unlock(); }
@@ -0,0 +1,43 @@
+#pragma once
+
+// Host stand-in for HTTPClient: GET() answers with the response set by hal::httpRespond(),
+// typically a recorded Open-Meteo payload, framed with Content-Length or chunked. It honours
+// conditional requests against hal::httpValidators() and fails as hal::httpFailNext() says.
+
+#include "WiFiClientSecure.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_MODIFIED 304
+
+class HTTPClient {
+ public:
+  bool begin(WiFiClient& client, const char* url);
+  bool begin(WiFiClient& client, const String& url) { return begin(client, url.c_str()); }
+  void end();
+  int GET();
+
+  void setReuse(bool reuse) { (void)reuse; }
+  void setConnectTimeout(int32_t ms) { (void)ms; }
+  void setTimeout(uint16_t ms) { (void)ms; }
+  void useHTTP10(bool on = true) { (void)on; }
+  void addHeader(const String& name, const String& value);
+  void collectHeaders(const char* keys[], size_t count) { (void)keys, (void)count; }
+  String header(const char* name);
+  int getSize() { return size_; }
+  WiFiClient& getStream() { return *client_; }
+
+ private:
+  WiFiClient* client_ = nullptr;
+  int size_ = -1;
+  bool chunked_ = false;
+  int code_ = 0;
+  // Request validators, cleared by end() like the real client's request headers.
+  char ifNoneMatch_[80] = "";
+  char ifModifiedSince_[40] = "";
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+// Host stand-in for LittleFS: files live in memory for the process lifetime.
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+class File {
+ public:
+  File() = default;
+  File(std::shared_ptr<std::vector<uint8_t>> data, bool write, size_t pos)
+      : data_(std::move(data)), write_(write), pos_(pos) {}
+
+  explicit operator bool() const { return data_ != nullptr; }
+  size_t size() const { return data_ ? data_->size() : 0; }
+  bool seek(uint32_t pos);
+  size_t read(uint8_t* out, size_t n);
+  size_t write(const uint8_t* data, size_t n);
+  void close() { data_.reset(); }
+
+ private:
+  std::shared_ptr<std::vector<uint8_t>> data_;
+  bool write_ = false;
+  size_t pos_ = 0;
+};
+
+class LittleFSFS {
+ public:
+  bool begin(bool formatOnFail = false, const char* base = "/littlefs", uint8_t maxOpen = 10,
+             const char* label = "spiffs");
+  File open(const char* path, const char* mode = FILE_READ);
+  bool exists(const char* path) const { return files_.count(path) != 0; }
+  bool remove(const char* path) { return files_.erase(path) != 0; }
+  bool rename(const char* from, const char* to);
+  bool mkdir(const char* path) { return (void)path, true; }
+  size_t totalBytes() const { return 1536 * 1024; }
+  size_t usedBytes() const;
+
+ private:
+  std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files_;
+};
+
+extern LittleFSFS LittleFS;
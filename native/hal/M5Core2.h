@@ -0,0 +1,189 @@
+#pragma once
+
+// Host stand-in for the M5Core2 library: a framebuffer-backed TFT_eSPI that counts what
+// would cross the SPI bus, touch buttons that never fire, and a clock-backed RTC and
+// scripted AXP192 (see hal.h).
+
+#include "Arduino.h"
+#include "Wire.h"
+
+// Panel or sprite. The panel counts every pixel written and every SPI transaction
+// (one per drawing call, or one per startWrite()/endWrite() pair around several).
+// Sprites draw into memory and count nothing until pushed.
+class TFT_eSPI {
+ public:
+  TFT_eSPI(int16_t w = 320, int16_t h = 240);
+  virtual ~TFT_eSPI();
+  TFT_eSPI(const TFT_eSPI&) = delete;
+  TFT_eSPI& operator=(const TFT_eSPI&) = delete;
+
+  int16_t width() const { return w_; }
+  int16_t height() const { return h_; }
+  static uint16_t color565(uint8_t r, uint8_t g, uint8_t b) {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+  }
+
+  void fillScreen(uint32_t color) { fillRect(0, 0, w_, h_, color); }
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+  void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+  void fillRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color);
+  void drawRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color);
+  void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color);
+  void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color);
+  void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color);
+  void drawPixel(int32_t x, int32_t y, uint32_t color);
+
+  // Text uses fixed cell metrics per font (1: 6x8, 2: 8x16, 4: 14x26). A glyph cell is
+  // painted in the background colour (when it differs) with a foreground bar, which is
+  // what matters for the pixel and transaction counts.
+  void setTextColor(uint16_t fg) { setTextColor(fg, fg); }
+  void setTextColor(uint16_t fg, uint16_t bg) {
+    textFg_ = fg;
+    textBg_ = bg;
+  }
+  void setTextFont(uint8_t font) { font_ = font; }
+  void setTextSize(uint8_t size) { (void)size; }
+  int16_t textWidth(const char* s, uint8_t font) const;
+  int16_t textWidth(const String& s, uint8_t font) const { return textWidth(s.c_str(), font); }
+  int16_t fontHeight(uint8_t font) const;
+  int16_t drawString(const char* s, int32_t x, int32_t y, uint8_t font);
+  int16_t drawString(const String& s, int32_t x, int32_t y, uint8_t font) {
+    return drawString(s.c_str(), x, y, font);
+  }
+  int16_t drawCentreString(const char* s, int32_t x, int32_t y, uint8_t font) {
+    return drawString(s, x - textWidth(s, font) / 2, y, font);
+  }
+  int16_t drawRightString(const char* s, int32_t x, int32_t y, uint8_t font) {
+    return drawString(s, x - textWidth(s, font), y, font);
+  }
+
+  void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data);
+  bool initDMA() { return true; }
+  void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* data,
+                    uint16_t* buffer = nullptr) {
+    (void)buffer;
+    pushImage(x, y, w, h, data);
+  }
+  void dmaWait() {}
+  bool dmaBusy() const { return false; }
+  bool getSwapBytes() const { return swap_; }
+  void setSwapBytes(bool swap) { swap_ = swap; }
+  void startWrite();
+  void endWrite();
+  void setBrightness(uint8_t level) { brightness_ = level; }
+
+  // Host-side inspection.
+  uint16_t pixelAt(int16_t x, int16_t y) const;
+  uint64_t pixelsWritten() const { return pixels_; }
+  uint64_t transactions() const { return transactions_; }
+  uint8_t brightness() const { return brightness_; }
+  void resetCounters() {
+    pixels_ = 0;
+    transactions_ = 0;
+  }
+
+ protected:
+  void resize(int16_t w, int16_t h);
+  void fillClipped(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color);
+  void begin();
+  void end() { writeDepth_--; }
+
+  uint16_t* buf_ = nullptr;
+  int16_t w_ = 0;
+  int16_t h_ = 0;
+  bool panel_ = true;
+
+ private:
+  uint16_t textFg_ = 0xFFFF;
+  uint16_t textBg_ = 0;
+  uint8_t font_ = 1;
+  bool swap_ = true;
+  uint8_t brightness_ = 0;
+  int writeDepth_ = 0;
+  uint64_t pixels_ = 0;
+  uint64_t transactions_ = 0;
+};
+
+class TFT_eSprite : public TFT_eSPI {
+ public:
+  explicit TFT_eSprite(TFT_eSPI* parent) : TFT_eSPI(0, 0), parent_(parent) { panel_ = false; }
+
+  void setColorDepth(int8_t bits) { (void)bits; }
+  void setPsram(bool enable) { (void)enable; }
+  void* createSprite(int16_t w, int16_t h);
+  void deleteSprite() { resize(0, 0); }
+  void* getPointer() { return buf_; }
+  void fillSprite(uint32_t color) { fillScreen(color); }
+  void pushSprite(int32_t x, int32_t y) { parent_->pushImage(x, y, w_, h_, buf_); }
+
+ private:
+  TFT_eSPI* parent_;
+};
+
+class M5Display : public TFT_eSPI {};
+
+enum { DIR_UP = 1, DIR_DOWN, DIR_LEFT, DIR_RIGHT };
+
+struct Button {
+  Button(int16_t x, int16_t y, int16_t w, int16_t h, bool rot1 = false, const char* name = "") {
+    (void)x, (void)y, (void)w, (void)h, (void)rot1, (void)name;
+  }
+  bool wasPressed() { return false; }
+  bool wasReleased() { return false; }
+  bool isPressed() { return false; }
+  bool pressedFor(uint32_t ms) { return (void)ms, false; }
+};
+
+struct Gesture {
+  Gesture(const char* name, int16_t minDistance, int16_t direction, int16_t plusminus) {
+    (void)name, (void)minDistance, (void)direction, (void)plusminus;
+  }
+  bool wasDetected() { return false; }
+};
+
+struct RTC_TimeTypeDef {
+  uint8_t Hours = 0;
+  uint8_t Minutes = 0;
+  uint8_t Seconds = 0;
+};
+
+struct RTC_DateTypeDef {
+  uint8_t WeekDay = 0;
+  uint8_t Month = 0;
+  uint8_t Date = 0;
+  uint16_t Year = 0;
+};
+
+struct RTC {
+  void GetTime(RTC_TimeTypeDef* t);
+  void GetDate(RTC_DateTypeDef* d);
+  void SetTime(RTC_TimeTypeDef* t) { (void)t; }
+  void SetDate(RTC_DateTypeDef* d) { (void)d; }
+};
+
+struct AXP192 {
+  float GetBatVoltage();
+  float GetBatCurrent() { return 0.0f; }
+  float GetBatteryLevel();
+  bool isCharging();
+  void SetLcdVoltage(uint16_t mv) { (void)mv; }
+  void SetLed(uint8_t on) { (void)on; }
+};
+
+struct M5Core2 {
+  void begin(bool lcd = true, bool sd = true, bool serial = true, bool i2c = false,
+             int mode = 0, bool speaker = false) {
+    (void)lcd, (void)sd, (void)serial, (void)i2c, (void)mode, (void)speaker;
+  }
+  void update() {}
+  void shutdown() {}
+
+  M5Display Lcd;
+  Button BtnA{10, 240, 110, 40};
+  Button BtnB{130, 240, 70, 40};
+  Button BtnC{230, 240, 80, 40};
+  RTC Rtc;
+  AXP192 Axp;
+};
+
+extern M5Core2 M5;
@@ -0,0 +1,20 @@
+#pragma once
+
+// Host stand-in for NVS: namespaces of byte blobs kept in memory for the process lifetime.
+
+#include "Arduino.h"
+
+class Preferences {
+ public:
+  bool begin(const char* ns, bool readOnly = false);
+  void end() { ns_.clear(); }
+  size_t putBytes(const char* key, const void* data, size_t len);
+  size_t getBytes(const char* key, void* out, size_t maxLen);
+  size_t getBytesLength(const char* key);
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+ private:
+  std::string ns_;
+  bool readOnly_ = false;
+};
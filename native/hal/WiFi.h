@@ -0,0 +1,119 @@
+#pragma once
+
+// Host stand-in for the ESP32 WiFi library. The station link follows a script set with
+// hal::wifiScript() and hal::wifiTiming(): begin() reaches the scripted status after the
+// scripted delay, plus a channel scan unless it names the AP's channel and BSSID, plus DHCP
+// unless config() set a static address.
+
+#include <memory>
+
+#include "Arduino.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP = 8,
+} arduino_event_id_t;
+
+union arduino_event_info_t {
+  struct {
+    uint8_t reason;
+  } wifi_sta_disconnected;
+};
+
+class IPAddress {
+ public:
+  IPAddress() = default;
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : addr_(a | (b << 8) | (c << 16) | (static_cast<uint32_t>(d) << 24)) {}
+  explicit IPAddress(uint32_t addr) : addr_(addr) {}
+  operator uint32_t() const { return addr_; }
+  uint8_t operator[](int i) const { return (addr_ >> (8 * i)) & 0xFF; }
+  String toString() const;
+
+ private:
+  uint32_t addr_ = 0;
+};
+
+using WiFiEventCb = void (*)(arduino_event_id_t event, arduino_event_info_t info);
+
+class WiFiClass {
+ public:
+  wl_status_t begin(const char* ssid = nullptr, const char* pass = nullptr, int32_t channel = 0,
+                    const uint8_t* bssid = nullptr, bool connect = true);
+  bool disconnect(bool wifiOff = false, bool eraseAp = false);
+  wl_status_t status();
+  bool mode(wifi_mode_t m) { return (void)m, true; }
+  bool setHostname(const char* name) { return (void)name, true; }
+  bool setAutoReconnect(bool on) { return (void)on, true; }
+  bool setSleep(bool on) {
+    sleep_ = on;
+    return true;
+  }
+  bool getSleep() const { return sleep_; }
+
+  bool config(IPAddress localIp, IPAddress gateway, IPAddress subnet,
+              IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+
+  String SSID();
+  String psk() { return String("bench-pass"); }
+  uint8_t* BSSID();
+  int32_t channel();
+  IPAddress localIP();
+  IPAddress gatewayIP();
+  IPAddress subnetMask();
+  IPAddress dnsIP(uint8_t index = 0);
+  int8_t RSSI();
+  int onEvent(WiFiEventCb cb) {
+    cb_ = cb;
+    return 1;
+  }
+
+ private:
+  WiFiEventCb cb_ = nullptr;
+  wl_status_t last_ = WL_DISCONNECTED;
+  bool sleep_ = false;
+};
+
+extern WiFiClass WiFi;
+
+// Plain client: only ever used through WiFiClientSecure and HTTPClient here. Reads come
+// from the response the HTTP stand-in queued on it.
+class WiFiClient : public Stream {
+ public:
+  int connect(const char* host, uint16_t port, int32_t timeoutMs = 0);
+  void stop() { open_ = false; }
+  uint8_t connected() { return open_; }
+  int available() override { return static_cast<int>(left()); }
+  int read() override { return left() ? static_cast<uint8_t>((*rx_)[pos_++]) : -1; }
+  int peek() override { return left() ? static_cast<uint8_t>((*rx_)[pos_]) : -1; }
+  size_t readBytes(char* buffer, size_t length) override;
+  size_t write(uint8_t c) override { return (void)c, 1; }
+  void setTimeout(uint32_t seconds) { timeout_ = seconds * 1000; }
+
+  // Loaded by HTTPClient::GET() with the body as the server would frame it.
+  void setResponse(std::shared_ptr<const std::string> raw) {
+    rx_ = std::move(raw);
+    pos_ = 0;
+  }
+
+ private:
+  size_t left() const { return rx_ ? rx_->size() - pos_ : 0; }
+
+  bool open_ = false;
+  std::shared_ptr<const std::string> rx_;
+  size_t pos_ = 0;
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "WiFi.h"
+
+// TLS is not simulated; hal::httpHandshakeMs() adds handshake time to connect().
+class WiFiClientSecure : public WiFiClient {
+ public:
+  void setInsecure() {}
+  void setCACert(const char* cert) { (void)cert; }
+  void setHandshakeTimeout(unsigned long seconds) { (void)seconds; }
+};
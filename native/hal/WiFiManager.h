@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in for WiFiManager: the portal starts and never receives credentials.
+
+#include "WiFi.h"
+
+class WiFiManager {
+ public:
+  void setAPCallback(void (*cb)(WiFiManager*)) { apCallback_ = cb; }
+  void setConnectTimeout(unsigned long seconds) { (void)seconds; }
+  void setConfigPortalBlocking(bool blocking) { (void)blocking; }
+  bool startConfigPortal(const char* apName, const char* apPass) {
+    (void)apName, (void)apPass;
+    if (apCallback_) apCallback_(this);
+    return false;
+  }
+  bool process() { return false; }
+  void stopConfigPortal() {}
+  void resetSettings() {}
+
+ private:
+  void (*apCallback_)(WiFiManager*) = nullptr;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+// Host stand-in for the I2C driver. Wire1, the Core2's internal bus, answers as an AXP192
+// (battery from hal::battery() and hal::batteryCurrent()), a BM8563 (time from the host
+// clock) and an idle FT6336U.
+// Nothing answers on Wire, the Grove port.
+
+#include "Arduino.h"
+
+class TwoWire {
+ public:
+  explicit TwoWire(uint8_t bus) : bus_(bus) {}
+
+  bool begin(int sda = -1, int scl = -1, uint32_t freq = 0) {
+    (void)sda, (void)scl, (void)freq;
+    return true;
+  }
+  void setClock(uint32_t freq) { (void)freq; }
+  void beginTransmission(uint8_t addr) {
+    addr_ = addr;
+    txLen_ = 0;
+  }
+  size_t write(uint8_t b) {
+    if (txLen_ >= sizeof(tx_)) return 0;
+    tx_[txLen_++] = b;
+    return 1;
+  }
+  // 0 on ACK, 2 when no device has the address. The first byte written sets the register
+  // pointer; register writes are accepted and dropped.
+  uint8_t endTransmission(bool stop = true);
+  uint8_t requestFrom(uint8_t addr, uint8_t n);
+  int available() { return rxLen_ - rxPos_; }
+  int read() { return rxPos_ < rxLen_ ? rx_[rxPos_++] : -1; }
+
+ private:
+  uint8_t bus_;
+  uint8_t addr_ = 0;
+  uint8_t reg_ = 0;
+  uint8_t tx_[16] = {};
+  uint8_t txLen_ = 0;
+  uint8_t rx_[32] = {};
+  uint8_t rxLen_ = 0;
+  uint8_t rxPos_ = 0;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
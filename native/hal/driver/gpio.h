@@ -0,0 +1,25 @@
+#pragma once
+
+// Host stand-in: wakeup and interrupt-type changes are accepted and ignored.
+
+#include "../Arduino.h"
+
+typedef int gpio_num_t;
+#define GPIO_NUM_NC (-1)
+
+typedef enum {
+  GPIO_INTR_DISABLE = 0,
+  GPIO_INTR_POSEDGE = 1,
+  GPIO_INTR_NEGEDGE = 2,
+  GPIO_INTR_ANYEDGE = 3,
+  GPIO_INTR_LOW_LEVEL = 4,
+  GPIO_INTR_HIGH_LEVEL = 5,
+} gpio_int_type_t;
+
+inline esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type) {
+  return (void)pin, (void)type, ESP_OK;
+}
+inline esp_err_t gpio_wakeup_disable(gpio_num_t pin) { return (void)pin, ESP_OK; }
+inline esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type) {
+  return (void)pin, (void)type, ESP_OK;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in: every capability is plain heap.
+
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+inline void* heap_caps_malloc(size_t size, unsigned caps) { return (void)caps, malloc(size); }
+inline void heap_caps_free(void* ptr) { free(ptr); }
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in: accepts any configuration and runs the CPU clock at its maximum, as
+// esp_pm_configure() does while a task holds the CPU.
+
+#include "Arduino.h"
+
+typedef struct {
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+inline esp_err_t esp_pm_configure(const void* config) {
+  setCpuFrequencyMhz(static_cast<const esp_pm_config_esp32_t*>(config)->max_freq_mhz);
+  return ESP_OK;
+}
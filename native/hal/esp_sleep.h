@@ -0,0 +1,22 @@
+#pragma once
+
+// Host stand-in: the host never sleeps. Deep sleep requests are counted and return; the wake
+// cause is whatever hal::wakeCause() set.
+
+#include "Arduino.h"
+#include "driver/gpio.h"
+
+typedef enum {
+  ESP_SLEEP_WAKEUP_UNDEFINED = 0,
+  ESP_SLEEP_WAKEUP_EXT0 = 2,
+  ESP_SLEEP_WAKEUP_EXT1 = 3,
+  ESP_SLEEP_WAKEUP_TIMER = 4,
+} esp_sleep_wakeup_cause_t;
+
+inline esp_err_t esp_sleep_enable_gpio_wakeup() { return ESP_OK; }
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us);
+inline esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t pin, int level) {
+  return (void)pin, (void)level, ESP_OK;
+}
+void esp_deep_sleep_start();
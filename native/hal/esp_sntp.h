@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in: configTzTime() "syncs" at once to the host clock (plus clockAdvance()),
+// calling the notification callback before it returns.
+
+#include <sys/time.h>
+
+#include "Arduino.h"
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval* tv);
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
@@ -0,0 +1,975 @@
+#include "hal.h"
+
+#include <Adafruit_BME680.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <WiFiManager.h>
+#include <Wire.h>
+#include <esp_sntp.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <new>
+#include <strings.h>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+EspClass ESP;
+M5Core2 M5;
+TwoWire Wire(0);
+TwoWire Wire1(1);
+WiFiClass WiFi;
+LittleFSFS LittleFS;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point gStart = Clock::now();
+std::atomic<int64_t> gOffsetUs{0};
+std::atomic<bool> gSerialQuiet{false};
+
+uint8_t gBatteryPct = 87;
+bool gCharging = false;
+uint16_t gDischargeMa = 95;
+double gCoulombOut = 0;       // counts up to gCoulombSinceUs
+uint64_t gCoulombSinceUs = 0;
+std::atomic<uint32_t> gCpuMhz{240};
+int gPins[64];
+
+struct WifiScript {
+  uint32_t connectMs = 1500;
+  wl_status_t result = WL_CONNECTED;
+  int8_t rssi = -58;
+  uint32_t scanMs = 0;
+  uint32_t dhcpMs = 0;
+  uint8_t apChannel = 6;
+  uint8_t apBssid[6] = {0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56};
+  uint32_t staticIp = 0;  // set by config(); 0 for DHCP
+  bool begun = false;
+  bool dropped = false;
+  bool directedMiss = false;  // begin() named a channel or BSSID the AP is not on
+  uint32_t beginMs = 0;
+  uint32_t joinMs = 0;  // of the current begin()
+};
+WifiScript gWifi;
+
+esp_sleep_wakeup_cause_t gWakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+uint64_t gSleepTimerUs = 0;
+uint32_t gDeepSleeps = 0;
+
+struct HttpScript {
+  int code = 200;
+  bool chunked = false;
+  std::shared_ptr<const std::string> raw = std::make_shared<std::string>();
+  uint32_t handshakeMs = 0;
+  uint32_t requests = 0;
+  uint32_t connects = 0;
+  std::string etag;
+  std::string lastModified;
+  uint32_t notModified = 0;
+  uint32_t failCount = 0;
+  int failCode = 0;
+  std::string retryAfter;
+};
+HttpScript gHttp;
+
+sntp_sync_time_cb_t gSntpCallback = nullptr;
+
+std::map<std::string, std::vector<uint8_t>> gNvs;
+
+uint64_t nowUs() {
+  const int64_t us =
+      std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - gStart).count();
+  return static_cast<uint64_t>(us + gOffsetUs.load());
+}
+
+// AXP192 discharge coulomb counter: 0.5 mA * 65536 / 25 Hz per count.
+double coulombOut() {
+  const double hours = (nowUs() - gCoulombSinceUs) / 3600e6;
+  return gCoulombOut + gDischargeMa * hours / (65536 * 0.5 / 3600 / 25);
+}
+
+// Waits on `cv` for at most `ticks` ms (forever for portMAX_DELAY) until `ready` holds.
+template <typename Pred>
+bool waitTicks(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+               TickType_t ticks, Pred ready) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+}  // namespace
+
+// ----- Control -----
+
+namespace hal {
+
+void clockAdvance(uint32_t ms) { gOffsetUs += static_cast<int64_t>(ms) * 1000; }
+
+void wifiScript(uint32_t connectMs, wl_status_t result, int8_t rssi) {
+  gWifi.connectMs = connectMs;
+  gWifi.result = result;
+  gWifi.rssi = rssi;
+}
+
+void wifiTiming(uint32_t scanMs, uint32_t dhcpMs) {
+  gWifi.scanMs = scanMs;
+  gWifi.dhcpMs = dhcpMs;
+}
+
+void wifiApChannel(uint8_t channel) { gWifi.apChannel = channel; }
+
+void wifiDrop() { gWifi.dropped = true; }
+
+void httpRespond(int code, const std::string& body, size_t chunkBytes) {
+  gHttp.code = code;
+  gHttp.chunked = chunkBytes > 0;
+  if (!gHttp.chunked) {
+    gHttp.raw = std::make_shared<std::string>(body);
+    return;
+  }
+  auto raw = std::make_shared<std::string>();
+  char head[24];
+  for (size_t pos = 0; pos < body.size(); pos += chunkBytes) {
+    const size_t n = min(chunkBytes, body.size() - pos);
+    snprintf(head, sizeof(head), "%zx\r\n", n);
+    *raw += head;
+    raw->append(body, pos, n);
+    *raw += "\r\n";
+  }
+  *raw += "0\r\n\r\n";
+  gHttp.raw = raw;
+}
+
+void httpHandshakeMs(uint32_t ms) { gHttp.handshakeMs = ms; }
+uint32_t httpRequests() { return gHttp.requests; }
+uint32_t httpConnects() { return gHttp.connects; }
+
+void httpValidators(const std::string& etag, const std::string& lastModified) {
+  gHttp.etag = etag;
+  gHttp.lastModified = lastModified;
+}
+
+uint32_t httpNotModified() { return gHttp.notModified; }
+
+void httpFailNext(uint32_t count, int code, uint32_t retryAfterSec) {
+  gHttp.failCount = count;
+  gHttp.failCode = code;
+  gHttp.retryAfter = retryAfterSec ? std::to_string(retryAfterSec) : "";
+}
+
+void battery(uint8_t pct, bool charging) {
+  gBatteryPct = pct;
+  gCharging = charging;
+}
+
+void batteryCurrent(uint16_t dischargeMa) {
+  gCoulombOut = coulombOut();
+  gCoulombSinceUs = nowUs();
+  gDischargeMa = dischargeMa;
+}
+
+void pin(uint8_t p, int level) { gPins[p % 64] = level; }
+
+void wakeCause(esp_sleep_wakeup_cause_t cause) { gWakeCause = cause; }
+uint32_t deepSleeps() { return gDeepSleeps; }
+uint64_t deepSleepTimerUs() { return gSleepTimerUs; }
+
+void serialQuiet(bool quiet) { gSerialQuiet = quiet; }
+
+}  // namespace hal
+
+// ----- Heap -----
+
+// libstdc++'s operator new calls malloc() from inside the shared library, out of reach of
+// -Wl,--wrap; defining it here routes C++ allocations through the heap guard as well.
+void* operator new(size_t n) {
+  if (void* p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// ----- Core -----
+
+uint32_t millis() { return static_cast<uint32_t>(nowUs() / 1000); }
+uint32_t micros() { return static_cast<uint32_t>(nowUs()); }
+void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+void yield() { std::this_thread::yield(); }
+
+bool String::equalsIgnoreCase(const String& o) const {
+  return strcasecmp(c_str(), o.c_str()) == 0;
+}
+
+size_t Print::write(const uint8_t* data, size_t n) {
+  size_t done = 0;
+  while (done < n && write(data[done]) == 1) done++;
+  return done;
+}
+
+int Print::printf(const char* fmt, ...) {
+  char buf[512];
+  va_list args;
+  va_start(args, fmt);
+  const int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (n <= 0) return n;
+  write(reinterpret_cast<const uint8_t*>(buf), min<size_t>(n, sizeof(buf) - 1));
+  return n;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t done = 0;
+  while (done < length) {
+    const int c = read();
+    if (c < 0) break;
+    buffer[done++] = static_cast<char>(c);
+  }
+  return done;
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t* data, size_t n) {
+  if (!gSerialQuiet) fwrite(data, 1, n, stderr);
+  return n;
+}
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+  gCpuMhz = mhz;
+  return true;
+}
+
+uint32_t getCpuFrequencyMhz() { return gCpuMhz; }
+
+uint32_t esp_random() {
+  static uint32_t state = 0x9E3779B9;
+  state = state * 1664525u + 1013904223u;
+  return state;
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) {
+  gSntpCallback = callback;
+}
+
+void configTzTime(const char* tz, const char* server1, const char* server2,
+                  const char* server3) {
+  (void)server1, (void)server2, (void)server3;
+  setenv("TZ", tz, 1);
+  tzset();
+  const uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count() +
+                      gOffsetUs.load();
+  timeval tv;
+  tv.tv_sec = static_cast<time_t>(us / 1000000);
+  tv.tv_usec = static_cast<suseconds_t>(us % 1000000);
+  if (gSntpCallback) gSntpCallback(&tv);
+}
+
+uint32_t EspClass::getFreeHeap() { return 180000; }
+uint32_t EspClass::getMinFreeHeap() { return 150000; }
+uint32_t EspClass::getMaxAllocHeap() { return 110000; }
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)mode;
+  if (gPins[pin % 64] == 0) gPins[pin % 64] = HIGH;
+}
+int digitalRead(uint8_t pin) { return gPins[pin % 64]; }
+void digitalWrite(uint8_t pin, uint8_t level) { gPins[pin % 64] = level; }
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) { (void)pin, (void)isr, (void)mode; }
+
+// ----- FreeRTOS -----
+
+struct HalTask {
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+};
+
+struct HalQueue {
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length;
+  size_t itemSize;
+};
+
+struct HalSemaphore {
+  std::mutex m;
+  std::condition_variable cv;
+  int count;
+};
+
+struct HalEventGroup {
+  std::mutex m;
+  std::condition_variable cv;
+  EventBits_t bits = 0;
+};
+
+namespace {
+
+thread_local HalTask* tTask = nullptr;
+
+// Threads the stand-ins did not start use a thread-local task, not a heap one: the heap
+// guard asks for the current task from inside malloc().
+HalTask* currentTask() {
+  thread_local HalTask self;
+  if (!tTask) tTask = &self;
+  return tTask;
+}
+
+}  // namespace
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stack,
+                                   void* param, UBaseType_t prio, TaskHandle_t* out,
+                                   BaseType_t core) {
+  (void)name, (void)stack, (void)prio, (void)core;
+  HalTask* task = new HalTask;
+  if (out) *out = task;
+  std::thread([task, fn, param]() {
+    tTask = task;
+    fn(param);
+  }).detach();
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+TickType_t xTaskGetTickCount() { return millis(); }
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { return (void)task, 2048; }
+BaseType_t xPortGetCoreID() { return 0; }
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->m);
+  task->notify++;
+  task->cv.notify_all();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return currentTask(); }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  HalTask* task = currentTask();
+  std::unique_lock<std::mutex> lock(task->m);
+  waitTicks(task->cv, lock, ticks, [task] { return task->notify > 0; });
+  const uint32_t value = task->notify;
+  if (value > 0) task->notify = clear ? 0 : value - 1;
+  return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HalQueue* q = new HalQueue;
+  q->length = length;
+  q->itemSize = itemSize;
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!waitTicks(q->cv, lock, ticks, [q] { return q->items.size() < q->length; })) {
+    return pdFAIL;
+  }
+  const uint8_t* p = static_cast<const uint8_t*>(item);
+  q->items.emplace_back(p, p + q->itemSize);
+  q->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void* item) {
+  std::lock_guard<std::mutex> lock(q->m);
+  q->items.clear();
+  const uint8_t* p = static_cast<const uint8_t*>(item);
+  q->items.emplace_back(p, p + q->itemSize);
+  q->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!waitTicks(q->cv, lock, ticks, [q] { return !q->items.empty(); })) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void* item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!waitTicks(q->cv, lock, ticks, [q] { return !q->items.empty(); })) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  HalSemaphore* s = new HalSemaphore;
+  s->count = 1;
+  return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  HalSemaphore* s = new HalSemaphore;
+  s->count = 0;
+  return s;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(s->m);
+  if (!waitTicks(s->cv, lock, ticks, [s] { return s->count > 0; })) return pdFALSE;
+  s->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  std::lock_guard<std::mutex> lock(s->m);
+  if (s->count > 0) return pdFALSE;
+  s->count = 1;
+  s->cv.notify_all();
+  return pdTRUE;
+}
+
+EventGroupHandle_t xEventGroupCreate() { return new HalEventGroup; }
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits) {
+  std::lock_guard<std::mutex> lock(g->m);
+  g->bits |= bits;
+  g->cv.notify_all();
+  return g->bits;
+}
+
+EventBits_t xEventGroupSetBitsFromISR(EventGroupHandle_t g, EventBits_t bits, BaseType_t* woken) {
+  if (woken) *woken = pdFALSE;
+  return xEventGroupSetBits(g, bits);
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits) {
+  std::lock_guard<std::mutex> lock(g->m);
+  const EventBits_t before = g->bits;
+  g->bits &= ~bits;
+  return before;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(g->m);
+  auto ready = [g, bits, all] { return all ? (g->bits & bits) == bits : (g->bits & bits) != 0; };
+  const bool ok = waitTicks(g->cv, lock, ticks, ready);
+  const EventBits_t value = g->bits;
+  if (ok && clear) g->bits &= ~bits;
+  return value;
+}
+
+// ----- Display -----
+
+namespace {
+
+int16_t glyphWidth(uint8_t font) { return font == 4 ? 14 : (font == 2 ? 8 : 6); }
+
+}  // namespace
+
+TFT_eSPI::TFT_eSPI(int16_t w, int16_t h) { resize(w, h); }
+
+TFT_eSPI::~TFT_eSPI() { delete[] buf_; }
+
+void TFT_eSPI::resize(int16_t w, int16_t h) {
+  delete[] buf_;
+  buf_ = nullptr;
+  w_ = max<int16_t>(w, 0);
+  h_ = max<int16_t>(h, 0);
+  if (w_ > 0 && h_ > 0) buf_ = new uint16_t[static_cast<size_t>(w_) * h_]();
+}
+
+void TFT_eSPI::begin() {
+  if (writeDepth_++ == 0 && panel_) transactions_++;
+}
+
+void TFT_eSPI::startWrite() { begin(); }
+void TFT_eSPI::endWrite() { end(); }
+
+void TFT_eSPI::fillClipped(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) {
+  const int32_t x0 = max<int32_t>(x, 0);
+  const int32_t y0 = max<int32_t>(y, 0);
+  const int32_t x1 = min<int32_t>(x + w, w_);
+  const int32_t y1 = min<int32_t>(y + h, h_);
+  if (x0 >= x1 || y0 >= y1) return;
+  for (int32_t row = y0; row < y1; row++) {
+    std::fill(buf_ + row * w_ + x0, buf_ + row * w_ + x1, color);
+  }
+  if (panel_) pixels_ += static_cast<uint64_t>(x1 - x0) * (y1 - y0);
+}
+
+void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+  begin();
+  fillClipped(x, y, w, h, color);
+  end();
+}
+
+void TFT_eSPI::drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+  begin();
+  fillClipped(x, y, w, 1, color);
+  fillClipped(x, y + h - 1, w, 1, color);
+  fillClipped(x, y + 1, 1, h - 2, color);
+  fillClipped(x + w - 1, y + 1, 1, h - 2, color);
+  end();
+}
+
+void TFT_eSPI::fillRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t r,
+                             uint32_t color) {
+  r = min<int32_t>(r, min(w, h) / 2);
+  begin();
+  fillClipped(x, y + r, w, h - 2 * r, color);
+  for (int32_t i = 0; i < r; i++) {
+    const int32_t dy = r - i;
+    const int32_t dx = r - static_cast<int32_t>(std::sqrt(static_cast<float>(r * r - dy * dy)));
+    fillClipped(x + dx, y + i, w - 2 * dx, 1, color);
+    fillClipped(x + dx, y + h - 1 - i, w - 2 * dx, 1, color);
+  }
+  end();
+}
+
+void TFT_eSPI::drawRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t r,
+                             uint32_t color) {
+  r = min<int32_t>(r, min(w, h) / 2);
+  begin();
+  fillClipped(x + r, y, w - 2 * r, 1, color);
+  fillClipped(x + r, y + h - 1, w - 2 * r, 1, color);
+  fillClipped(x, y + r, 1, h - 2 * r, color);
+  fillClipped(x + w - 1, y + r, 1, h - 2 * r, color);
+  for (int32_t i = 0; i < r; i++) {
+    const int32_t dy = r - i;
+    const int32_t dx = r - static_cast<int32_t>(std::sqrt(static_cast<float>(r * r - dy * dy)));
+    fillClipped(x + dx, y + i, 1, 1, color);
+    fillClipped(x + w - 1 - dx, y + i, 1, 1, color);
+    fillClipped(x + dx, y + h - 1 - i, 1, 1, color);
+    fillClipped(x + w - 1 - dx, y + h - 1 - i, 1, 1, color);
+  }
+  end();
+}
+
+void TFT_eSPI::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color) {
+  begin();
+  const int32_t dx = std::abs(x1 - x0);
+  const int32_t dy = -std::abs(y1 - y0);
+  const int32_t sx = x0 < x1 ? 1 : -1;
+  const int32_t sy = y0 < y1 ? 1 : -1;
+  int32_t err = dx + dy;
+  for (;;) {
+    fillClipped(x0, y0, 1, 1, color);
+    if (x0 == x1 && y0 == y1) break;
+    const int32_t e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+  end();
+}
+
+void TFT_eSPI::drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) {
+  fillRect(x, y, w, 1, color);
+}
+
+void TFT_eSPI::drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) {
+  fillRect(x, y, 1, h, color);
+}
+
+void TFT_eSPI::drawPixel(int32_t x, int32_t y, uint32_t color) { fillRect(x, y, 1, 1, color); }
+
+int16_t TFT_eSPI::textWidth(const char* s, uint8_t font) const {
+  return static_cast<int16_t>(strlen(s) * glyphWidth(font));
+}
+
+int16_t TFT_eSPI::fontHeight(uint8_t font) const {
+  return font == 4 ? 26 : (font == 2 ? 16 : 8);
+}
+
+int16_t TFT_eSPI::drawString(const char* s, int32_t x, int32_t y, uint8_t font) {
+  const int16_t cw = glyphWidth(font);
+  const int16_t ch = fontHeight(font);
+  const bool opaque = textBg_ != textFg_;
+  begin();
+  for (const char* p = s; *p; p++, x += cw) {
+    if (opaque) fillClipped(x, y, cw, ch, textBg_);
+    if (*p == ' ') continue;
+    // Glyph ink: on an opaque cell these pixels were already counted with the background.
+    const uint64_t before = pixels_;
+    fillClipped(x + 1, y + ch / 2 - 1, cw - 2, 2, textFg_);
+    if (opaque) pixels_ = before;
+  }
+  end();
+  return static_cast<int16_t>(strlen(s) * cw);
+}
+
+void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data) {
+  const int32_t x0 = max<int32_t>(x, 0);
+  const int32_t y0 = max<int32_t>(y, 0);
+  const int32_t x1 = min<int32_t>(x + w, w_);
+  const int32_t y1 = min<int32_t>(y + h, h_);
+  if (x0 >= x1 || y0 >= y1) return;
+  begin();
+  for (int32_t row = y0; row < y1; row++) {
+    memcpy(buf_ + row * w_ + x0, data + (row - y) * w + (x0 - x), (x1 - x0) * sizeof(uint16_t));
+  }
+  if (panel_) pixels_ += static_cast<uint64_t>(x1 - x0) * (y1 - y0);
+  end();
+}
+
+uint16_t TFT_eSPI::pixelAt(int16_t x, int16_t y) const {
+  return (x >= 0 && y >= 0 && x < w_ && y < h_) ? buf_[y * w_ + x] : 0;
+}
+
+void* TFT_eSprite::createSprite(int16_t w, int16_t h) {
+  resize(w, h);
+  return buf_;
+}
+
+// ----- I2C -----
+
+namespace {
+
+uint8_t binToBcd(int v) { return static_cast<uint8_t>((v / 10) << 4 | (v % 10)); }
+
+// Register `reg` of a device on the internal bus, or false when nothing has `addr`.
+bool internalBusReg(uint8_t addr, uint8_t reg, uint8_t& out) {
+  switch (addr) {
+    case 0x34: {  // AXP192: status, battery voltage (1.1 mV), discharge current (0.5 mA)
+      const uint16_t mv = static_cast<uint16_t>((3121 + gBatteryPct * 10) * 10 / 11);
+      const uint16_t ma = static_cast<uint16_t>(gCharging ? 0 : gDischargeMa * 2);
+      const uint32_t out32 = static_cast<uint32_t>(coulombOut());
+      out = reg == 0x00                 ? (gCharging ? 0x24 : 0x00)
+            : reg == 0x78               ? static_cast<uint8_t>(mv >> 4)
+            : reg == 0x79               ? static_cast<uint8_t>(mv & 0x0F)
+            : reg == 0x7C               ? static_cast<uint8_t>(ma >> 5)
+            : reg == 0x7D               ? static_cast<uint8_t>(ma & 0x1F)
+            : reg >= 0xB4 && reg <= 0xB7 ? static_cast<uint8_t>(out32 >> (8 * (0xB7 - reg)))
+            : reg == 0xB8               ? 0x80  // coulomb counter running
+                                        : 0;
+      return true;
+    }
+    case 0x51: {  // BM8563: seconds..years in BCD from 0x02
+      const time_t now = time(nullptr) + static_cast<time_t>(gOffsetUs.load() / 1000000);
+      tm t;
+      gmtime_r(&now, &t);
+      const uint8_t regs[] = {binToBcd(t.tm_sec),
+                              binToBcd(t.tm_min),
+                              binToBcd(t.tm_hour),
+                              binToBcd(t.tm_mday),
+                              binToBcd(t.tm_wday),
+                              binToBcd(t.tm_mon + 1),
+                              binToBcd(t.tm_year % 100)};
+      out = reg >= 0x02 && reg <= 0x08 ? regs[reg - 0x02] : 0;
+      return true;
+    }
+    case 0x38:  // FT6336U: no touch points
+      out = 0;
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+uint8_t TwoWire::endTransmission(bool stop) {
+  (void)stop;
+  uint8_t probe;
+  if (bus_ != 1 || !internalBusReg(addr_, 0, probe)) return 2;
+  if (txLen_ > 0) reg_ = tx_[0];
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t n) {
+  rxLen_ = 0;
+  rxPos_ = 0;
+  n = min<uint8_t>(n, sizeof(rx_));
+  for (uint8_t i = 0; i < n; i++) {
+    if (bus_ != 1 || !internalBusReg(addr, static_cast<uint8_t>(reg_ + i), rx_[i])) return 0;
+  }
+  rxLen_ = n;
+  return n;
+}
+
+// ----- RTC / power -----
+
+void RTC::GetTime(RTC_TimeTypeDef* t) {
+  const time_t now = time(nullptr) + static_cast<time_t>(gOffsetUs.load() / 1000000);
+  tm parts;
+  gmtime_r(&now, &parts);
+  t->Hours = parts.tm_hour;
+  t->Minutes = parts.tm_min;
+  t->Seconds = parts.tm_sec;
+}
+
+void RTC::GetDate(RTC_DateTypeDef* d) {
+  const time_t now = time(nullptr) + static_cast<time_t>(gOffsetUs.load() / 1000000);
+  tm parts;
+  gmtime_r(&now, &parts);
+  d->WeekDay = parts.tm_wday;
+  d->Month = parts.tm_mon + 1;
+  d->Date = parts.tm_mday;
+  d->Year = parts.tm_year + 1900;
+}
+
+float AXP192::GetBatteryLevel() { return gBatteryPct; }
+float AXP192::GetBatVoltage() { return 3.3f + gBatteryPct * 0.009f; }
+bool AXP192::isCharging() { return gCharging; }
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return gWakeCause; }
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us) {
+  gSleepTimerUs = us;
+  return ESP_OK;
+}
+
+void esp_deep_sleep_start() { gDeepSleeps++; }
+
+// ----- Wi-Fi / HTTP -----
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(buf);
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* pass, int32_t channel,
+                             const uint8_t* bssid, bool connect) {
+  (void)ssid, (void)pass;
+  const bool directed = channel != 0 && bssid != nullptr;
+  gWifi.directedMiss = directed && (channel != gWifi.apChannel ||
+                                    memcmp(bssid, gWifi.apBssid, sizeof(gWifi.apBssid)) != 0);
+  gWifi.joinMs = gWifi.connectMs + (directed ? 0 : gWifi.scanMs) +
+                 (gWifi.staticIp ? 0 : gWifi.dhcpMs);
+  gWifi.begun = connect;
+  gWifi.dropped = false;
+  gWifi.beginMs = millis();
+  return status();
+}
+
+bool WiFiClass::config(IPAddress localIp, IPAddress gateway, IPAddress subnet, IPAddress dns1,
+                       IPAddress dns2) {
+  (void)gateway, (void)subnet, (void)dns1, (void)dns2;
+  gWifi.staticIp = localIp;
+  return true;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp) {
+  (void)wifiOff, (void)eraseAp;
+  gWifi.begun = false;
+  return true;
+}
+
+wl_status_t WiFiClass::status() {
+  wl_status_t st = WL_DISCONNECTED;
+  if (gWifi.begun) {
+    if (gWifi.dropped) {
+      st = WL_CONNECTION_LOST;
+    } else if (millis() - gWifi.beginMs >= gWifi.joinMs) {
+      st = gWifi.directedMiss ? WL_NO_SSID_AVAIL : gWifi.result;
+    }
+  }
+  if (st != last_) {
+    last_ = st;
+    if (cb_) {
+      arduino_event_info_t info = {};
+      cb_(st == WL_CONNECTED ? ARDUINO_EVENT_WIFI_STA_GOT_IP : ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+          info);
+    }
+  }
+  return st;
+}
+
+String WiFiClass::SSID() { return String(status() == WL_CONNECTED ? "bench-ap" : ""); }
+uint8_t* WiFiClass::BSSID() { return status() == WL_CONNECTED ? gWifi.apBssid : nullptr; }
+int32_t WiFiClass::channel() { return status() == WL_CONNECTED ? gWifi.apChannel : 0; }
+IPAddress WiFiClass::localIP() {
+  if (status() != WL_CONNECTED) return IPAddress();
+  return gWifi.staticIp ? IPAddress(gWifi.staticIp) : IPAddress(192, 168, 1, 50);
+}
+IPAddress WiFiClass::gatewayIP() {
+  return status() == WL_CONNECTED ? IPAddress(192, 168, 1, 1) : IPAddress();
+}
+IPAddress WiFiClass::subnetMask() {
+  return status() == WL_CONNECTED ? IPAddress(255, 255, 255, 0) : IPAddress();
+}
+IPAddress WiFiClass::dnsIP(uint8_t index) {
+  return status() == WL_CONNECTED && index == 0 ? IPAddress(192, 168, 1, 1) : IPAddress();
+}
+int8_t WiFiClass::RSSI() { return status() == WL_CONNECTED ? gWifi.rssi : 0; }
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+  (void)host, (void)port, (void)timeoutMs;
+  if (WiFi.status() != WL_CONNECTED) return 0;
+  hal::clockAdvance(gHttp.handshakeMs);
+  gHttp.connects++;
+  open_ = true;
+  return 1;
+}
+
+size_t WiFiClient::readBytes(char* buffer, size_t length) {
+  const size_t n = min(length, left());
+  if (n > 0) memcpy(buffer, rx_->data() + pos_, n);
+  pos_ += n;
+  return n;
+}
+
+bool HTTPClient::begin(WiFiClient& client, const char* url) {
+  (void)url;
+  client_ = &client;
+  return true;
+}
+
+void HTTPClient::end() {
+  client_ = nullptr;
+  ifNoneMatch_[0] = '\0';
+  ifModifiedSince_[0] = '\0';
+}
+
+void HTTPClient::addHeader(const String& name, const String& value) {
+  if (name.equalsIgnoreCase("If-None-Match")) {
+    snprintf(ifNoneMatch_, sizeof(ifNoneMatch_), "%s", value.c_str());
+  } else if (name.equalsIgnoreCase("If-Modified-Since")) {
+    snprintf(ifModifiedSince_, sizeof(ifModifiedSince_), "%s", value.c_str());
+  }
+}
+
+int HTTPClient::GET() {
+  static const auto kEmpty = std::make_shared<const std::string>();
+  gHttp.requests++;
+  code_ = 0;
+  chunked_ = false;
+  if (!client_ || !client_->connected()) return HTTPC_ERROR_CONNECTION_REFUSED;
+  int code = gHttp.code;
+  if (gHttp.failCount > 0) {
+    gHttp.failCount--;
+    code = gHttp.failCode;
+  } else if (code == HTTP_CODE_OK &&
+             ((ifNoneMatch_[0] && gHttp.etag == ifNoneMatch_) ||
+              (ifModifiedSince_[0] && gHttp.lastModified == ifModifiedSince_))) {
+    gHttp.notModified++;
+    code = HTTP_CODE_NOT_MODIFIED;
+  }
+  if (code < 0) {
+    client_->stop();
+    return code;
+  }
+  code_ = code;
+  if (code != HTTP_CODE_OK) {
+    size_ = 0;
+    client_->setResponse(kEmpty);
+    return code;
+  }
+  chunked_ = gHttp.chunked;
+  size_ = chunked_ ? -1 : static_cast<int>(gHttp.raw->size());
+  client_->setResponse(gHttp.raw);
+  return code;
+}
+
+String HTTPClient::header(const char* name) {
+  if (strcasecmp(name, "Transfer-Encoding") == 0) return String(chunked_ ? "chunked" : "");
+  if (code_ == HTTP_CODE_OK && strcasecmp(name, "ETag") == 0) return String(gHttp.etag);
+  if (code_ == HTTP_CODE_OK && strcasecmp(name, "Last-Modified") == 0) {
+    return String(gHttp.lastModified);
+  }
+  if (code_ != HTTP_CODE_OK && strcasecmp(name, "Retry-After") == 0) {
+    return String(gHttp.retryAfter);
+  }
+  return String();
+}
+
+// ----- Storage -----
+
+bool Preferences::begin(const char* ns, bool readOnly) {
+  ns_ = ns;
+  readOnly_ = readOnly;
+  return true;
+}
+
+size_t Preferences::putBytes(const char* key, const void* data, size_t len) {
+  if (readOnly_ || ns_.empty()) return 0;
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  gNvs[ns_ + "/" + key].assign(p, p + len);
+  return len;
+}
+
+size_t Preferences::getBytes(const char* key, void* out, size_t maxLen) {
+  const auto it = gNvs.find(ns_ + "/" + key);
+  if (it == gNvs.end() || it->second.size() > maxLen) return 0;
+  memcpy(out, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  const auto it = gNvs.find(ns_ + "/" + key);
+  return it == gNvs.end() ? 0 : it->second.size();
+}
+
+bool Preferences::remove(const char* key) {
+  return !readOnly_ && gNvs.erase(ns_ + "/" + key) != 0;
+}
+
+bool Preferences::isKey(const char* key) { return gNvs.count(ns_ + "/" + key) != 0; }
+
+bool File::seek(uint32_t pos) {
+  if (!data_ || pos > data_->size()) return false;
+  pos_ = pos;
+  return true;
+}
+
+size_t File::read(uint8_t* out, size_t n) {
+  if (!data_) return 0;
+  n = min(n, data_->size() - pos_);
+  memcpy(out, data_->data() + pos_, n);
+  pos_ += n;
+  return n;
+}
+
+size_t File::write(const uint8_t* data, size_t n) {
+  if (!data_ || !write_) return 0;
+  if (pos_ + n > data_->size()) data_->resize(pos_ + n);
+  memcpy(data_->data() + pos_, data, n);
+  pos_ += n;
+  return n;
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char* base, uint8_t maxOpen, const char* label) {
+  (void)formatOnFail, (void)base, (void)maxOpen, (void)label;
+  return true;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+  auto it = files_.find(path);
+  if (mode[0] == 'r') {
+    return it == files_.end() ? File() : File(it->second, false, 0);
+  }
+  if (it == files_.end()) {
+    it = files_.emplace(path, std::make_shared<std::vector<uint8_t>>()).first;
+  }
+  if (mode[0] == 'w') it->second->clear();
+  return File(it->second, true, it->second->size());
+}
+
+bool LittleFSFS::rename(const char* from, const char* to) {
+  const auto it = files_.find(from);
+  if (it == files_.end()) return false;
+  files_[to] = it->second;
+  files_.erase(it);
+  return true;
+}
+
+size_t LittleFSFS::usedBytes() const {
+  size_t used = 0;
+  for (const auto& f : files_) used += (f.second->size() + 4095) / 4096 * 4096;
+  return used;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Controls for the host stand-ins, used by the benchmarks to script what the hardware and
+// the network do.
+
+#include <string>
+
+#include "HTTPClient.h"
+#include "M5Core2.h"
+#include "WiFi.h"
+#include "esp_sleep.h"
+
+namespace hal {
+
+// Moves millis()/micros() (and the RTC) forward without sleeping.
+void clockAdvance(uint32_t ms);
+
+// WiFi.begin() reaches `result` after `connectMs`; until then the status is WL_DISCONNECTED.
+void wifiScript(uint32_t connectMs, wl_status_t result, int8_t rssi = -58);
+// Extra time a join spends scanning for the AP (skipped by a begin() naming its channel and
+// BSSID) and in DHCP (skipped with a static address).
+void wifiTiming(uint32_t scanMs, uint32_t dhcpMs);
+// Moves the AP to another channel: a directed begin() with the old one ends WL_NO_SSID_AVAIL.
+void wifiApChannel(uint8_t channel);
+// Drops an established link, as a lost AP would.
+void wifiDrop();
+
+// What GET() answers. The body is framed with Content-Length, or as `chunkBytes`-sized
+// chunks when that is non-zero. A negative code fails the request without a body.
+void httpRespond(int code, const std::string& body, size_t chunkBytes = 0);
+// Added to every fresh (non-reused) connection's connect().
+void httpHandshakeMs(uint32_t ms);
+uint32_t httpRequests();
+uint32_t httpConnects();
+// Validators sent with every 200; a request carrying a matching If-None-Match or
+// If-Modified-Since gets 304 Not Modified. Empty strings turn either off.
+void httpValidators(const std::string& etag, const std::string& lastModified);
+uint32_t httpNotModified();
+// The next `count` requests fail with `code` and no body: a negative code as a client error,
+// a positive one as that HTTP status, with Retry-After when `retryAfterSec` is non-zero.
+void httpFailNext(uint32_t count, int code, uint32_t retryAfterSec = 0);
+
+// What the AXP192 on Wire1 (and M5.Axp) report.
+void battery(uint8_t pct, bool charging);
+// Battery discharge current while not charging; it also drives the coulomb counter.
+void batteryCurrent(uint16_t dischargeMa);
+void pin(uint8_t pin, int level);
+
+// What esp_sleep_get_wakeup_cause() reports for this "boot".
+void wakeCause(esp_sleep_wakeup_cause_t cause);
+// esp_deep_sleep_start() calls so far, and the timer wakeup armed for the latest.
+uint32_t deepSleeps();
+uint64_t deepSleepTimerUs();
+
+// Sends Serial output to stderr (default) or drops it.
+void serialQuiet(bool quiet);
+
+}  // namespace hal
@@ -0,0 +1,11 @@
+#pragma once
+
+// lwIP's BSD socket API is the host's.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
@@ -0,0 +1,204 @@
+#include "duty_cycle.h"
+
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+
+#include <cstddef>
+
+#include "power_governor.h"  // BATTERY_CAPACITY_MAH
+#include "wall_clock.h"
+#include "weather_cache.h"  // crc32Update
+
+// Assumed drain while asleep until the coulomb counter has measured whole cycles: the AXP192,
+// touch controller and RTC stay powered.
+#ifndef DUTY_CYCLE_SLEEP_MA
+#define DUTY_CYCLE_SLEEP_MA 3
+#endif
+
+namespace {
+
+constexpr uint16_t kMagic = 0x4443;  // "DC"
+constexpr uint8_t kVersion = 1;
+constexpr uint8_t kHasSchedule = 1 << 0;
+constexpr uint8_t kHasBase = 1 << 1;
+
+// Coulomb counts are 0.36 mAh each: a measurement needs this many hours before it replaces
+// the estimate, and is halved past a week so it keeps following the present load.
+constexpr uint32_t kMeasureMinSec = 3600;
+constexpr uint32_t kMeasureMaxSec = 7 * 86400UL;
+constexpr uint32_t kAwakeWindow = 256;
+
+struct Retained {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t flags;
+  uint32_t cycles;
+  uint32_t awakeMsLast;
+  uint32_t awakeMsSum;  // over awakeCycles
+  uint32_t awakeCycles;
+  uint32_t sleepSecLast;
+  uint32_t nextFetchUnix;
+  uint32_t baseUnix;  // wall clock at the reading the current cycle started from
+  uint32_t baseCoulombOut;
+  uint32_t baseCoulombIn;
+  uint32_t measuredCounts;  // discharge over measuredSec, on battery throughout
+  uint32_t measuredSec;
+  uint16_t awakeMa;  // ADC discharge while awake, smoothed
+  uint16_t reserved;
+  uint32_t crc;  // CRC32 over all preceding bytes
+};
+
+// Zeroed at power-on, kept through deep sleep.
+RTC_DATA_ATTR Retained gRtc;
+
+uint8_t gWakePin = 0;
+uint8_t gBatteryPct = 0;
+bool gExternalPower = false;
+bool gCycleClosed = false;  // this boot's first reading has been accounted
+
+void seal() {
+  gRtc.magic = kMagic;
+  gRtc.version = kVersion;
+  gRtc.crc = crc32Update(0, &gRtc, offsetof(Retained, crc));
+}
+
+bool valid() {
+  return gRtc.magic == kMagic && gRtc.version == kVersion &&
+         gRtc.crc == crc32Update(0, &gRtc, offsetof(Retained, crc));
+}
+
+uint16_t drainMaX10(bool& measured) {
+  measured = gRtc.measuredSec >= kMeasureMinSec && gRtc.measuredCounts > 0;
+  if (measured) {
+    // counts * kAxpCoulombMah over measuredSec, in 0.1 mA.
+    return static_cast<uint16_t>(min<uint64_t>(
+        gRtc.measuredCounts * 36000ULL * kAxpCoulombMah / gRtc.measuredSec, 65535));
+  }
+  if (gRtc.awakeCycles == 0 || gRtc.awakeMa == 0 || gRtc.sleepSecLast == 0) return 0;
+  // Time-weighted: the measured awake current for the average pass, the assumed sleep one
+  // for the rest of the cycle.
+  const uint64_t awakeMs = gRtc.awakeMsSum / gRtc.awakeCycles;
+  const uint64_t sleepMs = gRtc.sleepSecLast * 1000ULL;
+  return static_cast<uint16_t>(
+      min<uint64_t>((awakeMs * gRtc.awakeMa + sleepMs * DUTY_CYCLE_SLEEP_MA) * 10 /
+                        (awakeMs + sleepMs),
+                    65535));
+}
+
+}  // namespace
+
+WakeCause dutyCycleBegin(uint8_t wakePin) {
+  gWakePin = wakePin;
+  WakeCause wake = WakeCause::PowerOn;
+  switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_TIMER:
+      wake = WakeCause::Timer;
+      break;
+    case ESP_SLEEP_WAKEUP_EXT0:
+      wake = WakeCause::Touch;
+      break;
+    default:
+      break;
+  }
+  if (wake == WakeCause::PowerOn || !valid()) {
+    gRtc = Retained{};
+    wake = WakeCause::PowerOn;
+  }
+  if (wake == WakeCause::Timer) gRtc.cycles++;
+  seal();
+  return wake;
+}
+
+void dutyCycleNotePower(const PowerReading& r, uint8_t batteryPct) {
+  gBatteryPct = batteryPct;
+  gExternalPower = r.externalPower;
+  if (!r.externalPower && r.dischargeMa > 0) {
+    gRtc.awakeMa = gRtc.awakeMa ? (gRtc.awakeMa * 3 + r.dischargeMa) / 4 : r.dischargeMa;
+  }
+  if (!gCycleClosed) {
+    gCycleClosed = true;
+    uint32_t unixSec = 0;
+    const bool clockSet = wallClockNow(unixSec);
+    const bool onBattery = (gRtc.flags & kHasBase) && !r.externalPower && clockSet &&
+                           r.coulombIn == gRtc.baseCoulombIn && unixSec > gRtc.baseUnix;
+    if (onBattery) {
+      gRtc.measuredCounts += r.coulombOut - gRtc.baseCoulombOut;
+      gRtc.measuredSec += unixSec - gRtc.baseUnix;
+      if (gRtc.measuredSec > kMeasureMaxSec) {
+        gRtc.measuredCounts /= 2;
+        gRtc.measuredSec /= 2;
+      }
+    } else if (r.externalPower || r.coulombIn != gRtc.baseCoulombIn) {
+      // Charged in between: what was measured no longer describes the drain alone.
+      gRtc.measuredCounts = 0;
+      gRtc.measuredSec = 0;
+    }
+    gRtc.flags = clockSet ? (gRtc.flags | kHasBase) : (gRtc.flags & ~kHasBase);
+    gRtc.baseUnix = unixSec;
+    gRtc.baseCoulombOut = r.coulombOut;
+    gRtc.baseCoulombIn = r.coulombIn;
+  }
+  seal();
+}
+
+bool dutyCycleFetchDue(uint32_t unixSec) {
+  // The RTC slow clock runs a few percent off, so a wake for a fetch may come a little early.
+  static constexpr uint32_t kWakeSlackSec = 60;
+  if (!(gRtc.flags & kHasSchedule) || unixSec == 0 || gRtc.nextFetchUnix == 0) return true;
+  return unixSec + kWakeSlackSec >= gRtc.nextFetchUnix;
+}
+
+void dutyCycleSleep(uint32_t sleepSec, uint32_t nextFetchUnix, bool timerWake) {
+  // From app start: the ROM and bootloader's few hundred ms before it are not counted.
+  const uint32_t awakeMs = millis();
+  if (timerWake) {
+    if (gRtc.awakeCycles >= kAwakeWindow) {
+      gRtc.awakeMsSum /= 2;
+      gRtc.awakeCycles /= 2;
+    }
+    gRtc.awakeMsLast = awakeMs;
+    gRtc.awakeMsSum += awakeMs;
+    gRtc.awakeCycles++;
+  }
+  gRtc.sleepSecLast = sleepSec;
+  gRtc.nextFetchUnix = nextFetchUnix;
+  gRtc.flags |= kHasSchedule;
+  seal();
+
+  const DutyCycleStats st = dutyCycleStats();
+  Serial.printf("[Duty] %s %u ms (pass avg %u ms), sleeping %u s",
+                timerWake ? "Pass" : "Session",
+                static_cast<unsigned>(awakeMs),
+                static_cast<unsigned>(st.awakeMsAvg),
+                static_cast<unsigned>(sleepSec));
+  if (st.drainMaX10 != 0) {
+    Serial.printf("; drain %u.%u mA (%s), ~%u.%u days",
+                  static_cast<unsigned>(st.drainMaX10 / 10),
+                  static_cast<unsigned>(st.drainMaX10 % 10),
+                  st.measured ? "measured" : "estimated",
+                  static_cast<unsigned>(st.batteryDaysX10 / 10),
+                  static_cast<unsigned>(st.batteryDaysX10 % 10));
+  }
+  Serial.println();
+  Serial.flush();
+
+  esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(sleepSec) * 1000000ULL);
+  esp_sleep_enable_ext0_wakeup(static_cast<gpio_num_t>(gWakePin), 0);
+  esp_deep_sleep_start();
+}
+
+DutyCycleStats dutyCycleStats() {
+  DutyCycleStats st;
+  st.cycles = gRtc.cycles;
+  st.awakeMsLast = gRtc.awakeMsLast;
+  st.awakeMsAvg = gRtc.awakeCycles ? gRtc.awakeMsSum / gRtc.awakeCycles : 0;
+  st.sleepSecLast = gRtc.sleepSecLast;
+  st.nextFetchUnix = gRtc.nextFetchUnix;
+  st.drainMaX10 = drainMaX10(st.measured);
+  if (st.drainMaX10 > 0 && !gExternalPower) {
+    // capacity * pct / 100 mAh at drain / 10 mA, in 0.1 days.
+    st.batteryDaysX10 = static_cast<uint16_t>(min<uint32_t>(
+        BATTERY_CAPACITY_MAH * gBatteryPct / (st.drainMaX10 * 24UL), 65535));
+  }
+  return st;
+}
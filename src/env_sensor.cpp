@@ -0,0 +1,168 @@
+#include "env_sensor.h"
+
+#include <Adafruit_BME680.h>
+#include <Wire.h>
+
+#include "ring_buffer.h"
+#include "snapshot.h"
+
+// Wiring and heater profile; override with build flags.
+#ifndef ENV_I2C_ADDR
+#define ENV_I2C_ADDR 0x77
+#endif
+
+#ifndef ENV_I2C_SDA
+#define ENV_I2C_SDA 32
+#endif
+
+#ifndef ENV_I2C_SCL
+#define ENV_I2C_SCL 33
+#endif
+
+// Gas heater profile: target temperature and how long it is held before the reading.
+#ifndef ENV_GAS_HEATER_C
+#define ENV_GAS_HEATER_C 320
+#endif
+
+#ifndef ENV_GAS_HEATER_MS
+#define ENV_GAS_HEATER_MS 150
+#endif
+
+namespace {
+
+constexpr uint32_t kTaskStack = 4096;
+constexpr uint32_t kMinPeriodMs = 100;
+constexpr uint32_t kRetryMs = 30000;  // probe interval while the sensor is missing
+constexpr uint32_t kLateMs = 100;     // start delay after a slot that counts as late
+
+Adafruit_BME680 gBme(&Wire);
+TaskHandle_t gTask = nullptr;
+
+// Published by the sensor task (envSensorStart() before it runs), read by any task.
+Snapshot<EnvSample> gLatest;
+Snapshot<EnvStats> gStatsShared;
+
+// Only the history copy, rare and off the UI path, still takes a spinlock.
+portMUX_TYPE gLock = portMUX_INITIALIZER_UNLOCKED;
+RingBuffer<EnvSample, kEnvHistory> gRing;
+uint32_t gPushed = 0;  // samples ever pushed to gRing
+
+// Sensor-task state.
+EnvStats gStats;
+
+bool sensorInit() {
+  if (!gBme.begin(ENV_I2C_ADDR)) return false;
+  gBme.setTemperatureOversampling(BME680_OS_8X);
+  gBme.setHumidityOversampling(BME680_OS_2X);
+  gBme.setPressureOversampling(BME680_OS_4X);
+  gBme.setIIRFilterSize(BME680_FILTER_SIZE_3);
+  gBme.setGasHeater(ENV_GAS_HEATER_C, ENV_GAS_HEATER_MS);
+  return true;
+}
+
+// Triggers a forced-mode conversion and sleeps through the heater and conversion time
+// before reading, so endReading() does not busy-wait.
+bool measure(EnvSample& out) {
+  const unsigned long doneAt = gBme.beginReading();
+  if (doneAt == 0) return false;
+  const int32_t waitMs = static_cast<int32_t>(doneAt - millis());
+  if (waitMs > 0) vTaskDelay(pdMS_TO_TICKS(waitMs) + 1);
+  if (!gBme.endReading()) return false;
+
+  out.ms = millis();
+  out.tempC100 = static_cast<int16_t>(lroundf(gBme.temperature * 100.0f));
+  out.humidityPermille = static_cast<uint16_t>(lroundf(gBme.humidity * 10.0f));
+  out.pressurePa = gBme.pressure;
+  out.gasOhm = gBme.gas_resistance;
+  return true;
+}
+
+void setPresent(bool present) {
+  gStats.present = present;
+  if (!present) gStats.errors++;
+  gStatsShared.publish(gStats);
+}
+
+void envTaskMain(void* param) {
+  (void)param;
+  const uint32_t periodMs = gStats.periodMs;
+  Wire.begin(ENV_I2C_SDA, ENV_I2C_SCL, 400000);
+
+  bool present = false;
+  uint32_t due = millis();
+  for (;;) {
+    if (!present) {
+      present = sensorInit();
+      setPresent(present);
+      if (!present) {
+        Serial.printf("[Env] No BME680 at 0x%02X; retrying in %u s\n",
+                      ENV_I2C_ADDR,
+                      static_cast<unsigned>(kRetryMs / 1000));
+        vTaskDelay(pdMS_TO_TICKS(kRetryMs));
+        due = millis();
+        continue;
+      }
+      Serial.println("[Env] BME680 ready");
+    }
+
+    const int32_t earlyMs = static_cast<int32_t>(due - millis());
+    if (earlyMs > 0) vTaskDelay(pdMS_TO_TICKS(earlyMs));
+
+    // Slots that passed entirely while the previous measurement (or anything else on this
+    // core) ran are skipped rather than caught up.
+    const uint32_t lagMs = millis() - due;
+    const uint32_t skipped = lagMs / periodMs;
+    due += (skipped + 1) * periodMs;
+
+    EnvSample sample;
+    const bool ok = measure(sample);
+
+    gStats.missed += skipped;
+    if (lagMs % periodMs > kLateMs) gStats.late++;
+    gStats.maxLagMs = max(gStats.maxLagMs, lagMs);
+    if (ok) {
+      portENTER_CRITICAL(&gLock);
+      gRing.push(sample);
+      gPushed++;
+      portEXIT_CRITICAL(&gLock);
+      gLatest.publish(sample);
+      gStats.samples++;
+    }
+    gStatsShared.publish(gStats);
+
+    if (!ok) {
+      Serial.println("[Env] Read failed; re-probing");
+      present = false;
+      setPresent(false);
+    }
+  }
+}
+
+}  // namespace
+
+bool envSensorStart(uint32_t periodMs) {
+  if (gTask) return true;
+  gStats.periodMs = max(periodMs, kMinPeriodMs);
+  gStatsShared.publish(gStats);
+  return xTaskCreatePinnedToCore(envTaskMain, "env", kTaskStack, nullptr, 1, &gTask, 0) ==
+         pdPASS;
+}
+
+bool envLatest(EnvSample& out) { return gLatest.read(out) != 0; }
+
+EnvStats envStats() {
+  EnvStats st;
+  gStatsShared.read(st);
+  return st;
+}
+
+size_t envHistory(uint32_t& next, EnvSample* out, size_t maxCount) {
+  portENTER_CRITICAL(&gLock);
+  const uint32_t oldest = gPushed - gRing.size();
+  if (next < oldest) next = oldest;
+  const size_t n = next < gPushed ? min<size_t>(maxCount, gPushed - next) : 0;
+  for (size_t i = 0; i < n; i++) out[i] = gRing.at(next - oldest + i);
+  next += n;
+  portEXIT_CRITICAL(&gLock);
+  return n;
+}
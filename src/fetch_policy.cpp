@@ -0,0 +1,115 @@
+#include "fetch_policy.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Retry-After beyond this is treated as this: a misconfigured server should not silence
+// the station for days.
+constexpr uint32_t kRetryAfterMaxMs = 6UL * 60UL * 60UL * 1000UL;
+
+void copyBounded(char* dst, size_t len, const char* src) {
+  const size_t n = src ? strlen(src) : 0;
+  if (n >= len) {
+    dst[0] = '\0';
+    return;
+  }
+  memcpy(dst, src, n);
+  dst[n] = '\0';
+}
+
+}  // namespace
+
+uint32_t FetchPolicy::nextRandom() {
+  // xorshift32: plenty for spreading retries, and needs no entropy source per call.
+  rng_ ^= rng_ << 13;
+  rng_ ^= rng_ >> 17;
+  rng_ ^= rng_ << 5;
+  return rng_;
+}
+
+// retryMin * 2^(streak-1), capped at the refresh period, then jittered into [d/2, d].
+uint32_t FetchPolicy::backoffMs() {
+  uint32_t delay = retryMinMs_;
+  for (uint16_t i = 1; i < stats_.failStreak && delay < refreshMs_; i++) delay *= 2;
+  delay = min(delay, refreshMs_);
+  const uint32_t half = delay / 2;
+  return delay - half + (half ? nextRandom() % (half + 1) : 0);
+}
+
+void FetchPolicy::setSlots(uint32_t periodSec, uint32_t offsetSec, uint32_t spreadSec) {
+  slotPeriodSec_ = periodSec;
+  if (periodSec == 0) return;
+  slotShiftSec_ = (offsetSec + (spreadSec ? nextRandom() % spreadSec : 0)) % periodSec;
+}
+
+uint32_t FetchPolicy::slotDelaySec(uint32_t unixSec) const {
+  if (slotPeriodSec_ == 0) return refreshMs_ / 1000;
+  const uint32_t sinceSlot = (unixSec - slotShiftSec_) % slotPeriodSec_;
+  uint32_t delay = slotPeriodSec_ - sinceSlot;
+  // A fetch this close before a slot most likely got that slot's data already.
+  if (delay < kFetchSlotMinGapSec) delay += slotPeriodSec_;
+  return delay;
+}
+
+uint32_t FetchPolicy::record(FetchOutcome outcome,
+                             uint32_t nowMs,
+                             uint32_t retryAfterMs,
+                             uint32_t unixSec) {
+  const bool good = outcome != FetchOutcome::Failed;
+  stats_.attempts++;
+  history_ = (history_ << 1) | (good ? 1u : 0u);
+  if (historyLen_ < kFetchHistory) historyLen_++;
+  // Bits above historyLen_ are still zero until the window fills.
+  stats_.successPermille =
+      static_cast<uint16_t>(__builtin_popcount(history_) * 1000u / historyLen_);
+
+  uint32_t delay = unixSec != 0 ? slotDelaySec(unixSec) * 1000 : refreshMs_;
+  switch (outcome) {
+    case FetchOutcome::Updated:
+      stats_.updated++;
+      break;
+    case FetchOutcome::NotModified:
+      stats_.notModified++;
+      break;
+    case FetchOutcome::Failed:
+      stats_.failures++;
+      if (stats_.failStreak < UINT16_MAX) stats_.failStreak++;
+      delay = backoffMs();
+      break;
+  }
+  if (good) {
+    stats_.failStreak = 0;
+    noteGood(nowMs);
+  }
+  delay = max(delay, min(retryAfterMs, kRetryAfterMaxMs));
+  stats_.retryMs = delay;
+  return delay;
+}
+
+void FetchPolicy::noteGood(uint32_t goodAtMs) {
+  stats_.lastGoodMs = goodAtMs;
+  stats_.hasGood = true;
+}
+
+void FetchPolicy::setValidators(const char* etag, const char* lastModified) {
+  copyBounded(etag_, sizeof(etag_), etag);
+  copyBounded(lastModified_, sizeof(lastModified_), lastModified);
+}
+
+void FetchPolicy::clearValidators() {
+  etag_[0] = '\0';
+  lastModified_[0] = '\0';
+}
+
+uint32_t fetchParseRetryAfterMs(const char* value) {
+  if (!value) return 0;
+  while (*value == ' ') value++;
+  if (*value < '0' || *value > '9') return 0;
+  char* end = nullptr;
+  const unsigned long sec = strtoul(value, &end, 10);
+  while (*end == ' ') end++;
+  if (*end != '\0') return 0;
+  return sec >= kRetryAfterMaxMs / 1000 ? kRetryAfterMaxMs : sec * 1000UL;
+}
@@ -0,0 +1,147 @@
+#include "forecast_store.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+void forecastClear(ForecastStore& fc) {
+  fc.currentTime = 0;
+  fc.currentTempC10 = kTempUnknown;
+  fc.currentCond = WxCond::Unknown;
+  fc.utcOffsetSec = 0;
+
+  fc.dailyStart = 0;
+  fc.dayCount = 0;
+  for (uint8_t i = 0; i < kForecastDays; i++) {
+    fc.dailyMinC10[i] = kTempUnknown;
+    fc.dailyMaxC10[i] = kTempUnknown;
+  }
+  memset(fc.dailyPrecipPct, kPrecipUnknown, sizeof(fc.dailyPrecipPct));
+  memset(fc.dailyCondPacked, 0, sizeof(fc.dailyCondPacked));
+
+  fc.hourlyStart = 0;
+  fc.hourCount = 0;
+  for (uint8_t i = 0; i < kForecastHours; i++) fc.hourlyTempC10[i] = kTempUnknown;
+  memset(fc.hourlyPrecipPct, kPrecipUnknown, sizeof(fc.hourlyPrecipPct));
+  memset(fc.hourlyCondPacked, 0, sizeof(fc.hourlyCondPacked));
+}
+
+int16_t tempToC10(float c) {
+  if (std::isnan(c) || c < -300.0f || c > 300.0f) return kTempUnknown;
+  return static_cast<int16_t>(lroundf(c * 10.0f));
+}
+
+WxCond wmoToCond(int code) {
+  // WMO weather interpretation codes (subset).
+  if (code < 0) return WxCond::Unknown;
+  if (code == 0) return WxCond::Clear;
+  if (code <= 2) return WxCond::MostlyClear;
+  if (code == 3) return WxCond::Cloudy;
+  if (code == 45 || code == 48) return WxCond::Fog;
+  if (code >= 51 && code <= 57) return WxCond::Drizzle;
+  if (code >= 61 && code <= 67) return WxCond::Rain;
+  if (code >= 71 && code <= 77) return WxCond::Snow;
+  if (code >= 80 && code <= 82) return WxCond::Showers;
+  if (code >= 85 && code <= 86) return WxCond::SnowShowers;
+  if (code >= 95) return WxCond::Thunder;
+  return WxCond::Unknown;
+}
+
+const char* condShortText(WxCond c) {
+  switch (c) {
+    case WxCond::Clear:
+      return "Clear";
+    case WxCond::MostlyClear:
+      return "Mostly clear";
+    case WxCond::Cloudy:
+      return "Cloudy";
+    case WxCond::Fog:
+      return "Fog";
+    case WxCond::Drizzle:
+      return "Drizzle";
+    case WxCond::Rain:
+      return "Rain";
+    case WxCond::Snow:
+      return "Snow";
+    case WxCond::Showers:
+      return "Showers";
+    case WxCond::SnowShowers:
+      return "Snow showers";
+    case WxCond::Thunder:
+      return "Thunder";
+    case WxCond::Unknown:
+      break;
+  }
+  return "Weather";
+}
+
+const char* condAbbrev(WxCond c) {
+  switch (c) {
+    case WxCond::Clear:
+      return "Clr";
+    case WxCond::MostlyClear:
+      return "Fair";
+    case WxCond::Cloudy:
+      return "Cldy";
+    case WxCond::Fog:
+      return "Fog";
+    case WxCond::Drizzle:
+      return "Drzl";
+    case WxCond::Rain:
+      return "Rain";
+    case WxCond::Snow:
+      return "Snow";
+    case WxCond::Showers:
+      return "Shwr";
+    case WxCond::SnowShowers:
+      return "SnSh";
+    case WxCond::Thunder:
+      return "Thdr";
+    case WxCond::Unknown:
+      break;
+  }
+  return "--";
+}
+
+void formatTempC10(int16_t c10, char* out, size_t len) {
+  if (c10 == kTempUnknown) {
+    snprintf(out, len, "--");
+    return;
+  }
+  // Round half away from zero in tenths, e.g. -25 -> "-3", 14 -> "1".
+  const int whole = (c10 >= 0) ? (c10 + 5) / 10 : -((-c10 + 5) / 10);
+  snprintf(out, len, "%d", whole);
+}
+
+bool forecastFormatTicker(const ForecastStore& fc, const char* label, char* out, size_t len) {
+  if (len == 0) return false;
+  out[0] = '\0';
+  if (!fc.hasData()) return false;
+
+  char now[8];
+  char lo[8];
+  char hi[8];
+  formatTempC10(fc.currentTempC10, now, sizeof(now));
+  if (fc.dayCount == 0) {
+    snprintf(out, len, "%s: %s°C %s", label, now, condShortText(fc.currentCond));
+    return true;
+  }
+
+  formatTempC10(fc.dailyMinC10[0], lo, sizeof(lo));
+  formatTempC10(fc.dailyMaxC10[0], hi, sizeof(hi));
+  int n = snprintf(out,
+                   len,
+                   "%s: %s°C %s | Today %s–%s°C %s",
+                   label,
+                   now,
+                   condShortText(fc.currentCond),
+                   lo,
+                   hi,
+                   condShortText(fc.dailyCond(0)));
+  if (fc.dayCount > 1 && n > 0 && static_cast<size_t>(n) < len) {
+    formatTempC10(fc.dailyMinC10[1], lo, sizeof(lo));
+    formatTempC10(fc.dailyMaxC10[1], hi, sizeof(hi));
+    snprintf(out + n, len - n, " | Tomorrow %s–%s°C %s", lo, hi, condShortText(fc.dailyCond(1)));
+  }
+  return true;
+}
@@ -0,0 +1,108 @@
+#include "heap_guard.h"
+
+#include <atomic>
+
+namespace {
+
+// Each logged violation is followed by this long a pause, so a leak in a fast path cannot
+// flood the serial port.
+constexpr uint32_t kLogQuietMs = 10000;
+
+// Read by other tasks (metrics); a handful of words, short enough for a spinlock.
+portMUX_TYPE gLock = portMUX_INITIALIZER_UNLOCKED;
+uint32_t gLargestBlockMin = UINT32_MAX;
+uint32_t gSteadyViolations = 0;
+uint32_t gLogNextMs = 0;
+
+#if HEAP_GUARD
+std::atomic<TaskHandle_t> gWatched{nullptr};
+std::atomic<uint32_t> gAllocs{0};
+std::atomic<void*> gLastCaller{nullptr};
+
+inline void noteAlloc(void* caller) {
+  const TaskHandle_t watched = gWatched.load(std::memory_order_relaxed);
+  if (!watched || xTaskGetCurrentTaskHandle() != watched) return;
+  gAllocs.fetch_add(1, std::memory_order_relaxed);
+  gLastCaller.store(caller, std::memory_order_relaxed);
+}
+#endif
+
+}  // namespace
+
+#if HEAP_GUARD
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  noteAlloc(__builtin_return_address(0));
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+  noteAlloc(__builtin_return_address(0));
+  return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  noteAlloc(__builtin_return_address(0));
+  return __real_realloc(ptr, size);
+}
+}
+#endif
+
+void heapGuardWatch() {
+#if HEAP_GUARD
+  gWatched = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+uint32_t heapGuardAllocs() {
+#if HEAP_GUARD
+  return gAllocs.load(std::memory_order_relaxed);
+#else
+  return 0;
+#endif
+}
+
+void heapGuardEndPass(uint32_t allocsAtStart, bool steady) {
+#if HEAP_GUARD
+  const uint32_t n = heapGuardAllocs() - allocsAtStart;
+  if (n == 0 || !steady) return;
+  portENTER_CRITICAL(&gLock);
+  gSteadyViolations++;
+  portEXIT_CRITICAL(&gLock);
+  const uint32_t now = millis();
+  if (static_cast<int32_t>(now - gLogNextMs) < 0) return;
+  gLogNextMs = now + kLogQuietMs;
+  // Under 64 characters, so printf() itself does not allocate. Resolve the address with
+  // xtensa-esp32-elf-addr2line -e firmware.elf.
+  Serial.printf("[Heap] loop() allocated %u times, last from %p\n",
+                static_cast<unsigned>(n),
+                gLastCaller.load(std::memory_order_relaxed));
+#else
+  (void)allocsAtStart;
+  (void)steady;
+#endif
+}
+
+void heapSample() {
+  const uint32_t largest = ESP.getMaxAllocHeap();
+  portENTER_CRITICAL(&gLock);
+  gLargestBlockMin = min(gLargestBlockMin, largest);
+  portEXIT_CRITICAL(&gLock);
+}
+
+HeapStats heapStats() {
+  HeapStats s;
+  s.freeBytes = ESP.getFreeHeap();
+  s.minFreeBytes = ESP.getMinFreeHeap();
+  s.largestBlock = ESP.getMaxAllocHeap();
+  s.watchedAllocs = heapGuardAllocs();
+  portENTER_CRITICAL(&gLock);
+  s.largestBlockMin = gLargestBlockMin == UINT32_MAX ? s.largestBlock : gLargestBlockMin;
+  s.steadyViolations = gSteadyViolations;
+  portEXIT_CRITICAL(&gLock);
+  return s;
+}
@@ -0,0 +1,706 @@
+#include "http_api.h"
+
+#include <lwip/sockets.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+
+#include "env_sensor.h"
+#include "heap_guard.h"
+#include "mqtt_publisher.h"
+#include "snapshot.h"
+#include "tsdb.h"
+
+// Listening port; override with a build flag.
+#ifndef HTTP_API_PORT
+#define HTTP_API_PORT 80
+#endif
+
+namespace {
+
+constexpr uint32_t kTaskStack = 6144;
+constexpr uint8_t kMaxClients = 4;
+constexpr int kBacklog = 4;
+constexpr size_t kBufBytes = 1024;  // the request (larger gets 431), then response pieces
+constexpr uint32_t kClientTimeoutMs = 3000;
+constexpr uint32_t kSelectTimeoutMs = 200;
+
+enum class Route : uint8_t { Current, Forecast, Metrics, NotFound, BadRequest, NotGet, TooLarge };
+
+struct Client {
+  int fd = -1;
+  uint32_t openedMs = 0;
+  bool responding = false;  // the request is complete and `buf` holds response pieces
+  bool done = false;        // every piece of the response has been formatted
+  Route route = Route::NotFound;
+  size_t len = 0;           // bytes in `buf`
+  size_t sentLen = 0;       // of which already sent
+  uint32_t pieces = 0;      // response pieces formatted so far
+  uint32_t sent = 0;        // response bytes sent
+  uint32_t formatUs = 0;
+  ApiState st;  // what the response shows, read once when the request completes
+  EnvSample env;
+  bool hasEnv = false;
+  char buf[kBufBytes];
+};
+
+Client gClients[kMaxClients];
+int gListenFd = -1;
+TaskHandle_t gTask = nullptr;
+std::atomic<bool> gEnabled{false};
+Snapshot<ApiState> gState;
+
+portMUX_TYPE gStatsLock = portMUX_INITIALIZER_UNLOCKED;
+HttpApiStats gStats;
+
+void setNonBlocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Formats the next part of a response into its client's buffer. The response functions run
+// from the top on every pass: pieces sent in earlier passes are counted but not formatted,
+// and once a piece does not fit, it and the rest wait until the buffer has been sent.
+class ResponseWriter {
+ public:
+  explicit ResponseWriter(Client& c) : c_(c) {}
+
+  void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+  void print(const char* s) { printf("%s", s); }
+
+  // Some pieces are left for the next pass.
+  bool full() const { return full_; }
+
+ private:
+  Client& c_;
+  uint32_t piece_ = 0;
+  bool full_ = false;
+};
+
+void ResponseWriter::printf(const char* fmt, ...) {
+  if (full_ || piece_++ < c_.pieces) return;
+  va_list args;
+  va_start(args, fmt);
+  const int n = vsnprintf(c_.buf + c_.len, sizeof(c_.buf) - c_.len, fmt, args);
+  va_end(args);
+  if (n >= 0 && c_.len + n >= sizeof(c_.buf)) {
+    if (c_.len > 0) {
+      full_ = true;
+      return;
+    }
+    c_.len = sizeof(c_.buf) - 1;  // a single piece longer than the buffer is truncated
+  } else if (n > 0) {
+    c_.len += n;
+  }
+  c_.pieces++;
+}
+
+void writeHead(ResponseWriter& w, const char* status, const char* contentType) {
+  w.printf("HTTP/1.1 %s\r\n"
+           "Content-Type: %s\r\n"
+           "Cache-Control: no-store\r\n"
+           "Connection: close\r\n\r\n",
+           status,
+           contentType);
+}
+
+// ----- JSON -----
+
+void jsonC10(ResponseWriter& w, int32_t c10) {
+  if (c10 == kTempUnknown) {
+    w.print("null");
+    return;
+  }
+  w.printf("%s%d.%d",
+           c10 < 0 ? "-" : "",
+           static_cast<int>(abs(c10) / 10),
+           static_cast<int>(abs(c10) % 10));
+}
+
+void jsonFixed(ResponseWriter& w, int32_t v, int32_t scale, int decimals) {
+  w.printf("%s%d.%0*d",
+           v < 0 ? "-" : "",
+           static_cast<int>(abs(v) / scale),
+           decimals,
+           static_cast<int>(abs(v) % scale));
+}
+
+void jsonPrecip(ResponseWriter& w, uint8_t pct) {
+  if (pct == kPrecipUnknown) {
+    w.print("null");
+  } else {
+    w.printf("%u", static_cast<unsigned>(pct));
+  }
+}
+
+void writeCurrent(ResponseWriter& w, const ApiState& st, const EnvSample* env) {
+  const ForecastStore& fc = st.forecast;
+  writeHead(w, "200 OK", "application/json");
+  w.printf("{\"label\":\"%s\",\"weather\":{\"status\":%d,\"time\":%lu,\"temp_c\":",
+           st.label,
+           st.weatherStatus,
+           static_cast<unsigned long>(fc.currentTime));
+  jsonC10(w, fc.currentTempC10);
+  w.printf(",\"condition\":\"%s\"},\"room\":", condShortText(fc.currentCond));
+
+  if (env) {
+    w.printf("{\"age_s\":%lu,\"temp_c\":", static_cast<unsigned long>((millis() - env->ms) / 1000));
+    jsonFixed(w, env->tempC100, 100, 2);
+    w.print(",\"humidity_pct\":");
+    jsonFixed(w, env->humidityPermille, 10, 1);
+    w.print(",\"pressure_hpa\":");
+    jsonFixed(w, static_cast<int32_t>(env->pressurePa), 100, 2);
+    w.printf(",\"gas_ohm\":%lu}", static_cast<unsigned long>(env->gasOhm));
+  } else {
+    w.print("null");
+  }
+
+  w.printf(",\"device\":{\"uptime_s\":%lu,\"rssi_dbm\":%d,\"battery_pct\":%u,\"charging\":%s}}\n",
+           static_cast<unsigned long>(millis() / 1000),
+           static_cast<int>(st.rssi),
+           static_cast<unsigned>(st.batteryPct),
+           st.charging ? "true" : "false");
+}
+
+void writeForecast(ResponseWriter& w, const ApiState& st) {
+  const ForecastStore& fc = st.forecast;
+  writeHead(w, "200 OK", "application/json");
+  w.printf("{\"label\":\"%s\",\"utc_offset_s\":%ld,\"daily\":[",
+           st.label,
+           static_cast<long>(fc.utcOffsetSec));
+  for (uint8_t i = 0; i < fc.dayCount; i++) {
+    w.printf("%s{\"time\":%lu,\"min_c\":",
+             i ? "," : "",
+             static_cast<unsigned long>(fc.dailyStart + i * 86400UL));
+    jsonC10(w, fc.dailyMinC10[i]);
+    w.print(",\"max_c\":");
+    jsonC10(w, fc.dailyMaxC10[i]);
+    w.print(",\"precip_pct\":");
+    jsonPrecip(w, fc.dailyPrecipPct[i]);
+    w.printf(",\"condition\":\"%s\"}", condShortText(fc.dailyCond(i)));
+  }
+  w.print("],\"hourly\":[");
+  for (uint8_t i = 0; i < fc.hourCount; i++) {
+    w.printf("%s{\"time\":%lu,\"temp_c\":",
+             i ? "," : "",
+             static_cast<unsigned long>(fc.hourlyStart + i * 3600UL));
+    jsonC10(w, fc.hourlyTempC10[i]);
+    w.print(",\"precip_pct\":");
+    jsonPrecip(w, fc.hourlyPrecipPct[i]);
+    w.printf(",\"condition\":\"%s\"}", condShortText(fc.hourlyCond(i)));
+  }
+  w.print("]}\n");
+}
+
+// ----- Prometheus -----
+
+void metricHead(ResponseWriter& w, const char* name, const char* type, const char* help) {
+  w.printf("# HELP core2_%s %s\n# TYPE core2_%s %s\n", name, help, name, type);
+}
+
+void metric(ResponseWriter& w, const char* name, const char* type, const char* help,
+            uint64_t v) {
+  metricHead(w, name, type, help);
+  w.printf("core2_%s %llu\n", name, static_cast<unsigned long long>(v));
+}
+
+void metricSigned(ResponseWriter& w, const char* name, const char* help, int32_t v) {
+  metricHead(w, name, "gauge", help);
+  w.printf("core2_%s %d\n", name, static_cast<int>(v));
+}
+
+void metricFixed(ResponseWriter& w, const char* name, const char* type, const char* help,
+                 int64_t v, int64_t scale, int decimals) {
+  metricHead(w, name, type, help);
+  const unsigned long long a = static_cast<unsigned long long>(v < 0 ? -v : v);
+  w.printf("core2_%s %s%llu.%0*llu\n",
+           name,
+           v < 0 ? "-" : "",
+           a / scale,
+           decimals,
+           a % scale);
+}
+
+void metricSeconds(ResponseWriter& w, const char* name, const char* type, const char* help,
+                   uint64_t us) {
+  metricFixed(w, name, type, help, static_cast<int64_t>(us), 1000000, 6);
+}
+
+void writeMetrics(ResponseWriter& w, const ApiState& st, const EnvSample* env) {
+  writeHead(w, "200 OK", "text/plain; version=0.0.4");
+
+  metric(w, "uptime_seconds", "gauge", "Time since boot.", millis() / 1000);
+  metricSigned(w, "wifi_rssi_dbm", "Wi-Fi signal strength.", st.rssi);
+  if (st.wifiJoinMs != 0) {
+    metricFixed(w,
+                "wifi_join_seconds",
+                "gauge",
+                "Time from Wi-Fi join to an IP address.",
+                st.wifiJoinMs,
+                1000,
+                3);
+    metric(w, "wifi_join_fast", "gauge", "1 if the join skipped the scan.", st.wifiJoinFast);
+  }
+  metric(w, "battery_percent", "gauge", "Battery charge level.", st.batteryPct);
+  metric(w, "battery_charging", "gauge", "1 while the battery is charging.", st.charging);
+  if (st.dutyCycle) {
+    metric(w, "duty_wakes_total", "counter", "Timer wakes since power-on.", st.dutyCycles);
+    metricFixed(w,
+                "duty_awake_seconds",
+                "gauge",
+                "Time awake in the latest timer wake.",
+                st.dutyAwakeMsLast,
+                1000,
+                3);
+    metricFixed(w,
+                "duty_awake_avg_seconds",
+                "gauge",
+                "Average time awake per timer wake.",
+                st.dutyAwakeMsAvg,
+                1000,
+                3);
+    if (st.dutyDrainMaX10 != 0) {
+      metricFixed(w,
+                  "duty_drain_milliamps",
+                  "gauge",
+                  "Average battery drain over whole cycles.",
+                  st.dutyDrainMaX10,
+                  10,
+                  1);
+      metricFixed(w,
+                  "duty_battery_days",
+                  "gauge",
+                  "Estimated battery life at that drain.",
+                  st.dutyBatteryDaysX10,
+                  10,
+                  1);
+    }
+  }
+
+  const HeapStats heap = heapStats();
+  metric(w, "heap_free_bytes", "gauge", "Free internal heap.", heap.freeBytes);
+  metric(w, "heap_min_free_bytes", "gauge", "Lowest free heap since boot.", heap.minFreeBytes);
+  metric(w,
+         "heap_max_alloc_bytes",
+         "gauge",
+         "Largest block the heap can allocate.",
+         heap.largestBlock);
+  metric(w,
+         "heap_max_alloc_min_bytes",
+         "gauge",
+         "Lowest largest-block size seen since boot (fragmentation).",
+         heap.largestBlockMin);
+#if HEAP_GUARD
+  metric(w, "loop_heap_allocs_total", "counter", "Allocations made by loop().", heap.watchedAllocs);
+  metric(w,
+         "loop_steady_alloc_passes_total",
+         "counter",
+         "Steady-state loop() passes that allocated.",
+         heap.steadyViolations);
+#endif
+
+  metric(w, "loop_wakeups_total", "counter", "loop() passes.", st.loopWakeups);
+  metricSeconds(w,
+                "loop_blocked_seconds_total",
+                "counter",
+                "Time loop() spent waiting for events.",
+                st.loopBlockedUs);
+  metricSeconds(
+      w, "loop_busy_seconds_total", "counter", "Time loop() spent running.", st.loopBusyUs);
+  metricSeconds(w, "loop_busy_max_seconds", "gauge", "Longest loop() pass.", st.loopBusyUsMax);
+
+  metricHead(w, "render_frame_seconds", "summary", "Compositor frame time.");
+  w.printf("core2_render_frame_seconds_sum %llu.%06llu\ncore2_render_frame_seconds_count %lu\n",
+           static_cast<unsigned long long>(st.frameUsTotal / 1000000),
+           static_cast<unsigned long long>(st.frameUsTotal % 1000000),
+           static_cast<unsigned long>(st.frames));
+  metricSeconds(w, "render_frame_max_seconds", "gauge", "Longest frame.", st.frameUsMax);
+  metricSeconds(w,
+                "input_latency_seconds",
+                "gauge",
+                "Last touch until its frame was on the panel.",
+                st.latencyUsLast);
+
+  metricHead(w, "weather_fetches_total", "counter", "Weather fetches by outcome.");
+  w.printf("core2_weather_fetches_total{result=\"ok\"} %lu\n"
+           "core2_weather_fetches_total{result=\"not_modified\"} %lu\n"
+           "core2_weather_fetches_total{result=\"error\"} %lu\n",
+           static_cast<unsigned long>(st.fetches - st.fetchFailures - st.fetchNotModified),
+           static_cast<unsigned long>(st.fetchNotModified),
+           static_cast<unsigned long>(st.fetchFailures));
+  metricFixed(w,
+              "weather_fetch_success_ratio",
+              "gauge",
+              "Share of recent fetches that succeeded.",
+              st.fetchSuccessPermille,
+              1000,
+              3);
+  metric(w,
+         "weather_fetch_fail_streak",
+         "gauge",
+         "Consecutive failed fetches.",
+         st.fetchFailStreak);
+  if (st.dataGood) {
+    metric(w,
+           "weather_data_age_seconds",
+           "gauge",
+           "Time since the forecast was last fetched or confirmed.",
+           (millis() - st.dataGoodMs) / 1000);
+  }
+  metricHead(w, "weather_fetch_seconds", "summary", "Weather fetch latency, connect to parsed.");
+  w.printf("core2_weather_fetch_seconds_sum %llu.%03llu\ncore2_weather_fetch_seconds_count %lu\n",
+           static_cast<unsigned long long>(st.fetchMsTotal / 1000),
+           static_cast<unsigned long long>(st.fetchMsTotal % 1000),
+           static_cast<unsigned long>(st.fetches));
+  metricFixed(
+      w, "weather_fetch_last_seconds", "gauge", "Latest fetch latency.", st.fetchMsLast, 1000, 3);
+  metricSigned(w, "weather_status", "Last fetch HTTP status, <0 client error.", st.weatherStatus);
+  if (st.forecast.currentTempC10 != kTempUnknown) {
+    metricFixed(w,
+                "outdoor_temperature_celsius",
+                "gauge",
+                "Forecast current temperature.",
+                st.forecast.currentTempC10,
+                10,
+                1);
+  }
+
+  if (env) {
+    metricFixed(
+        w, "room_temperature_celsius", "gauge", "BME680 temperature.", env->tempC100, 100, 2);
+    metricFixed(w,
+                "room_humidity_percent",
+                "gauge",
+                "BME680 relative humidity.",
+                env->humidityPermille,
+                10,
+                1);
+    metric(w, "room_pressure_pascals", "gauge", "BME680 pressure.", env->pressurePa);
+    metric(w, "room_gas_resistance_ohms", "gauge", "BME680 gas resistance.", env->gasOhm);
+  }
+  const EnvStats es = envStats();
+  metric(w, "env_samples_total", "counter", "BME680 measurements.", es.samples);
+  metric(w, "env_missed_total", "counter", "BME680 slots skipped.", es.missed);
+  metric(w, "env_late_total", "counter", "BME680 measurements started late.", es.late);
+  metric(w, "env_errors_total", "counter", "BME680 probe and read failures.", es.errors);
+
+  const TsStats ts = tsStats();
+  metric(w, "history_points_total", "counter", "Raw points stored.", ts.points);
+  metric(w, "history_encoded_bytes_total", "counter", "Compressed point data.", ts.encodedBytes);
+  metric(w, "history_written_bytes_total", "counter", "Bytes written to flash files.", ts.fsBytes);
+  metric(w,
+         "history_blocks_programmed_total",
+         "counter",
+         "Estimated 4 KB flash blocks programmed.",
+         ts.fsBlocks);
+  metric(w, "history_dropped_total", "counter", "Points lost to a full queue.", ts.dropped);
+  metric(w, "fs_used_bytes", "gauge", "LittleFS space in use.", ts.fsUsed);
+
+  const MqttStats ms = mqttStats();
+  metric(w, "mqtt_connected", "gauge", "1 while connected to the broker.", ms.connected);
+  metric(w, "mqtt_connects_total", "counter", "Broker sessions started.", ms.connects);
+  metric(w, "mqtt_published_total", "counter", "PUBLISH packets sent.", ms.published);
+  metric(w, "mqtt_batches_total", "counter", "send() calls carrying them.", ms.batches);
+  metric(w, "mqtt_queue_depth", "gauge", "Readings waiting for the broker.", ms.queued);
+  metric(w, "mqtt_dropped_total", "counter", "Readings lost to a full queue.", ms.dropped);
+
+  portENTER_CRITICAL(&gStatsLock);
+  const HttpApiStats hs = gStats;
+  portEXIT_CRITICAL(&gStatsLock);
+  metric(w, "http_requests_total", "counter", "API requests served.", hs.requests);
+  metric(w, "http_timeouts_total", "counter", "Clients closed before a full request.", hs.timeouts);
+  metricSeconds(
+      w, "http_handle_max_seconds", "gauge", "Longest time formatting a response.", hs.handleUsMax);
+}
+
+// ----- Connections -----
+
+void closeClient(Client& c) {
+  if (c.fd < 0) return;
+  close(c.fd);
+  c.fd = -1;
+  c.len = 0;
+  c.responding = false;
+  portENTER_CRITICAL(&gStatsLock);
+  gStats.clients--;
+  portEXIT_CRITICAL(&gStatsLock);
+}
+
+void finishClient(Client& c, bool complete) {
+  portENTER_CRITICAL(&gStatsLock);
+  if (!complete) gStats.sendFailures++;
+  gStats.bytesSent += c.sent;
+  gStats.handleUsMax = max(gStats.handleUsMax, c.formatUs);
+  portEXIT_CRITICAL(&gStatsLock);
+  closeClient(c);
+}
+
+void writeResponse(ResponseWriter& w, const Client& c) {
+  const EnvSample* env = c.hasEnv ? &c.env : nullptr;
+  switch (c.route) {
+    case Route::Current:
+      writeCurrent(w, c.st, env);
+      break;
+    case Route::Forecast:
+      writeForecast(w, c.st);
+      break;
+    case Route::Metrics:
+      writeMetrics(w, c.st, env);
+      break;
+    case Route::NotFound:
+      writeHead(w, "404 Not Found", "text/plain");
+      w.print("Try /api/current, /api/forecast or /metrics\n");
+      break;
+    case Route::BadRequest:
+      writeHead(w, "400 Bad Request", "text/plain");
+      break;
+    case Route::NotGet:
+      writeHead(w, "405 Method Not Allowed", "text/plain");
+      break;
+    case Route::TooLarge:
+      writeHead(w, "431 Request Header Fields Too Large", "text/plain");
+      w.print("431 Request Header Fields Too Large\n");
+      break;
+  }
+}
+
+// Refills the drained buffer with the next pieces of the response.
+void fillClient(Client& c) {
+  const uint32_t startUs = micros();
+  c.len = 0;
+  c.sentLen = 0;
+  ResponseWriter w(c);
+  writeResponse(w, c);
+  c.done = !w.full();
+  c.formatUs += micros() - startUs;
+}
+
+// Sends what the socket takes without waiting, formatting more as the buffer drains, and
+// closes the connection once the whole response is out. When the socket is full, select()
+// brings the server back here once it is writable again.
+void writeClient(Client& c) {
+  for (;;) {
+    if (c.sentLen == c.len) {
+      if (c.done) {
+        finishClient(c, true);
+        return;
+      }
+      fillClient(c);
+      continue;
+    }
+    const int n = send(c.fd, c.buf + c.sentLen, c.len - c.sentLen, 0);
+    if (n > 0) {
+      c.sentLen += n;
+      c.sent += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    } else {
+      finishClient(c, false);
+      return;
+    }
+  }
+}
+
+void respond(Client& c, Route route) {
+  c.route = route;
+  if (route == Route::Current || route == Route::Forecast || route == Route::Metrics) {
+    gState.read(c.st);
+    c.hasEnv = envLatest(c.env);
+  }
+  c.responding = true;
+  c.done = false;
+  c.len = 0;
+  c.sentLen = 0;
+  c.pieces = 0;
+  c.sent = 0;
+  c.formatUs = 0;
+  writeClient(c);
+}
+
+// Routes a complete request; the connection is closed once the response is sent.
+void handleRequest(Client& c) {
+  Route route = Route::NotFound;
+  char* path = c.buf + 4;
+  const bool isGet = strncmp(c.buf, "GET ", 4) == 0;
+  const size_t pathLen = isGet ? strcspn(path, " ?\r\n") : 0;
+  if (!isGet) {
+    route = Route::NotGet;
+  } else if (pathLen == 0) {
+    route = Route::BadRequest;
+  } else {
+    path[pathLen] = '\0';
+    if (strcmp(path, "/metrics") == 0) {
+      route = Route::Metrics;
+    } else if (strcmp(path, "/api/current") == 0) {
+      route = Route::Current;
+    } else if (strcmp(path, "/api/forecast") == 0) {
+      route = Route::Forecast;
+    }
+  }
+
+  portENTER_CRITICAL(&gStatsLock);
+  gStats.requests++;
+  if (route == Route::NotFound) gStats.notFound++;
+  if (route == Route::BadRequest || route == Route::NotGet) gStats.badRequests++;
+  portEXIT_CRITICAL(&gStatsLock);
+  respond(c, route);
+}
+
+// Reads what has arrived; handles the request once the header block is complete.
+void readClient(Client& c) {
+  const int n = recv(c.fd, c.buf + c.len, sizeof(c.buf) - 1 - c.len, 0);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    closeClient(c);
+    return;
+  }
+  if (n < 0) return;
+  c.len += n;
+  c.buf[c.len] = '\0';
+  if (strstr(c.buf, "\r\n\r\n") || strstr(c.buf, "\n\n")) {
+    handleRequest(c);
+  } else if (c.len == sizeof(c.buf) - 1) {
+    portENTER_CRITICAL(&gStatsLock);
+    gStats.badRequests++;
+    portEXIT_CRITICAL(&gStatsLock);
+    respond(c, Route::TooLarge);
+  }
+}
+
+Client* freeSlot() {
+  for (Client& c : gClients) {
+    if (c.fd < 0) return &c;
+  }
+  return nullptr;
+}
+
+// Accepts while there are free slots. The rest wait in the listen backlog (and beyond it
+// the TCP stack drops their SYNs, so clients retry) instead of being refused.
+void acceptClients() {
+  Client* slot;
+  while ((slot = freeSlot()) != nullptr) {
+    const int fd = accept(gListenFd, nullptr, nullptr);
+    if (fd < 0) return;
+    setNonBlocking(fd);
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    slot->fd = fd;
+    slot->len = 0;
+    slot->responding = false;
+    slot->openedMs = millis();
+    portENTER_CRITICAL(&gStatsLock);
+    gStats.clients++;
+    portEXIT_CRITICAL(&gStatsLock);
+  }
+}
+
+bool openListener() {
+  const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) return false;
+  const int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(HTTP_API_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(fd, kBacklog) != 0) {
+    close(fd);
+    return false;
+  }
+  setNonBlocking(fd);
+  gListenFd = fd;
+  Serial.printf("[HTTP] Listening on port %u\n", static_cast<unsigned>(HTTP_API_PORT));
+  return true;
+}
+
+void closeAll() {
+  for (Client& c : gClients) closeClient(c);
+  if (gListenFd >= 0) {
+    close(gListenFd);
+    gListenFd = -1;
+    Serial.println("[HTTP] Stopped");
+  }
+}
+
+void httpTaskMain(void* param) {
+  (void)param;
+  for (;;) {
+    if (!gEnabled.load()) {
+      closeAll();
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    if (gListenFd < 0 && !openListener()) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+      continue;
+    }
+
+    // Clients still sending their request wait to be readable, those being answered to be
+    // writable, so none of them ever holds up the others.
+    fd_set rd;
+    fd_set wr;
+    FD_ZERO(&rd);
+    FD_ZERO(&wr);
+    int maxFd = -1;
+    if (freeSlot()) {
+      FD_SET(gListenFd, &rd);
+      maxFd = gListenFd;
+    }
+    for (const Client& c : gClients) {
+      if (c.fd < 0) continue;
+      FD_SET(c.fd, c.responding ? &wr : &rd);
+      maxFd = max(maxFd, c.fd);
+    }
+    timeval tv = {0, static_cast<long>(kSelectTimeoutMs * 1000)};
+    const int ready = select(maxFd + 1, &rd, &wr, nullptr, &tv);
+    if (ready < 0) {
+      // The interface went away under the sockets; start over once re-enabled.
+      closeAll();
+      vTaskDelay(pdMS_TO_TICKS(kSelectTimeoutMs));
+      continue;
+    }
+
+    if (ready > 0 && FD_ISSET(gListenFd, &rd)) acceptClients();
+    const uint32_t now = millis();
+    for (Client& c : gClients) {
+      if (c.fd < 0) continue;
+      if (ready > 0 && c.responding && FD_ISSET(c.fd, &wr)) {
+        writeClient(c);
+      } else if (ready > 0 && !c.responding && FD_ISSET(c.fd, &rd)) {
+        readClient(c);
+      }
+      if (c.fd < 0 || now - c.openedMs <= kClientTimeoutMs) continue;
+      if (c.responding) {
+        finishClient(c, false);
+      } else {
+        closeClient(c);
+        portENTER_CRITICAL(&gStatsLock);
+        gStats.timeouts++;
+        portEXIT_CRITICAL(&gStatsLock);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool httpApiStart() {
+  if (gTask) return true;
+  return xTaskCreatePinnedToCore(httpTaskMain, "http", kTaskStack, nullptr, 1, &gTask, 0) ==
+         pdPASS;
+}
+
+void httpApiSetEnabled(bool enabled) {
+  if (gEnabled.exchange(enabled) == enabled) return;
+  if (gTask) xTaskNotifyGive(gTask);
+}
+
+void httpApiPublish(const ApiState& st) { gState.publish(st); }
+
+HttpApiStats httpApiStats() {
+  portENTER_CRITICAL(&gStatsLock);
+  const HttpApiStats st = gStats;
+  portEXIT_CRITICAL(&gStatsLock);
+  return st;
+}
@@ -0,0 +1,167 @@
+#include "http_body.h"
+
+#include <algorithm>
+
+HttpBodyStream::HttpBodyStream(Stream& raw, int contentLength, bool chunked,
+                               const std::atomic<bool>* cancel)
+    : raw_(raw), cancel_(cancel), chunked_(chunked), untilClose_(!chunked && contentLength < 0) {
+  if (!chunked_ && contentLength >= 0) {
+    remaining_ = static_cast<size_t>(contentLength);
+    done_ = (remaining_ == 0);
+  }
+}
+
+int HttpBodyStream::rawRead() {
+  if (cancel_ && cancel_->load(std::memory_order_relaxed)) {
+    failed_ = true;
+    return -1;
+  }
+  char c = 0;
+  if (raw_.readBytes(&c, 1) != 1) {  // honours the stream's read timeout
+    if (!untilClose_) failed_ = true;
+    return -1;
+  }
+  return static_cast<uint8_t>(c);
+}
+
+// Parses "<hex-size>[;ext]\r\n", preceded by the CRLF that closes the previous chunk.
+// A zero-size chunk ends the body; its trailer section is consumed up to the blank line.
+bool HttpBodyStream::beginChunk() {
+  if (!firstChunk_) {
+    if (rawRead() != '\r' || rawRead() != '\n') {
+      failed_ = true;
+      return false;
+    }
+  }
+  firstChunk_ = false;
+
+  size_t size = 0;
+  bool inExt = false;
+  int digits = 0;
+  for (;;) {
+    const int c = rawRead();
+    if (c < 0) return false;
+    if (c == '\r') continue;
+    if (c == '\n') break;
+    if (inExt) continue;
+    if (c == ';') {
+      inExt = true;
+      continue;
+    }
+    int v = -1;
+    if (c >= '0' && c <= '9') v = c - '0';
+    else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+    if (v < 0 || digits >= 8) {
+      failed_ = true;
+      return false;
+    }
+    size = (size << 4) | static_cast<size_t>(v);
+    digits++;
+  }
+  if (digits == 0) {
+    failed_ = true;
+    return false;
+  }
+
+  if (size == 0) {
+    // Trailer: header lines until an empty line.
+    int lineLen = 0;
+    for (;;) {
+      const int c = rawRead();
+      if (c < 0) return false;
+      if (c == '\r') continue;
+      if (c == '\n') {
+        if (lineLen == 0) break;
+        lineLen = 0;
+        continue;
+      }
+      lineLen++;
+    }
+    done_ = true;
+    return false;
+  }
+
+  remaining_ = size;
+  return true;
+}
+
+int HttpBodyStream::available() {
+  if (peeked_ >= 0) return 1;
+  if (done_ || failed_) return 0;
+  const int avail = raw_.available();
+  if (avail <= 0 || untilClose_) return avail > 0 ? avail : 0;
+  return static_cast<int>(std::min(static_cast<size_t>(avail), remaining_));
+}
+
+int HttpBodyStream::read() {
+  if (peeked_ >= 0) {
+    const int c = peeked_;
+    peeked_ = -1;
+    return c;
+  }
+  if (done_ || failed_) return -1;
+
+  if (untilClose_) {
+    const int c = rawRead();
+    if (c < 0) done_ = true;
+    return c;
+  }
+
+  if (remaining_ == 0) {
+    if (!chunked_) {
+      done_ = true;
+      return -1;
+    }
+    if (!beginChunk()) return -1;
+  }
+
+  const int c = rawRead();
+  if (c < 0) return -1;
+  remaining_--;
+  if (!chunked_ && remaining_ == 0) done_ = true;
+  return c;
+}
+
+// Bulk path for the payload bytes inside a chunk (or Content-Length body); framing
+// and the read-until-close case go through read().
+size_t HttpBodyStream::readBytes(char* dst, size_t n) {
+  size_t got = 0;
+  if (n > 0 && peeked_ >= 0) {
+    dst[got++] = static_cast<char>(peeked_);
+    peeked_ = -1;
+  }
+  while (got < n && !done_ && !failed_) {
+    if (untilClose_ || remaining_ == 0) {
+      const int c = read();
+      if (c < 0) break;
+      dst[got++] = static_cast<char>(c);
+      continue;
+    }
+    if (cancel_ && cancel_->load(std::memory_order_relaxed)) {
+      failed_ = true;
+      break;
+    }
+    const size_t want = std::min(n - got, remaining_);
+    const size_t len = raw_.readBytes(dst + got, want);
+    got += len;
+    remaining_ -= len;
+    if (len < want) {
+      failed_ = true;
+      break;
+    }
+    if (!chunked_ && remaining_ == 0) done_ = true;
+  }
+  return got;
+}
+
+int HttpBodyStream::peek() {
+  if (peeked_ < 0) peeked_ = read();
+  return peeked_;
+}
+
+bool HttpBodyStream::drain() {
+  peeked_ = -1;
+  while (!done_ && !failed_) read();
+  return done_ && !failed_ && !untilClose_;
+}
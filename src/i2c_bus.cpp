@@ -0,0 +1,275 @@
+#include "i2c_bus.h"
+
+#include <Wire.h>
+
+#include <atomic>
+
+#include "snapshot.h"
+
+namespace {
+
+constexpr uint8_t kAxpAddr = 0x34;
+constexpr uint8_t kRtcAddr = 0x51;
+
+constexpr uint32_t kTaskStack = 4096;
+// Above the network and sensor workers on core 0, so a touch hand-over is served as soon as
+// the transaction in flight ends. The task spends nearly all its time blocked.
+constexpr UBaseType_t kTaskPriority = 3;
+
+TaskHandle_t gTask = nullptr;
+
+// One pending handed-over call per class: callers of a class take turns on its lock, the
+// bus task runs the call and gives its `done`. Each class waits only behind its own callers.
+struct Slot {
+  SemaphoreHandle_t lock = nullptr;
+  SemaphoreHandle_t done = nullptr;
+  void (*fn)(void*) = nullptr;
+  void* arg = nullptr;
+  uint32_t requestedUs = 0;
+  std::atomic<bool> pending{false};
+};
+Slot gSlots[kI2cClassCount];
+
+struct PeriodicJob {
+  I2cClass cls;
+  uint32_t periodMs;
+  uint32_t dueMs;
+  bool (*run)(I2cClassStats& st);
+};
+
+Snapshot<PowerReading> gPower;
+Snapshot<RtcReading> gRtc;
+
+// Written by the bus task, copied by readers; short enough for a spinlock.
+portMUX_TYPE gLock = portMUX_INITIALIZER_UNLOCKED;
+I2cStats gStats;
+
+uint8_t bcdToBin(uint8_t v) { return static_cast<uint8_t>((v >> 4) * 10 + (v & 0x0F)); }
+
+// Burst read of `n` consecutive registers, counted against `st`.
+bool readRegs(uint8_t addr, uint8_t reg, uint8_t* out, uint8_t n, I2cClassStats& st) {
+  st.transactions++;
+  Wire1.beginTransmission(addr);
+  Wire1.write(reg);
+  if (Wire1.endTransmission(false) != 0 || Wire1.requestFrom(addr, n) != n) {
+    st.errors++;
+    return false;
+  }
+  for (uint8_t i = 0; i < n; i++) out[i] = static_cast<uint8_t>(Wire1.read());
+  return true;
+}
+
+bool writeReg(uint8_t addr, uint8_t reg, uint8_t value, I2cClassStats& st) {
+  st.transactions++;
+  Wire1.beginTransmission(addr);
+  Wire1.write(reg);
+  Wire1.write(value);
+  if (Wire1.endTransmission() != 0) {
+    st.errors++;
+    return false;
+  }
+  return true;
+}
+
+// AXP192 ADC pair: 12-bit voltages are hi << 4 | lo, 13-bit currents hi << 5 | lo.
+uint16_t axpAdc(const uint8_t* b, uint8_t bits) {
+  return static_cast<uint16_t>((b[0] << (bits - 8)) | (b[1] & ((1u << (bits - 8)) - 1)));
+}
+
+uint32_t be32(const uint8_t* b) {
+  return (static_cast<uint32_t>(b[0]) << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+bool readPower(I2cClassStats& st) {
+  uint8_t status;
+  uint8_t adc[6];
+  uint8_t coulomb[8];
+  if (!readRegs(kAxpAddr, 0x00, &status, 1, st)) return false;
+  if (!readRegs(kAxpAddr, 0x78, adc, sizeof(adc), st)) return false;
+  if (!readRegs(kAxpAddr, 0xB0, coulomb, sizeof(coulomb), st)) return false;
+
+  PowerReading r;
+  r.ms = millis();
+  r.batteryMv = static_cast<uint16_t>(axpAdc(adc, 12) * 11 / 10);  // 1.1 mV per LSB
+  r.chargeMa = static_cast<uint16_t>(axpAdc(adc + 2, 13) / 2);      // 0.5 mA per LSB
+  r.dischargeMa = static_cast<uint16_t>(axpAdc(adc + 4, 13) / 2);
+  r.coulombIn = be32(coulomb);
+  r.coulombOut = be32(coulomb + 4);
+  r.charging = (status & 0x04) != 0;
+  r.externalPower = (status & 0xA0) != 0;
+  gPower.publish(r);
+  return true;
+}
+
+bool readRtc(I2cClassStats& st) {
+  uint8_t b[7];
+  if (!readRegs(kRtcAddr, 0x02, b, sizeof(b), st)) return false;
+
+  RtcReading r;
+  r.ms = millis();
+  r.seconds = bcdToBin(b[0] & 0x7F);
+  r.minutes = bcdToBin(b[1] & 0x7F);
+  r.hours = bcdToBin(b[2] & 0x3F);
+  r.date = bcdToBin(b[3] & 0x3F);
+  r.weekDay = bcdToBin(b[4] & 0x07);
+  r.month = bcdToBin(b[5] & 0x1F);
+  r.year = static_cast<uint16_t>(((b[5] & 0x80) ? 1900 : 2000) + bcdToBin(b[6]));
+  r.valid = !(b[0] & 0x80) && r.month >= 1 && r.month <= 12 && r.date >= 1 && r.date <= 31 &&
+            r.hours <= 23 && r.minutes <= 59 && r.seconds <= 59;
+  gRtc.publish(r);
+  return true;
+}
+
+PeriodicJob gJobs[] = {
+    {I2cClass::Power, 0, 0, readPower},
+    {I2cClass::Rtc, 0, 0, readRtc},
+};
+
+void account(I2cClass cls, const I2cClassStats& delta, uint32_t busUs, uint32_t latencyUs) {
+  portENTER_CRITICAL(&gLock);
+  I2cClassStats& st = gStats.cls[static_cast<uint8_t>(cls)];
+  st.jobs++;
+  st.transactions += delta.transactions;
+  st.errors += delta.errors;
+  st.busUs += busUs;
+  st.latencyUsTotal += latencyUs;
+  if (latencyUs > st.latencyUsMax) st.latencyUsMax = latencyUs;
+  portEXIT_CRITICAL(&gLock);
+}
+
+bool anyPending() {
+  for (const Slot& slot : gSlots) {
+    if (slot.pending.load(std::memory_order_acquire)) return true;
+  }
+  return false;
+}
+
+// Runs pending hand-overs, highest class first, until none is left. After each one the
+// scan starts over, so a touch request that arrived meanwhile goes next.
+void runRequests() {
+  for (uint8_t c = 0; c < kI2cClassCount;) {
+    Slot& slot = gSlots[c];
+    if (!slot.pending.load(std::memory_order_acquire)) {
+      c++;
+      continue;
+    }
+    const uint32_t t0 = micros();
+    slot.fn(slot.arg);
+    const uint32_t t1 = micros();
+    account(static_cast<I2cClass>(c), I2cClassStats{}, t1 - t0, t1 - slot.requestedUs);
+    slot.pending.store(false, std::memory_order_release);
+    xSemaphoreGive(slot.done);
+    c = 0;
+  }
+}
+
+// Runs one device batch. Its latency counts from when it fell due.
+void runJob(PeriodicJob& job, uint32_t now) {
+  I2cClassStats delta;
+  const uint32_t t0 = micros();
+  job.run(delta);
+  const uint32_t t1 = micros();
+  const uint32_t lateMs = now - job.dueMs;
+  account(job.cls, delta, t1 - t0, lateMs * 1000 + (t1 - t0));
+  job.dueMs = now + job.periodMs;
+}
+
+void taskMain(void* param) {
+  (void)param;
+  for (;;) {
+    uint32_t now = millis();
+    int32_t waitMs = INT32_MAX;
+    for (const PeriodicJob& job : gJobs) {
+      waitMs = min(waitMs, static_cast<int32_t>(job.dueMs - now));
+    }
+    if (waitMs > 0 && !anyPending()) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+
+    // Handed-over calls first, and again between batches, so a touch read waits for at
+    // most one batch. gJobs is in priority order.
+    runRequests();
+    now = millis();
+    for (PeriodicJob& job : gJobs) {
+      if (static_cast<int32_t>(now - job.dueMs) < 0) continue;
+      runJob(job, now);
+      runRequests();
+    }
+  }
+}
+
+}  // namespace
+
+bool i2cBusStart(uint32_t powerPeriodMs, uint32_t rtcPeriodMs) {
+  if (gTask) return true;
+  gJobs[0].periodMs = powerPeriodMs;
+  gJobs[1].periodMs = rtcPeriodMs;
+
+  // The coulomb counter is off after a cold start; it gives average currents over minutes.
+  uint8_t coulombCtl = 0;
+  I2cClassStats setup;
+  if (readRegs(kAxpAddr, 0xB8, &coulombCtl, 1, setup) && !(coulombCtl & 0x80)) {
+    writeReg(kAxpAddr, 0xB8, 0x80, setup);
+  }
+  account(I2cClass::Power, setup, 0, 0);
+
+  // First readings in place, so setup() can use them before the task runs.
+  const uint32_t now = millis();
+  for (PeriodicJob& job : gJobs) {
+    job.dueMs = now;
+    runJob(job, now);
+  }
+
+  for (Slot& slot : gSlots) {
+    slot.lock = xSemaphoreCreateMutex();
+    slot.done = xSemaphoreCreateBinary();
+    if (!slot.lock || !slot.done) return false;
+  }
+  return xTaskCreatePinnedToCore(
+             taskMain, "i2c", kTaskStack, nullptr, kTaskPriority, &gTask, 0) == pdPASS;
+}
+
+bool i2cPower(PowerReading& out) { return gPower.read(out) != 0; }
+
+bool i2cRtc(RtcReading& out) { return gRtc.read(out) != 0; }
+
+uint32_t i2cPowerVersion() { return gPower.version(); }
+
+void i2cBusRun(I2cClass cls, void (*fn)(void*), void* arg) {
+  if (!gTask || xTaskGetCurrentTaskHandle() == gTask) {
+    const uint32_t t0 = micros();
+    fn(arg);
+    const uint32_t us = micros() - t0;
+    account(cls, I2cClassStats{}, us, us);
+    return;
+  }
+
+  Slot& slot = gSlots[static_cast<uint8_t>(cls)];
+  xSemaphoreTake(slot.lock, portMAX_DELAY);
+  slot.fn = fn;
+  slot.arg = arg;
+  slot.requestedUs = micros();
+  slot.pending.store(true, std::memory_order_release);
+  xTaskNotifyGive(gTask);
+  xSemaphoreTake(slot.done, portMAX_DELAY);
+  xSemaphoreGive(slot.lock);
+}
+
+I2cStats i2cStats() {
+  portENTER_CRITICAL(&gLock);
+  const I2cStats s = gStats;
+  portEXIT_CRITICAL(&gLock);
+  return s;
+}
+
+const char* i2cClassName(I2cClass cls) {
+  switch (cls) {
+    case I2cClass::Touch:
+      return "touch";
+    case I2cClass::Power:
+      return "power";
+    case I2cClass::Rtc:
+      return "rtc";
+    case I2cClass::Count:
+      break;
+  }
+  return "?";
+}
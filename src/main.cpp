@@ -4,7 +4,31 @@
 #include <WiFiClientSecure.h>
 #include <WiFi.h>
 #include <WiFiManager.h>
-#include <ArduinoJson.h>
+
+#include <atomic>
+#include <cstdarg>
+
+#include "duty_cycle.h"
+#include "env_sensor.h"
+#include "fetch_policy.h"
+#include "forecast_store.h"
+#include "heap_guard.h"
+#include "http_api.h"
+#include "http_body.h"
+#include "i2c_bus.h"
+#include "mqtt_publisher.h"
+#include "power_governor.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "timer_wheel.h"
+#include "tsdb.h"
+#include "ui_compositor.h"
+#include "ui_layout.h"
+#include "wall_clock.h"
+#include "weather_cache.h"
+#include "weather_locations.h"
+#include "weather_parse.h"
+#include "wifi_fast.h"
 
 #if __has_include("secrets.h")
 #include "secrets.h"
@@ -30,6 +54,83 @@
 #define WEATHER_LABEL "DK"
 #endif
 
+// Several sites, e.g. "DK:55.6761,12.5683;BER:52.52,13.405"; when set, replaces the single
+// site above. Either way the list can be changed at runtime ("loc" over serial).
+#ifndef WEATHER_LOCATIONS
+#define WEATHER_LOCATIONS ""
+#endif
+
+// With more than one site, the Forecast view and the ticker move on this often.
+#ifndef WEATHER_ROTATE_MS
+#define WEATHER_ROTATE_MS 15000
+#endif
+
+// Forecast fetches run every 30 min at this many minutes past the hour and the half hour
+// (UTC), once the clock is set. Open-Meteo's current conditions move on at each quarter
+// hour and its hourly model updates land a few minutes after the hour.
+#ifndef WEATHER_FETCH_OFFSET_MIN
+#define WEATHER_FETCH_OFFSET_MIN 5
+#endif
+
+// POSIX time zone of the clock in the top bar (default: Copenhagen).
+#ifndef TIME_ZONE
+#define TIME_ZONE "CET-1CEST,M3.5.0,M10.5.0/3"
+#endif
+
+// BME680 sample period (ms).
+#ifndef ENV_SAMPLE_MS
+#define ENV_SAMPLE_MS 10000
+#endif
+
+// Battery duty cycle, off by default. With DUTY_CYCLE_MIN > 0 the station deep-sleeps and
+// wakes every DUTY_CYCLE_MIN minutes (and for the forecast's fetch slots) to sample, fetch
+// when due, redraw and sleep again; a touch wakes it into the interactive mode, which sleeps
+// again once the screen has been dimmed for a while. DUTY_CYCLE_BACKLIGHT is the backlight
+// level through timer wakes and sleep: 0 keeps the panel dark.
+#ifndef DUTY_CYCLE_MIN
+#define DUTY_CYCLE_MIN 0
+#endif
+
+#ifndef DUTY_CYCLE_BACKLIGHT
+#define DUTY_CYCLE_BACKLIGHT 0
+#endif
+
+// Home Assistant over MQTT; an empty host leaves the publisher off.
+#ifndef MQTT_HOST
+#define MQTT_HOST ""
+#endif
+
+#ifndef MQTT_PORT
+#define MQTT_PORT 1883
+#endif
+
+#ifndef MQTT_USER
+#define MQTT_USER ""
+#endif
+
+#ifndef MQTT_PASS
+#define MQTT_PASS ""
+#endif
+
+#ifndef MQTT_PUBLISH_MS
+#define MQTT_PUBLISH_MS 60000
+#endif
+
+// Footer ticker: frame rate and scroll speed.
+#ifndef TICKER_FPS
+#define TICKER_FPS 30
+#endif
+
+#ifndef TICKER_SPEED_PX_S
+#define TICKER_SPEED_PX_S 40
+#endif
+
+// Define UI_COMPOSITOR_FULL_FRAME to repaint the whole screen on every UI pass, as the
+// pre-compositor code did; the "[UI] px/s" log then shows the full-redraw cost.
+// Define LOOP_POLLING to run loop() every 10 ms instead of on events and deadlines; the
+// "[Loop] wakeups/s" log then shows the polling cost.
+// Build with -DPROFILER=0 to drop the cycle profiler and its Diagnostics tab.
+
 // Optional: password for the Core2 setup AP ("Core2-Setup").
 // Leave empty to keep the setup AP open.
 // Note: WPA2 AP passwords must be 8..63 chars.
@@ -40,6 +141,11 @@
 static constexpr const char* kHostname = "core2-ha";
 static constexpr const char* kPortalApName = "Core2-Setup";
 static constexpr uint32_t kConnectTimeoutMs = 30000;
+// A directed join to the cached AP normally finishes in well under a second; past this the
+// AP has most likely moved and a full scan takes over.
+static constexpr uint32_t kFastJoinTimeoutMs = 4000;
+static constexpr uint32_t kFastLeaseReuseSec = 3600;  // cached address used without DHCP
+static constexpr uint32_t kDhcpHandoverMs = 60000;    // then DHCP takes the address back
 static constexpr uint32_t kPortalTimeoutMs = 180000;
 
 static const char* portalPasswordOrNull();
@@ -52,70 +158,81 @@ static uint16_t kColorAccent = 0;
 static uint16_t kColorGood = 0;
 static uint16_t kColorWarn = 0;
 static uint16_t kColorBad = 0;
-
-static constexpr int16_t kStatusPillH = 28;
-static constexpr int16_t kWiFiPillH = 24;
-
-struct Rect {
-  int16_t x = 0;
-  int16_t y = 0;
-  int16_t w = 0;
-  int16_t h = 0;
-
-  constexpr Rect() = default;
-  constexpr Rect(int16_t x_, int16_t y_, int16_t w_, int16_t h_) : x(x_), y(y_), w(w_), h(h_) {}
-
-  bool contains(int16_t px, int16_t py) const {
-    return px >= x && py >= y && px < (x + w) && py < (y + h);
-  }
-};
-
-enum class View : uint8_t { Status = 0, WiFi = 1, About = 2 };
+static uint16_t kColorPrecip = 0;
+
+#if PROFILER
+enum class View : uint8_t { Status = 0, Forecast = 1, WiFi = 2, About = 3, Diagnostics = 4 };
+static constexpr uint8_t kViewCount = 5;
+#else
+enum class View : uint8_t { Status = 0, Forecast = 1, WiFi = 2, About = 3 };
+static constexpr uint8_t kViewCount = 4;
+#endif
 enum class WifiState : uint8_t { Connecting = 0, Connected = 1, Portal = 2, Error = 3 };
 
 static View gView = View::Status;
 static WifiState gWifiState = WifiState::Connecting;
 static WiFiManager gWiFiManager;
-static String gConnectTarget = "";
+static char gConnectTarget[33] = "";  // SSID from secrets; empty for saved credentials
+static char gStaSsid[33] = "";        // SSID of the current link, read once per connect
 static bool gConnectUsingSecrets = false;
+static bool gJoinFast = false;      // the current attempt is the directed one
+static bool gJoinStatic = false;    // the cached address is configured instead of DHCP
+static bool gFastFailed = false;    // skip the directed join until a full one succeeds
+static uint32_t gJoinStartMs = 0;
+static uint32_t gJoinMs = 0;        // time to IP of the current link; 0 if not measured
+static bool gJoinWasFast = false;
+static bool gJoinWasStatic = false;
 static wl_status_t gLastStaStatus = WL_DISCONNECTED;
 
 static bool gPortalActive = false;
 static bool gUiDirty = true;
-static String gLastError;
-static uint32_t gWifiDeadlineMs = 0;
-static uint32_t gPortalDeadlineMs = 0;
-static uint32_t gUiNextRefreshMs = 0;
-static View gLastDrawnView = View::Status;
-static WifiState gLastDrawnWifiState = WifiState::Error;
-static String gLastDrawnSSID;
-static String gLastDrawnIP;
-static int32_t gLastDrawnRSSI = INT32_MIN;
-static String gLastDrawnError;
-static int8_t gLastDrawnBatteryPct = -1;
-static bool gLastDrawnCharging = false;
-static uint32_t gBatteryNextSampleMs = 0;
+static char gLastError[32] = "";
+static uint32_t gBatteryPowerVersion = 0;  // last PowerReading taken into the cache
 static uint8_t gBatteryPctCached = 0;
 static bool gBatteryChargingCached = false;
 static bool gBatteryCachedValid = false;
+static constexpr uint32_t kBatterySampleMs = 30000;  // AXP192 reads on the I2C bus task
+static constexpr uint32_t kRtcSyncMs = 60000;        // BM8563 reads; millis() in between
 
 static constexpr int16_t kTopBarH = 34;
+static constexpr int16_t kTopBarClockW = 46;  // "23:59" at the right end of the top bar
 static constexpr int16_t kFooterH = 24;
+static constexpr int16_t kWiFiButtonsH = 34;  // Portal / Retry / Forget, above the footer
+static constexpr int16_t kWiFiButtonsY = kLayoutScreenH - kFooterH - kWiFiButtonsH - 8;
 static Rect gTabStatus;
+static Rect gTabForecast;
 static Rect gTabWifi;
 static Rect gTabAbout;
+static Rect gTabDiag;  // empty when built without the profiler
+static Rect gTopClock;
 static Rect gBtnPortal;
 static Rect gBtnRetry;
 static Rect gBtnForget;
 static Rect gFooterRect;
+static Rect gTickerRect;
 
-static TFT_eSprite* gTickerSprite = nullptr;
+static TFT_eSprite* gTickerSprite = nullptr;  // footer window, pushed to the panel
 static int16_t gTickerW = 0;
 static int16_t gTickerH = 0;
 
+// The whole ticker line, rasterized once per text change (in PSRAM when available).
+// Scrolling copies a window of it into gTickerSprite instead of drawing text again.
+static constexpr int16_t kTickerGap = 24;
+static constexpr int16_t kTickerStripMaxW = 2048;
+static constexpr uint32_t kTickerFrameMs = 1000 / TICKER_FPS;
+static TFT_eSprite* gTickerStrip = nullptr;
+static int16_t gTickerStripW = 0;   // period: text width + gap when scrolling
+static int16_t gTickerTextW = 0;    // cached textWidth() of gTickerText
+static bool gTickerStripOk = false;
+static bool gTickerDirty = true;    // gTickerText changed since the strip was built
+static uint32_t gTickerScrollStartMs = 0;
+static int16_t gTickerLastOffset = -1;
+
 static Button* gHitTabStatus = nullptr;
+static Button* gHitTabForecast = nullptr;
 static Button* gHitTabWiFi = nullptr;
 static Button* gHitTabAbout = nullptr;
+static Button* gHitTabDiag = nullptr;
 static Button* gHitPortal = nullptr;
 static Button* gHitRetry = nullptr;
 static Button* gHitForget = nullptr;
@@ -126,19 +243,229 @@ static Gesture gSwipeRight("swipe right", 90, DIR_RIGHT, 35);
 static constexpr uint8_t kBrightnessActive = 60;
 static constexpr uint8_t kBrightnessDim = 12;
 static constexpr uint32_t kDimAfterMs = 20000;
-static uint32_t gLastInteractionMs = 0;
 static uint8_t gCurrentBrightness = 255;
+// Set while dimmed: the render task stops scrolling the ticker and only wakes for frames.
+static std::atomic<bool> gTickerPaused{false};
+
+static constexpr bool kDutyCycle = DUTY_CYCLE_MIN > 0;
+static constexpr uint32_t kDutyPeriodSec = (kDutyCycle ? DUTY_CYCLE_MIN : 1) * 60UL;
+static constexpr uint32_t kDutyPollMs = 250;       // a timer wake checks whether it is done
+static constexpr uint32_t kDutyPassMaxMs = 40000;  // and sleeps at this uptime regardless
+static constexpr uint32_t kDutyIdleMs = 30000;     // interactive: dimmed this long, then sleep
+static constexpr uint32_t kDutyMinSleepSec = 30;
+static bool gDutyPass = false;   // this boot is a timer wake nobody has touched
+static bool gDutyFetch = false;  // ... that fetches the forecast
+static uint32_t gDutyFetchesAtStart = 0;
+static uint32_t gDutyFrames = 0;  // render count that means the last frame is up; 0 before
+static uint32_t gDutyDrawnMs = 0;
+
+// loop() blocks on this event group until a bit is set or the next timer job is due.
+static constexpr EventBits_t kLoopEvtTouch = 1 << 0;    // touch controller INT went low
+static constexpr EventBits_t kLoopEvtWifi = 1 << 1;     // WiFi.onEvent()
+static constexpr EventBits_t kLoopEvtWeather = 1 << 2;  // weather worker finished a request
+static constexpr EventBits_t kLoopEvtUi = 1 << 3;       // uiMarkDirty()
+static constexpr EventBits_t kLoopEvtAll =
+    kLoopEvtTouch | kLoopEvtWifi | kLoopEvtWeather | kLoopEvtUi;
+static constexpr uint8_t kTouchIntPin = 39;       // FT6336U INT, low while touched
+static constexpr uint32_t kTouchPollMs = 10;      // M5.update() cadence while touched
+static constexpr uint32_t kTouchTrailMs = 80;     // keep polling after release for gestures
+static constexpr uint32_t kPortalPollMs = 20;     // WiFiManager needs process() calls
+static constexpr uint32_t kLoopMaxSleepMs = 60000;
+static EventGroupHandle_t gLoopEvents = nullptr;
+static uint32_t gTouchPollUntilMs = 0;
+static uint32_t gLoopWakeups = 0;
+static uint64_t gLoopBlockedUs = 0;
+static uint32_t gLoopWakeUs = 0;  // micros() when the current pass started
+// Since boot, for the metrics endpoint; the counters above reset with every stats line.
+static uint32_t gLoopWakeupsTotal = 0;
+static uint64_t gLoopBlockedUsTotal = 0;
+static uint64_t gLoopBusyUsTotal = 0;
+static uint32_t gLoopBusyUsMax = 0;
+// LOOP_POLLING's default; the host benchmarks switch it to measure both.
+#ifdef LOOP_POLLING
+static bool gLoopPolling = true;
+#else
+static bool gLoopPolling = false;
+#endif
 
-static portMUX_TYPE gWeatherMux = portMUX_INITIALIZER_UNLOCKED;
 static TaskHandle_t gWeatherTask = nullptr;
-static volatile bool gWeatherTaskRunning = false;
-static uint32_t gWeatherNextFetchMs = 0;
-static uint32_t gFooterNextTickMs = 0;
-static int16_t gWeatherScrollPx = 0;
-static char gWeatherText[160] = "Weather: (waiting for WiFi)";
-static bool gWeatherHasData = false;
+static QueueHandle_t gWeatherQueue = nullptr;
+static volatile bool gWeatherFetchPending = false;
+static uint32_t gWeatherFetchStartMs = 0;
+static std::atomic<bool> gWeatherCancel{false};
+static volatile bool gWeatherSavePending = false;
+static std::atomic<uint32_t> gWeatherNextFetchMs{0};
+static uint32_t gWeatherQueuedSitesVersion = 0;  // site list of the last request, loop()'s
+
+// Outcome of the last fetch, and the latest decoded forecast of each site. The weather worker
+// publishes whole values; the UI reads them lock-free and only re-renders when a version
+// moves. A site's forecast is published as soon as the parser has it.
+static constexpr int kWeatherStatusNone = 0;  // no fetch finished yet
+static constexpr int kWeatherStatusParseError = -1000;
+
+struct WeatherState {
+  int status = kWeatherStatusNone;  // HTTP code, or <0 for client errors
+  uint32_t fetches = 0;             // completed fetches since boot
+  uint32_t fetchFailures = 0;       // of which did not produce a forecast
+  uint32_t fetchMsLast = 0;         // connect to parsed
+  uint64_t fetchMsTotal = 0;
+  FetchPolicyStats policy;
+};
+
+// 304 Not Modified confirms the forecasts on display are current.
+static bool weatherStatusOk(int status) {
+  return status == HTTP_CODE_OK || status == HTTP_CODE_NOT_MODIFIED;
+}
 
-static void uiMarkDirty() { gUiDirty = true; }
+// Tagged with the site it was fetched for: after the list changes, a slot holds another
+// site's forecast until the next fetch, and is ignored until then.
+struct SiteForecast {
+  ForecastStore forecast;
+  int32_t latE4 = 0;
+  int32_t lonE4 = 0;
+};
+
+static Snapshot<WeatherState> gWeather;
+static Snapshot<SiteForecast> gForecasts[kWeatherLocationsMax];
+
+// The site list is loop()'s; the worker reads the published copy when it builds a request.
+static WeatherLocations gSites;
+static Snapshot<WeatherLocations> gSitesShared;
+
+// UI-task copies; only loop() touches these. The home site (the first) feeds the history,
+// HTTP API and MQTT; the Forecast view and the ticker show gUiSite.
+static WeatherState gUiWeather;
+static uint32_t gUiWeatherVersion = 0;
+static SiteForecast gUiHome;
+static uint32_t gUiHomeVersion = 0;
+static uint8_t gUiSite = 0;
+static SiteForecast gUiForecast;
+static uint32_t gUiForecastVersion = 0;
+static uint32_t gUiForecastKey = 0;  // custom-widget key: bumped when gUiForecast changes
+static constexpr size_t kTickerTextMax = 192;
+static char gUiTickerText[kTickerTextMax] = "Weather: (waiting for WiFi)";
+
+// loop() turns UI state into a frame description and publishes it; the render task, pinned
+// to core 1, owns the panel and turns frames into pixels. Neither waits for the other.
+struct RenderFrame {
+  UiFrame ui;
+  char tickerText[kTickerTextMax];
+  uint8_t site;      // whose forecast the Forecast view's custom widgets draw
+  uint32_t inputUs;  // micros() of the latest input when the frame was built
+};
+
+static Snapshot<RenderFrame> gRenderFrame;
+static RenderFrame gUiFrame;  // UI-task build buffer
+static uint32_t gUiInputUs = 0;
+static uint32_t gUiComposes = 0;
+
+// Render-side measurements, published by the render task for the UI and serial log.
+struct RenderStats {
+  uint32_t frames = 0;
+  uint64_t frameUsTotal = 0;
+  uint32_t frameUsAvg = 0;  // moving average over ~8 frames
+  uint32_t frameUsMax = 0;
+  uint32_t latencyUsLast = 0;  // input detected in loop() until its frame is on the panel
+  uint32_t latencyUsMax = 0;
+  uint32_t pixels = 0;
+  uint32_t pushes = 0;
+};
+
+static Snapshot<RenderStats> gRenderStats;
+
+static constexpr uint32_t kUiStatsMs = 10000;
+static uint32_t gUiStatsStartMs = 0;
+static RenderStats gUiStatsLast;
+static uint32_t gUiStatsComposes = 0;
+static uint32_t gUiStatsMqttPublished = 0;
+static I2cStats gUiStatsI2c;
+
+// Render-task state; nothing else touches these after setup().
+static constexpr uint32_t kRenderTaskStack = 6144;
+static TaskHandle_t gRenderTask = nullptr;
+static Compositor gCompositor;
+static RenderFrame gRenderCopy;
+static SiteForecast gRenderForecast;
+static uint32_t gRenderForecastVersion = 0;
+static uint8_t gRenderSite = 0;
+static char gTickerText[kTickerTextMax] = "";
+
+static void loopSignal(EventBits_t bits) {
+  if (gLoopEvents) xEventGroupSetBits(gLoopEvents, bits);
+}
+
+// Serial.printf() mallocs a buffer for lines longer than 64 characters; the periodic lines
+// loop() writes go through this fixed one instead.
+static void logPrintf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static void logPrintf(const char* fmt, ...) {
+  static char line[256];
+  va_list args;
+  va_start(args, fmt);
+  const int n = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (n <= 0) return;
+  Serial.write(reinterpret_cast<const uint8_t*>(line), min<size_t>(n, sizeof(line) - 1));
+}
+
+// Everything loop() does on a clock is a job on the timer wheel (timer_wheel.h), which
+// also tells loopWait() how long it may block.
+static void touchTick(uint32_t nowMs);
+static void uiRefreshTick(uint32_t nowMs);
+static void uiStatsTick(uint32_t nowMs);
+static void dimTick(uint32_t nowMs);
+static void wifiConnectTimeoutTick(uint32_t nowMs);
+static void wifiFastJoinTimeoutTick(uint32_t nowMs);
+static void wifiDhcpHandoverTick(uint32_t nowMs);
+static void wifiPortalTick(uint32_t nowMs);
+static void wifiPortalTimeoutTick(uint32_t nowMs);
+static void weatherTick(uint32_t nowMs);
+static void siteRotateTick(uint32_t nowMs);
+static void historyTick(uint32_t nowMs);
+static void historyReportTick(uint32_t nowMs);
+static void apiTick(uint32_t nowMs);
+static void mqttTick(uint32_t nowMs);
+static void serialCommandTick(uint32_t nowMs);
+static void clockTick(uint32_t nowMs);
+static void dutyTick(uint32_t nowMs);
+
+static TimerJob gJobTouch("touch", touchTick);
+static TimerJob gJobUiRefresh("ui", uiRefreshTick);
+static TimerJob gJobUiStats("stats", uiStatsTick);
+static TimerJob gJobDim("dim", dimTick);
+static TimerJob gJobConnectTimeout("connect", wifiConnectTimeoutTick);
+static TimerJob gJobFastJoin("fast-join", wifiFastJoinTimeoutTick);
+static TimerJob gJobDhcpHandover("dhcp", wifiDhcpHandoverTick);
+static TimerJob gJobPortal("portal", wifiPortalTick);
+static TimerJob gJobPortalTimeout("portal-end", wifiPortalTimeoutTick);
+static TimerJob gJobWeather("weather", weatherTick);
+static TimerJob gJobSiteRotate("rotate", siteRotateTick);
+static TimerJob gJobHistory("history", historyTick);
+static TimerJob gJobHistoryReport("ts-report", historyReportTick);
+static TimerJob gJobApi("api", apiTick);
+static TimerJob gJobMqtt("mqtt", mqttTick);
+static TimerJob gJobSerial("serial", serialCommandTick);
+static TimerJob gJobClock("clock", clockTick);
+static TimerJob gJobDuty("duty", dutyTick);
+
+// The next multiple of `stepMs`. Jobs started on a shared grid wake loop() together.
+static uint32_t gridNext(uint32_t stepMs) { return (millis() / stepMs + 1) * stepMs; }
+
+// Live values (RSSI, battery, API state, serial input) are looked at every second, every
+// ten while dimmed.
+static void liveRearm(TimerJob& job) {
+  timerStartAt(job, gridNext(gCurrentBrightness == kBrightnessDim ? 10000 : 1000));
+}
+
+static void uiMarkDirty() {
+  gUiDirty = true;
+  loopSignal(kLoopEvtUi);
+}
+
+// Tab order: swipe left / BtnB step forward, swipe right / BtnC step back.
+static View viewStep(View v, int dir) {
+  const int i = (static_cast<int>(v) + dir + kViewCount) % kViewCount;
+  return static_cast<View>(i);
+}
 
 static void inputInit() {
   auto reset = [](Button*& btn, const Rect& r, const char* name) {
@@ -147,8 +474,12 @@ static void inputInit() {
   };
 
   reset(gHitTabStatus, gTabStatus, "tabStatus");
+  reset(gHitTabForecast, gTabForecast, "tabForecast");
   reset(gHitTabWiFi, gTabWifi, "tabWiFi");
   reset(gHitTabAbout, gTabAbout, "tabAbout");
+#if PROFILER
+  reset(gHitTabDiag, gTabDiag, "tabDiag");
+#endif
 
   reset(gHitPortal, gBtnPortal, "btnPortal");
   reset(gHitRetry, gBtnRetry, "btnRetry");
@@ -167,23 +498,33 @@ static void uiInit() {
   kColorGood = M5.Lcd.color565(40, 200, 120);
   kColorWarn = M5.Lcd.color565(250, 180, 50);
   kColorBad = M5.Lcd.color565(250, 80, 80);
+  kColorPrecip = M5.Lcd.color565(30, 70, 120);
 
   M5.Lcd.setTextFont(2);
   M5.Lcd.setTextSize(1);
   M5.Lcd.setTextColor(kColorText, kColorBg);
 
-  const int16_t tabW = w / 3;
+  const int16_t tabsW = static_cast<int16_t>(w - kTopBarClockW);
+  const int16_t tabW = tabsW / kViewCount;
   gTabStatus = Rect{0, 0, tabW, kTopBarH};
-  gTabWifi = Rect{tabW, 0, tabW, kTopBarH};
+  gTabForecast = Rect{tabW, 0, tabW, kTopBarH};
+  gTabWifi = Rect{static_cast<int16_t>(tabW * 2), 0, tabW, kTopBarH};
+#if PROFILER
+  gTabAbout = Rect{static_cast<int16_t>(tabW * 3), 0, tabW, kTopBarH};
+  gTabDiag =
+      Rect{static_cast<int16_t>(tabW * 4), 0, static_cast<int16_t>(tabsW - tabW * 4), kTopBarH};
+#else
   gTabAbout =
-      Rect{static_cast<int16_t>(tabW * 2), 0, static_cast<int16_t>(w - tabW * 2), kTopBarH};
+      Rect{static_cast<int16_t>(tabW * 3), 0, static_cast<int16_t>(tabsW - tabW * 3), kTopBarH};
+#endif
+  gTopClock = Rect{tabsW, 9, kTopBarClockW, 16};
 
   gFooterRect = Rect{0, static_cast<int16_t>(h - kFooterH), w, kFooterH};
 
   const int16_t btnGap = 8;
   const int16_t btnW = (w - 24 - btnGap * 2) / 3;
-  const int16_t btnH = 34;
-  const int16_t btnY = static_cast<int16_t>(h - kFooterH - btnH - 8);
+  const int16_t btnH = kWiFiButtonsH;
+  const int16_t btnY = kWiFiButtonsY;
 
   gBtnPortal = Rect{12, btnY, btnW, btnH};
   gBtnRetry = Rect{static_cast<int16_t>(12 + btnW + btnGap), btnY, btnW, btnH};
@@ -194,56 +535,46 @@ static void uiInit() {
   const int16_t textMaxW = static_cast<int16_t>(batX - padX - 8);
   gTickerW = textMaxW;
   gTickerH = static_cast<int16_t>(gFooterRect.h - 1);
+  gTickerRect = Rect{padX, static_cast<int16_t>(gFooterRect.y + 1), gTickerW, gTickerH};
   if (!gTickerSprite) gTickerSprite = new TFT_eSprite(&M5.Lcd);
   gTickerSprite->setColorDepth(16);
   gTickerSprite->createSprite(gTickerW, gTickerH);
 
+  gCompositor.begin(&M5.Lcd, kColorBg);
   inputInit();
 }
 
-static void drawTab(const Rect& r, const char* label, bool active) {
-  const uint16_t bg = active ? kColorAccent : kColorPanel;
-  const uint16_t fg = active ? kColorBg : kColorMuted;
-  M5.Lcd.fillRect(r.x, r.y, r.w, r.h, bg);
-  M5.Lcd.setTextColor(fg, bg);
-  M5.Lcd.drawCentreString(label, r.x + (r.w / 2), r.y + 9, 2);
-  M5.Lcd.setTextColor(kColorText, kColorBg);
-}
+static constexpr int16_t kInfoLabelX = kLayoutMarginX;
 
-static void drawTopBar() {
-  drawTab(gTabStatus, "Status", gView == View::Status);
-  drawTab(gTabWifi, "WiFi", gView == View::WiFi);
-  drawTab(gTabAbout, "About", gView == View::About);
+static void uiTab(const Rect& r, const char* label, bool active) {
+  const uint16_t fg = active ? kColorBg : kColorMuted;
+  gUiFrame.ui.tab(r, label, fg, active ? kColorAccent : kColorPanel);
 }
 
-static void drawPill(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t bg, const char* label) {
-  M5.Lcd.fillRoundRect(x, y, w, h, 12, bg);
-  M5.Lcd.setTextColor(kColorBg, bg);
-  const int16_t textY = static_cast<int16_t>(y + (h - 16) / 2);
-  M5.Lcd.drawCentreString(label, x + (w / 2), textY, 2);
-  M5.Lcd.setTextColor(kColorText, kColorBg);
-}
+static void uiTopBar() {
+  uiTab(gTabStatus, "Status", gView == View::Status);
+  uiTab(gTabForecast, "Forecast", gView == View::Forecast);
+  uiTab(gTabWifi, "WiFi", gView == View::WiFi);
+  uiTab(gTabAbout, "About", gView == View::About);
+#if PROFILER
+  uiTab(gTabDiag, "Diag", gView == View::Diagnostics);
+#endif
 
-static void drawButton(const Rect& r, uint16_t bg, const char* label, bool enabled = true) {
-  const uint16_t fill = enabled ? bg : kColorPanel;
-  const uint16_t text = enabled ? kColorBg : kColorMuted;
-  M5.Lcd.fillRoundRect(r.x, r.y, r.w, r.h, 10, fill);
-  M5.Lcd.drawRoundRect(r.x, r.y, r.w, r.h, 10, enabled ? bg : kColorMuted);
-  M5.Lcd.setTextColor(text, fill);
-  const int16_t textY = static_cast<int16_t>(r.y + (r.h - 16) / 2);
-  M5.Lcd.drawCentreString(label, r.x + (r.w / 2), textY, 2);
-  M5.Lcd.setTextColor(kColorText, kColorBg);
+  // Local time once SNTP or the RTC has set the clock; the live-value grid redraws it.
+  char clock[8] = "--:--";
+  tm local;
+  if (wallClockLocal(local)) {
+    snprintf(clock,
+             sizeof(clock),
+             "%02u:%02u",
+             static_cast<unsigned>(local.tm_hour),
+             static_cast<unsigned>(local.tm_min));
+  }
+  gUiFrame.ui.text(gTopClock, clock, 2, kColorText, kColorBg, TextAlign::Centre);
 }
 
-static constexpr int16_t kInfoLabelX = 12;
-static constexpr int16_t kInfoValueX = 108;
-static constexpr int16_t kInfoRowH = 24;
-
-static void drawInfoRow(int16_t y, const char* label, const String& value) {
-  M5.Lcd.setTextColor(kColorMuted, kColorBg);
-  M5.Lcd.drawString(label, kInfoLabelX, y, 2);
-  M5.Lcd.setTextColor(kColorText, kColorBg);
-  M5.Lcd.drawString(value, kInfoValueX, y, 2);
+static void uiButton(const Rect& r, uint16_t color, const char* label) {
+  gUiFrame.ui.button(r, label, color, color, kColorBg);
 }
 
 static const char* wifiStateLabel() {
@@ -295,116 +626,495 @@ static const char* staStatusToString(wl_status_t st) {
   }
 }
 
-static void drawStatusView() {
-  const int16_t w = M5.Lcd.width();
-  const int16_t h = M5.Lcd.height();
-  int16_t y = kTopBarH + 14;
-
-  drawPill(12, y, w - 24, kStatusPillH, wifiStateColor(), wifiStateLabel());
-  y += kStatusPillH + 12;
-
-  drawInfoRow(y, "Host", kHostname);
-  y += kInfoRowH;
-
-  if (WiFi.status() == WL_CONNECTED) {
-    drawInfoRow(y, "SSID", WiFi.SSID());
-    y += kInfoRowH;
-    drawInfoRow(y, "IP", WiFi.localIP().toString());
-    y += kInfoRowH;
-    drawInfoRow(y, "RSSI", String(WiFi.RSSI()) + " dBm");
-    y += kInfoRowH;
-  } else if (gWifiState == WifiState::Portal) {
-    M5.Lcd.setTextColor(kColorMuted, kColorBg);
-    M5.Lcd.drawString("Setup:", 12, y, 2);
-    y += kInfoRowH;
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString(String("1) Join ") + kPortalApName, 12, y, 2);
-    y += kInfoRowH;
-    M5.Lcd.drawString("2) Open http://192.168.4.1", 12, y, 2);
-    y += kInfoRowH;
-  } else if (gWifiState == WifiState::Error) {
-    M5.Lcd.setTextColor(kColorMuted, kColorBg);
-    M5.Lcd.drawString("Error:", 12, y, 2);
-    y += kInfoRowH;
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString(gLastError, 12, y, 2);
-    y += kInfoRowH;
+// "21.4°C 45% 1013hPa gas 52k", or why there is no reading.
+static void formatEnvReading(char* out, size_t len) {
+  EnvSample s;
+  if (!envLatest(s)) {
+    snprintf(out, len, "%s", envStats().present ? "waiting..." : "no sensor");
+    return;
+  }
+  const int t10 = (s.tempC100 >= 0 ? s.tempC100 + 5 : s.tempC100 - 5) / 10;
+  const int n = snprintf(out,
+                         len,
+                         "%s%d.%d°C %u%% %luhPa",
+                         t10 < 0 ? "-" : "",
+                         abs(t10) / 10,
+                         abs(t10) % 10,
+                         static_cast<unsigned>((s.humidityPermille + 5) / 10),
+                         static_cast<unsigned long>((s.pressurePa + 50) / 100));
+  if (s.gasOhm != 0 && n > 0 && static_cast<size_t>(n) < len) {
+    snprintf(out + n, len - n, " gas %luk", static_cast<unsigned long>(s.gasOhm / 1000));
+  }
+  if (millis() - s.ms > 3 * envStats().periodMs) {
+    const size_t used = strlen(out);
+    snprintf(out + used, len - used, " (old)");
+  }
+}
+
+// Row bindings for the view tables below. Each writes into the caller's buffer or returns
+// a string that outlives the call.
+static const char* bindWifiState(char*, size_t) { return wifiStateLabel(); }
+static const char* bindHostname(char*, size_t) { return kHostname; }
+static const char* bindLastError(char*, size_t) { return gLastError; }
+static const char* bindStaState(char*, size_t) { return staStatusToString(WiFi.status()); }
+
+static const char* bindSsid(char*, size_t) { return gStaSsid; }
+
+static const char* bindIp(char* buf, size_t len) {
+  const IPAddress ip = WiFi.localIP();
+  snprintf(buf,
+           len,
+           "%u.%u.%u.%u",
+           static_cast<unsigned>(ip[0]),
+           static_cast<unsigned>(ip[1]),
+           static_cast<unsigned>(ip[2]),
+           static_cast<unsigned>(ip[3]));
+  return buf;
+}
+
+static const char* bindRssi(char* buf, size_t len) {
+  snprintf(buf, len, "%d dBm", static_cast<int>(WiFi.RSSI()));
+  return buf;
+}
+
+// "0.42 s fast", "6.10 s full": how long the current link took from begin() to an address.
+static const char* bindJoinTime(char* buf, size_t len) {
+  if (gJoinMs == 0) return "-";
+  snprintf(buf,
+           len,
+           "%u.%02u s %s",
+           static_cast<unsigned>(gJoinMs / 1000),
+           static_cast<unsigned>(gJoinMs % 1000 / 10),
+           gJoinWasStatic ? "fast, no DHCP" : gJoinWasFast ? "fast" : "full");
+  return buf;
+}
+
+static const char* bindConnectTarget(char*, size_t) {
+  return gConnectUsingSecrets ? gConnectTarget : "(saved)";
+}
+
+static const char* bindConnectingTo(char* buf, size_t len) {
+  snprintf(buf, len, "Connecting: %s", bindConnectTarget(buf, len));
+  return buf;
+}
+
+static const char* bindStaStateLine(char* buf, size_t len) {
+  snprintf(buf, len, "State: %s", staStatusToString(WiFi.status()));
+  return buf;
+}
+
+static const char* bindJoinStep(char* buf, size_t len) {
+  snprintf(buf, len, "1) Join %s", kPortalApName);
+  return buf;
+}
+
+static const char* bindJoinAp(char* buf, size_t len) {
+  snprintf(buf,
+           len,
+           "Join AP: %s%s",
+           kPortalApName,
+           portalPasswordOrNull() != nullptr ? " (password set)" : "");
+  return buf;
+}
+
+static const char* bindApName(char* buf, size_t len) {
+  snprintf(buf, len, "AP: %s", kPortalApName);
+  return buf;
+}
+
+static const char* bindRoom(char* buf, size_t len) {
+  formatEnvReading(buf, len);
+  return buf;
+}
+
+static const char* bindFrameStats(char* buf, size_t len) {
+  RenderStats st;
+  gRenderStats.read(st);
+  snprintf(buf,
+           len,
+           "Frame %u.%u ms (max %u.%u), input %u ms",
+           static_cast<unsigned>(st.frameUsAvg / 1000),
+           static_cast<unsigned>(st.frameUsAvg / 100 % 10),
+           static_cast<unsigned>(st.frameUsMax / 1000),
+           static_cast<unsigned>(st.frameUsMax / 100 % 10),
+           static_cast<unsigned>(st.latencyUsLast / 1000));
+  return buf;
+}
+
+// Clock, battery draw and the runtime the measured active/dimmed mix would give, or with the
+// duty cycle the days its measured drain would.
+static const char* bindPower(char* buf, size_t len) {
+  const PowerGovernorStats ps = powerGovernorStats();
+  const int n = snprintf(buf,
+                         len,
+                         "CPU %u MHz%s, ",
+                         static_cast<unsigned>(ps.cpuMhz),
+                         ps.lightSleep && ps.mode == PowerMode::Dimmed ? " + sleep" : "");
+  if (n < 0 || static_cast<size_t>(n) >= len) return buf;
+  const DutyCycleStats ds = dutyCycleStats();
+  if (ps.externalPower) {
+    snprintf(buf + n, len - n, "on USB power");
+  } else if (kDutyCycle && ds.batteryDaysX10 > 0) {
+    snprintf(buf + n,
+             len - n,
+             "%u mA, duty ~%u.%u d",
+             static_cast<unsigned>(ps.nowMa),
+             static_cast<unsigned>(ds.batteryDaysX10 / 10),
+             static_cast<unsigned>(ds.batteryDaysX10 % 10));
+  } else if (ps.runtimeMin > 0) {
+    snprintf(buf + n,
+             len - n,
+             "%u mA, ~%u.%u h left",
+             static_cast<unsigned>(ps.nowMa),
+             static_cast<unsigned>(ps.runtimeMin / 60),
+             static_cast<unsigned>(ps.runtimeMin % 60 / 6));
   } else {
-    M5.Lcd.setTextColor(kColorMuted, kColorBg);
-    const String target = gConnectUsingSecrets ? (String("Connecting: ") + gConnectTarget)
-                                               : String("Connecting: (saved)");
-    M5.Lcd.drawString(target, 12, y, 2);
-    y += kInfoRowH;
-    M5.Lcd.drawString(String("State: ") + staStatusToString(WiFi.status()), 12, y, 2);
-    y += kInfoRowH;
-    M5.Lcd.drawString("Tip: WiFi tab (or BtnA) for setup portal.", 12, y, 2);
-    y += kInfoRowH;
+    snprintf(buf + n, len - n, "%u mA", static_cast<unsigned>(ps.nowMa));
   }
+  return buf;
+}
 
-  (void)h;
+static bool staConnected() { return WiFi.status() == WL_CONNECTED; }
+static bool wifiConnecting() { return gWifiState == WifiState::Connecting; }
+static bool wifiPortal() { return gWifiState == WifiState::Portal; }
+static bool wifiError() { return gWifiState == WifiState::Error; }
+
+// View tables, placed at compile time from just below the top bar.
+static constexpr int16_t kViewTop = kTopBarH + 14;
+
+static constexpr RowSpec kStatusRows[] = {
+    rowPill(28, 40, bindWifiState, wifiStateColor),
+    rowInfo("Host", bindHostname),
+    when(staConnected),
+    rowInfo("SSID", bindSsid),
+    rowInfo("IP", bindIp),
+    rowInfo("RSSI", bindRssi),
+    when(wifiPortal),
+    rowText("Setup:", UiColor::Muted, kLayoutInfoRowH),
+    rowText(bindJoinStep, UiColor::Text, kLayoutInfoRowH),
+    rowText("2) Open http://192.168.4.1", UiColor::Text, kLayoutInfoRowH),
+    when(wifiError),
+    rowText("Error:", UiColor::Muted, kLayoutInfoRowH),
+    rowText(bindLastError, UiColor::Text, kLayoutInfoRowH),
+    otherwise(),
+    rowText(bindConnectingTo, UiColor::Muted, kLayoutInfoRowH),
+    rowText(bindStaStateLine, UiColor::Muted, kLayoutInfoRowH),
+    rowText("Tip: WiFi tab (or BtnA) for setup portal.", UiColor::Muted, kLayoutInfoRowH),
+    endWhen(),
+    rowInfo("Room", bindRoom),
+};
+static constexpr auto kStatusLayout = layoutRows(kStatusRows, kViewTop);
+
+static constexpr RowSpec kWiFiRows[] = {
+    rowTitle("Wi-Fi", kLayoutTitleH),  // tight, to leave room for three rows
+    rowPill(24, 28, bindWifiState, wifiStateColor),
+    when(staConnected),
+    rowInfo("SSID", bindSsid),
+    rowInfo("IP", bindIp),
+    rowInfo("Join", bindJoinTime),
+    when(wifiConnecting),
+    rowInfo("Try", bindConnectTarget),
+    rowInfo("State", bindStaState),
+    when(wifiPortal),  // the pill already says SETUP PORTAL
+    rowText(bindJoinAp, UiColor::Muted, 22),
+    rowTitle("http://192.168.4.1", kLayoutTitleH),
+    when(wifiError),
+    rowText("WiFi error"),
+    rowText(bindLastError, UiColor::Text),
+    otherwise(),
+    rowText("Connecting..."),
+    endWhen(),
+};
+static constexpr auto kWiFiLayout = layoutRows(kWiFiRows, kViewTop);
+
+static constexpr RowSpec kAboutRows[] = {
+    rowTitle("Core2 Home Automation", 34),
+    rowText("Wi-Fi setup portal"),
+    rowText(bindApName),
+    rowText("URL: http://192.168.4.1", UiColor::Muted, 22),
+    rowText("Tip: press BtnA for portal."),
+    rowText("Build: " __DATE__ " " __TIME__),
+    rowText(bindFrameStats),
+    rowText(bindPower),
+};
+static constexpr auto kAboutLayout = layoutRows(kAboutRows, kViewTop);
+
+// Footer and buttons stay clear of every table.
+static_assert(kStatusLayout.bottom <= kLayoutScreenH - kFooterH, "Status overlaps the footer");
+static_assert(kAboutLayout.bottom <= kLayoutScreenH - kFooterH, "About overlaps the footer");
+static_assert(kWiFiLayout.bottom <= kWiFiButtonsY, "WiFi view overlaps its buttons");
+
+template <size_t N>
+static void uiLayout(const Layout<N>& layout) {
+  const uint16_t palette[] = {kColorText, kColorMuted};  // by UiColor
+  layoutCompose(gUiFrame.ui, layout, palette, kColorBg);
 }
 
-static void drawWiFiView() {
+static void composeStatusView() { uiLayout(kStatusLayout); }
+
+static void composeWiFiView() {
+  uiLayout(kWiFiLayout);
+  uiButton(gBtnPortal, kColorAccent, "Portal");
+  uiButton(gBtnRetry, kColorGood, "Retry");
+  uiButton(gBtnForget, kColorBad, "Forget");
+}
+
+static void composeAboutView() { uiLayout(kAboutLayout); }
+
+#if PROFILER
+// Profiler table in the 6x8 font, so the columns line up: one row per scope, times in us.
+static void composeDiagView() {
+  static constexpr int16_t kRowH = 13;
   const int16_t w = M5.Lcd.width();
-  int16_t y = kTopBarH + 14;
+  int16_t y = kTopBarH + 8;
+  auto row = [&y, w](const char* s, uint16_t fg) {
+    gUiFrame.ui.text(
+        Rect{kInfoLabelX, y, static_cast<int16_t>(w - kInfoLabelX), 8}, s, 1, fg, kColorBg);
+    y += kRowH;
+  };
 
-  M5.Lcd.setTextColor(kColorText, kColorBg);
-  M5.Lcd.drawString("Wi-Fi", 12, y, 4);
-  y += 34;
-
-  drawPill(12, y, w - 24, kWiFiPillH, wifiStateColor(), wifiStateLabel());
-  y += kWiFiPillH + 12;
-
-  if (WiFi.status() == WL_CONNECTED) {
-    drawInfoRow(y, "SSID", WiFi.SSID());
-    y += kInfoRowH;
-    drawInfoRow(y, "IP", WiFi.localIP().toString());
-  } else if (gWifiState == WifiState::Connecting) {
-    const String target = gConnectUsingSecrets ? gConnectTarget : "(saved)";
-    drawInfoRow(y, "Try", target);
-    y += kInfoRowH;
-    drawInfoRow(y, "State", staStatusToString(WiFi.status()));
-  } else if (gWifiState == WifiState::Portal) {
-    M5.Lcd.setTextColor(kColorMuted, kColorBg);
-    M5.Lcd.drawString("Setup portal is running.", 12, y, 2);
-    M5.Lcd.drawString(String("Join AP: ") + kPortalApName, 12, y + 18, 2);
-    if (portalPasswordOrNull() != nullptr) M5.Lcd.drawString("AP password: set", 12, y + 36, 2);
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString("http://192.168.4.1", 12, y + 58, 4);
-    M5.Lcd.setTextColor(kColorMuted, kColorBg);
-  } else if (gWifiState == WifiState::Error) {
-    M5.Lcd.setTextColor(kColorMuted, kColorBg);
-    M5.Lcd.drawString("WiFi error", 12, y, 2);
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString(gLastError, 12, y + 18, 2);
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%-11s %7s %6s %6s %6s", "scope", "n", "p50", "p99", "max us");
+  row(buf, kColorMuted);
+  char p50[12];
+  char p99[12];
+  char mx[12];
+  for (uint8_t i = 0; i < kProfScopeCount; i++) {
+    const ProfSummary st = profSummary(static_cast<ProfScope>(i));
+    profFormatUs(st.p50Cycles, p50, sizeof(p50));
+    profFormatUs(st.p99Cycles, p99, sizeof(p99));
+    profFormatUs(st.maxCycles, mx, sizeof(mx));
+    snprintf(buf,
+             sizeof(buf),
+             "%-11s %7lu %6s %6s %6s",
+             st.name,
+             static_cast<unsigned long>(st.count),
+             p50,
+             p99,
+             mx);
+    row(buf, st.count ? kColorText : kColorMuted);
+  }
+  y += 4;
+  row(profEnabled() ? "Serial: prof, prof reset, prof off" : "Paused (serial: prof on)",
+      kColorMuted);
+}
+#endif
+
+// The forecast in `f` if it is current data for site `i`, else null.
+static const ForecastStore* siteForecast(const SiteForecast& f, uint8_t i) {
+  if (i >= gSites.count || !gSites.at[i].sameSite(f.latE4, f.lonE4)) return nullptr;
+  return f.forecast.hasData() ? &f.forecast : nullptr;
+}
+
+static const ForecastStore* homeForecast() { return siteForecast(gUiHome, 0); }
+
+// Footer line for the site on display, regenerated whenever a new version is published.
+static void weatherTickerText(char* out, size_t len) {
+  const WeatherState& st = gUiWeather;
+  const char* label = gSites.at[gUiSite].label;
+  const ForecastStore* fc = siteForecast(gUiForecast, gUiSite);
+  if (fc && forecastFormatTicker(*fc, label, out, len)) {
+    if (!weatherStatusOk(st.status) && st.status != kWeatherStatusNone) {
+      const size_t n = strlen(out);
+      snprintf(out + n, len - n, " (update failed)");
+    }
+    return;
+  }
+
+  if (st.status == kWeatherStatusNone) {
+    snprintf(out, len, "%s weather: (waiting for WiFi)", label);
+  } else if (weatherStatusOk(st.status)) {
+    snprintf(out, len, "%s weather: (updating)", label);  // site added since the last fetch
+  } else if (st.status == kWeatherStatusParseError) {
+    snprintf(out, len, "%s weather: parse error", label);
+  } else if (st.status > 0) {
+    snprintf(out, len, "%s weather: HTTP %d", label, st.status);
   } else {
-    M5.Lcd.setTextColor(kColorMuted, kColorBg);
-    M5.Lcd.drawString("Connecting...", 12, y, 2);
+    snprintf(out, len, "%s weather: network error %d", label, st.status);
   }
+}
 
-  drawButton(gBtnPortal, kColorAccent, "Portal");
-  drawButton(gBtnRetry, kColorGood, "Retry");
-  drawButton(gBtnForget, kColorBad, "Forget");
+// Pulls the latest published weather into the UI copies. Returns true if any changed.
+static bool weatherRefreshUi() {
+  bool changed = false;
+  const uint32_t v = gWeather.read(gUiWeather, gUiWeatherVersion);
+  if (v != gUiWeatherVersion) {
+    gUiWeatherVersion = v;
+    changed = true;
+  }
+  const uint32_t hv = gForecasts[0].read(gUiHome, gUiHomeVersion);
+  if (hv != gUiHomeVersion) {
+    gUiHomeVersion = hv;
+    changed = true;
+  }
+  const uint32_t sv = gForecasts[gUiSite].read(gUiForecast, gUiForecastVersion);
+  if (sv != gUiForecastVersion) {
+    gUiForecastVersion = sv;
+    gUiForecastKey++;
+    changed = true;
+  }
+  if (changed) weatherTickerText(gUiTickerText, sizeof(gUiTickerText));
+  return changed;
+}
+
+// Puts site `i` on the Forecast view and the ticker, and restarts the rotation clock.
+static void weatherShowSite(uint8_t i) {
+  gUiSite = i < gSites.count ? i : 0;
+  gUiForecastVersion = UINT32_MAX;  // forces the copy, and with it a new widget key
+  timerStart(gJobSiteRotate, WEATHER_ROTATE_MS);
+  weatherRefreshUi();
 }
 
-static void drawAboutView() {
-  int16_t y = kTopBarH + 14;
+static constexpr int16_t kForecastDailyH = 94;
+static constexpr int16_t kForecastChartH = 50;
+static constexpr int16_t kForecastChartBlockH = 6 + kForecastChartH + 12;  // rule + chart + hours
 
-  M5.Lcd.setTextColor(kColorText, kColorBg);
-  M5.Lcd.drawString("Core2 Home Automation", 12, y, 4);
-  y += 40;
+static const char* weekdayShort(uint32_t localSec) {
+  static constexpr const char* kNames[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+  return kNames[(localSec / 86400UL + 4) % 7];  // 1970-01-01 was a Thursday
+}
 
-  M5.Lcd.setTextColor(kColorMuted, kColorBg);
-  M5.Lcd.drawString("Wi-Fi setup portal", 12, y, 2);
-  y += 20;
-  M5.Lcd.drawString(String("AP: ") + kPortalApName, 12, y, 2);
-  y += 20;
-  M5.Lcd.drawString("URL: http://192.168.4.1", 12, y, 2);
-  y += 30;
+// One column per day: name, condition, max, min, precipitation chance.
+static void drawForecastDaily(TFT_eSPI& g, const Rect& r, int16_t ox, int16_t oy) {
+  const ForecastStore& fc = gRenderForecast.forecast;
+  const int16_t x0 = static_cast<int16_t>(r.x - ox);
+  const int16_t y = static_cast<int16_t>(r.y - oy);
+
+  char buf[12];
+  const int16_t colW = static_cast<int16_t>((r.w - 8) / kForecastDays);
+  for (uint8_t i = 0; i < fc.dayCount; i++) {
+    const int16_t cx = static_cast<int16_t>(x0 + 4 + colW * i + colW / 2);
+    const uint32_t local = fc.dailyStart + fc.utcOffsetSec + i * 86400UL;
+
+    g.setTextColor(i == 0 ? kColorAccent : kColorText, kColorBg);
+    g.drawCentreString(i == 0 ? "Today" : weekdayShort(local), cx, y, 2);
+    g.setTextColor(kColorMuted, kColorBg);
+    g.drawCentreString(condAbbrev(fc.dailyCond(i)), cx, y + 18, 2);
+
+    g.setTextColor(kColorText, kColorBg);
+    formatTempC10(fc.dailyMaxC10[i], buf, sizeof(buf));
+    g.drawCentreString(buf, cx, y + 38, 2);
+    g.setTextColor(kColorMuted, kColorBg);
+    formatTempC10(fc.dailyMinC10[i], buf, sizeof(buf));
+    g.drawCentreString(buf, cx, y + 56, 2);
+
+    if (fc.dailyPrecipPct[i] != kPrecipUnknown) {
+      snprintf(buf, sizeof(buf), "%u%%", static_cast<unsigned>(fc.dailyPrecipPct[i]));
+      g.setTextColor(kColorAccent, kColorBg);
+      g.drawCentreString(buf, cx, y + 74, 2);
+    }
+  }
+}
+
+// A 48 h temperature line over precipitation-probability bars, below a separator rule.
+static void drawForecastChart(TFT_eSPI& g, const Rect& r, int16_t ox, int16_t oy) {
+  const ForecastStore& fc = gRenderForecast.forecast;
+  const int16_t x0 = static_cast<int16_t>(r.x - ox);
+  const int16_t y = static_cast<int16_t>(r.y - oy);
+
+  g.drawFastHLine(x0 + 8, y, r.w - 16, kColorPanel);
+  if (fc.hourCount < 2) return;
+
+  int16_t lo = INT16_MAX;
+  int16_t hi = INT16_MIN + 1;
+  for (uint8_t i = 0; i < fc.hourCount; i++) {
+    const int16_t t = fc.hourlyTempC10[i];
+    if (t == kTempUnknown) continue;
+    lo = min(lo, t);
+    hi = max(hi, t);
+  }
+  if (lo > hi) return;
+  if (hi - lo < 20) hi = static_cast<int16_t>(lo + 20);  // keep flat days from looking jagged
+
+  char buf[12];
+  const int16_t chartX = static_cast<int16_t>(x0 + 30);
+  const int16_t chartW = static_cast<int16_t>(r.w - 30 - 8);
+  const int16_t chartY = static_cast<int16_t>(y + 6);
+  const int16_t chartH = kForecastChartH;
+  auto px = [&](uint8_t i) {
+    return static_cast<int16_t>(chartX + (chartW - 1) * i / (fc.hourCount - 1));
+  };
+  auto py = [&](int16_t t) {
+    return static_cast<int16_t>(chartY + chartH - 1 - (chartH - 1) * (t - lo) / (hi - lo));
+  };
+
+  for (uint8_t i = 0; i < fc.hourCount; i++) {
+    const uint8_t pct = fc.hourlyPrecipPct[i];
+    if (pct == kPrecipUnknown || pct == 0) continue;
+    const int16_t barH = static_cast<int16_t>(chartH * pct / 100);
+    g.fillRect(px(i), chartY + chartH - barH, max<int16_t>(1, chartW / fc.hourCount), barH,
+               kColorPrecip);
+  }
+
+  for (uint8_t i = 1; i < fc.hourCount; i++) {
+    const int16_t a = fc.hourlyTempC10[i - 1];
+    const int16_t b = fc.hourlyTempC10[i];
+    if (a == kTempUnknown || b == kTempUnknown) continue;
+    g.drawLine(px(i - 1), py(a), px(i), py(b), kColorAccent);
+  }
+
+  g.setTextColor(kColorMuted, kColorBg);
+  formatTempC10(hi, buf, sizeof(buf));
+  g.drawRightString(buf, chartX - 4, chartY, 1);
+  formatTempC10(lo, buf, sizeof(buf));
+  g.drawRightString(buf, chartX - 4, chartY + chartH - 8, 1);
+
+  for (uint8_t i = 0; i < fc.hourCount; i++) {
+    const uint32_t local = fc.hourlyStart + fc.utcOffsetSec + i * 3600UL;
+    const uint32_t hour = (local / 3600UL) % 24;
+    if (hour % 6 != 0) continue;
+    g.drawFastVLine(px(i), chartY + chartH, 3, kColorMuted);
+    snprintf(buf, sizeof(buf), "%02u", static_cast<unsigned>(hour));
+    g.drawCentreString(buf, px(i), chartY + chartH + 4, 1);
+  }
+}
 
-  M5.Lcd.drawString("Tip: press BtnA for portal.", 12, y, 2);
-  y += 20;
-  M5.Lcd.drawString(String("Build: ") + __DATE__ + " " + __TIME__, 12, y, 2);
+// Both blocks are custom widgets keyed by the shown site's forecast version, so they are
+// only repainted when it changes or another site comes up. They draw from the render task's
+// own copy of that site's forecast. With several sites, a line below names the one shown.
+static void composeForecastView() {
+  UiFrame& ui = gUiFrame.ui;
+  const int16_t w = M5.Lcd.width();
+  const int16_t y = kTopBarH + 8;
+  // Under the chart: which site, and how old the data is (fetched or confirmed unchanged).
+  const bool hasForecast = siteForecast(gUiForecast, gUiSite) != nullptr;
+  const bool aged = hasForecast && gUiWeather.policy.hasGood;
+  if (gSites.count > 1 || aged) {
+    char buf[64];
+    int n = 0;
+    if (gSites.count > 1) {
+      n = snprintf(buf,
+                   sizeof(buf),
+                   "%s  %u/%u%s",
+                   gSites.at[gUiSite].label,
+                   static_cast<unsigned>(gUiSite + 1),
+                   static_cast<unsigned>(gSites.count),
+                   aged ? "  " : "");
+    }
+    if (aged && n >= 0 && static_cast<size_t>(n) < sizeof(buf)) {
+      const FetchPolicyStats& ps = gUiWeather.policy;
+      snprintf(buf + n,
+               sizeof(buf) - n,
+               "updated %u min ago%s",
+               static_cast<unsigned>((millis() - ps.lastGoodMs) / 60000),
+               ps.failStreak ? ", retrying" : "");
+    }
+    ui.text(Rect{0, static_cast<int16_t>(y + kForecastDailyH + kForecastChartBlockH + 2), w, 8},
+            buf,
+            1,
+            kColorMuted,
+            kColorBg,
+            TextAlign::Centre);
+  }
+  if (!hasForecast) {
+    ui.text(Rect{0, static_cast<int16_t>(y + 60), w, 18}, "No forecast yet", 2, kColorMuted,
+            kColorBg, TextAlign::Centre);
+    return;
+  }
+  ui.custom(Rect{0, y, w, kForecastDailyH}, drawForecastDaily, gUiForecastKey);
+  ui.custom(Rect{0, static_cast<int16_t>(y + kForecastDailyH), w, kForecastChartBlockH},
+            drawForecastChart,
+            gUiForecastKey);
 }
 
 static uint8_t clampU8(int v, int lo, int hi) {
@@ -413,387 +1123,1092 @@ static uint8_t clampU8(int v, int lo, int hi) {
   return static_cast<uint8_t>(v);
 }
 
-static uint8_t getBatteryPercent() {
-  const float level = M5.Axp.GetBatteryLevel();  // 0..100
-  const int pct = static_cast<int>(level + 0.5f);
-  return clampU8(pct, 0, 100);
+// Same curve as M5.Axp.GetBatteryLevel(): linear from 3.12 V, 0 below 3.25 V.
+static uint8_t getBatteryPercent(uint16_t mv) {
+  if (mv < 3248) return 0;
+  return clampU8((mv - 3121 + 5) / 10, 0, 100);
 }
 
-static void batterySampleTick() {
-  const uint32_t now = millis();
-  if (gBatteryNextSampleMs != 0 && now < gBatteryNextSampleMs) return;
-  gBatteryNextSampleMs = now + 30000;
-
-  gBatteryPctCached = getBatteryPercent();
-  gBatteryChargingCached = M5.Axp.isCharging();
+// Takes a new AXP192 reading from the bus task, which samples every kBatterySampleMs.
+// Returns true when it differs from the cached one.
+static bool batterySampleTick() {
+  const uint32_t version = i2cPowerVersion();
+  if (version == gBatteryPowerVersion) return false;
+  gBatteryPowerVersion = version;
+
+  PowerReading power;
+  if (!i2cPower(power)) return false;
+  const uint8_t pct = getBatteryPercent(power.batteryMv);
+  powerNoteReading(power, pct);
+  dutyCycleNotePower(power, pct);
+  const bool charging = power.charging;
+  const bool changed =
+      !gBatteryCachedValid || pct != gBatteryPctCached || charging != gBatteryChargingCached;
+  gBatteryPctCached = pct;
+  gBatteryChargingCached = charging;
   gBatteryCachedValid = true;
+  return changed;
 }
 
-static void drawBatteryIcon(int16_t x, int16_t y, uint8_t pct, bool charging) {
-  const int16_t w = 28;
-  const int16_t h = 12;
-  const int16_t nubW = 3;
-  const int16_t nubH = 6;
-  const int16_t nubX = x + w;
-  const int16_t nubY = y + (h - nubH) / 2;
+static bool tickerScrolls() { return gTickerTextW > gTickerW; }
+
+// Measures gTickerText once and rasterizes it into the strip.
+static void tickerRebuild() {
+  gTickerDirty = false;
+  gTickerTextW = M5.Lcd.textWidth(gTickerText, 2);
+  gTickerScrollStartMs = millis();
+  gTickerLastOffset = -1;
 
-  const uint16_t outline = kColorMuted;
-  const uint16_t fillBg = kColorPanel;
-  const uint16_t fillFg = (pct <= 15) ? kColorBad : (pct <= 35 ? kColorWarn : kColorGood);
+  const int16_t stripW = tickerScrolls() ? static_cast<int16_t>(gTickerTextW + kTickerGap)
+                                         : gTickerW;
+  if (stripW > kTickerStripMaxW) {
+    gTickerStripOk = false;
+    return;
+  }
+  if (!gTickerStrip) {
+    gTickerStrip = new TFT_eSprite(&M5.Lcd);
+    gTickerStrip->setColorDepth(16);
+  }
+  if (!gTickerStripOk || stripW != gTickerStripW) {
+    gTickerStrip->deleteSprite();
+    gTickerStripOk = gTickerStrip->createSprite(stripW, gTickerH) != nullptr;
+    gTickerStripW = gTickerStripOk ? stripW : 0;
+    if (!gTickerStripOk) {
+      Serial.printf("[UI] Ticker strip %dx%d alloc failed\n", stripW, gTickerH);
+      return;
+    }
+  }
 
-  M5.Lcd.fillRect(x, y, w, h, fillBg);
-  M5.Lcd.drawRect(x, y, w, h, outline);
-  M5.Lcd.fillRect(nubX, nubY, nubW, nubH, outline);
+  gTickerStrip->fillSprite(kColorPanel);
+  gTickerStrip->setTextColor(kColorText, kColorPanel);
+  gTickerStrip->drawString(gTickerText, 0, (gTickerH - 16) / 2, 2);
+}
 
-  const int16_t innerX = x + 2;
-  const int16_t innerY = y + 2;
-  const int16_t innerW = w - 4;
-  const int16_t innerH = h - 4;
-  const int16_t filledW = static_cast<int16_t>((innerW * pct) / 100);
-  M5.Lcd.fillRect(innerX, innerY, innerW, innerH, fillBg);
-  if (filledW > 0) M5.Lcd.fillRect(innerX, innerY, filledW, innerH, fillFg);
+static int16_t tickerOffsetAt(uint32_t now) {
+  if (!tickerScrolls()) return 0;
+  const uint32_t period = static_cast<uint32_t>(gTickerTextW + kTickerGap);
+  // In `period` seconds the text moves by exactly TICKER_SPEED_PX_S periods, so the start
+  // can skip ahead by whole such cycles without a jump. That keeps the product below small
+  // however long the text stays the same.
+  const uint32_t cycleMs = period * 1000;
+  gTickerScrollStartMs += (now - gTickerScrollStartMs) / cycleMs * cycleMs;
+  const uint32_t px = (now - gTickerScrollStartMs) * TICKER_SPEED_PX_S / 1000;
+  return static_cast<int16_t>(px % period);
+}
 
-  if (charging) {
-    // Simple bolt overlay.
-    const int16_t bx = x + 12;
-    const int16_t by = y + 2;
-    M5.Lcd.drawLine(bx + 2, by, bx - 1, by + 5, kColorText);
-    M5.Lcd.drawLine(bx - 1, by + 5, bx + 2, by + 5, kColorText);
-    M5.Lcd.drawLine(bx + 2, by + 5, bx - 1, by + 10, kColorText);
+// Copies columns [offset, offset + gTickerW) of the strip (wrapping at its width) into the
+// footer window. Both sprites are 16-bit, so this is two memcpy per row at most.
+static void tickerBlitWindow(int16_t offset) {
+  const uint16_t* src = static_cast<const uint16_t*>(gTickerStrip->getPointer());
+  uint16_t* dst = static_cast<uint16_t*>(gTickerSprite->getPointer());
+  const int16_t first = min<int16_t>(gTickerW, static_cast<int16_t>(gTickerStripW - offset));
+  for (int16_t row = 0; row < gTickerH; row++) {
+    const uint16_t* s = src + row * gTickerStripW;
+    uint16_t* d = dst + row * gTickerW;
+    memcpy(d, s + offset, first * sizeof(uint16_t));
+    if (first < gTickerW) memcpy(d + first, s, (gTickerW - first) * sizeof(uint16_t));
   }
 }
 
-static void uiDrawFooterWeatherOnly(const char* weatherText) {
-  const int16_t w = M5.Lcd.width();
+// Draws the ticker at its current scroll position. Returns false when nothing moved.
+static bool uiDrawFooterTicker(bool force) {
+  PROF_SCOPE(ProfScope::Ticker);
+  if (gTickerDirty) {
+    tickerRebuild();
+    force = true;
+  }
 
-  const int16_t padX = 8;
-  const int16_t batX = static_cast<int16_t>(w - padX - 28 - 3);  // battery + nub
-  const int16_t textX0 = padX;
-  const int16_t textMaxW = static_cast<int16_t>(batX - padX - 8);
+  const int16_t offset = tickerOffsetAt(millis());
+  if (!force && offset == gTickerLastOffset) return false;
+  gTickerLastOffset = offset;
 
-  if (!gTickerSprite || gTickerW != textMaxW) {
+  if (!gTickerSprite) {
     // Fallback: draw directly without clipping.
     const int16_t textY = static_cast<int16_t>(gFooterRect.y + 5);
     M5.Lcd.setTextColor(kColorText, kColorPanel);
-    M5.Lcd.drawString(weatherText, textX0, textY, 2);
-    return;
+    M5.Lcd.drawString(gTickerText, gTickerRect.x, textY, 2);
+    return true;
   }
 
-  gTickerSprite->fillSprite(kColorPanel);
-  gTickerSprite->setTextColor(kColorText, kColorPanel);
-  const int16_t textY = static_cast<int16_t>((gTickerH - 16) / 2);
-  const int16_t textW = gTickerSprite->textWidth(weatherText, 2);
-
-  if (textW <= textMaxW) {
-    gTickerSprite->drawString(weatherText, 0, textY, 2);
-    gWeatherScrollPx = 0;
+  if (gTickerStripOk) {
+    tickerBlitWindow(offset);
   } else {
-    const int16_t gap = 24;
-    const int16_t total = textW + gap;
-    const int16_t scroll = gWeatherScrollPx % total;
-    gTickerSprite->drawString(weatherText, -scroll, textY, 2);
-    gTickerSprite->drawString(weatherText, -scroll + total, textY, 2);
+    // No strip (text too wide or out of memory): rasterize the visible part every frame.
+    const int16_t textY = static_cast<int16_t>((gTickerH - 16) / 2);
+    const int16_t period = static_cast<int16_t>(gTickerTextW + kTickerGap);
+    gTickerSprite->fillSprite(kColorPanel);
+    gTickerSprite->setTextColor(kColorText, kColorPanel);
+    gTickerSprite->drawString(gTickerText, -offset, textY, 2);
+    if (tickerScrolls()) gTickerSprite->drawString(gTickerText, -offset + period, textY, 2);
   }
 
-  gTickerSprite->pushSprite(textX0, gFooterRect.y + 1);
+  gTickerSprite->pushSprite(gTickerRect.x, gTickerRect.y);
+  gCompositor.notePush(static_cast<uint32_t>(gTickerRect.area()));
+  return true;
 }
 
-static void uiDrawFooterFull(bool forceFull) {
+// Panel with a rule on top and the battery gauge on the right. The ticker window is not a
+// widget: it is pushed on its own and repainted whenever a compositor frame covers it.
+static void composeFooter() {
   const int16_t w = M5.Lcd.width();
-  const int16_t h = M5.Lcd.height();
-
-  char weatherLocal[sizeof(gWeatherText)];
-  portENTER_CRITICAL(&gWeatherMux);
-  strncpy(weatherLocal, gWeatherText, sizeof(weatherLocal));
-  weatherLocal[sizeof(weatherLocal) - 1] = '\0';
-  portEXIT_CRITICAL(&gWeatherMux);
-
-  const uint8_t batPct = gBatteryCachedValid ? gBatteryPctCached : 0;
-  const bool charging = gBatteryCachedValid ? gBatteryChargingCached : false;
-
-  const bool batChanged = (static_cast<int8_t>(batPct) != gLastDrawnBatteryPct) ||
-                          (charging != gLastDrawnCharging);
-  if (!forceFull && !batChanged && strlen(weatherLocal) == 0) return;
-
-  M5.Lcd.fillRect(gFooterRect.x, gFooterRect.y, gFooterRect.w, gFooterRect.h, kColorPanel);
-  M5.Lcd.drawFastHLine(gFooterRect.x, gFooterRect.y, gFooterRect.w, kColorMuted);
-
   const int16_t padX = 8;
   const int16_t batX = static_cast<int16_t>(w - padX - 28 - 3);  // battery + nub
   const int16_t batY = static_cast<int16_t>(gFooterRect.y + (gFooterRect.h - 12) / 2);
-  drawBatteryIcon(batX, batY, batPct, charging);
 
-  uiDrawFooterWeatherOnly(weatherLocal);
+  UiFrame& ui = gUiFrame.ui;
+  ui.fill(Rect{gFooterRect.x, gFooterRect.y, gFooterRect.w, 1}, kColorMuted);
+  ui.fill(Rect{gFooterRect.x,
+               static_cast<int16_t>(gFooterRect.y + 1),
+               gFooterRect.w,
+               static_cast<int16_t>(gFooterRect.h - 1)},
+          kColorPanel);
 
-  gLastDrawnBatteryPct = static_cast<int8_t>(batPct);
-  gLastDrawnCharging = charging;
+  const uint8_t pct = gBatteryCachedValid ? gBatteryPctCached : 0;
+  const bool charging = gBatteryCachedValid ? gBatteryChargingCached : false;
+  const uint16_t level = (pct <= 15) ? kColorBad : (pct <= 35 ? kColorWarn : kColorGood);
+  ui.battery(Rect{batX, batY, 31, 12}, pct, charging, level, kColorMuted, kColorPanel,
+             kColorText);
 }
 
-static void uiDrawFull() {
-  M5.Lcd.fillScreen(kColorBg);
-  drawTopBar();
+// Declares every visible widget in a fixed order and hands the frame to the render task,
+// which repaints only what changed since the previous frame.
+static void uiCompose() {
+  PROF_SCOPE(ProfScope::Compose);
+  weatherRefreshUi();
+
+  gUiFrame.ui.clear();
+  uiTopBar();
   switch (gView) {
     case View::Status:
-      drawStatusView();
+      composeStatusView();
+      break;
+    case View::Forecast:
+      composeForecastView();
       break;
     case View::WiFi:
-      drawWiFiView();
+      composeWiFiView();
       break;
     case View::About:
-      drawAboutView();
+      composeAboutView();
+      break;
+#if PROFILER
+    case View::Diagnostics:
+      composeDiagView();
       break;
+#endif
+  }
+  composeFooter();
+  memcpy(gUiFrame.tickerText, gUiTickerText, sizeof(gUiFrame.tickerText));
+  gUiFrame.site = gUiSite;
+  gUiFrame.inputUs = gUiInputUs;
+
+  gRenderFrame.publish(gUiFrame);
+  gUiComposes++;
+  if (gRenderTask) xTaskNotifyGive(gRenderTask);
+}
+
+static void renderFrame(RenderStats& stats, uint32_t& lastInputUs) {
+  PROF_SCOPE(ProfScope::Render);
+  const uint32_t t0 = micros();
+
+  const uint8_t site = gRenderCopy.site;
+  gRenderForecastVersion = gForecasts[site].read(
+      gRenderForecast, site == gRenderSite ? gRenderForecastVersion : UINT32_MAX);
+  gRenderSite = site;
+  if (strcmp(gRenderCopy.tickerText, gTickerText) != 0) {
+    memcpy(gTickerText, gRenderCopy.tickerText, sizeof(gTickerText));
+    gTickerDirty = true;
   }
-  uiDrawFooterFull(true);
 
-  gLastDrawnView = gView;
-  gLastDrawnWifiState = gWifiState;
-  gLastDrawnSSID = WiFi.SSID();
-  gLastDrawnIP = WiFi.localIP().toString();
-  gLastDrawnRSSI = WiFi.RSSI();
-  gLastDrawnError = gLastError;
+#ifdef UI_COMPOSITOR_FULL_FRAME
+  gCompositor.invalidateAll();
+#endif
+  gCompositor.render(gRenderCopy.ui);
+  if (gCompositor.lastFrameTouched(gTickerRect)) uiDrawFooterTicker(true);
+
+  const uint32_t t1 = micros();
+  const uint32_t frameUs = t1 - t0;
+  stats.frames++;
+  stats.frameUsTotal += frameUs;
+  stats.frameUsAvg = stats.frames == 1 ? frameUs : (stats.frameUsAvg * 7 + frameUs) / 8;
+  stats.frameUsMax = max(stats.frameUsMax, frameUs);
+
+  if (gRenderCopy.inputUs != lastInputUs) {
+    lastInputUs = gRenderCopy.inputUs;
+    stats.latencyUsLast = t1 - lastInputUs;
+    stats.latencyUsMax = max(stats.latencyUsMax, stats.latencyUsLast);
+  }
 }
 
-static void clearLine(int16_t x, int16_t y, int16_t w) {
-  M5.Lcd.fillRect(x, y, w, 18, kColorBg);
+// Owns the panel: renders each newly published frame, and scrolls the ticker in between.
+static void renderTaskMain(void* param) {
+  (void)param;
+
+  RenderStats stats;
+  uint32_t frameVersion = 0;
+  uint32_t lastInputUs = 0;
+  gCompositor.invalidateAll();
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, gTickerPaused ? portMAX_DELAY : pdMS_TO_TICKS(kTickerFrameMs));
+    const uint32_t v = gRenderFrame.read(gRenderCopy, frameVersion);
+    if (v != frameVersion) {
+      frameVersion = v;
+      renderFrame(stats, lastInputUs);
+    }
+    if (frameVersion != 0) uiDrawFooterTicker(false);
+
+    stats.pixels = gCompositor.pixelsPushed();
+    stats.pushes = gCompositor.pushes();
+    gRenderStats.publish(stats);
+  }
 }
 
-static void uiUpdateDynamicStatus() {
-  const int16_t w = M5.Lcd.width();
-  const int16_t pillY = kTopBarH + 14;
+// Priority 2 on core 1: above loop(), so a slow Wi-Fi or I2C call there cannot stall
+// drawing, while DMA waits block and hand the core back to input handling.
+static void renderTaskStart() {
+  if (gRenderTask) return;
+  xTaskCreatePinnedToCore(
+      renderTaskMain, "render", kRenderTaskStack, nullptr, 2, &gRenderTask, 1);
+}
 
-  if (gWifiState != gLastDrawnWifiState) {
-    drawPill(12, pillY, w - 24, kStatusPillH, wifiStateColor(), wifiStateLabel());
-    gLastDrawnWifiState = gWifiState;
+// Logs what the render task pushed to the panel, to compare against full-frame redraws.
+// Every kUiStatsMs, over the window since the previous run (or setup()).
+static void uiStatsTick(uint32_t now) {
+  RenderStats st;
+  gRenderStats.read(st);
+  const uint32_t elapsedMs = now - gUiStatsStartMs;
+  if (gUiStatsStartMs != 0 && elapsedMs > 0) {
+    const uint32_t px = st.pixels - gUiStatsLast.pixels;
+    const uint32_t frame = static_cast<uint32_t>(M5.Lcd.width()) * M5.Lcd.height();
+    const uint32_t frames = st.frames - gUiStatsLast.frames;
+    const uint32_t avgUs =
+        frames ? static_cast<uint32_t>((st.frameUsTotal - gUiStatsLast.frameUsTotal) / frames)
+               : 0;
+    logPrintf("[UI] %u px/s (%u.%02u screens/s), %u composes, %u frames avg %u us"
+              " (max %u), %u pushes, input->photon %u ms (max %u)\n",
+              static_cast<unsigned>(px * 1000ULL / elapsedMs),
+              static_cast<unsigned>(px * 1000ULL / elapsedMs / frame),
+              static_cast<unsigned>(px * 100000ULL / elapsedMs / frame % 100),
+              static_cast<unsigned>(gUiComposes - gUiStatsComposes),
+              static_cast<unsigned>(frames),
+              static_cast<unsigned>(avgUs),
+              static_cast<unsigned>(st.frameUsMax),
+              static_cast<unsigned>(st.pushes - gUiStatsLast.pushes),
+              static_cast<unsigned>(st.latencyUsLast / 1000),
+              static_cast<unsigned>(st.latencyUsMax / 1000));
+
+    // Share of wall time loop() spent blocked waiting for work.
+    const uint32_t blockedPermille =
+        static_cast<uint32_t>(gLoopBlockedUs / (static_cast<uint64_t>(elapsedMs) + 1));
+    const EnvStats env = envStats();
+    logPrintf("[Env] %u samples, %u missed, %u late, %u errors, max lag %u ms\n",
+              static_cast<unsigned>(env.samples),
+              static_cast<unsigned>(env.missed),
+              static_cast<unsigned>(env.late),
+              static_cast<unsigned>(env.errors),
+              static_cast<unsigned>(env.maxLagMs));
+    // Compression against 4-byte timestamps and values, and flash bytes per encoded byte.
+    const TsStats ts = tsStats();
+    const uint32_t encoded = ts.encodedBytes + 1;
+    logPrintf("[TS] %u points, %u rollups, %u segments, %u B encoded (%u.%ux smaller),"
+              " %u KB written (WA %u.%u, ~%u blocks), %u dropped, %u rejected\n",
+              static_cast<unsigned>(ts.points),
+              static_cast<unsigned>(ts.rollups),
+              static_cast<unsigned>(ts.segments),
+              static_cast<unsigned>(ts.encodedBytes),
+              static_cast<unsigned>(ts.rawBytes / encoded),
+              static_cast<unsigned>(ts.rawBytes * 10ULL / encoded % 10),
+              static_cast<unsigned>(ts.fsBytes / 1024),
+              static_cast<unsigned>(ts.fsBytes / encoded),
+              static_cast<unsigned>(ts.fsBytes * 10ULL / encoded % 10),
+              static_cast<unsigned>(ts.fsBlocks),
+              static_cast<unsigned>(ts.dropped),
+              static_cast<unsigned>(ts.rejected));
+    const HttpApiStats hs = httpApiStats();
+    if (hs.requests > 0) {
+      logPrintf("[HTTP] %u requests, %u timeouts, %u send failures, max %u us\n",
+                static_cast<unsigned>(hs.requests),
+                static_cast<unsigned>(hs.timeouts),
+                static_cast<unsigned>(hs.sendFailures),
+                static_cast<unsigned>(hs.handleUsMax));
+    }
+    const MqttStats mq = mqttStats();
+    if (MQTT_HOST[0] != '\0') {
+      const uint32_t published = mq.published - gUiStatsMqttPublished;
+      logPrintf("[MQTT] %s, %u published (%u.%02u msg/s) in %u batches, queue %u (max %u),"
+                " %u dropped, last drain %u ms\n",
+                mq.connected ? "connected" : "offline",
+                static_cast<unsigned>(mq.published),
+                static_cast<unsigned>(published * 1000UL / elapsedMs),
+                static_cast<unsigned>(published * 100000UL / elapsedMs % 100),
+                static_cast<unsigned>(mq.batches),
+                static_cast<unsigned>(mq.queued),
+                static_cast<unsigned>(mq.queueMax),
+                static_cast<unsigned>(mq.dropped),
+                static_cast<unsigned>(mq.drainMsLast));
+    }
+    gUiStatsMqttPublished = mq.published;
+    // Internal bus: share of wall time held, then per class the jobs in this window, their
+    // average latency (due or requested until done) and the worst since boot.
+    const I2cStats i2c = i2cStats();
+    uint64_t i2cBusUs = 0;
+    uint32_t i2cErrors = 0;
+    char i2cLine[160];
+    size_t i2cLen = 0;
+    for (uint8_t i = 0; i < kI2cClassCount; i++) {
+      const I2cClassStats& cur = i2c.cls[i];
+      const I2cClassStats& last = gUiStatsI2c.cls[i];
+      const uint32_t jobs = cur.jobs - last.jobs;
+      i2cBusUs += cur.busUs - last.busUs;
+      i2cErrors += cur.errors;
+      const int n = snprintf(i2cLine + i2cLen,
+                             sizeof(i2cLine) - i2cLen,
+                             ", %s %u avg %u us (max %u)",
+                             i2cClassName(static_cast<I2cClass>(i)),
+                             static_cast<unsigned>(jobs),
+                             static_cast<unsigned>(
+                                 jobs ? (cur.latencyUsTotal - last.latencyUsTotal) / jobs : 0),
+                             static_cast<unsigned>(cur.latencyUsMax));
+      if (n > 0) i2cLen = min(sizeof(i2cLine) - 1, i2cLen + n);
+    }
+    gUiStatsI2c = i2c;
+    const uint32_t i2cPermille = static_cast<uint32_t>(i2cBusUs / (elapsedMs + 1ULL));
+    logPrintf("[I2C] bus %u.%u%% busy, %u errors%s\n",
+              static_cast<unsigned>(min<uint32_t>(i2cPermille, 1000) / 10),
+              static_cast<unsigned>(min<uint32_t>(i2cPermille, 1000) % 10),
+              static_cast<unsigned>(i2cErrors),
+              i2cLine);
+    const PowerGovernorStats ps = powerGovernorStats();
+    const PowerModeStats& pa = ps.modes[static_cast<uint8_t>(PowerMode::Active)];
+    const PowerModeStats& pd = ps.modes[static_cast<uint8_t>(PowerMode::Dimmed)];
+    logPrintf("[Power] %s at %u MHz, light sleep %s, %u mA now; active %u mA over %u min,"
+              " dimmed %u mA over %u min, est. runtime %u min\n",
+              powerModeName(ps.mode),
+              static_cast<unsigned>(ps.cpuMhz),
+              ps.lightSleep ? "on when dimmed" : "unavailable",
+              static_cast<unsigned>(ps.nowMa),
+              static_cast<unsigned>(pa.avgMa),
+              static_cast<unsigned>(pa.ms / 60000),
+              static_cast<unsigned>(pd.avgMa),
+              static_cast<unsigned>(pd.ms / 60000),
+              static_cast<unsigned>(ps.runtimeMin));
+    heapSample();
+    const HeapStats heap = heapStats();
+    logPrintf("[Heap] %u B free (min %u), largest block %u B (min %u), loop() allocs %u,"
+              " %u steady-state passes allocated\n",
+              static_cast<unsigned>(heap.freeBytes),
+              static_cast<unsigned>(heap.minFreeBytes),
+              static_cast<unsigned>(heap.largestBlock),
+              static_cast<unsigned>(heap.largestBlockMin),
+              static_cast<unsigned>(heap.watchedAllocs),
+              static_cast<unsigned>(heap.steadyViolations));
+    logPrintf("[Loop] %u.%02u wakeups/s, blocked %u.%u%%\n",
+              static_cast<unsigned>(gLoopWakeups * 1000UL / elapsedMs),
+              static_cast<unsigned>(gLoopWakeups * 100000UL / elapsedMs % 100),
+              static_cast<unsigned>(min<uint32_t>(blockedPermille, 1000) / 10),
+              static_cast<unsigned>(min<uint32_t>(blockedPermille, 1000) % 10));
+    timerReport(Serial);
   }
+  gUiStatsStartMs = now;
+  gUiStatsLast = st;
+  gUiStatsComposes = gUiComposes;
+  gLoopWakeups = 0;
+  gLoopBlockedUs = 0;
+}
 
-  if (WiFi.status() != WL_CONNECTED) return;
+// Governor mode and ticker follow the backlight. Leaving PowerMode::Dimmed happens before
+// anything else reacts to the input, so the response is composed at full speed.
+static void powerModeSet(PowerMode mode) {
+  if (mode == powerMode()) return;
+  powerSetMode(mode);
+  gTickerPaused = mode == PowerMode::Dimmed;
+  if (!gTickerPaused && gRenderTask) xTaskNotifyGive(gRenderTask);
+}
 
-  const int16_t y0 = pillY + kStatusPillH + 12;  // first row start
-  const int16_t valueX = kInfoValueX;
-  const int16_t valueW = w - kInfoValueX - 12;
+static void backlightSet(uint8_t level) {
+  if (level == gCurrentBrightness) return;
+  gCurrentBrightness = level;
+  // The Core2 backlight is an AXP192 rail, set over the internal I2C bus.
+  i2cBusRun(
+      I2cClass::Power,
+      [](void* value) { M5.Lcd.setBrightness(*static_cast<uint8_t*>(value)); },
+      &gCurrentBrightness);
+}
 
-  const String ssid = WiFi.SSID();
-  const String ip = WiFi.localIP().toString();
-  const int32_t rssi = WiFi.RSSI();
+// Any touch keeps the screen lit and restarts the dim countdown; only presses that change
+// something count as input for the input->photon latency.
+static void noteActivity() {
+  timerStart(gJobDim, kDimAfterMs + 1);
+  if (gCurrentBrightness == kBrightnessActive) return;
+  powerModeSet(PowerMode::Active);
+  backlightSet(kBrightnessActive);
+  if (!timerArmed(gJobSiteRotate)) timerStart(gJobSiteRotate, 0);  // paused while dimmed
+}
 
-  if (ssid != gLastDrawnSSID) {
-    clearLine(valueX, y0 + kInfoRowH, valueW);
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString(ssid, valueX, y0 + kInfoRowH, 2);
-    gLastDrawnSSID = ssid;
-  }
+static void noteInteraction() {
+  noteActivity();
+  gUiInputUs = micros();
+}
 
-  if (ip != gLastDrawnIP) {
-    clearLine(valueX, y0 + kInfoRowH * 2, valueW);
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString(ip, valueX, y0 + kInfoRowH * 2, 2);
-    gLastDrawnIP = ip;
-  }
+// Due kDimAfterMs after the last touch; noteActivity() pushes it back.
+static void dimTick(uint32_t now) {
+  (void)now;
+  PROF_SCOPE(ProfScope::Power);
+  powerModeSet(PowerMode::Dimmed);
+  backlightSet(kBrightnessDim);
+  if (kDutyCycle) timerStart(gJobDuty, kDutyIdleMs);
+}
 
-  if (rssi != gLastDrawnRSSI) {
-    clearLine(valueX, y0 + kInfoRowH * 3, valueW);
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString(String(rssi) + " dBm", valueX, y0 + kInfoRowH * 3, 2);
-    gLastDrawnRSSI = rssi;
-  }
+static const char* portalPasswordOrNull() {
+  return (strlen(PORTAL_AP_PASS) >= 8) ? PORTAL_AP_PASS : nullptr;
 }
 
-static void uiUpdateDynamicWiFi() {
-  const int16_t w = M5.Lcd.width();
-  const int16_t titleY = kTopBarH + 14;
-  const int16_t pillY = titleY + 34;
+static constexpr const char* kWeatherHost = "api.open-meteo.com";
+static constexpr uint16_t kWeatherPort = 443;
+static constexpr uint32_t kWeatherTaskStack = 8192;
+static constexpr uint32_t kWeatherConnectTimeoutMs = 8000;  // TCP connect + TLS handshake
+static constexpr uint16_t kWeatherReadTimeoutMs = 8000;     // per socket read
+static constexpr uint32_t kWeatherWatchdogMs = 45000;       // cancel a fetch stuck this long
+static constexpr uint32_t kWeatherRefreshMs = 30UL * 60UL * 1000UL;
+static constexpr uint32_t kWeatherRetryMinMs = 20000;  // first retry after a failure, ~10-20 s
+
+struct WeatherRequest {
+  uint32_t seq = 0;
+};
 
-  if (gWifiState != gLastDrawnWifiState) {
-    drawPill(12, pillY, w - 24, kWiFiPillH, wifiStateColor(), wifiStateLabel());
-    gLastDrawnWifiState = gWifiState;
-  }
+struct WeatherFetchTiming {
+  uint32_t handshakeMs = 0;  // 0 when the kept-alive connection was reused
+  uint32_t requestMs = 0;    // request sent until response headers parsed
+  bool reused = false;
+  int httpCode = 0;
+};
 
-  if (WiFi.status() != WL_CONNECTED) {
-    if (gWifiState == WifiState::Error && gLastError != gLastDrawnError) {
-      // Simplest: redraw the whole view when error text changes.
-      uiMarkDirty();
+static WeatherFetchTiming gWeatherLastTiming;
+
+// Worker-owned: retry backoff and the validators for conditional requests. setup() may
+// touch it before the worker starts.
+static FetchPolicy gWeatherPolicy(kWeatherRefreshMs, kWeatherRetryMinMs);
+
+// Worker-owned: the sites the current request is for. Forecasts are published under their
+// coordinates, so a list edited mid-fetch cannot mislabel one.
+static WeatherLocations gWorkerSites;
+static uint32_t gWorkerSitesVersion = 0;
+
+// Base URL plus a comma-separated coordinate list: up to ~20 characters per site.
+static constexpr size_t kWeatherUrlMax = 352 + 20 * kWeatherLocationsMax;
+
+static bool weatherCancelled() { return gWeatherCancel.load(std::memory_order_relaxed); }
+
+// Sends one GET on the worker's long-lived connection. A fresh TCP+TLS session is only
+// opened when the previous one was closed by either side.
+static int weatherSendRequest(WiFiClientSecure& client,
+                              HTTPClient& https,
+                              const char* url,
+                              WeatherFetchTiming& timing) {
+  timing = WeatherFetchTiming{};
+  timing.reused = client.connected();
+  if (!timing.reused) {
+    client.stop();
+    const uint32_t t0 = millis();
+    if (!client.connect(kWeatherHost, kWeatherPort, kWeatherConnectTimeoutMs)) {
+      return HTTPC_ERROR_CONNECTION_REFUSED;
     }
-    return;
+    timing.handshakeMs = millis() - t0;
+  }
+  if (weatherCancelled()) return HTTPC_ERROR_CONNECTION_LOST;
+
+  if (!https.begin(client, url)) return HTTPC_ERROR_CONNECTION_REFUSED;
+  static const char* kHeaderKeys[] = {"Transfer-Encoding", "ETag", "Last-Modified", "Retry-After"};
+  // Also clears values left from the previous response.
+  https.collectHeaders(kHeaderKeys, sizeof(kHeaderKeys) / sizeof(kHeaderKeys[0]));
+  if (gWeatherPolicy.etag()[0] != '\0') https.addHeader("If-None-Match", gWeatherPolicy.etag());
+  if (gWeatherPolicy.lastModified()[0] != '\0') {
+    https.addHeader("If-Modified-Since", gWeatherPolicy.lastModified());
   }
 
-  const int16_t y0 = pillY + kWiFiPillH + 12;
-  const int16_t valueX = kInfoValueX;
-  const int16_t valueW = w - kInfoValueX - 12;
+  const uint32_t t1 = millis();
+  const int code = https.GET();
+  timing.requestMs = millis() - t1;
+  timing.httpCode = code;
+  return code;
+}
 
-  const String ssid = WiFi.SSID();
-  const String ip = WiFi.localIP().toString();
+static constexpr uint32_t kUnixAt2000 = 946684800UL;
+
+// Seconds since 2000-01-01: UTC once the wall clock is set, before that the battery-backed
+// BM8563's own count, or 0 if it reads garbage. Callers only take differences, so an RTC
+// that was never set still works. The bus task reads the chip every kRtcSyncMs; millis()
+// covers the time since.
+static uint32_t rtcNowSec() {
+  uint32_t unixSec;
+  if (wallClockNow(unixSec) && unixSec > kUnixAt2000) return unixSec - kUnixAt2000;
+  RtcReading rtc;
+  if (!i2cRtc(rtc) || !rtc.valid || rtc.year < 2000 || rtc.year > 2099) return 0;
+  return rtcUnixSec(rtc) - kUnixAt2000 + (millis() - rtc.ms) / 1000;
+}
 
-  if (ssid != gLastDrawnSSID) {
-    clearLine(valueX, y0, valueW);
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString(ssid, valueX, y0, 2);
-    gLastDrawnSSID = ssid;
+// Publishes the outcome of a fetch; the forecasts themselves went out as they were parsed,
+// and a site that failed keeps its previous one on display. `fetchMs` is 0 when nothing was
+// fetched. Only one task publishes at a time: setup() before the worker starts, then the
+// worker.
+static void weatherPublish(bool ok, int status, uint32_t nextFetchMs, uint32_t fetchMs) {
+  WeatherState st;
+  gWeather.read(st);
+  st.status = status;
+  if (fetchMs != 0) {
+    st.fetches++;
+    if (!ok) st.fetchFailures++;
+    st.fetchMsLast = fetchMs;
+    st.fetchMsTotal += fetchMs;
   }
+  st.policy = gWeatherPolicy.stats();
+  gWeather.publish(st);
+  gWeatherNextFetchMs = nextFetchMs;
+}
 
-  if (ip != gLastDrawnIP) {
-    clearLine(valueX, y0 + kInfoRowH, valueW);
-    M5.Lcd.setTextColor(kColorText, kColorBg);
-    M5.Lcd.drawString(ip, valueX, y0 + kInfoRowH, 2);
-    gLastDrawnIP = ip;
-  }
+// Parser sink: publishes one site's forecast the moment it is decoded.
+static void weatherPublishSite(uint8_t index, const ForecastStore& fc) {
+  SiteForecast f;
+  f.forecast = fc;
+  f.latE4 = gWorkerSites.at[index].latE4;
+  f.lonE4 = gWorkerSites.at[index].lonE4;
+  gForecasts[index].publish(f);
 }
 
-static void uiUpdateDynamic() {
-  if (gView != gLastDrawnView) {
-    uiMarkDirty();
+static void weatherHandleRequest(WiFiClientSecure& client, HTTPClient& https, const char* url) {
+  const uint32_t startMs = millis();
+  bool parsed = false;
+  uint8_t decoded = 0;
+  int status = kWeatherStatusParseError;
+
+  // Heap low-water mark across the fetch (TLS buffers + JSON document).
+  const uint32_t heapBefore = ESP.getFreeHeap();
+  uint32_t heapLow = heapBefore;
+  auto sampleHeap = [&heapLow]() { heapLow = min(heapLow, ESP.getFreeHeap()); };
+
+  WeatherFetchTiming timing;
+  int httpCode = weatherSendRequest(client, https, url, timing);
+  if (httpCode < 0 && timing.reused && !weatherCancelled()) {
+    // The server may have dropped the idle keep-alive connection; retry once on a new one.
+    https.end();
+    client.stop();
+    httpCode = weatherSendRequest(client, https, url, timing);
+  }
+  sampleHeap();
+
+  bool reusable = false;
+  if (httpCode == 200) {
+    const bool chunked = https.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+    HttpBodyStream body(https.getStream(), https.getSize(), chunked, &gWeatherCancel);
+    WeatherParseStats stats;
+    parsed = weatherParseStream(body, gWorkerSites.count, weatherPublishSite, stats);
+    decoded = stats.locations;
+    reusable = body.drain();
+    sampleHeap();
+    Serial.printf("[Weather] %u/%u sites, %u B (%u B past capacity) in %u ms, doc peak %u B, "
+                  "heap peak %u B, stack peak %u B%s%s\n",
+                  static_cast<unsigned>(stats.locations),
+                  static_cast<unsigned>(gWorkerSites.count),
+                  static_cast<unsigned>(stats.bytesRead),
+                  static_cast<unsigned>(stats.bytesSkipped),
+                  static_cast<unsigned>(stats.parseMs),
+                  static_cast<unsigned>(stats.docPeakBytes),
+                  static_cast<unsigned>(heapBefore - heapLow),
+                  static_cast<unsigned>(kWeatherTaskStack - uxTaskGetStackHighWaterMark(nullptr)),
+                  parsed ? "" : ", error: ",
+                  stats.error);
+    if (parsed) {
+      status = httpCode;
+      gWeatherPolicy.setValidators(https.header("ETag").c_str(),
+                                   https.header("Last-Modified").c_str());
+    }
+  } else {
+    // A 304 carries no body, so the connection stays usable.
+    reusable = httpCode == HTTP_CODE_NOT_MODIFIED;
+    status = httpCode;
+  }
+  const uint32_t retryAfterMs =
+      httpCode > 0 ? fetchParseRetryAfterMs(https.header("Retry-After").c_str()) : 0;
+  https.end();
+  if (!reusable) client.stop();
+
+  gWeatherLastTiming = timing;
+  Serial.printf("[Weather] HTTP %d, handshake %u ms%s, request %u ms\n",
+                httpCode,
+                static_cast<unsigned>(timing.handshakeMs),
+                timing.reused ? " (reused)" : "",
+                static_cast<unsigned>(timing.requestMs));
+
+  if (weatherCancelled()) {
+    // Link dropped mid-fetch: keep the last forecast and fetch again once reconnected.
+    Serial.println("[Weather] Fetch cancelled");
+    client.stop();
+    gWeatherNextFetchMs = 0;
     return;
   }
+  FetchOutcome outcome = FetchOutcome::Failed;
+  if (parsed) {
+    outcome = FetchOutcome::Updated;
+  } else if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+    outcome = FetchOutcome::NotModified;
+  }
+  const uint32_t nowMs = millis();
+  uint32_t unixSec = 0;
+  wallClockNow(unixSec);  // stays 0 while the clock is unset
+  const uint32_t delayMs = gWeatherPolicy.record(outcome, nowMs, retryAfterMs, unixSec);
+  if (outcome == FetchOutcome::Failed) {
+    Serial.printf("[Weather] Failure %u in a row, retry in %u s\n",
+                  static_cast<unsigned>(gWeatherPolicy.stats().failStreak),
+                  static_cast<unsigned>(delayMs / 1000));
+  }
+  weatherPublish(outcome != FetchOutcome::Failed,
+                 status,
+                 nowMs + delayMs,
+                 max<uint32_t>(nowMs - startMs, 1));
+  if (decoded > 0) gWeatherSavePending = true;
+}
 
-  switch (gView) {
-    case View::Status:
-      uiUpdateDynamicStatus();
-      break;
-    case View::WiFi:
-      uiUpdateDynamicWiFi();
-      break;
-    case View::About:
-      break;
+// Picks up a changed site list and rebuilds the request URL for it: every site in one
+// request, each resolved to its own time zone.
+static void weatherWorkerSync(char* url, size_t len) {
+  const uint32_t v = gSitesShared.read(gWorkerSites, gWorkerSitesVersion);
+  if (v == gWorkerSitesVersion && url[0] != '\0') return;
+  gWorkerSitesVersion = v;
+  gWeatherPolicy.clearValidators();
+  const int n = snprintf(
+      url,
+      len,
+      "https://%s/v1/forecast?current=temperature_2m,weather_code"
+      "&daily=temperature_2m_max,temperature_2m_min,weather_code,precipitation_probability_max"
+      "&hourly=temperature_2m,weather_code,precipitation_probability"
+      "&forecast_days=%u&forecast_hours=%u&timeformat=unixtime&timezone=auto",
+      kWeatherHost,
+      static_cast<unsigned>(kForecastDays),
+      static_cast<unsigned>(kForecastHours));
+  if (n > 0 && static_cast<size_t>(n) < len) {
+    weatherLocationsQuery(gWorkerSites, url + n, len - n);
   }
 }
 
-static void noteInteraction() { gLastInteractionMs = millis(); }
+// Long-lived network worker: owns the TLS client and serves fetch requests from the queue.
+static void weatherTaskMain(void* param) {
+  (void)param;
 
-static void powerTick() {
-  const uint32_t now = millis();
-  const bool shouldDim = (now - gLastInteractionMs) > kDimAfterMs;
-  const uint8_t target = shouldDim ? kBrightnessDim : kBrightnessActive;
-  if (target != gCurrentBrightness) {
-    M5.Lcd.setBrightness(target);
-    gCurrentBrightness = target;
+  WiFiClientSecure client;
+  client.setInsecure();
+  client.setHandshakeTimeout(kWeatherConnectTimeoutMs / 1000);
+  client.setTimeout(kWeatherReadTimeoutMs / 1000);  // seconds on arduino-esp32 2.x
+
+  HTTPClient https;
+  https.setReuse(true);
+  https.setConnectTimeout(kWeatherConnectTimeoutMs);
+  https.setTimeout(kWeatherReadTimeoutMs);
+
+  char url[kWeatherUrlMax] = "";
+  WeatherRequest req;
+  for (;;) {
+    if (xQueueReceive(gWeatherQueue, &req, portMAX_DELAY) != pdTRUE) continue;
+    if (weatherCancelled()) {
+      client.stop();
+    } else {
+      weatherWorkerSync(url, sizeof(url));
+      weatherHandleRequest(client, https, url);
+    }
+    gWeatherFetchPending = false;
+    loopSignal(kLoopEvtWeather);
   }
 }
 
-static const char* wmoCodeToShortText(int code) {
-  // WMO weather interpretation codes (subset).
-  if (code == 0) return "Clear";
-  if (code <= 2) return "Mostly clear";
-  if (code == 3) return "Cloudy";
-  if (code == 45 || code == 48) return "Fog";
-  if (code >= 51 && code <= 57) return "Drizzle";
-  if (code >= 61 && code <= 67) return "Rain";
-  if (code >= 71 && code <= 77) return "Snow";
-  if (code >= 80 && code <= 82) return "Showers";
-  if (code >= 85 && code <= 86) return "Snow showers";
-  if (code >= 95) return "Thunder";
-  return "Weather";
+static void weatherWorkerStart() {
+  if (gWeatherTask) return;
+  gWeatherQueue = xQueueCreate(1, sizeof(WeatherRequest));
+  xTaskCreatePinnedToCore(
+      weatherTaskMain, "weather", kWeatherTaskStack, nullptr, 1, &gWeatherTask, 0);
 }
 
-static const char* portalPasswordOrNull() {
-  return (strlen(PORTAL_AP_PASS) >= 8) ? PORTAL_AP_PASS : nullptr;
+// Fetch slots every kWeatherRefreshMs, WEATHER_FETCH_OFFSET_MIN past the half hour, each
+// station up to kWeatherSlotSpreadSec later. Before the worker starts and the cache restore.
+static constexpr uint32_t kWeatherSlotSpreadSec = 90;
+
+static void weatherPolicyBegin() {
+  gWeatherPolicy.seed(esp_random());
+  gWeatherPolicy.setSlots(
+      kWeatherRefreshMs / 1000, WEATHER_FETCH_OFFSET_MIN * 60UL, kWeatherSlotSpreadSec);
 }
 
-static void weatherTaskMain(void* param) {
-  (void)param;
+// Called when the link drops: aborts the in-flight fetch at its next read, or drops the
+// queued request unserved. Socket timeouts bound how long the worker can stay blocked.
+static void weatherCancel() {
+  if (!gWeatherFetchPending) return;
+  gWeatherCancel = true;
+}
 
-  char out[sizeof(gWeatherText)] = {0};
-  snprintf(out, sizeof(out), "%s weather: update failed", WEATHER_LABEL);
+// The build's list: WEATHER_LOCATIONS, or the single WEATHER_LABEL site.
+static void weatherSitesDefault(WeatherLocations& list) {
+  list.count = 0;
+  const char* error = "";
+  if (WEATHER_LOCATIONS[0] != '\0') {
+    if (weatherLocationsParse(WEATHER_LOCATIONS, list, error)) return;
+    Serial.printf("[Loc] WEATHER_LOCATIONS: %s\n", error);
+  }
+  WeatherLocation& home = list.at[0];
+  snprintf(home.label, sizeof(home.label), "%s", WEATHER_LABEL);
+  home.latE4 = static_cast<int32_t>(lroundf(WEATHER_LATITUDE * 10000.0f));
+  home.lonE4 = static_cast<int32_t>(lroundf(WEATHER_LONGITUDE * 10000.0f));
+  list.count = 1;
+}
 
-  WiFiClientSecure client;
-  client.setInsecure();
+static void weatherSitesLog() {
+  char buf[kWeatherLocationsMax * kWeatherSiteTextMax];
+  weatherLocationsFormat(gSites, buf, sizeof(buf));
+  Serial.print("[Loc] ");
+  Serial.println(buf);  // printf() would allocate for a line this long
+}
 
-  HTTPClient https;
-  char url[256];
-  snprintf(url,
-           sizeof(url),
-           "https://api.open-meteo.com/v1/forecast?latitude=%.4f&longitude=%.4f&current="
-           "temperature_2m,weather_code&daily=temperature_2m_max,temperature_2m_min,weather_code&"
-           "forecast_days=1&timezone=Europe%%2FCopenhagen",
-           static_cast<double>(WEATHER_LATITUDE),
-           static_cast<double>(WEATHER_LONGITUDE));
-
-  if (https.begin(client, url)) {
-    const int httpCode = https.GET();
-    if (httpCode == 200) {
-      const String payload = https.getString();
-      StaticJsonDocument<4096> doc;
-      const DeserializationError err = deserializeJson(doc, payload);
-      if (!err) {
-        const float temp = doc["current"]["temperature_2m"] | NAN;
-        const int code = doc["current"]["weather_code"] | -1;
-
-        const float tmax = doc["daily"]["temperature_2m_max"][0] | NAN;
-        const float tmin = doc["daily"]["temperature_2m_min"][0] | NAN;
-        const int dcode = doc["daily"]["weather_code"][0] | -1;
-
-        if (!isnan(temp)) {
-          snprintf(out,
-                   sizeof(out),
-                   "%s: %.0f°C %s | Today %.0f–%.0f°C %s",
-                   WEATHER_LABEL,
-                   static_cast<double>(temp),
-                   wmoCodeToShortText(code),
-                   static_cast<double>(tmin),
-                   static_cast<double>(tmax),
-                   wmoCodeToShortText(dcode));
-        }
-      } else {
-        snprintf(out, sizeof(out), "%s weather: parse error", WEATHER_LABEL);
-      }
-    } else {
-      snprintf(out, sizeof(out), "%s weather: HTTP %d", WEATHER_LABEL, httpCode);
+// Makes `list` the site list: the worker picks it up with the next request, which
+// weatherTick() sends right away.
+static void weatherSitesApply(const WeatherLocations& list) {
+  gSites = list;
+  gSitesShared.publish(gSites);
+  weatherShowSite(gUiSite);
+  uiMarkDirty();
+  timerStart(gJobWeather, 0);
+}
+
+// The saved list, else the build's. The restored cache belongs to it, so it does not count
+// as an edit.
+static void weatherSitesBegin() {
+  if (!weatherLocationsLoad(gSites)) weatherSitesDefault(gSites);
+  gSitesShared.publish(gSites);
+  gWeatherQueuedSitesVersion = gSitesShared.version();
+  weatherSitesLog();
+}
+
+// Shows the forecasts saved by the previous boot and, if the RTC says they are all still
+// fresh, defers the first fetch until it would have been due anyway. A slot saved for
+// another site (the list changed since) is skipped.
+static void weatherCacheRestore() {
+  uint8_t restored = 0;
+  uint32_t oldestSec = UINT32_MAX;
+  for (uint8_t i = 0; i < gSites.count; i++) {
+    WeatherCacheEntry entry;
+    if (!weatherCacheLoad(i, entry) || !gSites.at[i].sameSite(entry.latE4, entry.lonE4)) {
+      continue;
     }
-    https.end();
+    SiteForecast f;
+    f.forecast = entry.forecast;
+    f.latE4 = entry.latE4;
+    f.lonE4 = entry.lonE4;
+    gForecasts[i].publish(f);
+    restored++;
+    oldestSec = min(oldestSec, entry.savedAtSec);
+  }
+  if (restored == 0) return;
+
+  const uint32_t nowSec = rtcNowSec();
+  const bool clockOk = nowSec != 0 && oldestSec != 0 && nowSec >= oldestSec;
+  const uint32_t ageSec = clockOk ? nowSec - oldestSec : UINT32_MAX;
+  // On the wall clock the cache stays fresh until the first fetch slot after it was saved.
+  uint32_t unixSec;
+  const uint32_t refreshSec = wallClockNow(unixSec)
+                                  ? gWeatherPolicy.slotDelaySec(oldestSec + kUnixAt2000)
+                                  : kWeatherRefreshMs / 1000;
+  const bool fresh = ageSec < refreshSec && restored == gSites.count;
+
+  // Counts toward the data age as if fetched then; the bound keeps ageSec * 1000 in range.
+  if (ageSec < 30UL * 86400UL) gWeatherPolicy.noteGood(millis() - ageSec * 1000UL);
+  weatherPublish(true,
+                 kWeatherStatusNone,
+                 fresh ? millis() + (refreshSec - ageSec) * 1000UL : 0,
+                 0);
+
+  if (clockOk) {
+    Serial.printf("[Weather] Restored %u/%u sites, age %u s (%s)\n",
+                  static_cast<unsigned>(restored),
+                  static_cast<unsigned>(gSites.count),
+                  static_cast<unsigned>(ageSec),
+                  fresh ? "fresh" : "stale");
   } else {
-    snprintf(out, sizeof(out), "%s weather: TLS init failed", WEATHER_LABEL);
+    Serial.printf("[Weather] Restored %u/%u sites, age unknown\n",
+                  static_cast<unsigned>(restored),
+                  static_cast<unsigned>(gSites.count));
   }
+}
 
-  portENTER_CRITICAL(&gWeatherMux);
-  strncpy(gWeatherText, out, sizeof(gWeatherText));
-  gWeatherText[sizeof(gWeatherText) - 1] = '\0';
-  gWeatherHasData = true;
-  gWeatherNextFetchMs = millis() + (30UL * 60UL * 1000UL);
-  gWeatherScrollPx = 0;
-  portEXIT_CRITICAL(&gWeatherMux);
+static void weatherCacheSaveTick() {
+  if (!gWeatherSavePending) return;
+  gWeatherSavePending = false;
+
+  WeatherCacheEntry entry;
+  SiteForecast f;
+  entry.savedAtSec = rtcNowSec();
+  for (uint8_t i = 0; i < gSites.count; i++) {
+    gForecasts[i].read(f);
+    if (!siteForecast(f, i)) continue;
+    entry.forecast = f.forecast;
+    entry.latE4 = f.latE4;
+    entry.lonE4 = f.lonE4;
+    if (!weatherCacheSave(i, entry)) {
+      Serial.println("[Weather] Cache save failed");
+      return;
+    }
+  }
+}
 
-  gWeatherTaskRunning = false;
-  gWeatherTask = nullptr;
-  vTaskDelete(nullptr);
+// Moves the Forecast view and the ticker on to the next site; weatherShowSite() arms it.
+// Paused while dimmed, like the ticker's scrolling, until noteActivity() restarts it.
+static void siteRotateTick(uint32_t now) {
+  (void)now;
+  if (gSites.count < 2 || gCurrentBrightness == kBrightnessDim) return;
+  weatherShowSite(static_cast<uint8_t>((gUiSite + 1) % gSites.count));
+  uiMarkDirty();
 }
 
-static void weatherTick() {
+// Started by the worker finishing, Wi-Fi events and site list edits; otherwise due at the
+// deadline it set itself: the watchdog while a fetch is out, else the next fetch.
+static void weatherTick(uint32_t now) {
+  PROF_SCOPE(ProfScope::Weather);
+  weatherCacheSaveTick();
   if (WiFi.status() != WL_CONNECTED) return;
-  if (gWeatherTaskRunning) return;
+  if (!gWeatherQueue) return;
+
+  if (gWeatherFetchPending) {
+    if (weatherCancelled()) return;  // the worker's reply starts this job again
+    const uint32_t overdueMs = gWeatherFetchStartMs + kWeatherWatchdogMs;
+    if (timeReached(now, overdueMs)) {
+      Serial.println("[Weather] Fetch overdue; cancelling");
+      weatherCancel();
+      return;
+    }
+    timerStartAt(gJobWeather, overdueMs);
+    return;
+  }
 
-  const uint32_t now = millis();
-  if (gWeatherNextFetchMs != 0 && now < gWeatherNextFetchMs) return;
+  // An edited site list is fetched right away.
+  const uint32_t nextFetchMs =
+      gSitesShared.version() == gWeatherQueuedSitesVersion ? gWeatherNextFetchMs.load() : 0;
+  if (nextFetchMs != 0 && !timeReached(now, nextFetchMs)) {
+    timerStartAt(gJobWeather, nextFetchMs);
+    return;
+  }
 
-  gWeatherTaskRunning = true;
-  xTaskCreatePinnedToCore(weatherTaskMain, "weather", 8192, nullptr, 1, &gWeatherTask, 0);
+  static uint32_t seq = 0;
+  WeatherRequest req;
+  req.seq = ++seq;
+  gWeatherCancel = false;
+  gWeatherFetchPending = true;
+  gWeatherFetchStartMs = now;
+  gWeatherQueuedSitesVersion = gSitesShared.version();
+  if (xQueueSend(gWeatherQueue, &req, 0) != pdTRUE) gWeatherFetchPending = false;
+  timerStart(gJobWeather, kWeatherWatchdogMs);
 }
 
-static void footerTick() {
-  const uint32_t now = millis();
-  if (now < gFooterNextTickMs) return;
-  gFooterNextTickMs = now + 250;
+// Feeds the station history with each new BME680 sample and each freshly fetched current
+// temperature. Timestamps come from the RTC, which only this task reads.
+static constexpr uint32_t kHistoryReportMs = 600000;
+static uint32_t gHistoryEnvNext = 0;  // number of the next BME680 sample to store
+static uint32_t gHistoryWeatherTime = 0;
+
+static void formatC100(int32_t c100, char* out, size_t len) {
+  snprintf(out,
+           len,
+           "%s%d.%02d",
+           c100 < 0 ? "-" : "",
+           static_cast<int>(abs(c100) / 100),
+           static_cast<int>(abs(c100) % 100));
+}
 
-  char weatherLocal[sizeof(gWeatherText)];
-  portENTER_CRITICAL(&gWeatherMux);
-  strncpy(weatherLocal, gWeatherText, sizeof(weatherLocal));
-  weatherLocal[sizeof(weatherLocal) - 1] = '\0';
-  portEXIT_CRITICAL(&gWeatherMux);
+// Logs the room temperature range over the last day and week, with each query's time.
+static void historyReport(uint32_t nowSec) {
+  static constexpr uint32_t kSpans[] = {86400UL, 7 * 86400UL};
+  for (const uint32_t span : kSpans) {
+    TsSummary sum;
+    if (!tsSummarize(TsSeries::RoomTemp, nowSec - span, nowSec, sum)) continue;
+    char lo[16];
+    char hi[16];
+    char mean[16];
+    formatC100(sum.min, lo, sizeof(lo));
+    formatC100(sum.max, hi, sizeof(hi));
+    formatC100(sum.mean, mean, sizeof(mean));
+    logPrintf("[TS] Room %ud: %s..%s °C (mean %s) over %u points, query %u us\n",
+              static_cast<unsigned>(span / 86400UL),
+              lo,
+              hi,
+              mean,
+              static_cast<unsigned>(sum.count),
+              static_cast<unsigned>(tsStats().queryUsLast));
+  }
+}
 
-  const int16_t w = M5.Lcd.width();
-  const int16_t padX = 8;
-  const int16_t batX = static_cast<int16_t>(w - padX - 28 - 3);
-  const int16_t textMaxW = static_cast<int16_t>(batX - padX - 8);
-  const int16_t textW = M5.Lcd.textWidth(weatherLocal, 2);
-  const bool shouldScroll = textW > textMaxW;
-  if (shouldScroll) gWeatherScrollPx += 2;
+// On the live-value grid.
+static void historyTick(uint32_t now) {
+  (void)now;
+  liveRearm(gJobHistory);
+  const bool newEnv = envStats().samples != gHistoryEnvNext;
+  const ForecastStore* fc = homeForecast();
+  const bool newWeather = fc && weatherStatusOk(gUiWeather.status) &&
+                          fc->currentTime != gHistoryWeatherTime &&
+                          fc->currentTempC10 != kTempUnknown;
+  if (!newEnv && !newWeather) return;
+
+  const uint32_t nowSec = rtcNowSec();
+  if (nowSec == 0) return;
+  // The samples since the last one stored, from the sensor's ring, so none are lost while
+  // the clock is unset or this job runs late (for as long as the ring holds them). A few
+  // per pass, so a backlog does not overflow the store's queue.
+  EnvSample batch[4];
+  const size_t n = newEnv ? envHistory(gHistoryEnvNext, batch, 4) : 0;
+  const uint32_t nowMs = millis();  // after the copy, so no sample is newer
+  for (size_t i = 0; i < n; i++) {
+    const EnvSample& env = batch[i];
+    const uint32_t ts = nowSec - (nowMs - env.ms) / 1000;
+    tsAppend(TsSeries::RoomTemp, ts, env.tempC100);
+    tsAppend(TsSeries::RoomHumidity, ts, env.humidityPermille);
+    tsAppend(TsSeries::RoomPressure, ts, static_cast<int32_t>(env.pressurePa));
+    if (env.gasOhm != 0) tsAppend(TsSeries::RoomGas, ts, static_cast<int32_t>(env.gasOhm));
+  }
+  if (newWeather) {
+    gHistoryWeatherTime = fc->currentTime;
+    tsAppend(TsSeries::OutdoorTemp, nowSec, fc->currentTempC10);
+  }
+}
+
+// Every kHistoryReportMs.
+static void historyReportTick(uint32_t now) {
+  (void)now;
+  const uint32_t nowSec = rtcNowSec();
+  if (nowSec != 0) historyReport(nowSec);
+}
+
+// Serves the HTTP API while the STA link is up (see linkTick()). loop() state is
+// republished on the live-value grid, so it is up to 10 s old while the screen is dimmed.
+static void apiTick(uint32_t now) {
+  (void)now;
+  liveRearm(gJobApi);
+  if (gWifiState != WifiState::Connected) return;
+
+  RenderStats rs;
+  gRenderStats.read(rs);
+  ApiState st = {};
+  snprintf(st.label, sizeof(st.label), "%s", gSites.at[0].label);
+  if (const ForecastStore* fc = homeForecast()) {
+    st.forecast = *fc;
+  } else {
+    forecastClear(st.forecast);
+  }
+  st.weatherStatus = gUiWeather.status;
+  st.fetches = gUiWeather.fetches;
+  st.fetchFailures = gUiWeather.fetchFailures;
+  st.fetchNotModified = gUiWeather.policy.notModified;
+  st.fetchMsLast = gUiWeather.fetchMsLast;
+  st.fetchMsTotal = gUiWeather.fetchMsTotal;
+  st.fetchSuccessPermille = gUiWeather.policy.successPermille;
+  st.fetchFailStreak = gUiWeather.policy.failStreak;
+  st.dataGood = gUiWeather.policy.hasGood;
+  st.dataGoodMs = gUiWeather.policy.lastGoodMs;
+  st.rssi = static_cast<int8_t>(WiFi.RSSI());
+  st.wifiJoinMs = gJoinMs;
+  st.wifiJoinFast = gJoinWasFast;
+  st.batteryPct = gBatteryPctCached;
+  st.charging = gBatteryChargingCached;
+  if (kDutyCycle) {
+    const DutyCycleStats ds = dutyCycleStats();
+    st.dutyCycle = true;
+    st.dutyCycles = ds.cycles;
+    st.dutyAwakeMsLast = ds.awakeMsLast;
+    st.dutyAwakeMsAvg = ds.awakeMsAvg;
+    st.dutyDrainMaX10 = ds.drainMaX10;
+    st.dutyBatteryDaysX10 = ds.batteryDaysX10;
+  }
+  st.loopWakeups = gLoopWakeupsTotal;
+  st.loopBlockedUs = gLoopBlockedUsTotal;
+  st.loopBusyUs = gLoopBusyUsTotal;
+  st.loopBusyUsMax = gLoopBusyUsMax;
+  st.frames = rs.frames;
+  st.frameUsTotal = rs.frameUsTotal;
+  st.frameUsMax = rs.frameUsMax;
+  st.latencyUsLast = rs.latencyUsLast;
+  httpApiPublish(st);
+}
+
+// Queues a state reading every MQTT_PUBLISH_MS whether or not the broker is reachable; the
+// publisher holds them until it is. Not started without MQTT_HOST.
+static void mqttTick(uint32_t now) {
+  const bool connected = gWifiState == WifiState::Connected;
+
+  const ForecastStore* fc = homeForecast();
+  MqttReading r;
+  r.ms = now;
+  r.outdoorC10 = fc ? fc->currentTempC10 : kTempUnknown;
+  r.condition =
+      fc && fc->currentCond != WxCond::Unknown ? condShortText(fc->currentCond) : nullptr;
+  r.batteryPct = gBatteryPctCached;
+  r.charging = gBatteryChargingCached;
+  r.rssi = connected ? static_cast<int8_t>(WiFi.RSSI()) : 0;
+  EnvSample env;
+  if (envLatest(env)) {
+    r.room = true;
+    r.roomC100 = env.tempC100;
+    r.roomPermille = env.humidityPermille;
+    r.roomPa = env.pressurePa;
+    r.roomGasOhm = env.gasOhm;
+  }
+  mqttQueue(r);
+}
+
+// Hands the link state to the HTTP API and MQTT tasks; loop() calls it on Wi-Fi events.
+static void linkTick() {
+  const bool connected = gWifiState == WifiState::Connected;
+  httpApiSetEnabled(connected);
+  if (MQTT_HOST[0] != '\0') mqttSetOnline(connected);
+  if (connected) wallClockStartSync();
+}
 
-  batterySampleTick();
-  const bool batChanged = (static_cast<int8_t>(gBatteryPctCached) != gLastDrawnBatteryPct) ||
-                          (gBatteryChargingCached != gLastDrawnCharging);
+// Every kClockTickMs: copies a new SNTP time to the RTC.
+static constexpr uint32_t kClockTickMs = 60000;
 
-  if (batChanged) {
-    uiDrawFooterFull(false);
-  } else if (shouldScroll) {
-    uiDrawFooterWeatherOnly(weatherLocal);
+static void clockTick(uint32_t now) {
+  (void)now;
+  wallClockTick();
+}
+
+// Runs on the Wi-Fi event task: only wakes loop(), which reads the new state itself.
+static void wifiOnEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  (void)event;
+  (void)info;
+  loopSignal(kLoopEvtWifi);
+}
+
+static void IRAM_ATTR touchIsr() {
+  powerWakeFromIsr();
+  BaseType_t woken = pdFALSE;
+  xEventGroupSetBitsFromISR(gLoopEvents, kLoopEvtTouch, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+// Blocks until an event bit is set or the next timer job is due. Built with LOOP_POLLING it
+// sleeps a fixed 10 ms instead, like the old loop, for comparison.
+static EventBits_t loopWait() {
+  const uint32_t t0 = micros();
+  EventBits_t bits = kLoopEvtAll;
+  if (gLoopPolling) {
+    delay(10);
+  } else {
+    uint32_t dueMs = 0;
+    const int32_t untilMs = timerNextDue(dueMs)
+                                ? min<int32_t>(static_cast<int32_t>(dueMs - millis()),
+                                               static_cast<int32_t>(kLoopMaxSleepMs))
+                                : static_cast<int32_t>(kLoopMaxSleepMs);
+    const TickType_t ticks = untilMs > 0 ? pdMS_TO_TICKS(untilMs) : 0;
+    bits = xEventGroupWaitBits(gLoopEvents, kLoopEvtAll, pdTRUE, pdFALSE, ticks);
   }
+  gLoopWakeUs = micros();
+  gLoopBlockedUs += gLoopWakeUs - t0;
+  gLoopBlockedUsTotal += gLoopWakeUs - t0;
+  gLoopWakeups++;
+  gLoopWakeupsTotal++;
+  return bits & kLoopEvtAll;
 }
 
 static void wifiManagerApCallback(WiFiManager* wifiManager) {
@@ -802,38 +2217,119 @@ static void wifiManagerApCallback(WiFiManager* wifiManager) {
   uiMarkDirty();
 }
 
+// The cached address instead of DHCP, or back to DHCP with nullptr.
+static void wifiSetLease(const WifiFastRecord* rec) {
+  if (rec) {
+    WiFi.config(IPAddress(rec->ip), IPAddress(rec->gateway), IPAddress(rec->subnet),
+                IPAddress(rec->dns));
+  } else if (gJoinStatic) {
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+  }
+  gJoinStatic = rec != nullptr;
+}
+
+// Directed join on the cached AP's channel and BSSID, on the cached address while its lease
+// is recent. False when there is nothing usable to try.
+static bool wifiJoinFast() {
+  WifiFastRecord rec;
+  if (gFastFailed || !wifiFastLoad(rec)) return false;
+  if (gConnectUsingSecrets && strcmp(rec.ssid, gConnectTarget) != 0) return false;
+
+  String saved;  // the saved credentials' password; their SSID is only known once joined
+  const char* pass = WIFI_PASS;
+  if (!gConnectUsingSecrets) {
+    saved = WiFi.psk();
+    pass = saved.c_str();
+  }
+  uint32_t unixSec = 0;
+  const bool reuseLease = rec.ip != 0 && rec.leaseUnix != 0 && wallClockNow(unixSec) &&
+                          unixSec - rec.leaseUnix < kFastLeaseReuseSec;
+  wifiSetLease(reuseLease ? &rec : nullptr);
+
+  Serial.printf("[WiFi] Fast join: %s on ch %u%s\n",
+                rec.ssid,
+                static_cast<unsigned>(rec.channel),
+                reuseLease ? ", cached IP" : "");
+  gJoinFast = true;
+  timerStart(gJobFastJoin, kFastJoinTimeoutMs);
+  WiFi.begin(rec.ssid, pass, rec.channel, rec.bssid);
+  return true;
+}
+
+// Scan for the network and ask DHCP, as on a first boot.
+static void wifiJoinFull() {
+  gJoinFast = false;
+  timerStop(gJobFastJoin);
+  wifiSetLease(nullptr);
+  if (gConnectUsingSecrets) {
+    Serial.println("[WiFi] Connecting (secrets)");
+    WiFi.begin(WIFI_SSID, WIFI_PASS);
+  } else {
+    Serial.println("[WiFi] Connecting (saved creds)");
+    WiFi.begin();  // uses stored credentials if present
+  }
+}
+
+static void wifiFastFallback(const char* why) {
+  Serial.printf("[WiFi] Fast join failed (%s); scanning\n", why);
+  gFastFailed = true;
+  WiFi.disconnect(false, false);
+  wifiJoinFull();
+  uiMarkDirty();
+}
+
+// Remembers the link just made for the next fast join.
+static void wifiFastRemember() {
+  const uint8_t* bssid = WiFi.BSSID();
+  if (!bssid) return;
+  WifiFastRecord rec;
+  snprintf(rec.ssid, sizeof(rec.ssid), "%s", gStaSsid);
+  memcpy(rec.bssid, bssid, sizeof(rec.bssid));
+  rec.channel = static_cast<uint8_t>(WiFi.channel());
+  rec.ip = WiFi.localIP();
+  rec.gateway = WiFi.gatewayIP();
+  rec.subnet = WiFi.subnetMask();
+  rec.dns = WiFi.dnsIP(0);
+  if (gJoinStatic) {
+    // Not a new lease: keep the time of the one it came from.
+    WifiFastRecord old;
+    if (wifiFastLoad(old)) rec.leaseUnix = old.leaseUnix;
+  } else if (!wallClockNow(rec.leaseUnix)) {
+    rec.leaseUnix = 0;
+  }
+  wifiFastSave(rec);
+}
+
 static void wifiStartConnecting() {
-  gLastError = "";
+  gLastError[0] = '\0';
   if (gPortalActive) {
     gWiFiManager.stopConfigPortal();
     gPortalActive = false;
   }
   gWifiState = WifiState::Connecting;
-  gWifiDeadlineMs = millis() + kConnectTimeoutMs;
+  timerStop(gJobPortal);
+  timerStop(gJobPortalTimeout);
+  timerStart(gJobConnectTimeout, kConnectTimeoutMs);
 
   WiFi.mode(WIFI_STA);
   WiFi.setHostname(kHostname);
   WiFi.setAutoReconnect(true);
   WiFi.setSleep(false);
   WiFi.disconnect(false, false);
+  timerStop(gJobDhcpHandover);
 
-  if (strlen(WIFI_SSID) > 0) {
-    Serial.println("[WiFi] Connecting (secrets)");
-    gConnectUsingSecrets = true;
-    gConnectTarget = WIFI_SSID;
-    WiFi.begin(WIFI_SSID, WIFI_PASS);
-  } else {
-    Serial.println("[WiFi] Connecting (saved creds)");
-    gConnectUsingSecrets = false;
-    gConnectTarget = "";
-    WiFi.begin();  // uses stored credentials if present
-  }
+  gConnectUsingSecrets = strlen(WIFI_SSID) > 0;
+  snprintf(gConnectTarget, sizeof(gConnectTarget), "%s", WIFI_SSID);
+  gJoinStartMs = millis();
+  if (!wifiJoinFast()) wifiJoinFull();
   gLastStaStatus = WiFi.status();
 
   uiMarkDirty();
 }
 
 static void wifiStartPortal(bool resetFirst) {
+  // Nobody is there to use it during a timer wake, which sleeps at its deadline instead.
+  if (gDutyPass) return;
   Serial.println("[WiFi] Starting config portal");
 
   if (gPortalActive) {
@@ -844,6 +2340,7 @@ static void wifiStartPortal(bool resetFirst) {
   if (resetFirst) {
     Serial.println("[WiFi] Resetting saved WiFi config");
     gWiFiManager.resetSettings();
+    wifiFastForget();
   }
 
   gWiFiManager.setAPCallback(wifiManagerApCallback);
@@ -853,7 +2350,11 @@ static void wifiStartPortal(bool resetFirst) {
 
   gPortalActive = true;
   gWifiState = WifiState::Portal;
-  gPortalDeadlineMs = millis() + kPortalTimeoutMs;
+  gJoinFast = false;
+  timerStop(gJobConnectTimeout);
+  timerStop(gJobFastJoin);
+  timerStart(gJobPortal, 0, kPortalPollMs);
+  timerStart(gJobPortalTimeout, kPortalTimeoutMs);
 
   // Non-blocking: returns immediately; we keep calling process() from loop().
   gWiFiManager.startConfigPortal(kPortalApName, portalPasswordOrNull());
@@ -862,17 +2363,34 @@ static void wifiStartPortal(bool resetFirst) {
 }
 
 static void wifiTick() {
+  PROF_SCOPE(ProfScope::Wifi);
   const wl_status_t st = WiFi.status();
 
   if (st == WL_CONNECTED) {
     if (gWifiState != WifiState::Connected) {
-      Serial.println("[WiFi] Connected");
+      // Through the portal the join was WiFiManager's and is not timed.
+      gJoinMs = 0;
+      if (gWifiState == WifiState::Connecting) gJoinMs = max<uint32_t>(millis() - gJoinStartMs, 1);
+      gJoinWasFast = gJoinFast;
+      gJoinWasStatic = gJoinStatic;
+      gJoinFast = false;
+      gFastFailed = false;
+      Serial.printf("[WiFi] Connected in %u ms (%s)\n",
+                    static_cast<unsigned>(gJoinMs),
+                    gJoinWasFast ? "fast" : "full");
       WiFi.setSleep(true);
+      snprintf(gStaSsid, sizeof(gStaSsid), "%s", WiFi.SSID().c_str());
+      wifiFastRemember();
+      if (gJoinStatic) timerStart(gJobDhcpHandover, kDhcpHandoverMs);
       if (gPortalActive) {
         gWiFiManager.stopConfigPortal();
         gPortalActive = false;
       }
       gWifiState = WifiState::Connected;
+      timerStop(gJobConnectTimeout);
+      timerStop(gJobFastJoin);
+      timerStop(gJobPortal);
+      timerStop(gJobPortalTimeout);
       uiMarkDirty();
     }
     return;
@@ -886,25 +2404,16 @@ static void wifiTick() {
 
   if (gWifiState == WifiState::Portal && gPortalActive) {
     gWiFiManager.process();
-    if (millis() > gPortalDeadlineMs) {
-      Serial.println("[WiFi] Portal timeout");
-      gWiFiManager.stopConfigPortal();
-      gPortalActive = false;
-      gWifiState = WifiState::Error;
-      gLastError = "Portal timeout";
-      uiMarkDirty();
-    }
     return;
   }
 
   if (gWifiState == WifiState::Connecting) {
-    if (st == WL_CONNECT_FAILED) {
-      Serial.println("[WiFi] Auth failed; starting portal");
-      wifiStartPortal(false);
+    if (gJoinFast && (st == WL_NO_SSID_AVAIL || st == WL_CONNECT_FAILED)) {
+      wifiFastFallback(staStatusToString(st));
       return;
     }
-    if (millis() > gWifiDeadlineMs) {
-      Serial.println("[WiFi] Connect timeout; starting portal");
+    if (st == WL_CONNECT_FAILED) {
+      Serial.println("[WiFi] Auth failed; starting portal");
       wifiStartPortal(false);
     }
     return;
@@ -913,23 +2422,65 @@ static void wifiTick() {
   if (gWifiState == WifiState::Connected) {
     // Lost connection: try reconnect for a while, then portal.
     Serial.println("[WiFi] Disconnected; retrying");
+    weatherCancel();
     wifiStartConnecting();
     return;
   }
 }
 
+// Every kPortalPollMs while the portal is up.
+static void wifiPortalTick(uint32_t now) {
+  (void)now;
+  wifiTick();
+}
+
+static void wifiConnectTimeoutTick(uint32_t now) {
+  (void)now;
+  if (gWifiState != WifiState::Connecting) return;
+  Serial.println("[WiFi] Connect timeout; starting portal");
+  wifiStartPortal(false);
+}
+
+static void wifiFastJoinTimeoutTick(uint32_t now) {
+  (void)now;
+  if (gWifiState != WifiState::Connecting || !gJoinFast) return;
+  wifiFastFallback("timeout");
+}
+
+// A link joined on the cached address hands it back to DHCP once things are quiet, so the
+// router's lease table and the station agree again.
+static void wifiDhcpHandoverTick(uint32_t now) {
+  (void)now;
+  if (gWifiState != WifiState::Connected || !gJoinStatic) return;
+  if (gWeatherFetchPending) {
+    timerStart(gJobDhcpHandover, 5000);
+    return;
+  }
+  Serial.println("[WiFi] Cached IP handed back to DHCP");
+  wifiSetLease(nullptr);
+}
+
+static void wifiPortalTimeoutTick(uint32_t now) {
+  (void)now;
+  if (gWifiState != WifiState::Portal || !gPortalActive) return;
+  Serial.println("[WiFi] Portal timeout");
+  gWiFiManager.stopConfigPortal();
+  gPortalActive = false;
+  gWifiState = WifiState::Error;
+  timerStop(gJobPortal);
+  snprintf(gLastError, sizeof(gLastError), "Portal timeout");
+  uiMarkDirty();
+}
+
 static void inputTick() {
+  PROF_SCOPE(ProfScope::Input);
   if (gSwipeLeft.wasDetected()) {
     noteInteraction();
-    if (gView == View::Status) gView = View::WiFi;
-    else if (gView == View::WiFi) gView = View::About;
-    else gView = View::Status;
+    gView = viewStep(gView, +1);
     uiMarkDirty();
   } else if (gSwipeRight.wasDetected()) {
     noteInteraction();
-    if (gView == View::Status) gView = View::About;
-    else if (gView == View::About) gView = View::WiFi;
-    else gView = View::Status;
+    gView = viewStep(gView, -1);
     uiMarkDirty();
   }
 
@@ -937,6 +2488,10 @@ static void inputTick() {
     noteInteraction();
     gView = View::Status;
     uiMarkDirty();
+  } else if (gHitTabForecast && gHitTabForecast->wasPressed()) {
+    noteInteraction();
+    gView = View::Forecast;
+    uiMarkDirty();
   } else if (gHitTabWiFi && gHitTabWiFi->wasPressed()) {
     noteInteraction();
     gView = View::WiFi;
@@ -945,6 +2500,12 @@ static void inputTick() {
     noteInteraction();
     gView = View::About;
     uiMarkDirty();
+#if PROFILER
+  } else if (gHitTabDiag && gHitTabDiag->wasPressed()) {
+    noteInteraction();
+    gView = View::Diagnostics;
+    uiMarkDirty();
+#endif
   }
 
   if (gView != View::WiFi) return;
@@ -961,65 +2522,307 @@ static void inputTick() {
   }
 }
 
+// Everything a timer wake leaves out: the HTTP API, MQTT and dimming.
+static void sessionStart() {
+  httpApiStart();
+  mqttStart({MQTT_HOST, MQTT_PORT, MQTT_USER, MQTT_PASS, kHostname});
+  linkTick();
+  timerStart(gJobDim, kDimAfterMs + 1);
+  // Waiting for the grid gives the first fetch a head start.
+  if (MQTT_HOST[0] != '\0') timerStartAt(gJobMqtt, gridNext(MQTT_PUBLISH_MS), MQTT_PUBLISH_MS);
+}
+
+// A timer wake: Wi-Fi only comes up when the forecast is due. The schedule kept in RTC
+// memory stands in for the one a fetch would set, so the next sleep ends in time for it.
+static void dutyPassBegin() {
+  uint32_t unixSec = 0;
+  wallClockNow(unixSec);
+  gDutyFetch = dutyCycleFetchDue(unixSec);
+  gView = View::Forecast;
+  gTickerPaused = true;
+  const DutyCycleStats ds = dutyCycleStats();
+  Serial.printf("[Duty] Timer wake %u%s\n",
+                static_cast<unsigned>(ds.cycles),
+                gDutyFetch ? ", fetching" : "");
+  if (gDutyFetch) {
+    gWeatherNextFetchMs = 0;
+    wifiStartConnecting();
+  } else if (ds.nextFetchUnix > unixSec) {
+    gWeatherNextFetchMs = millis() + (ds.nextFetchUnix - unixSec) * 1000;
+  }
+  WeatherState ws;
+  gWeather.read(ws);
+  gDutyFetchesAtStart = ws.fetches;
+  timerStart(gJobDuty, kDutyPollMs, kDutyPollMs);
+}
+
+// A touch during a timer wake: carry on as a normal session.
+static void dutyPassEnd() {
+  gDutyPass = false;
+  timerStop(gJobDuty);
+  gTickerPaused = false;
+  if (gRenderTask) xTaskNotifyGive(gRenderTask);
+  if (!gDutyFetch) wifiStartConnecting();
+  sessionStart();
+  uiMarkDirty();
+}
+
+// Saves what must outlive the sleep and sleeps until the next multiple of DUTY_CYCLE_MIN in
+// UTC, or the next fetch if that comes first. Does not return on the device.
+static void dutySleep(bool timerWake) {
+  weatherCacheSaveTick();
+  tsFlush();
+  const uint32_t now = millis();
+  uint32_t unixSec = 0;
+  const bool clockSet = wallClockNow(unixSec);
+  uint32_t sleepSec = clockSet ? kDutyPeriodSec - unixSec % kDutyPeriodSec : kDutyPeriodSec;
+  uint32_t nextFetchUnix = 0;
+  const uint32_t nextFetchMs = gWeatherNextFetchMs;
+  if (clockSet && nextFetchMs != 0 && !timeReached(now, nextFetchMs)) {
+    nextFetchUnix = unixSec + (nextFetchMs - now) / 1000;
+    sleepSec = min(sleepSec, nextFetchUnix - unixSec);
+  }
+  sleepSec = max(sleepSec, kDutyMinSleepSec);
+  WiFi.disconnect(true);
+  backlightSet(DUTY_CYCLE_BACKLIGHT);
+  dutyCycleSleep(sleepSec, nextFetchUnix, timerWake);
+}
+
+// A timer wake polls until the fetch (if due) and a sensor sample are in, or its deadline,
+// then draws once and sleeps when that frame is on the panel. In a session it is armed by
+// dimming and sleeps unless the portal is up or a fetch is still out.
+static void dutyTick(uint32_t now) {
+  if (!gDutyPass) {
+    if (gCurrentBrightness != kBrightnessDim) return;
+    if (gPortalActive) {
+      timerStart(gJobDuty, kDutyIdleMs);
+    } else if (gWeatherFetchPending) {
+      timerStart(gJobDuty, 1000);
+    } else {
+      dutySleep(false);
+    }
+    return;
+  }
+
+  // Bounds the wait for the last frame; the render task may be mid-frame.
+  static constexpr uint32_t kDutyDrawMaxMs = 2000;
+  RenderStats rs;
+  gRenderStats.read(rs);
+  if (gDutyFrames == 0) {
+    WeatherState ws;
+    gWeather.read(ws);
+    const bool fetched = !gDutyFetch || ws.fetches != gDutyFetchesAtStart;
+    EnvSample env;
+    const EnvStats es = envStats();
+    const bool sampled = envLatest(env) || (!es.present && es.errors > 0);
+    if (!(fetched && sampled) && !timeReached(now, kDutyPassMaxMs)) return;
+    historyTick(now);
+    uiCompose();
+    gDutyFrames = rs.frames + 1;
+    gDutyDrawnMs = now;
+    if (gRenderTask) return;
+  } else if (rs.frames < gDutyFrames && !timeReached(now, gDutyDrawnMs + kDutyDrawMaxMs)) {
+    return;
+  }
+  dutySleep(true);
+}
+
 void setup() {
   M5.begin();
   Serial.begin(115200);
 
-  gLastInteractionMs = millis();
-  M5.Lcd.setBrightness(kBrightnessActive);
-  gCurrentBrightness = kBrightnessActive;
-  gBatteryNextSampleMs = 0;
-  batterySampleTick();
+  heapGuardWatch();
+  gLoopEvents = xEventGroupCreate();
+  pinMode(kTouchIntPin, INPUT);
+  attachInterrupt(digitalPinToInterrupt(kTouchIntPin), touchIsr, FALLING);
+  powerGovernorBegin(kTouchIntPin);
+  WiFi.onEvent(wifiOnEvent);
+
+  gDutyPass = dutyCycleBegin(kTouchIntPin) == WakeCause::Timer && kDutyCycle;
+
+  const uint8_t brightness = gDutyPass ? DUTY_CYCLE_BACKLIGHT : kBrightnessActive;
+  M5.Lcd.setBrightness(brightness);
+  gCurrentBrightness = brightness;
+  i2cBusStart(kBatterySampleMs, kRtcSyncMs);  // from here on only the bus task uses Wire1
+  wallClockBegin(TIME_ZONE);
+  batterySampleTick();  // after the clock: the duty cycle's charge account is timed by it
 
   uiInit();
-  wifiStartConnecting();
-  uiDrawFull();
+  weatherSitesBegin();
+  weatherPolicyBegin();
+  weatherCacheRestore();
+  weatherShowSite(0);
+  weatherWorkerStart();
+  envSensorStart(ENV_SAMPLE_MS);
+  if (gDutyPass) {
+    dutyPassBegin();
+  } else {
+    wifiStartConnecting();
+  }
+  renderTaskStart();
+  uiCompose();
+  tsStart();  // after the first frame: mounting formats the partition on first boot
+  if (!gDutyPass) sessionStart();
+
   gUiDirty = false;
-  gUiNextRefreshMs = millis() + 1000;
+  timerStart(gJobWeather, 0);
+  gUiStatsStartMs = millis();
+  timerStartAt(gJobUiStats, gridNext(kUiStatsMs), kUiStatsMs);
+  timerStart(gJobHistoryReport, 0, kHistoryReportMs);
+  timerStartAt(gJobClock, gridNext(kClockTickMs), kClockTickMs);
+  liveRearm(gJobUiRefresh);
+  liveRearm(gJobHistory);
+  liveRearm(gJobApi);
+  liveRearm(gJobSerial);
 }
 
-void loop() {
-  M5.update();
+// Touch is only sampled while the controller reports a finger (plus a short tail so
+// releases and swipes complete): touchWake() starts this job every kTouchPollMs and it
+// stops itself once the tail has passed. The on-screen BtnA-C are touch zones on the Core2.
+static void touchWake(uint32_t now) {
+  if (gDutyPass) dutyPassEnd();
+  gTouchPollUntilMs = now + kTouchTrailMs;
+  noteActivity();
+  if (!timerArmed(gJobTouch)) timerStart(gJobTouch, 0, kTouchPollMs);
+}
+
+static void touchTick(uint32_t now) {
+  if (digitalRead(kTouchIntPin) == LOW) {
+    gTouchPollUntilMs = now + kTouchTrailMs;
+    noteActivity();
+  }
+  if (timeReached(now, gTouchPollUntilMs)) {
+    timerStop(gJobTouch);
+    return;
+  }
+  PROF_SCOPE(ProfScope::Touch);
 
+  {
+    PROF_SCOPE(ProfScope::M5Update);
+    i2cBusRun(I2cClass::Touch, [](void*) { M5.update(); }, nullptr);
+  }
   if (M5.BtnA.wasPressed()) {
     noteInteraction();
     wifiStartPortal(false);
   }
   if (M5.BtnB.wasPressed()) {
     noteInteraction();
-    if (gView == View::Status) gView = View::WiFi;
-    else if (gView == View::WiFi) gView = View::About;
-    else gView = View::Status;
+    gView = viewStep(gView, +1);
     uiMarkDirty();
   }
   if (M5.BtnC.wasPressed()) {
     noteInteraction();
-    if (gView == View::Status) gView = View::About;
-    else if (gView == View::About) gView = View::WiFi;
-    else gView = View::Status;
+    gView = viewStep(gView, -1);
     uiMarkDirty();
   }
-
-  wifiTick();
   inputTick();
+}
 
-  const uint32_t now = millis();
-  if (gUiDirty) {
-    uiDrawFull();
-    gUiDirty = false;
-    gUiNextRefreshMs = now + 1000;
-  } else if (now > gUiNextRefreshMs) {
-    uiUpdateDynamic();
-    if (gUiDirty) {
-      uiDrawFull();
-      gUiDirty = false;
+// "loc" lists the forecast sites; "loc set LIST" replaces them, "loc add LIST" adds sites
+// (or moves one with the same label), "loc del LABEL" removes one and "loc reset" returns to
+// the build's list. LIST is "LABEL:lat,lon;LABEL:lat,lon;...".
+static void siteCommand(const char* args) {
+  WeatherLocations next = gSites;
+  const char* error = nullptr;
+  if (strncmp(args, "set ", 4) == 0) {
+    next.count = 0;
+    weatherLocationsParse(args + 4, next, error);
+  } else if (strncmp(args, "add ", 4) == 0) {
+    weatherLocationsParse(args + 4, next, error);
+  } else if (strncmp(args, "del ", 4) == 0) {
+    if (!weatherLocationsRemove(next, args + 4)) {
+      error = "no such site";
+    } else if (next.count == 0) {
+      error = "the last site cannot be removed";
+    }
+  } else if (strcmp(args, "reset") == 0) {
+    weatherLocationsClear();
+    weatherSitesDefault(next);
+  } else if (args[0] != '\0') {
+    error = "usage: loc [set LIST | add LIST | del LABEL | reset]";
+  }
+
+  if (error) {
+    Serial.printf("[Loc] %s\n", error);
+    return;
+  }
+  if (args[0] != '\0') {
+    if (strcmp(args, "reset") != 0 && !weatherLocationsSave(next)) {
+      Serial.println("[Loc] Save failed");
     }
-    gUiNextRefreshMs = now + 1000;
+    weatherSitesApply(next);
+  }
+  weatherSitesLog();
+}
+
+// Serial line commands, read on the live-value grid, so they are answered within a second
+// (ten while dimmed): "loc ..." (see siteCommand()) and, with the profiler, "prof" to dump
+// it, "prof reset" to clear it and "prof on" / "prof off" to resume and pause recording.
+static void serialCommandTick(uint32_t now) {
+  (void)now;
+  liveRearm(gJobSerial);
+  static char line[16 + kWeatherLocationsMax * kWeatherSiteTextMax];
+  static uint16_t len = 0;
+  while (Serial.available() > 0) {
+    const int c = Serial.read();
+    if (c == '\r') continue;
+    if (c != '\n') {
+      if (len < sizeof(line) - 1) line[len++] = static_cast<char>(c);
+      continue;
+    }
+    line[len] = '\0';
+    len = 0;
+    if (strcmp(line, "loc") == 0 || strncmp(line, "loc ", 4) == 0) {
+      siteCommand(line[3] ? line + 4 : line + 3);
+#if PROFILER
+    } else if (strcmp(line, "prof") == 0) {
+      profDump(Serial);
+    } else if (strcmp(line, "prof reset") == 0) {
+      profReset();
+      Serial.println("[Prof] Reset");
+    } else if (strcmp(line, "prof on") == 0 || strcmp(line, "prof off") == 0) {
+      profSetEnabled(line[6] == 'n');
+      Serial.println(profEnabled() ? "[Prof] Recording" : "[Prof] Paused");
+#endif
+    } else if (line[0] != '\0') {
+      Serial.printf("[Serial] Unknown command: %s\n", line);
+    }
+  }
+}
+
+// Composes whatever changed, and on the live-value grid for values nothing signals (RSSI,
+// render stats). A new battery reading from the bus task is picked up here.
+static void uiRefreshTick(uint32_t now) {
+  (void)now;
+  if (batterySampleTick()) gUiDirty = true;
+  uiCompose();
+  gUiDirty = false;
+  xEventGroupClearBits(gLoopEvents, kLoopEvtUi);
+  liveRearm(gJobUiRefresh);
+}
+
+void loop() {
+  const EventBits_t events = loopWait();
+  PROF_SCOPE(ProfScope::Loop);
+  // Steady state: connected for the whole pass with no Wi-Fi event to handle. Reconnects,
+  // the portal and Wi-Fi library calls may allocate; nothing else in loop() should.
+  const uint32_t allocsAtStart = heapGuardAllocs();
+  const bool steady = gWifiState == WifiState::Connected && !(events & kLoopEvtWifi);
+
+  // Events first: they may start jobs that are due right away.
+  if ((events & kLoopEvtTouch) || digitalRead(kTouchIntPin) == LOW) touchWake(millis());
+  if (events & kLoopEvtWifi) {
+    wifiTick();
+    linkTick();
   }
+  if ((events & kLoopEvtWeather) && weatherRefreshUi()) uiMarkDirty();
+  if (events & (kLoopEvtWifi | kLoopEvtWeather)) timerStart(gJobWeather, 0);
 
-  weatherTick();
-  footerTick();
-  powerTick();
+  timerRun(millis());
+  if (gUiDirty) uiRefreshTick(millis());
 
-  delay(10);
+  const uint32_t busyUs = micros() - gLoopWakeUs;
+  gLoopBusyUsTotal += busyUs;
+  gLoopBusyUsMax = max(gLoopBusyUsMax, busyUs);
+  heapGuardEndPass(allocsAtStart, steady && gWifiState == WifiState::Connected);
 }
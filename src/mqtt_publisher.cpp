@@ -0,0 +1,551 @@
+#include "mqtt_publisher.h"
+
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+
+#include "ring_buffer.h"
+
+namespace {
+
+constexpr uint32_t kTaskStack = 4096;
+constexpr uint16_t kKeepAliveS = 60;
+constexpr uint32_t kPingIdleMs = kKeepAliveS * 1000UL / 2;  // idle time before a PINGREQ
+constexpr uint32_t kPingTimeoutMs = kKeepAliveS * 1000UL / 2;
+constexpr uint32_t kConnectTimeoutMs = 5000;  // TCP connect, then again for CONNACK
+constexpr uint32_t kSendTimeoutMs = 2000;
+constexpr uint32_t kRetryMinMs = 5000;
+constexpr uint32_t kRetryMaxMs = 120000;
+constexpr size_t kBatchBytes = 1024;    // PUBLISH packets coalesced into one send()
+constexpr size_t kTopicBytes = 96;
+constexpr size_t kPayloadBytes = 512;
+
+// Entities announced to Home Assistant; `key` is the field in the state JSON.
+struct Entity {
+  const char* component;
+  const char* key;
+  const char* name;
+  const char* unit;         // nullptr: none
+  const char* deviceClass;  // nullptr: none
+  bool room;                // only announced once a reading carries the room sensor
+};
+
+constexpr Entity kEntities[] = {
+    {"sensor", "outdoor_temp", "Outdoor temperature", "°C", "temperature", false},
+    {"sensor", "condition", "Weather", nullptr, nullptr, false},
+    {"sensor", "battery", "Battery", "%", "battery", false},
+    {"binary_sensor", "charging", "Charging", nullptr, "battery_charging", false},
+    {"sensor", "rssi", "Wi-Fi signal", "dBm", "signal_strength", false},
+    {"sensor", "room_temp", "Room temperature", "°C", "temperature", true},
+    {"sensor", "room_humidity", "Room humidity", "%", "humidity", true},
+    {"sensor", "room_pressure", "Room pressure", "hPa", "atmospheric_pressure", true},
+    {"sensor", "room_gas", "Room gas resistance", "Ω", nullptr, true},
+};
+
+MqttConfig gCfg = {};
+TaskHandle_t gTask = nullptr;
+std::atomic<bool> gOnline{false};
+
+// Shared with mqttQueue() and mqttStats() callers.
+portMUX_TYPE gLock = portMUX_INITIALIZER_UNLOCKED;
+RingBuffer<MqttReading, kMqttQueueLen> gQueue;
+MqttStats gStats;
+
+// Task-only state.
+int gFd = -1;
+bool gConnAck = false;
+uint32_t gLastSendMs = 0;
+uint32_t gPingSentMs = 0;  // 0: no PINGREQ outstanding
+bool gRoomAnnounced = false;
+bool gDraining = false;
+uint32_t gDrainStartMs = 0;
+uint32_t gTokens = 0;  // thousandths of a message
+uint32_t gTokensMs = 0;
+
+char gBatch[kBatchBytes];
+size_t gBatchLen = 0;
+uint32_t gBatchMessages = 0;
+char gTopic[kTopicBytes];
+char gPayload[kPayloadBytes];
+uint8_t gRx[16];
+size_t gRxLen = 0;
+
+void setNonBlocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+bool waitFd(int fd, bool write, uint32_t timeoutMs) {
+  fd_set set;
+  FD_ZERO(&set);
+  FD_SET(fd, &set);
+  timeval tv = {static_cast<long>(timeoutMs / 1000), static_cast<long>(timeoutMs % 1000 * 1000)};
+  return select(fd + 1, write ? nullptr : &set, write ? &set : nullptr, nullptr, &tv) > 0;
+}
+
+// Writes all of `data`, waiting for send-buffer space for at most kSendTimeoutMs.
+bool sendAll(int fd, const char* data, size_t len) {
+  const uint32_t startMs = millis();
+  while (len > 0) {
+    const int n = send(fd, data, len, 0);
+    if (n > 0) {
+      data += n;
+      len -= n;
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+        millis() - startMs < kSendTimeoutMs) {
+      waitFd(fd, true, 50);
+      continue;
+    }
+    return false;
+  }
+  return true;
+}
+
+// ----- Packets -----
+
+bool flush() {
+  if (gBatchLen == 0) return true;
+  const bool ok = gFd >= 0 && sendAll(gFd, gBatch, gBatchLen);
+  if (ok) {
+    gLastSendMs = millis();
+    portENTER_CRITICAL(&gLock);
+    gStats.published += gBatchMessages;
+    if (gBatchMessages > 0) gStats.batches++;
+    gStats.bytesSent += gBatchLen;
+    portEXIT_CRITICAL(&gLock);
+  }
+  gBatchLen = 0;
+  gBatchMessages = 0;
+  return ok;
+}
+
+// Reserves room for a packet of `remaining` bytes after the fixed header, flushing the batch
+// first if it would not fit, and writes the fixed header.
+bool beginPacket(uint8_t header, size_t remaining) {
+  uint8_t lenBytes[4];
+  uint8_t n = 0;
+  size_t v = remaining;
+  do {
+    lenBytes[n] = v % 128;
+    v /= 128;
+    if (v > 0) lenBytes[n] |= 0x80;
+    n++;
+  } while (v > 0 && n < sizeof(lenBytes));
+  if (1 + n + remaining > sizeof(gBatch)) return false;
+  if (gBatchLen + 1 + n + remaining > sizeof(gBatch) && !flush()) return false;
+  gBatch[gBatchLen++] = static_cast<char>(header);
+  memcpy(gBatch + gBatchLen, lenBytes, n);
+  gBatchLen += n;
+  return true;
+}
+
+void putBytes(const void* data, size_t len) {
+  memcpy(gBatch + gBatchLen, data, len);
+  gBatchLen += len;
+}
+
+void putString(const char* s) {
+  const size_t len = strlen(s);
+  const uint8_t prefix[2] = {static_cast<uint8_t>(len >> 8), static_cast<uint8_t>(len)};
+  putBytes(prefix, 2);
+  putBytes(s, len);
+}
+
+bool putPublish(const char* topic, const char* payload, bool retain) {
+  const size_t len = strlen(payload);
+  if (!beginPacket(retain ? 0x31 : 0x30, 2 + strlen(topic) + len)) return false;
+  putString(topic);
+  putBytes(payload, len);
+  gBatchMessages++;
+  return true;
+}
+
+bool putConnect() {
+  char willTopic[kTopicBytes];
+  snprintf(willTopic, sizeof(willTopic), "%s/status", gCfg.nodeId);
+  const bool auth = gCfg.user[0] != '\0';
+  uint8_t flags = 0x02 | 0x04 | 0x20;  // clean session, will, retained will
+  size_t remaining = 10 + 2 + strlen(gCfg.nodeId) + 2 + strlen(willTopic) + 2 + strlen("offline");
+  if (auth) {
+    flags |= 0x80 | 0x40;
+    remaining += 2 + strlen(gCfg.user) + 2 + strlen(gCfg.pass);
+  }
+  if (!beginPacket(0x10, remaining)) return false;
+  const uint8_t variable[] = {0, 4, 'M', 'Q', 'T', 'T', 4, flags, 0, kKeepAliveS};
+  putBytes(variable, sizeof(variable));
+  putString(gCfg.nodeId);
+  putString(willTopic);
+  putString("offline");
+  if (auth) {
+    putString(gCfg.user);
+    putString(gCfg.pass);
+  }
+  return true;
+}
+
+// Reads whatever the broker sent. Only CONNACK and PINGRESP are expected since nothing is
+// subscribed; false when the connection is closed, refused or out of step.
+bool serviceSocket() {
+  for (;;) {
+    const int n = recv(gFd, gRx + gRxLen, sizeof(gRx) - gRxLen, 0);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    gRxLen += n;
+    while (gRxLen >= 2) {
+      if (gRx[1] & 0x80) return false;  // no packet we expect is this long
+      const size_t len = 2 + gRx[1];
+      if (len > sizeof(gRx)) return false;
+      if (gRxLen < len) break;
+      const uint8_t type = gRx[0] >> 4;
+      if (type == 2) {
+        if (len < 4 || gRx[3] != 0) {
+          Serial.printf("[MQTT] Connection refused (code %u)\n", len < 4 ? 0u : gRx[3]);
+          return false;
+        }
+        gConnAck = true;
+      } else if (type == 13) {
+        gPingSentMs = 0;
+      }
+      gRxLen -= len;
+      memmove(gRx, gRx + len, gRxLen);
+    }
+  }
+}
+
+// ----- Payloads -----
+
+// printf into gPayload, truncating (and then producing invalid JSON, which the broker does
+// not check) rather than overflowing.
+class PayloadWriter {
+ public:
+  PayloadWriter() { gPayload[0] = '\0'; }
+
+  void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    if (len_ >= sizeof(gPayload) - 1) return;
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(gPayload + len_, sizeof(gPayload) - len_, fmt, args);
+    va_end(args);
+    if (n > 0) len_ = min(len_ + n, sizeof(gPayload) - 1);
+  }
+
+  void fixed(const char* key, int32_t v, int32_t scale, int decimals) {
+    printf(",\"%s\":%s%d.%0*d",
+           key,
+           v < 0 ? "-" : "",
+           static_cast<int>(abs(v) / scale),
+           decimals,
+           static_cast<int>(abs(v) % scale));
+  }
+
+ private:
+  size_t len_ = 0;
+};
+
+void formatState(const MqttReading& r) {
+  PayloadWriter w;
+  w.printf("{\"queued_s\":%lu", static_cast<unsigned long>((millis() - r.ms) / 1000));
+  if (r.outdoorC10 != INT16_MIN) {
+    w.fixed("outdoor_temp", r.outdoorC10, 10, 1);
+  } else {
+    w.printf(",\"outdoor_temp\":null");
+  }
+  if (r.condition) {
+    w.printf(",\"condition\":\"%s\"", r.condition);
+  } else {
+    w.printf(",\"condition\":null");
+  }
+  w.printf(",\"battery\":%u,\"charging\":%s",
+           static_cast<unsigned>(r.batteryPct),
+           r.charging ? "true" : "false");
+  if (r.rssi != 0) {
+    w.printf(",\"rssi\":%d", static_cast<int>(r.rssi));
+  } else {
+    w.printf(",\"rssi\":null");
+  }
+  if (r.room) {
+    w.fixed("room_temp", r.roomC100, 100, 2);
+    w.fixed("room_humidity", r.roomPermille, 10, 1);
+    w.fixed("room_pressure", static_cast<int32_t>(r.roomPa), 100, 2);
+    if (r.roomGasOhm != 0) {
+      w.printf(",\"room_gas\":%lu", static_cast<unsigned long>(r.roomGasOhm));
+    } else {
+      w.printf(",\"room_gas\":null");
+    }
+  }
+  w.printf("}");
+}
+
+void formatDiscovery(const Entity& e) {
+  PayloadWriter w;
+  w.printf("{\"name\":\"%s\",\"uniq_id\":\"%s_%s\","
+           "\"stat_t\":\"%s/state\",\"avty_t\":\"%s/status\"",
+           e.name,
+           gCfg.nodeId,
+           e.key,
+           gCfg.nodeId,
+           gCfg.nodeId);
+  if (strcmp(e.component, "binary_sensor") == 0) {
+    w.printf(",\"val_tpl\":\"{{ 'ON' if value_json.%s else 'OFF' }}\"", e.key);
+  } else {
+    w.printf(",\"val_tpl\":\"{{ value_json.%s }}\"", e.key);
+  }
+  if (e.unit) w.printf(",\"unit_of_meas\":\"%s\",\"stat_cla\":\"measurement\"", e.unit);
+  if (e.deviceClass) w.printf(",\"dev_cla\":\"%s\"", e.deviceClass);
+  w.printf(",\"dev\":{\"ids\":[\"%s\"],\"name\":\"Weather station %s\",\"mf\":\"M5Stack\","
+           "\"mdl\":\"Core2\"}}",
+           gCfg.nodeId,
+           gCfg.nodeId);
+}
+
+// Queues the discovery configs for the base or the room entities into the batch.
+bool putDiscovery(bool room) {
+  for (const Entity& e : kEntities) {
+    if (e.room != room) continue;
+    snprintf(gTopic, sizeof(gTopic), "homeassistant/%s/%s/%s/config", e.component, gCfg.nodeId,
+             e.key);
+    formatDiscovery(e);
+    if (!putPublish(gTopic, gPayload, true)) return false;
+  }
+  return true;
+}
+
+// ----- Connection -----
+
+void disconnect() {
+  if (gFd < 0) return;
+  if (gBatchLen == 0) {
+    const uint8_t bye[] = {0xE0, 0x00};
+    send(gFd, bye, sizeof(bye), 0);
+  }
+  close(gFd);
+  gFd = -1;
+  gBatchLen = 0;
+  gBatchMessages = 0;
+  portENTER_CRITICAL(&gLock);
+  const bool wasConnected = gStats.connected;
+  gStats.connected = false;
+  portEXIT_CRITICAL(&gLock);
+  if (wasConnected) Serial.println("[MQTT] Disconnected");
+}
+
+int openSocket() {
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  char port[8];
+  snprintf(port, sizeof(port), "%u", static_cast<unsigned>(gCfg.port));
+  addrinfo* res = nullptr;
+  if (getaddrinfo(gCfg.host, port, &hints, &res) != 0 || res == nullptr) return -1;
+
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd >= 0) {
+    setNonBlocking(fd);
+    int err = 0;
+    socklen_t errLen = sizeof(err);
+    const bool ok =
+        (connect(fd, res->ai_addr, res->ai_addrlen) == 0 || errno == EINPROGRESS) &&
+        waitFd(fd, true, kConnectTimeoutMs) &&
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0;
+    if (!ok) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+// Connects, waits for CONNACK and announces the device. Any backlog starts draining with a
+// full burst allowance.
+bool brokerConnect() {
+  gFd = openSocket();
+  if (gFd < 0) return false;
+  const int one = 1;
+  setsockopt(gFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  gRxLen = 0;
+  gConnAck = false;
+  gPingSentMs = 0;
+  if (!putConnect() || !flush()) return false;
+
+  const uint32_t startMs = millis();
+  while (!gConnAck) {
+    const uint32_t elapsed = millis() - startMs;
+    if (elapsed >= kConnectTimeoutMs) return false;
+    waitFd(gFd, false, kConnectTimeoutMs - elapsed);
+    if (!serviceSocket()) return false;
+  }
+
+  snprintf(gTopic, sizeof(gTopic), "%s/status", gCfg.nodeId);
+  gRoomAnnounced = false;
+  if (!putPublish(gTopic, "online", true) || !putDiscovery(false) || !flush()) return false;
+
+  const uint32_t now = millis();
+  gTokens = kMqttBurst * 1000;
+  gTokensMs = now;
+  portENTER_CRITICAL(&gLock);
+  gStats.connected = true;
+  gStats.connects++;
+  gDraining = !gQueue.empty();
+  portEXIT_CRITICAL(&gLock);
+  gDrainStartMs = now;
+  Serial.printf("[MQTT] Connected to %s:%u\n", gCfg.host, static_cast<unsigned>(gCfg.port));
+  return true;
+}
+
+// Sends queued readings as the rate allows and sets `waitMs` to when more may go. A backlog
+// waits for a whole batch's allowance so it leaves kMqttBurst messages per send(). A batch
+// that fails to send is lost, like any QoS 0 message in flight.
+bool drain(uint32_t& waitMs) {
+  const uint32_t now = millis();
+  gTokens = min<uint64_t>(gTokens + static_cast<uint64_t>(now - gTokensMs) * MQTT_DRAIN_PER_S,
+                          kMqttBurst * 1000);
+  gTokensMs = now;
+
+  for (;;) {
+    portENTER_CRITICAL(&gLock);
+    const uint32_t queued = gQueue.size();
+    portEXIT_CRITICAL(&gLock);
+    if (queued == 0) {
+      if (gDraining) {
+        gDraining = false;
+        portENTER_CRITICAL(&gLock);
+        gStats.drainMsLast = now - gDrainStartMs;
+        portEXIT_CRITICAL(&gLock);
+      }
+      return true;
+    }
+    const uint32_t batch = min(queued, kMqttBurst);
+    if (gTokens < batch * 1000) {
+      waitMs = min<uint32_t>(waitMs, (batch * 1000 - gTokens) / MQTT_DRAIN_PER_S + 1);
+      return true;
+    }
+
+    snprintf(gTopic, sizeof(gTopic), "%s/state", gCfg.nodeId);
+    for (uint32_t i = 0; i < batch; i++) {
+      MqttReading r;
+      portENTER_CRITICAL(&gLock);
+      const bool have = !gQueue.empty();
+      if (have) {
+        r = gQueue.at(0);
+        gQueue.popOldest();
+        gStats.queued = gQueue.size();
+      }
+      portEXIT_CRITICAL(&gLock);
+      if (!have) break;
+
+      if (r.room && !gRoomAnnounced) {
+        if (!putDiscovery(true)) return false;
+        gRoomAnnounced = true;
+        snprintf(gTopic, sizeof(gTopic), "%s/state", gCfg.nodeId);
+      }
+      formatState(r);
+      if (!putPublish(gTopic, gPayload, true)) return false;
+      gTokens -= 1000;
+    }
+    if (!flush()) return false;
+  }
+}
+
+// Pings after kPingIdleMs without traffic and gives up on a broker that does not answer.
+bool keepAlive(uint32_t& waitMs) {
+  const uint32_t now = millis();
+  if (gPingSentMs != 0) {
+    if (now - gPingSentMs >= kPingTimeoutMs) return false;
+    waitMs = min<uint32_t>(waitMs, kPingTimeoutMs - (now - gPingSentMs));
+    return true;
+  }
+  if (now - gLastSendMs >= kPingIdleMs) {
+    const uint8_t ping[] = {0xC0, 0x00};
+    if (!sendAll(gFd, reinterpret_cast<const char*>(ping), sizeof(ping))) return false;
+    gLastSendMs = now;
+    gPingSentMs = now;
+    waitMs = min<uint32_t>(waitMs, kPingTimeoutMs);
+    return true;
+  }
+  waitMs = min<uint32_t>(waitMs, kPingIdleMs - (now - gLastSendMs));
+  return true;
+}
+
+void mqttTaskMain(void* param) {
+  (void)param;
+  uint32_t retryMs = kRetryMinMs;
+  uint32_t retryAtMs = 0;
+  for (;;) {
+    if (!gOnline.load()) {
+      disconnect();
+      retryAtMs = millis();
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+
+    if (gFd < 0) {
+      const int32_t untilMs = static_cast<int32_t>(retryAtMs - millis());
+      if (untilMs > 0) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(untilMs));
+        continue;
+      }
+      if (!brokerConnect()) {
+        disconnect();
+        portENTER_CRITICAL(&gLock);
+        gStats.connectFailures++;
+        portEXIT_CRITICAL(&gLock);
+        Serial.printf("[MQTT] Connect to %s:%u failed, retry in %u s\n",
+                      gCfg.host,
+                      static_cast<unsigned>(gCfg.port),
+                      static_cast<unsigned>(retryMs / 1000));
+        retryAtMs = millis() + retryMs;
+        retryMs = min(retryMs * 2, kRetryMaxMs);
+        continue;
+      }
+      retryMs = kRetryMinMs;
+    }
+
+    uint32_t waitMs = kPingIdleMs;
+    if (!serviceSocket() || !drain(waitMs) || !keepAlive(waitMs)) {
+      disconnect();
+      retryAtMs = millis() + retryMs;
+      continue;
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+  }
+}
+
+}  // namespace
+
+bool mqttStart(const MqttConfig& cfg) {
+  if (gTask) return true;
+  if (cfg.host == nullptr || cfg.host[0] == '\0') return false;
+  gCfg = cfg;
+  return xTaskCreatePinnedToCore(mqttTaskMain, "mqtt", kTaskStack, nullptr, 1, &gTask, 0) ==
+         pdPASS;
+}
+
+void mqttSetOnline(bool online) {
+  if (gOnline.exchange(online) == online) return;
+  if (gTask) xTaskNotifyGive(gTask);
+}
+
+bool mqttQueue(const MqttReading& r) {
+  if (!gTask) return false;
+  portENTER_CRITICAL(&gLock);
+  if (gQueue.size() == gQueue.capacity()) gStats.dropped++;
+  gQueue.push(r);
+  gStats.queued = gQueue.size();
+  gStats.queueMax = max<uint32_t>(gStats.queueMax, gStats.queued);
+  portEXIT_CRITICAL(&gLock);
+  xTaskNotifyGive(gTask);
+  return true;
+}
+
+MqttStats mqttStats() {
+  portENTER_CRITICAL(&gLock);
+  const MqttStats st = gStats;
+  portEXIT_CRITICAL(&gLock);
+  return st;
+}
@@ -0,0 +1,186 @@
+#include "power_governor.h"
+
+#include <driver/gpio.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+
+#include <atomic>
+
+// CPU clock per mode. 80 MHz is the lowest that keeps the APB, and with it SPI and Wi-Fi,
+// at full rate.
+#ifndef POWER_ACTIVE_MHZ
+#define POWER_ACTIVE_MHZ 240
+#endif
+
+#ifndef POWER_DIMMED_MHZ
+#define POWER_DIMMED_MHZ 80
+#endif
+
+// Set to 0 to keep the CPU awake while dimmed even when the framework supports light sleep.
+#ifndef POWER_LIGHT_SLEEP
+#define POWER_LIGHT_SLEEP 1
+#endif
+
+namespace {
+
+// Coulomb counts over a whole interval are exact but coarse (0.36 mAh each); until a mode
+// has this much measured time its average comes from instantaneous ADC samples instead.
+constexpr uint32_t kCoulombMinMs = 10 * 60 * 1000;
+// Instantaneous samples this soon after a mode switch still see the previous mode.
+constexpr uint32_t kSampleSettleMs = 1000;
+
+struct ModeAccount {
+  uint32_t ms = 0;            // completed stays; the current one is added on read
+  uint32_t coulombCounts = 0;
+  uint32_t coulombMs = 0;     // intervals spent wholly in this mode, on battery
+  uint32_t sampleMaSum = 0;
+  uint32_t samples = 0;
+};
+
+enum class Pm : uint8_t { None, Dfs, DfsLightSleep };
+
+gpio_num_t gWakePin = GPIO_NUM_NC;
+Pm gPm = Pm::None;
+PowerMode gMode = PowerMode::Active;
+uint32_t gModeSinceMs = 0;
+std::atomic<bool> gWakeArmed{false};
+
+ModeAccount gModes[kPowerModeCount];
+PowerReading gLast;
+bool gLastValid = false;
+uint8_t gBatteryPct = 0;
+
+bool pmConfigure(uint32_t mhz, bool lightSleep) {
+  esp_pm_config_esp32_t cfg = {};
+  cfg.max_freq_mhz = static_cast<int>(mhz);
+  cfg.min_freq_mhz = static_cast<int>(mhz);
+  cfg.light_sleep_enable = lightSleep;
+  return esp_pm_configure(&cfg) == ESP_OK;
+}
+
+void applyMode(PowerMode mode) {
+  const bool dimmed = mode == PowerMode::Dimmed;
+  const uint32_t mhz = dimmed ? POWER_DIMMED_MHZ : POWER_ACTIVE_MHZ;
+  const bool sleep = dimmed && gPm == Pm::DfsLightSleep;
+  if (gPm == Pm::None) {
+    setCpuFrequencyMhz(mhz);
+  } else {
+    pmConfigure(mhz, sleep);
+  }
+
+  // GPIO wakeup only supports level triggers, which would also turn the pin's regular
+  // interrupt into one; it is armed for the dimmed stay only.
+  if (sleep) {
+    gpio_wakeup_enable(gWakePin, GPIO_INTR_LOW_LEVEL);
+    gWakeArmed = true;
+  } else if (gPm == Pm::DfsLightSleep) {
+    gWakeArmed = false;
+    gpio_wakeup_disable(gWakePin);
+    gpio_set_intr_type(gWakePin, GPIO_INTR_NEGEDGE);
+  }
+}
+
+uint16_t modeAvgMa(const ModeAccount& a) {
+  if (a.coulombMs >= kCoulombMinMs && a.coulombCounts > 0) {
+    // counts * kAxpCoulombMah over coulombMs, in mA.
+    return static_cast<uint16_t>(
+        min<uint64_t>(a.coulombCounts * 3600000ULL * kAxpCoulombMah / a.coulombMs, 65535));
+  }
+  return a.samples ? static_cast<uint16_t>(a.sampleMaSum / a.samples) : 0;
+}
+
+}  // namespace
+
+void powerGovernorBegin(uint8_t wakePin) {
+  gWakePin = static_cast<gpio_num_t>(wakePin);
+  // esp_pm_configure() refuses light sleep without tickless idle, and everything without
+  // CONFIG_PM_ENABLE; the stock Arduino core has neither.
+  if (POWER_LIGHT_SLEEP && pmConfigure(POWER_ACTIVE_MHZ, true)) {
+    gPm = Pm::DfsLightSleep;
+    esp_sleep_enable_gpio_wakeup();
+  } else if (pmConfigure(POWER_ACTIVE_MHZ, false)) {
+    gPm = Pm::Dfs;
+  }
+  gMode = PowerMode::Active;
+  gModeSinceMs = millis();
+  applyMode(gMode);
+  Serial.printf("[Power] %s; %u MHz active, %u MHz dimmed\n",
+                gPm == Pm::DfsLightSleep ? "Light sleep while dimmed"
+                : gPm == Pm::Dfs         ? "No light sleep (tickless idle off)"
+                                         : "No power management; clock scaling only",
+                static_cast<unsigned>(POWER_ACTIVE_MHZ),
+                static_cast<unsigned>(POWER_DIMMED_MHZ));
+}
+
+void powerSetMode(PowerMode mode) {
+  if (mode == gMode) return;
+  const uint32_t now = millis();
+  gModes[static_cast<uint8_t>(gMode)].ms += now - gModeSinceMs;
+  gMode = mode;
+  gModeSinceMs = now;
+  applyMode(mode);
+}
+
+PowerMode powerMode() { return gMode; }
+
+void powerNoteReading(const PowerReading& r, uint8_t batteryPct) {
+  gBatteryPct = batteryPct;
+  ModeAccount& a = gModes[static_cast<uint8_t>(gMode)];
+  if (!r.externalPower) {
+    if (static_cast<int32_t>(r.ms - gModeSinceMs) >= static_cast<int32_t>(kSampleSettleMs)) {
+      a.sampleMaSum += r.dischargeMa;
+      a.samples++;
+    }
+    // Only intervals that started after the last switch belong wholly to this mode.
+    if (gLastValid && !gLast.externalPower &&
+        static_cast<int32_t>(gLast.ms - gModeSinceMs) >= 0) {
+      a.coulombCounts += r.coulombOut - gLast.coulombOut;
+      a.coulombMs += r.ms - gLast.ms;
+    }
+  }
+  gLast = r;
+  gLastValid = true;
+}
+
+PowerGovernorStats powerGovernorStats() {
+  PowerGovernorStats s;
+  s.mode = gMode;
+  s.cpuMhz = static_cast<uint16_t>(getCpuFrequencyMhz());
+  s.lightSleep = gPm == Pm::DfsLightSleep;
+  s.externalPower = gLastValid && gLast.externalPower;
+  s.nowMa = gLastValid ? gLast.dischargeMa : 0;
+
+  // Runtime at the time-weighted mix of the measured modes.
+  uint64_t maMs = 0;
+  uint64_t ms = 0;
+  for (uint8_t i = 0; i < kPowerModeCount; i++) {
+    PowerModeStats& m = s.modes[i];
+    m.ms = gModes[i].ms + (i == static_cast<uint8_t>(gMode) ? millis() - gModeSinceMs : 0);
+    m.avgMa = modeAvgMa(gModes[i]);
+    if (m.avgMa == 0) continue;
+    maMs += static_cast<uint64_t>(m.avgMa) * m.ms;
+    ms += m.ms;
+  }
+  if (!s.externalPower && maMs > 0) {
+    const uint32_t mixMa = static_cast<uint32_t>(max<uint64_t>(maMs / ms, 1));
+    s.runtimeMin = BATTERY_CAPACITY_MAH * gBatteryPct * 60UL / 100 / mixMa;
+  }
+  return s;
+}
+
+const char* powerModeName(PowerMode mode) {
+  switch (mode) {
+    case PowerMode::Active:
+      return "active";
+    case PowerMode::Dimmed:
+      return "dimmed";
+    case PowerMode::Count:
+      break;
+  }
+  return "?";
+}
+
+void IRAM_ATTR powerWakeFromIsr() {
+  if (!gWakeArmed.exchange(false)) return;
+  gpio_set_intr_type(gWakePin, GPIO_INTR_NEGEDGE);
+}
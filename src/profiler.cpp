@@ -0,0 +1,143 @@
+#include "profiler.h"
+
+#if PROFILER
+
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+// Bucket 0..3 hold 0..3 cycles exactly; above that each octave [2^o, 2^(o+1)) is split
+// into 4 equal buckets, so 32-bit counts need 4 * 31 + 4 buckets.
+constexpr uint8_t kSubBits = 2;
+constexpr uint8_t kBuckets = (32 - kSubBits + 1) << kSubBits;
+
+struct Histogram {
+  uint32_t buckets[kBuckets];
+  uint32_t count;
+  uint32_t max;
+};
+
+const char* const kScopeNames[kProfScopeCount] = {
+    "loop",
+    "touch",
+    "m5.update",
+    "wifiTick",
+    "inputTick",
+    "uiCompose",
+    "render",
+    "ticker",
+    "weatherTick",
+    "powerTick",
+};
+
+// Scopes are recorded on the loop and render tasks and read by loop(); a sample is a few
+// increments, short enough for a spinlock.
+portMUX_TYPE gLock = portMUX_INITIALIZER_UNLOCKED;
+Histogram gHist[kProfScopeCount];
+std::atomic<bool> gEnabled{true};
+
+uint8_t bucketOf(uint32_t cycles) {
+  if (cycles < (1u << kSubBits)) return static_cast<uint8_t>(cycles);
+  const uint8_t octave = static_cast<uint8_t>(31 - __builtin_clz(cycles));
+  const uint32_t sub = (cycles >> (octave - kSubBits)) & ((1u << kSubBits) - 1);
+  return static_cast<uint8_t>(((octave - kSubBits + 1) << kSubBits) + sub);
+}
+
+// Largest value that lands in bucket `b`.
+uint32_t bucketUpper(uint8_t b) {
+  if (b < (1u << kSubBits)) return b;
+  const uint8_t octave = static_cast<uint8_t>((b >> kSubBits) + kSubBits - 1);
+  const uint32_t sub = b & ((1u << kSubBits) - 1);
+  const uint64_t lower =
+      (1ULL << octave) + (static_cast<uint64_t>(sub) << (octave - kSubBits));
+  return static_cast<uint32_t>(lower + (1ULL << (octave - kSubBits)) - 1);
+}
+
+uint32_t quantile(const Histogram& h, uint32_t permille) {
+  if (h.count == 0) return 0;
+  const uint64_t rank = (static_cast<uint64_t>(h.count) * permille + 999) / 1000;
+  uint64_t seen = 0;
+  for (uint8_t b = 0; b < kBuckets; b++) {
+    seen += h.buckets[b];
+    if (seen >= rank) return min(bucketUpper(b), h.max);
+  }
+  return h.max;
+}
+
+}  // namespace
+
+void profRecord(ProfScope scope, uint32_t cycles) {
+  if (!gEnabled.load(std::memory_order_relaxed)) return;
+  Histogram& h = gHist[static_cast<uint8_t>(scope)];
+  const uint8_t b = bucketOf(cycles);
+  portENTER_CRITICAL(&gLock);
+  h.buckets[b]++;
+  h.count++;
+  if (cycles > h.max) h.max = cycles;
+  portEXIT_CRITICAL(&gLock);
+}
+
+void profSetEnabled(bool enabled) { gEnabled = enabled; }
+
+bool profEnabled() { return gEnabled; }
+
+void profReset() {
+  portENTER_CRITICAL(&gLock);
+  memset(gHist, 0, sizeof(gHist));
+  portEXIT_CRITICAL(&gLock);
+}
+
+ProfSummary profSummary(ProfScope scope) {
+  Histogram h;
+  portENTER_CRITICAL(&gLock);
+  h = gHist[static_cast<uint8_t>(scope)];
+  portEXIT_CRITICAL(&gLock);
+
+  ProfSummary s;
+  s.name = kScopeNames[static_cast<uint8_t>(scope)];
+  s.count = h.count;
+  s.p50Cycles = quantile(h, 500);
+  s.p99Cycles = quantile(h, 990);
+  s.maxCycles = h.max;
+  return s;
+}
+
+void profFormatUs(uint32_t cycles, char* out, size_t len) {
+  const uint32_t mhz = max<uint32_t>(ESP.getCpuFreqMHz(), 1);
+  const uint32_t tenths = static_cast<uint32_t>(cycles * 10ULL / mhz);
+  if (tenths < 1000) {
+    snprintf(out,
+             len,
+             "%u.%u",
+             static_cast<unsigned>(tenths / 10),
+             static_cast<unsigned>(tenths % 10));
+  } else {
+    snprintf(out, len, "%u", static_cast<unsigned>(tenths / 10));
+  }
+}
+
+void profDump(Print& out) {
+  // Each printf() stays under 64 characters, which Print formats without allocating.
+  out.printf("[Prof] %-12s %8s %8s %8s %8s", "scope", "n", "p50", "p99", "max");
+  out.printf(" (us at %u MHz)%s\n",
+             static_cast<unsigned>(ESP.getCpuFreqMHz()),
+             profEnabled() ? "" : ", paused");
+  char p50[12];
+  char p99[12];
+  char mx[12];
+  for (uint8_t i = 0; i < kProfScopeCount; i++) {
+    const ProfSummary s = profSummary(static_cast<ProfScope>(i));
+    profFormatUs(s.p50Cycles, p50, sizeof(p50));
+    profFormatUs(s.p99Cycles, p99, sizeof(p99));
+    profFormatUs(s.maxCycles, mx, sizeof(mx));
+    out.printf("[Prof] %-12s %8u %8s %8s %8s\n",
+               s.name,
+               static_cast<unsigned>(s.count),
+               p50,
+               p99,
+               mx);
+  }
+}
+
+#endif  // PROFILER
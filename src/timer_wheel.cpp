@@ -0,0 +1,229 @@
+#include "timer_wheel.h"
+
+namespace {
+
+constexpr uint8_t kLevelBits = 6;
+constexpr uint32_t kSlots = 1u << kLevelBits;
+constexpr uint32_t kSlotMask = kSlots - 1;
+constexpr uint8_t kLevels = 4;
+constexpr uint32_t kWheelSpanMs = 1u << (kLevelBits * kLevels);
+constexpr uint16_t kReady = kLevels * kSlots;  // slot value for the ready list
+constexpr uint16_t kIdle = UINT16_MAX;
+
+// Slot lists are unordered; the ready list runs first in, first out.
+TimerJob* gSlots[kLevels * kSlots] = {};
+uint64_t gOccupied[kLevels] = {};
+TimerJob* gReadyHead = nullptr;
+TimerJob* gReadyTail = nullptr;
+uint32_t gPass = 0;
+uint32_t gWheelMs = 0;  // every slot up to this time has been expired
+bool gStarted = false;
+TimerJob* gKnown = nullptr;
+
+void begin(uint32_t nowMs) {
+  if (gStarted) return;
+  gStarted = true;
+  gWheelMs = nowMs;
+}
+
+bool wheelEmpty() {
+  for (const uint64_t occ : gOccupied) {
+    if (occ) return false;
+  }
+  return true;
+}
+
+void unlink(TimerJob& job) {
+  if (job.slot == kReady) {
+    (job.prev ? job.prev->next : gReadyHead) = job.next;
+    (job.next ? job.next->prev : gReadyTail) = job.prev;
+  } else {
+    (job.prev ? job.prev->next : gSlots[job.slot]) = job.next;
+    if (job.next) job.next->prev = job.prev;
+    if (!gSlots[job.slot]) gOccupied[job.slot >> kLevelBits] &= ~(1ULL << (job.slot & kSlotMask));
+  }
+  job.prev = job.next = nullptr;
+  job.slot = kIdle;
+}
+
+void pushReady(TimerJob& job) {
+  job.slot = kReady;
+  job.readyPass = gPass;
+  job.prev = gReadyTail;
+  job.next = nullptr;
+  (gReadyTail ? gReadyTail->next : gReadyHead) = &job;
+  gReadyTail = &job;
+}
+
+// Files an unlinked job on the level whose span covers how far ahead of the wheel it is due.
+void file(TimerJob& job) {
+  const int32_t ahead = static_cast<int32_t>(job.dueMs - gWheelMs);
+  if (ahead <= 0) {
+    pushReady(job);
+    return;
+  }
+  uint32_t at = job.dueMs;
+  uint8_t level = 0;
+  if (static_cast<uint32_t>(ahead) >= kWheelSpanMs) {
+    at = gWheelMs + kWheelSpanMs - 1;  // parked; re-filed when the wheel gets there
+    level = kLevels - 1;
+  } else {
+    while (static_cast<uint32_t>(ahead) >> (kLevelBits * (level + 1))) level++;
+  }
+  const uint32_t index = (at >> (kLevelBits * level)) & kSlotMask;
+  const uint16_t slot = static_cast<uint16_t>(level * kSlots + index);
+  job.slot = slot;
+  job.prev = nullptr;
+  job.next = gSlots[slot];
+  if (job.next) job.next->prev = &job;
+  gSlots[slot] = &job;
+  gOccupied[level] |= 1ULL << index;
+}
+
+// Empties the slot of `level` the wheel has just entered, re-filing its jobs on lower levels.
+// Returns the slot's index: 0 means the next level up has turned over too.
+uint32_t cascade(uint8_t level) {
+  const uint32_t index = (gWheelMs >> (kLevelBits * level)) & kSlotMask;
+  TimerJob* job = gSlots[level * kSlots + index];
+  gSlots[level * kSlots + index] = nullptr;
+  gOccupied[level] &= ~(1ULL << index);
+  while (job) {
+    TimerJob* next = job->next;
+    file(*job);
+    job = next;
+  }
+  return index;
+}
+
+// Walks the wheel to `nowMs`, moving expired jobs to the ready list. Empty stretches are
+// skipped a window (or the rest of one) at a time.
+void advance(uint32_t nowMs) {
+  if (wheelEmpty()) {
+    if (static_cast<int32_t>(nowMs - gWheelMs) > 0) gWheelMs = nowMs;
+    return;
+  }
+  while (static_cast<int32_t>(nowMs - gWheelMs) > 0) {
+    const uint32_t pos = gWheelMs & kSlotMask;
+    const uint64_t later = pos == kSlotMask ? 0 : gOccupied[0] & (~0ULL << (pos + 1));
+    const uint32_t step = later ? __builtin_ctzll(later) - pos : kSlots - pos;
+    if (step > nowMs - gWheelMs) {
+      gWheelMs = nowMs;
+      return;
+    }
+    gWheelMs += step;
+    const uint32_t index = gWheelMs & kSlotMask;
+    if (index == 0) {
+      for (uint8_t level = 1; level < kLevels && cascade(level) == 0; level++) {
+      }
+    }
+    TimerJob* job = gSlots[index];
+    gSlots[index] = nullptr;
+    gOccupied[0] &= ~(1ULL << index);
+    while (job) {
+      TimerJob* next = job->next;
+      pushReady(*job);
+      job = next;
+    }
+  }
+}
+
+}  // namespace
+
+void timerStart(TimerJob& job, uint32_t delayMs, uint32_t periodMs) {
+  timerStartAt(job, millis() + delayMs, periodMs);
+}
+
+void timerStartAt(TimerJob& job, uint32_t dueMs, uint32_t periodMs) {
+  begin(millis());
+  if (job.slot != kIdle) unlink(job);
+  if (!job.known) {
+    job.known = true;
+    job.nextKnown = gKnown;
+    gKnown = &job;
+  }
+  job.dueMs = dueMs;
+  job.periodMs = periodMs;
+  file(job);
+}
+
+void timerStop(TimerJob& job) {
+  if (job.slot != kIdle) unlink(job);
+}
+
+bool timerArmed(const TimerJob& job) { return job.slot != kIdle; }
+
+uint32_t timerRun(uint32_t nowMs) {
+  begin(nowMs);
+  advance(nowMs);
+  // Jobs made ready from here on carry the new pass number and wait for the next call.
+  gPass++;
+  uint32_t ran = 0;
+  while (gReadyHead && gReadyHead->readyPass != gPass) {
+    TimerJob& job = *gReadyHead;
+    unlink(job);
+    const uint32_t t = millis();
+    const int32_t late = static_cast<int32_t>(t - job.dueMs);
+    const uint32_t lateMs = late > 0 ? static_cast<uint32_t>(late) : 0;
+    job.stats.runs++;
+    job.stats.lateMsTotal += lateMs;
+    job.stats.lateMsMax = max(job.stats.lateMsMax, lateMs);
+    // Re-armed before the call, so the callback can stop or move it.
+    if (job.periodMs != 0) {
+      job.dueMs += job.periodMs;
+      if (timeReached(t, job.dueMs)) job.dueMs = t + job.periodMs;
+      file(job);
+    }
+    job.fn(t);
+    ran++;
+  }
+  return ran;
+}
+
+bool timerNextDue(uint32_t& dueMs) {
+  if (gReadyHead) {
+    dueMs = gWheelMs;
+    return true;
+  }
+  bool found = false;
+  for (uint8_t level = 0; level < kLevels; level++) {
+    const uint64_t occ = gOccupied[level];
+    if (!occ) continue;
+    // The first occupied slot after the current one holds this level's earliest jobs. A job
+    // parked there from further out counts as due when the wheel reaches the slot, which
+    // is when it gets re-filed.
+    const uint8_t shift = kLevelBits * level;
+    const uint32_t pos = (gWheelMs >> shift) & kSlotMask;
+    const uint64_t later = pos == kSlotMask ? 0 : occ & (~0ULL << (pos + 1));
+    const uint32_t index = __builtin_ctzll(later ? later : occ);
+    const uint32_t ahead = ((index - pos - 1) & kSlotMask) + 1;
+    const uint32_t startMs = ((gWheelMs >> shift) + ahead) << shift;
+    for (const TimerJob* job = gSlots[level * kSlots + index]; job; job = job->next) {
+      const uint32_t at = job->dueMs - startMs < (1u << shift) ? job->dueMs : startMs;
+      if (!found || static_cast<int32_t>(at - dueMs) < 0) dueMs = at;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void timerReport(Print& out) {
+  static char line[256];
+  size_t n = snprintf(line, sizeof(line), "[Sched] late ms avg/max (runs):");
+  for (TimerJob* job = gKnown; job; job = job->nextKnown) {
+    TimerJobStats& s = job->stats;
+    if (s.runs == 0) continue;
+    if (n < sizeof(line)) {
+      n += snprintf(line + n,
+                    sizeof(line) - n,
+                    " %s %u/%u (%u)",
+                    job->name,
+                    static_cast<unsigned>(s.lateMsTotal / s.runs),
+                    static_cast<unsigned>(s.lateMsMax),
+                    static_cast<unsigned>(s.runs));
+    }
+    s = TimerJobStats();
+  }
+  n = min(n, sizeof(line) - 2);
+  line[n++] = '\n';
+  out.write(reinterpret_cast<const uint8_t*>(line), n);
+}
@@ -0,0 +1,207 @@
+#include "ts_codec.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t kPayloadBits = kTsPayloadBytes * 8;
+
+// Largest encoding of one point: '1111' + 32-bit delta, then per column
+// '11' + 5 + 5 + 32 bits. The raw first point (32 + 32 per column) is smaller.
+constexpr uint32_t worstPointBits(uint8_t cols) { return 36u + 44u * cols; }
+
+}  // namespace
+
+void TsEncoder::reset(TsSegment* seg, uint8_t cols) {
+  seg_ = seg;
+  st_ = TsCodecState();
+  memset(static_cast<void*>(seg), 0, sizeof(*seg));
+  seg->hdr.magic = kTsSegmentMagic;
+  seg->hdr.cols = cols;
+}
+
+bool TsEncoder::resume(TsSegment* seg) {
+  TsDecoder dec(*seg);
+  uint32_t ts;
+  int32_t values[kTsMaxCols];
+  while (dec.next(ts, values)) {
+  }
+  const TsCodecState& st = dec.state();
+  if (dec.corrupt() || st.count != seg->hdr.count || st.bitPos != seg->hdr.bits) return false;
+  seg_ = seg;
+  st_ = st;
+  return true;
+}
+
+void TsEncoder::putBits(uint32_t v, uint8_t n) {
+  while (n > 0) {
+    const uint32_t byte = st_.bitPos >> 3;
+    const uint8_t used = st_.bitPos & 7;
+    const uint8_t room = 8 - used;
+    const uint8_t take = n < room ? n : room;
+    const uint8_t chunk = (v >> (n - take)) & ((1u << take) - 1);
+    if (used == 0) seg_->payload[byte] = 0;
+    seg_->payload[byte] |= chunk << (room - take);
+    st_.bitPos += take;
+    n -= take;
+  }
+}
+
+bool TsEncoder::append(uint32_t ts, const int32_t* values) {
+  TsSegmentHeader& h = seg_->hdr;
+  if (st_.bitPos + worstPointBits(h.cols) > kPayloadBits) return false;
+  if (st_.count == UINT16_MAX) return false;
+  if (st_.count > 0 && ts <= st_.prevTs) return false;
+
+  if (st_.count == 0) {
+    putBits(ts, 32);
+    for (uint8_t c = 0; c < h.cols; c++) {
+      putBits(static_cast<uint32_t>(values[c]), 32);
+      st_.prev[c] = values[c];
+    }
+    h.firstTs = ts;
+  } else {
+    const int64_t delta = static_cast<int64_t>(ts) - st_.prevTs;
+    const int64_t dod = delta - st_.prevDelta;
+    if (dod == 0) {
+      putBits(0b0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+      putBits(0b10, 2);
+      putBits(static_cast<uint32_t>(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+      putBits(0b110, 3);
+      putBits(static_cast<uint32_t>(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+      putBits(0b1110, 4);
+      putBits(static_cast<uint32_t>(dod + 2047), 12);
+    } else {
+      putBits(0b1111, 4);
+      putBits(static_cast<uint32_t>(delta), 32);
+    }
+    st_.prevDelta = delta;
+
+    for (uint8_t c = 0; c < h.cols; c++) {
+      const uint32_t x = static_cast<uint32_t>(values[c]) ^ static_cast<uint32_t>(st_.prev[c]);
+      st_.prev[c] = values[c];
+      if (x == 0) {
+        putBits(0b0, 1);
+        continue;
+      }
+      const uint8_t lead = __builtin_clz(x);
+      const uint8_t trail = __builtin_ctz(x);
+      if (st_.window[c] && lead >= st_.lead[c] && trail >= st_.trail[c]) {
+        putBits(0b10, 2);
+        putBits(x >> st_.trail[c], 32 - st_.lead[c] - st_.trail[c]);
+        continue;
+      }
+      const uint8_t len = 32 - lead - trail;
+      putBits(0b11, 2);
+      putBits(lead, 5);
+      putBits(len - 1, 5);
+      putBits(x >> trail, len);
+      st_.lead[c] = lead;
+      st_.trail[c] = trail;
+      st_.window[c] = true;
+    }
+  }
+
+  st_.prevTs = ts;
+  st_.count++;
+  h.count = st_.count;
+  h.bits = static_cast<uint16_t>(st_.bitPos);
+  h.lastTs = ts;
+  return true;
+}
+
+bool TsDecoder::getBits(uint8_t n, uint32_t& out) {
+  if (st_.bitPos + n > seg_.hdr.bits) {
+    corrupt_ = true;
+    return false;
+  }
+  out = 0;
+  while (n > 0) {
+    const uint8_t byte = seg_.payload[st_.bitPos >> 3];
+    const uint8_t used = st_.bitPos & 7;
+    const uint8_t room = 8 - used;
+    const uint8_t take = n < room ? n : room;
+    const uint8_t chunk = (byte >> (room - take)) & ((1u << take) - 1);
+    out = (out << take) | chunk;
+    st_.bitPos += take;
+    n -= take;
+  }
+  return true;
+}
+
+bool TsDecoder::next(uint32_t& ts, int32_t* values) {
+  const uint8_t cols = seg_.hdr.cols;
+  if (corrupt_ || st_.count >= seg_.hdr.count) return false;
+  if (cols == 0 || cols > kTsMaxCols || seg_.hdr.bits > kPayloadBits) {
+    corrupt_ = true;
+    return false;
+  }
+
+  uint32_t v = 0;
+  if (st_.count == 0) {
+    if (!getBits(32, v)) return false;
+    ts = v;
+    for (uint8_t c = 0; c < cols; c++) {
+      if (!getBits(32, v)) return false;
+      st_.prev[c] = static_cast<int32_t>(v);
+    }
+  } else {
+    // Count the '1' prefix bits (at most four) to find the bucket.
+    uint8_t ones = 0;
+    while (ones < 4) {
+      if (!getBits(1, v)) return false;
+      if (v == 0) break;
+      ones++;
+    }
+    static constexpr uint8_t kBucketBits[] = {0, 7, 9, 12};
+    static constexpr int16_t kBucketBias[] = {0, 63, 255, 2047};
+    int64_t delta;
+    if (ones == 4) {
+      if (!getBits(32, v)) return false;
+      delta = v;
+    } else {
+      v = 0;
+      if (ones > 0 && !getBits(kBucketBits[ones], v)) return false;
+      delta = st_.prevDelta + (static_cast<int64_t>(v) - kBucketBias[ones]);
+    }
+    if (delta <= 0 || st_.prevTs + delta > UINT32_MAX) {
+      corrupt_ = true;
+      return false;
+    }
+    st_.prevDelta = delta;
+    ts = static_cast<uint32_t>(st_.prevTs + delta);
+
+    for (uint8_t c = 0; c < cols; c++) {
+      if (!getBits(1, v)) return false;
+      if (v == 0) continue;
+      if (!getBits(1, v)) return false;
+      if (v == 1) {
+        uint32_t lead;
+        uint32_t len;
+        if (!getBits(5, lead) || !getBits(5, len)) return false;
+        len += 1;
+        if (lead + len > 32) {
+          corrupt_ = true;
+          return false;
+        }
+        st_.lead[c] = lead;
+        st_.trail[c] = 32 - lead - len;
+        st_.window[c] = true;
+      } else if (!st_.window[c]) {
+        corrupt_ = true;
+        return false;
+      }
+      const uint8_t len = 32 - st_.lead[c] - st_.trail[c];
+      if (!getBits(len, v)) return false;
+      st_.prev[c] ^= static_cast<int32_t>(v << st_.trail[c]);
+    }
+  }
+
+  for (uint8_t c = 0; c < cols; c++) values[c] = st_.prev[c];
+  st_.prevTs = ts;
+  st_.count++;
+  return true;
+}
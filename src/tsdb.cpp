@@ -0,0 +1,571 @@
+#include "tsdb.h"
+
+#include <LittleFS.h>
+
+#include <cstddef>
+
+#include "ts_codec.h"
+#include "weather_cache.h"
+
+namespace {
+
+constexpr uint32_t kTaskStack = 6144;
+constexpr UBaseType_t kQueueLen = 32;
+constexpr size_t kBlockBytes = 4096;  // LittleFS block size on the ESP32 flash
+constexpr const char* kDir = "/ts";
+
+constexpr size_t kSeriesCount = static_cast<size_t>(TsSeries::Count);
+constexpr size_t kTierCount = static_cast<size_t>(TsTier::Count);
+
+constexpr const char* kSeriesName[kSeriesCount] = {"rt", "rh", "rp", "rg", "ot"};
+constexpr char kTierName[kTierCount] = {'r', 'h', 'd'};
+constexpr uint8_t kTierCols[kTierCount] = {1, 3, 3};      // raw value; mean, min, max
+constexpr uint32_t kTierSec[kTierCount] = {0, 3600, 86400};
+// Segments per file generation. A raw segment holds roughly 500 slowly changing samples
+// (about 1.5 days at 10 s), a rollup segment about 100 hours or days.
+constexpr uint16_t kMaxSegments[kTierCount] = {64, 16, 4};
+
+enum class FileKind : uint8_t { Data, Index, OldData, OldIndex, Tail };
+constexpr const char* kFileExt[] = {"dat", "idx", "odt", "oix", "tail"};
+
+struct IndexEntry {
+  uint32_t firstTs;
+  uint32_t lastTs;
+};
+
+struct Item {
+  uint8_t series;
+  uint32_t ts;
+  int32_t value;
+};
+
+struct Stream {
+  TsSegment seg;  // open segment
+  TsEncoder enc;
+  uint16_t sealed = 0;  // segments in the current data file
+  uint32_t lastTs = 0;  // 0 while the tier is empty
+  bool dirty = false;   // appended since the last checkpoint
+};
+
+// Everything below is guarded by gMutex; the stats by gStatsLock.
+Stream gStreams[kSeriesCount][kTierCount];
+TsSegment gReadSeg;
+SemaphoreHandle_t gMutex = nullptr;
+QueueHandle_t gQueue = nullptr;
+TaskHandle_t gTask = nullptr;
+
+portMUX_TYPE gStatsLock = portMUX_INITIALIZER_UNLOCKED;
+TsStats gStats;
+uint64_t gEncodedBits = 0;
+
+Stream& stream(TsSeries s, TsTier t) {
+  return gStreams[static_cast<size_t>(s)][static_cast<size_t>(t)];
+}
+
+void filePath(char* out, size_t len, TsSeries s, TsTier t, FileKind kind) {
+  snprintf(out,
+           len,
+           "%s/%s-%c.%s",
+           kDir,
+           kSeriesName[static_cast<size_t>(s)],
+           kTierName[static_cast<size_t>(t)],
+           kFileExt[static_cast<size_t>(kind)]);
+}
+
+// LittleFS rewrites the partly filled last block of a file on every append, so a write
+// of `n` bytes at `offset` programs every block it touches from that block's start.
+void noteWrite(size_t offset, size_t n) {
+  portENTER_CRITICAL(&gStatsLock);
+  gStats.fsBytes += n;
+  gStats.fsBlocks += (offset % kBlockBytes + n + kBlockBytes - 1) / kBlockBytes;
+  portEXIT_CRITICAL(&gStatsLock);
+}
+
+bool appendFile(const char* path, const void* data, size_t n, size_t* newSize = nullptr) {
+  File f = LittleFS.open(path, FILE_APPEND);
+  if (!f) return false;
+  const size_t offset = f.size();
+  const size_t written = f.write(static_cast<const uint8_t*>(data), n);
+  f.close();
+  noteWrite(offset, written);
+  if (newSize) *newSize = offset + written;
+  return written == n;
+}
+
+bool rewriteFile(const char* path, const void* data, size_t n) {
+  File f = LittleFS.open(path, FILE_WRITE);
+  if (!f) return false;
+  const size_t written = f.write(static_cast<const uint8_t*>(data), n);
+  f.close();
+  noteWrite(0, written);
+  return written == n;
+}
+
+size_t fileSize(const char* path) {
+  if (!LittleFS.exists(path)) return 0;
+  File f = LittleFS.open(path, FILE_READ);
+  const size_t n = f ? f.size() : 0;
+  f.close();
+  return n;
+}
+
+uint32_t segmentCrc(const TsSegment& seg) {
+  const uint32_t crc = crc32Update(0, &seg.hdr, offsetof(TsSegmentHeader, crc));
+  return crc32Update(crc, seg.payload, (seg.hdr.bits + 7u) / 8u);
+}
+
+bool segmentValid(const TsSegment& seg, uint8_t cols) {
+  return seg.hdr.magic == kTsSegmentMagic && seg.hdr.cols == cols &&
+         seg.hdr.bits <= kTsPayloadBytes * 8 && seg.hdr.crc == segmentCrc(seg);
+}
+
+// Last index entry of a file, or false if it has none.
+bool lastIndexEntry(const char* path, IndexEntry& out) {
+  if (!LittleFS.exists(path)) return false;
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f) return false;
+  const size_t n = f.size();
+  const bool ok = n >= sizeof(out) && f.seek(n - n % sizeof(out) - sizeof(out)) &&
+                  f.read(reinterpret_cast<uint8_t*>(&out), sizeof(out)) == sizeof(out);
+  f.close();
+  return ok;
+}
+
+// Rewrites the index of the current data file from its segment headers (after a crash
+// between the data and index appends).
+void rebuildIndex(TsSeries s, TsTier t, uint16_t segments) {
+  char dataPath[32];
+  char idxPath[32];
+  filePath(dataPath, sizeof(dataPath), s, t, FileKind::Data);
+  filePath(idxPath, sizeof(idxPath), s, t, FileKind::Index);
+  File data = LittleFS.open(dataPath, FILE_READ);
+  File idx = LittleFS.open(idxPath, FILE_WRITE);
+  if (!data || !idx) return;
+  for (uint16_t i = 0; i < segments; i++) {
+    TsSegmentHeader hdr;
+    IndexEntry e = {0, 0};
+    if (data.seek(i * kTsSegmentBytes) &&
+        data.read(reinterpret_cast<uint8_t*>(&hdr), sizeof(hdr)) == sizeof(hdr)) {
+      e = {hdr.firstTs, hdr.lastTs};
+    }
+    idx.write(reinterpret_cast<const uint8_t*>(&e), sizeof(e));
+  }
+  data.close();
+  idx.close();
+  noteWrite(0, segments * sizeof(IndexEntry));
+  Serial.printf("[TS] Rebuilt index %s (%u segments)\n", idxPath, static_cast<unsigned>(segments));
+}
+
+// Starts a new generation: the current files replace the previous ones.
+void rotate(TsSeries s, TsTier t) {
+  char from[32];
+  char to[32];
+  static constexpr FileKind kPairs[][2] = {{FileKind::Data, FileKind::OldData},
+                                           {FileKind::Index, FileKind::OldIndex}};
+  for (const auto& pair : kPairs) {
+    filePath(from, sizeof(from), s, t, pair[0]);
+    filePath(to, sizeof(to), s, t, pair[1]);
+    if (LittleFS.exists(to)) LittleFS.remove(to);
+    LittleFS.rename(from, to);
+  }
+  stream(s, t).sealed = 0;
+}
+
+void seal(TsSeries s, TsTier t) {
+  Stream& st = stream(s, t);
+  char path[32];
+  st.seg.hdr.crc = segmentCrc(st.seg);
+
+  size_t dataSize = 0;
+  filePath(path, sizeof(path), s, t, FileKind::Data);
+  const bool dataOk = appendFile(path, &st.seg, kTsSegmentBytes, &dataSize);
+  st.sealed = dataSize / kTsSegmentBytes;
+  if (!dataOk) Serial.printf("[TS] Segment write failed (%s)\n", path);
+
+  const IndexEntry e = {st.seg.hdr.firstTs, st.seg.hdr.lastTs};
+  filePath(path, sizeof(path), s, t, FileKind::Index);
+  if (!appendFile(path, &e, sizeof(e)) || fileSize(path) != st.sealed * sizeof(e)) {
+    rebuildIndex(s, t, st.sealed);
+  }
+
+  portENTER_CRITICAL(&gStatsLock);
+  gStats.segments++;
+  portEXIT_CRITICAL(&gStatsLock);
+
+  if (st.sealed >= kMaxSegments[static_cast<size_t>(t)]) rotate(s, t);
+  // The tail file still holds this segment; restore() skips it by timestamp.
+  st.enc.reset(&st.seg, kTierCols[static_cast<size_t>(t)]);
+  st.dirty = false;
+}
+
+bool append(TsSeries s, TsTier t, uint32_t ts, const int32_t* values) {
+  Stream& st = stream(s, t);
+  if (ts == 0 || (st.lastTs != 0 && ts <= st.lastTs)) {
+    portENTER_CRITICAL(&gStatsLock);
+    gStats.rejected++;
+    portEXIT_CRITICAL(&gStatsLock);
+    return false;
+  }
+
+  uint32_t before = st.enc.bits();
+  if (!st.enc.append(ts, values)) {
+    seal(s, t);
+    before = 0;
+    if (!st.enc.append(ts, values)) return false;
+  }
+  st.lastTs = ts;
+  st.dirty = true;
+
+  portENTER_CRITICAL(&gStatsLock);
+  if (t == TsTier::Raw) {
+    gStats.points++;
+  } else {
+    gStats.rollups++;
+  }
+  gEncodedBits += st.enc.bits() - before;
+  gStats.rawBytes += 4 + 4 * kTierCols[static_cast<size_t>(t)];
+  portEXIT_CRITICAL(&gStatsLock);
+  return true;
+}
+
+void checkpoint() {
+  char path[32];
+  uint32_t written = 0;
+  for (size_t s = 0; s < kSeriesCount; s++) {
+    for (size_t t = 0; t < kTierCount; t++) {
+      Stream& st = gStreams[s][t];
+      if (!st.dirty) continue;
+      st.dirty = false;
+      st.seg.hdr.crc = segmentCrc(st.seg);
+      const TsSeries series = static_cast<TsSeries>(s);
+      filePath(path, sizeof(path), series, static_cast<TsTier>(t), FileKind::Tail);
+      if (rewriteFile(path, &st.seg, st.seg.usedBytes())) written++;
+    }
+  }
+
+  portENTER_CRITICAL(&gStatsLock);
+  gStats.checkpoints += written;
+  gStats.fsUsed = LittleFS.usedBytes();
+  portEXIT_CRITICAL(&gStatsLock);
+}
+
+void restore(TsSeries s, TsTier t) {
+  Stream& st = stream(s, t);
+  const uint8_t cols = kTierCols[static_cast<size_t>(t)];
+  char path[32];
+
+  filePath(path, sizeof(path), s, t, FileKind::Index);
+  const size_t idxSize = fileSize(path);
+  filePath(path, sizeof(path), s, t, FileKind::Data);
+  const size_t dataSize = fileSize(path);
+  st.sealed = dataSize / kTsSegmentBytes;
+  if (idxSize != st.sealed * sizeof(IndexEntry)) rebuildIndex(s, t, st.sealed);
+  if (dataSize % kTsSegmentBytes != 0) {
+    // Never appended to again: a torn segment would misalign everything after it.
+    Serial.printf("[TS] %s: partial segment; starting a new generation\n", path);
+    rotate(s, t);
+  }
+
+  IndexEntry last = {0, 0};
+  filePath(path, sizeof(path), s, t, st.sealed > 0 ? FileKind::Index : FileKind::OldIndex);
+  lastIndexEntry(path, last);
+
+  bool resumed = false;
+  filePath(path, sizeof(path), s, t, FileKind::Tail);
+  if (LittleFS.exists(path)) {
+    File f = LittleFS.open(path, FILE_READ);
+    const size_t n = f ? f.read(reinterpret_cast<uint8_t*>(&st.seg), sizeof(st.seg)) : 0;
+    f.close();
+    resumed = n >= sizeof(st.seg.hdr) && n >= st.seg.usedBytes() && segmentValid(st.seg, cols) &&
+              st.seg.hdr.count > 0 && st.seg.hdr.firstTs > last.lastTs && st.enc.resume(&st.seg);
+  }
+  if (!resumed) st.enc.reset(&st.seg, cols);
+
+  st.lastTs = st.enc.count() > 0 ? st.seg.hdr.lastTs : last.lastTs;
+  st.dirty = false;
+}
+
+int visitSegment(const TsSegment& seg, uint32_t fromTs, uint32_t toTs, TsVisitFn fn,
+                 void* ctx) {
+  TsDecoder dec(seg);
+  TsPoint p;
+  int32_t v[kTsMaxCols];
+  int visited = 0;
+  while (dec.next(p.ts, v)) {
+    if (p.ts < fromTs) continue;
+    if (p.ts >= toTs) break;
+    p.mean = v[0];
+    p.min = seg.hdr.cols == 3 ? v[1] : v[0];
+    p.max = seg.hdr.cols == 3 ? v[2] : v[0];
+    fn(p, ctx);
+    visited++;
+  }
+  return visited;
+}
+
+// Scans one generation's index in small chunks and decodes only overlapping segments.
+int queryFile(TsSeries s, TsTier t, bool old, uint32_t fromTs, uint32_t toTs, TsVisitFn fn,
+              void* ctx) {
+  char path[32];
+  filePath(path, sizeof(path), s, t, old ? FileKind::OldIndex : FileKind::Index);
+  if (!LittleFS.exists(path)) return 0;
+  File idx = LittleFS.open(path, FILE_READ);
+  if (!idx) return 0;
+  File data;
+
+  const uint8_t cols = kTierCols[static_cast<size_t>(t)];
+  IndexEntry chunk[16];
+  uint32_t base = 0;
+  int visited = 0;
+  bool done = false;
+  while (!done) {
+    const size_t n =
+        idx.read(reinterpret_cast<uint8_t*>(chunk), sizeof(chunk)) / sizeof(IndexEntry);
+    if (n == 0) break;
+    for (size_t k = 0; k < n; k++) {
+      const IndexEntry& e = chunk[k];
+      if (e.firstTs >= toTs) {
+        done = true;
+        break;
+      }
+      if (e.lastTs < fromTs) continue;
+      if (!data) {
+        filePath(path, sizeof(path), s, t, old ? FileKind::OldData : FileKind::Data);
+        data = LittleFS.open(path, FILE_READ);
+        if (!data) break;
+      }
+      if (!data.seek((base + k) * kTsSegmentBytes) ||
+          data.read(reinterpret_cast<uint8_t*>(&gReadSeg), kTsSegmentBytes) != kTsSegmentBytes ||
+          !segmentValid(gReadSeg, cols)) {
+        Serial.printf("[TS] %s: bad segment %u\n", path, static_cast<unsigned>(base + k));
+        continue;
+      }
+      visited += visitSegment(gReadSeg, fromTs, toTs, fn, ctx);
+    }
+    base += n;
+  }
+  data.close();
+  idx.close();
+  return visited;
+}
+
+int query(TsSeries s, TsTier t, uint32_t fromTs, uint32_t toTs, TsVisitFn fn, void* ctx) {
+  int visited = queryFile(s, t, true, fromTs, toTs, fn, ctx);
+  visited += queryFile(s, t, false, fromTs, toTs, fn, ctx);
+  const Stream& st = stream(s, t);
+  if (st.enc.count() > 0 && st.seg.hdr.lastTs >= fromTs && st.seg.hdr.firstTs < toTs) {
+    visited += visitSegment(st.seg, fromTs, toTs, fn, ctx);
+  }
+  return visited;
+}
+
+struct Rollup {
+  TsSeries series;
+  TsTier target;
+  uint32_t bucketSec;
+  uint32_t bucket;
+  uint32_t n;
+  int64_t sum;
+  int32_t min;
+  int32_t max;
+};
+
+int32_t roundedMean(int64_t sum, uint32_t n) {
+  return static_cast<int32_t>(sum >= 0 ? (sum + n / 2) / n : -((-sum + n / 2) / n));
+}
+
+void rollupEmit(Rollup& r) {
+  const int32_t v[3] = {roundedMean(r.sum, r.n), r.min, r.max};
+  append(r.series, r.target, r.bucket, v);
+  r.n = 0;
+}
+
+void rollupVisit(const TsPoint& p, void* ctx) {
+  Rollup& r = *static_cast<Rollup*>(ctx);
+  const uint32_t bucket = p.ts - p.ts % r.bucketSec;
+  if (r.n > 0 && bucket != r.bucket) rollupEmit(r);
+  if (r.n == 0) {
+    r.bucket = bucket;
+    r.sum = 0;
+    r.min = p.min;
+    r.max = p.max;
+  }
+  r.sum += p.mean;
+  r.min = min(r.min, p.min);
+  r.max = max(r.max, p.max);
+  r.n++;
+}
+
+// Folds every completed bucket of `src` that `dst` does not have yet. A bucket counts as
+// completed once `src` has a point in a later one; buckets without points are skipped.
+void compact(TsSeries s, TsTier src, TsTier dst) {
+  const uint32_t srcLast = stream(s, src).lastTs;
+  const uint32_t dstLast = stream(s, dst).lastTs;
+  const uint32_t bucketSec = kTierSec[static_cast<size_t>(dst)];
+  if (srcLast == 0) return;
+  const uint32_t end = srcLast - srcLast % bucketSec;
+  const uint32_t from = dstLast != 0 ? dstLast + bucketSec : 0;
+  if (from >= end) return;
+
+  Rollup r = {s, dst, bucketSec, 0, 0, 0, 0, 0};
+  query(s, src, from, end, rollupVisit, &r);
+  if (r.n > 0) rollupEmit(r);
+}
+
+void tsTaskMain(void* param) {
+  (void)param;
+  uint32_t nextCheckpointMs = millis() + TS_CHECKPOINT_MS;
+  for (;;) {
+    const int32_t waitMs = static_cast<int32_t>(nextCheckpointMs - millis());
+    Item item;
+    // Only peeks: taking the point before the mutex would let tsFlush() store later ones
+    // first, and this one would then be rejected as out of order.
+    xQueuePeek(gQueue, &item, waitMs > 0 ? pdMS_TO_TICKS(waitMs) : 0);
+
+    xSemaphoreTake(gMutex, portMAX_DELAY);
+    bool got = xQueueReceive(gQueue, &item, 0) == pdTRUE;
+    while (got) {
+      append(static_cast<TsSeries>(item.series), TsTier::Raw, item.ts, &item.value);
+      got = xQueueReceive(gQueue, &item, 0) == pdTRUE;
+    }
+    for (size_t s = 0; s < kSeriesCount; s++) {
+      compact(static_cast<TsSeries>(s), TsTier::Raw, TsTier::Hourly);
+      compact(static_cast<TsSeries>(s), TsTier::Hourly, TsTier::Daily);
+    }
+    if (static_cast<int32_t>(millis() - nextCheckpointMs) >= 0) {
+      checkpoint();
+      nextCheckpointMs = millis() + TS_CHECKPOINT_MS;
+    }
+    xSemaphoreGive(gMutex);
+  }
+}
+
+struct SummaryAcc {
+  int64_t sum;
+  TsSummary* out;
+};
+
+void summaryVisit(const TsPoint& p, void* ctx) {
+  SummaryAcc& acc = *static_cast<SummaryAcc*>(ctx);
+  TsSummary& out = *acc.out;
+  if (out.count == 0) {
+    out.min = p.min;
+    out.max = p.max;
+  }
+  out.min = min(out.min, p.min);
+  out.max = max(out.max, p.max);
+  acc.sum += p.mean;
+  out.count++;
+}
+
+}  // namespace
+
+bool tsStart() {
+  if (gTask) return true;
+  if (!LittleFS.begin(true)) {
+    Serial.println("[TS] LittleFS mount failed");
+    return false;
+  }
+  if (!LittleFS.exists(kDir)) LittleFS.mkdir(kDir);
+
+  gMutex = xSemaphoreCreateMutex();
+  gQueue = xQueueCreate(kQueueLen, sizeof(Item));
+  if (!gMutex || !gQueue) return false;
+
+  uint32_t segments = 0;
+  for (size_t s = 0; s < kSeriesCount; s++) {
+    for (size_t t = 0; t < kTierCount; t++) {
+      restore(static_cast<TsSeries>(s), static_cast<TsTier>(t));
+      segments += gStreams[s][t].sealed;
+    }
+  }
+
+  portENTER_CRITICAL(&gStatsLock);
+  gStats.mounted = true;
+  gStats.fsUsed = LittleFS.usedBytes();
+  gStats.fsTotal = LittleFS.totalBytes();
+  portEXIT_CRITICAL(&gStatsLock);
+  Serial.printf("[TS] Restored %u segments, %u/%u KB used\n",
+                static_cast<unsigned>(segments),
+                static_cast<unsigned>(gStats.fsUsed / 1024),
+                static_cast<unsigned>(gStats.fsTotal / 1024));
+
+  return xTaskCreatePinnedToCore(tsTaskMain, "tsdb", kTaskStack, nullptr, 1, &gTask, 0) ==
+         pdPASS;
+}
+
+bool tsAppend(TsSeries series, uint32_t ts, int32_t value) {
+  if (!gQueue || series >= TsSeries::Count) return false;
+  const Item item = {static_cast<uint8_t>(series), ts, value};
+  if (xQueueSend(gQueue, &item, 0) == pdTRUE) return true;
+  portENTER_CRITICAL(&gStatsLock);
+  gStats.dropped++;
+  portEXIT_CRITICAL(&gStatsLock);
+  return false;
+}
+
+void tsFlush() {
+  if (!gTask) return;
+  xSemaphoreTake(gMutex, portMAX_DELAY);
+  Item item;
+  while (xQueueReceive(gQueue, &item, 0) == pdTRUE) {
+    append(static_cast<TsSeries>(item.series), TsTier::Raw, item.ts, &item.value);
+  }
+  checkpoint();
+  xSemaphoreGive(gMutex);
+}
+
+int tsQuery(TsSeries series, TsTier tier, uint32_t fromTs, uint32_t toTs, TsVisitFn fn,
+            void* ctx) {
+  if (!gTask || series >= TsSeries::Count || tier >= TsTier::Count) return -1;
+  xSemaphoreTake(gMutex, portMAX_DELAY);
+  const uint32_t startUs = micros();
+  const int visited = query(series, tier, fromTs, toTs, fn, ctx);
+  const uint32_t us = micros() - startUs;
+  xSemaphoreGive(gMutex);
+
+  portENTER_CRITICAL(&gStatsLock);
+  gStats.queryUsLast = us;
+  gStats.queryUsMax = max(gStats.queryUsMax, us);
+  portEXIT_CRITICAL(&gStatsLock);
+  return visited;
+}
+
+TsTier tsTierFor(uint32_t spanSec) {
+  if (spanSec <= 6 * 3600UL) return TsTier::Raw;
+  if (spanSec <= 60 * 86400UL) return TsTier::Hourly;
+  return TsTier::Daily;
+}
+
+bool tsSummarize(TsSeries series, uint32_t fromTs, uint32_t toTs, TsSummary& out) {
+  out = TsSummary();
+  SummaryAcc acc = {0, &out};
+  tsQuery(series, tsTierFor(toTs - fromTs), fromTs, toTs, summaryVisit, &acc);
+  if (out.count == 0) return false;
+  out.mean = roundedMean(acc.sum, out.count);
+  return true;
+}
+
+TsStats tsStats() {
+  portENTER_CRITICAL(&gStatsLock);
+  TsStats st = gStats;
+  st.encodedBytes = static_cast<uint32_t>(gEncodedBits / 8);
+  portEXIT_CRITICAL(&gStatsLock);
+  return st;
+}
+
+#ifdef PIO_UNIT_TESTING
+void tsRestart() {
+  if (!gTask) return;
+  xSemaphoreTake(gMutex, portMAX_DELAY);
+  Item item;
+  while (xQueueReceive(gQueue, &item, 0) == pdTRUE) {
+  }
+  for (size_t s = 0; s < kSeriesCount; s++) {
+    for (size_t t = 0; t < kTierCount; t++) {
+      restore(static_cast<TsSeries>(s), static_cast<TsTier>(t));
+    }
+  }
+  xSemaphoreGive(gMutex);
+}
+#endif
@@ -0,0 +1,369 @@
+#include "ui_compositor.h"
+
+#include <cstring>
+
+#if UI_RENDER_DMA
+#include <esp_heap_caps.h>
+#endif
+
+namespace {
+
+// Two damage rectangles are merged when their union wastes at most this many pixels.
+// Below that, re-sending a few unchanged pixels is cheaper than another SPI window.
+constexpr int32_t kMergeSlackPx = 1024;
+
+void copyText(char* dst, size_t len, const char* src) {
+  memset(dst, 0, len);
+  if (src) strncpy(dst, src, len - 1);
+}
+
+}  // namespace
+
+Rect rectUnion(const Rect& a, const Rect& b) {
+  if (a.empty()) return b;
+  if (b.empty()) return a;
+  const int16_t x0 = min(a.x, b.x);
+  const int16_t y0 = min(a.y, b.y);
+  const int16_t x1 = max<int16_t>(a.x + a.w, b.x + b.w);
+  const int16_t y1 = max<int16_t>(a.y + a.h, b.y + b.h);
+  return Rect{x0, y0, static_cast<int16_t>(x1 - x0), static_cast<int16_t>(y1 - y0)};
+}
+
+Rect rectIntersect(const Rect& a, const Rect& b) {
+  const int16_t x0 = max(a.x, b.x);
+  const int16_t y0 = max(a.y, b.y);
+  const int16_t x1 = min<int16_t>(a.x + a.w, b.x + b.w);
+  const int16_t y1 = min<int16_t>(a.y + a.h, b.y + b.h);
+  if (x1 <= x0 || y1 <= y0) return Rect{};
+  return Rect{x0, y0, static_cast<int16_t>(x1 - x0), static_cast<int16_t>(y1 - y0)};
+}
+
+WidgetContent& UiFrame::add(WidgetKind kind, const Rect& r) {
+  WidgetContent& c = count_ < kMaxWidgets ? widgets_[count_++] : overflow_;
+  memset(static_cast<void*>(&c), 0, sizeof(c));  // padding too: slots are compared with memcmp
+  c.kind = kind;
+  c.bounds = r;
+  c.font = 2;
+  return c;
+}
+
+void UiFrame::fill(const Rect& r, uint16_t color) {
+  WidgetContent& c = add(WidgetKind::Fill, r);
+  c.colors[0] = color;
+}
+
+void UiFrame::text(const Rect& r, const char* s, uint8_t font, uint16_t fg, uint16_t bg,
+                   TextAlign align) {
+  WidgetContent& c = add(WidgetKind::Text, r);
+  c.font = font;
+  c.align = align;
+  c.colors[0] = fg;
+  c.colors[1] = bg;
+  copyText(c.text, sizeof(c.text), s);
+}
+
+void UiFrame::tab(const Rect& r, const char* label, uint16_t fg, uint16_t bg) {
+  WidgetContent& c = add(WidgetKind::Tab, r);
+  c.colors[0] = fg;
+  c.colors[1] = bg;
+  copyText(c.label, sizeof(c.label), label);
+}
+
+void UiFrame::pill(const Rect& r, const char* label, uint16_t fg, uint16_t bg) {
+  WidgetContent& c = add(WidgetKind::Pill, r);
+  c.colors[0] = fg;
+  c.colors[1] = bg;
+  copyText(c.label, sizeof(c.label), label);
+}
+
+void UiFrame::infoRow(const Rect& r, int16_t valueX, const char* label, const char* value,
+                      uint16_t labelFg, uint16_t valueFg, uint16_t bg) {
+  WidgetContent& c = add(WidgetKind::InfoRow, r);
+  c.param = valueX;
+  c.colors[0] = labelFg;
+  c.colors[1] = valueFg;
+  c.colors[2] = bg;
+  copyText(c.label, sizeof(c.label), label);
+  copyText(c.text, sizeof(c.text), value);
+}
+
+void UiFrame::button(const Rect& r, const char* label, uint16_t fill, uint16_t outline,
+                     uint16_t fg) {
+  WidgetContent& c = add(WidgetKind::Button, r);
+  c.colors[0] = fill;
+  c.colors[1] = outline;
+  c.colors[2] = fg;
+  copyText(c.label, sizeof(c.label), label);
+}
+
+void UiFrame::battery(const Rect& r, uint8_t pct, bool charging, uint16_t level,
+                      uint16_t outline, uint16_t trough, uint16_t bolt) {
+  WidgetContent& c = add(WidgetKind::Battery, r);
+  c.param = pct;
+  c.flags = charging ? 1 : 0;
+  c.colors[0] = level;
+  c.colors[1] = outline;
+  c.colors[2] = trough;
+  c.colors[3] = bolt;
+}
+
+void UiFrame::custom(const Rect& r, CustomDrawFn fn, uint32_t version) {
+  WidgetContent& c = add(WidgetKind::Custom, r);
+  c.fn = fn;
+  c.version = version;
+}
+
+bool Compositor::begin(TFT_eSPI* lcd, uint16_t bg) {
+  lcd_ = lcd;
+  bg_ = bg;
+  screen_ = Rect{0, 0, static_cast<int16_t>(lcd->width()), static_cast<int16_t>(lcd->height())};
+  count_ = 0;
+  declared_ = 0;
+  damageCount_ = 0;
+
+  if (!band_) {
+    band_ = new TFT_eSprite(lcd);
+    band_->setColorDepth(16);
+    if (!band_->createSprite(screen_.w, kBandRows)) {
+      Serial.println("[UI] Compositor band alloc failed; drawing directly");
+      delete band_;
+      band_ = nullptr;
+    }
+  }
+
+#if UI_RENDER_DMA
+  // The sprite may live in PSRAM, which SPI DMA cannot read; bands are packed into these
+  // internal buffers instead, alternating so one can be filled while the other is sent.
+  if (band_ && !dmaBuf_[0] && lcd_->initDMA()) {
+    const size_t bytes = static_cast<size_t>(screen_.w) * kBandRows * sizeof(uint16_t);
+    for (uint16_t*& buf : dmaBuf_) {
+      buf = static_cast<uint16_t*>(heap_caps_malloc(bytes, MALLOC_CAP_DMA));
+    }
+    if (!dmaBuf_[0] || !dmaBuf_[1]) {
+      Serial.println("[UI] DMA buffer alloc failed; using blocking pushes");
+      for (uint16_t*& buf : dmaBuf_) {
+        heap_caps_free(buf);
+        buf = nullptr;
+      }
+    }
+  }
+#endif
+  return band_ != nullptr;
+}
+
+void Compositor::declare(const WidgetContent& c) {
+  WidgetContent& slot = widgets_[declared_];
+  // memcpy rather than assignment so padding bytes stay comparable.
+  if (declared_ >= count_) {
+    memcpy(static_cast<void*>(&slot), &c, sizeof(c));
+    addDamage(c.bounds);
+  } else if (memcmp(&slot, &c, sizeof(c)) != 0) {
+    addDamage(slot.bounds);
+    if (c.bounds != slot.bounds) addDamage(c.bounds);
+    memcpy(static_cast<void*>(&slot), &c, sizeof(c));
+  }
+  declared_++;
+}
+
+void Compositor::invalidate(const Rect& r) { addDamage(r); }
+
+void Compositor::invalidateAll() { addDamage(screen_); }
+
+void Compositor::addDamage(const Rect& r) {
+  const Rect clipped = rectIntersect(r, screen_);
+  if (clipped.empty()) return;
+
+  if (damageCount_ == kMaxDamage) {
+    mergeDamage();
+    if (damageCount_ == kMaxDamage) {
+      // Still full: grow whichever rectangle absorbs this one most cheaply.
+      uint8_t best = 0;
+      int32_t bestGrowth = INT32_MAX;
+      for (uint8_t i = 0; i < damageCount_; i++) {
+        const int32_t growth = rectUnion(damage_[i], clipped).area() - damage_[i].area();
+        if (growth < bestGrowth) {
+          bestGrowth = growth;
+          best = i;
+        }
+      }
+      damage_[best] = rectUnion(damage_[best], clipped);
+      return;
+    }
+  }
+  damage_[damageCount_++] = clipped;
+}
+
+void Compositor::mergeDamage() {
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (uint8_t i = 0; i < damageCount_ && !merged; i++) {
+      for (uint8_t j = i + 1; j < damageCount_; j++) {
+        const Rect u = rectUnion(damage_[i], damage_[j]);
+        if (u.area() <= damage_[i].area() + damage_[j].area() + kMergeSlackPx) {
+          damage_[i] = u;
+          damage_[j] = damage_[--damageCount_];
+          merged = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+uint32_t Compositor::render(const UiFrame& frame) {
+  declared_ = 0;
+  for (uint8_t i = 0; i < frame.count(); i++) declare(frame.widget(i));
+  for (uint8_t i = declared_; i < count_; i++) addDamage(widgets_[i].bounds);
+  count_ = declared_;
+
+  mergeDamage();
+  const uint32_t before = pixelsPushed_;
+  flushedCount_ = damageCount_;
+  if (damageCount_ > 0) {
+    lcd_->startWrite();
+    const bool swap = lcd_->getSwapBytes();
+    lcd_->setSwapBytes(false);  // sprite memory is already in panel byte order
+    for (uint8_t i = 0; i < damageCount_; i++) {
+      flushed_[i] = damage_[i];
+      flushRect(damage_[i]);
+    }
+#if UI_RENDER_DMA
+    if (dmaEnabled()) lcd_->dmaWait();
+#endif
+    lcd_->setSwapBytes(swap);
+    lcd_->endWrite();
+  }
+  damageCount_ = 0;
+  return pixelsPushed_ - before;
+}
+
+bool Compositor::lastFrameTouched(const Rect& r) const {
+  for (uint8_t i = 0; i < flushedCount_; i++) {
+    if (flushed_[i].intersects(r)) return true;
+  }
+  return false;
+}
+
+void Compositor::flushRect(const Rect& d) {
+  if (!band_) {
+    lcd_->fillRect(d.x, d.y, d.w, d.h, bg_);
+    for (uint8_t i = 0; i < count_; i++) {
+      if (widgets_[i].bounds.intersects(d)) draw(*lcd_, widgets_[i], 0, 0);
+    }
+    notePush(static_cast<uint32_t>(d.area()));
+    return;
+  }
+
+  for (int16_t y0 = d.y; y0 < d.y + d.h; y0 += kBandRows) {
+    const int16_t bh = min<int16_t>(kBandRows, static_cast<int16_t>(d.y + d.h - y0));
+    const Rect band{d.x, y0, d.w, bh};
+
+    band_->fillRect(0, 0, d.w, bh, bg_);
+    for (uint8_t i = 0; i < count_; i++) {
+      if (widgets_[i].bounds.intersects(band)) draw(*band_, widgets_[i], d.x, y0);
+    }
+    pushBand(band);
+  }
+}
+
+// Sends rows [0, band.h) x columns [0, band.w) of the band sprite to `band` on the panel.
+// Rows were drawn at the sprite's full stride and are packed so the band is one window.
+void Compositor::pushBand(const Rect& band) {
+  uint16_t* src = static_cast<uint16_t*>(band_->getPointer());
+#if UI_RENDER_DMA
+  if (dmaEnabled()) {
+    // pushImageDMA() waits for the previous band before starting this one, so the buffer
+    // filled two bands ago is free again.
+    uint16_t* dst = dmaBuf_[dmaNext_];
+    dmaNext_ ^= 1;
+    for (int16_t row = 0; row < band.h; row++) {
+      memcpy(dst + row * band.w, src + row * screen_.w, band.w * sizeof(uint16_t));
+    }
+    lcd_->pushImageDMA(band.x, band.y, band.w, band.h, dst);
+    notePush(static_cast<uint32_t>(band.area()));
+    return;
+  }
+#endif
+  if (band.w != screen_.w) {
+    for (int16_t row = 1; row < band.h; row++) {
+      memmove(src + row * band.w, src + row * screen_.w, band.w * sizeof(uint16_t));
+    }
+  }
+  lcd_->pushImage(band.x, band.y, band.w, band.h, src);
+  notePush(static_cast<uint32_t>(band.area()));
+}
+
+// colors[] per kind: Fill {fill}; Text/Tab/Pill {fg, bg}; InfoRow {label, value, bg};
+// Button {fill, outline, text}; Battery {level, outline, trough, bolt}.
+void Compositor::draw(TFT_eSPI& g, const WidgetContent& c, int16_t ox, int16_t oy) {
+  const int16_t x = c.bounds.x - ox;
+  const int16_t y = c.bounds.y - oy;
+  const int16_t w = c.bounds.w;
+  const int16_t h = c.bounds.h;
+
+  switch (c.kind) {
+    case WidgetKind::None:
+      break;
+    case WidgetKind::Fill:
+      g.fillRect(x, y, w, h, c.colors[0]);
+      break;
+    case WidgetKind::Text:
+      g.fillRect(x, y, w, h, c.colors[1]);
+      g.setTextColor(c.colors[0], c.colors[1]);
+      if (c.align == TextAlign::Centre) {
+        g.drawCentreString(c.text, x + w / 2, y, c.font);
+      } else {
+        g.drawString(c.text, x, y, c.font);
+      }
+      break;
+    case WidgetKind::Tab:
+      g.fillRect(x, y, w, h, c.colors[1]);
+      g.setTextColor(c.colors[0], c.colors[1]);
+      g.drawCentreString(c.label, x + w / 2, y + 9, 2);
+      break;
+    case WidgetKind::Pill:
+      g.fillRoundRect(x, y, w, h, 12, c.colors[1]);
+      g.setTextColor(c.colors[0], c.colors[1]);
+      g.drawCentreString(c.label, x + w / 2, y + (h - 16) / 2, 2);
+      break;
+    case WidgetKind::InfoRow:
+      g.fillRect(x, y, w, h, c.colors[2]);
+      g.setTextColor(c.colors[0], c.colors[2]);
+      g.drawString(c.label, x, y, 2);
+      g.setTextColor(c.colors[1], c.colors[2]);
+      g.drawString(c.text, c.param - ox, y, 2);
+      break;
+    case WidgetKind::Button:
+      g.fillRoundRect(x, y, w, h, 10, c.colors[0]);
+      g.drawRoundRect(x, y, w, h, 10, c.colors[1]);
+      g.setTextColor(c.colors[2], c.colors[0]);
+      g.drawCentreString(c.label, x + w / 2, y + (h - 16) / 2, 2);
+      break;
+    case WidgetKind::Battery: {
+      // Body is w-3 wide, the last 3 px are the nub.
+      const int16_t bw = static_cast<int16_t>(w - 3);
+      const int16_t nubH = 6;
+      g.fillRect(x, y, bw, h, c.colors[2]);
+      g.drawRect(x, y, bw, h, c.colors[1]);
+      g.fillRect(x + bw, y + (h - nubH) / 2, 3, nubH, c.colors[1]);
+
+      const int16_t innerW = static_cast<int16_t>(bw - 4);
+      const int16_t filledW = static_cast<int16_t>((innerW * c.param) / 100);
+      if (filledW > 0) g.fillRect(x + 2, y + 2, filledW, h - 4, c.colors[0]);
+
+      if (c.flags & 1) {
+        // Simple bolt overlay.
+        const int16_t bx = x + 12;
+        const int16_t by = y + 2;
+        g.drawLine(bx + 2, by, bx - 1, by + 5, c.colors[3]);
+        g.drawLine(bx - 1, by + 5, bx + 2, by + 5, c.colors[3]);
+        g.drawLine(bx + 2, by + 5, bx - 1, by + 10, c.colors[3]);
+      }
+      break;
+    }
+    case WidgetKind::Custom:
+      if (c.fn) c.fn(g, c.bounds, ox, oy);
+      break;
+  }
+}
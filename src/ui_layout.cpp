@@ -0,0 +1,50 @@
+#include "ui_layout.h"
+
+void layoutCompose(UiFrame& frame, const RowPlaced* rows, size_t count, const uint16_t* palette,
+                   uint16_t bg) {
+  char buf[48];  // WidgetContent::text
+  bool matched = false;
+  bool skipping = false;
+  for (size_t i = 0; i < count; i++) {
+    const RowSpec& s = rows[i].spec;
+    const Rect& r = rows[i].bounds;
+    switch (s.kind) {
+      case RowKind::When:
+        skipping = matched || (s.when && !s.when());
+        matched = matched || !skipping;
+        continue;
+      case RowKind::EndWhen:
+        matched = false;
+        skipping = false;
+        continue;
+      default:
+        break;
+    }
+    if (skipping) continue;
+
+    // Text rows may have fixed text; an InfoRow's `text` is its label.
+    const char* text = s.bind ? s.bind(buf, sizeof(buf)) : s.kind == RowKind::Text ? s.text : "";
+    if (!text) text = "";
+    const uint16_t fg = palette[static_cast<uint8_t>(s.color)];
+    switch (s.kind) {
+      case RowKind::Text:
+        frame.text(r, text, s.font, fg, bg);
+        break;
+      case RowKind::InfoRow:
+        frame.infoRow(r,
+                      kLayoutValueX,
+                      s.text,
+                      text,
+                      palette[static_cast<uint8_t>(UiColor::Muted)],
+                      fg,
+                      bg);
+        break;
+      case RowKind::Pill:
+        frame.pill(r, text, bg, s.tint ? s.tint() : fg);
+        break;
+      case RowKind::When:
+      case RowKind::EndWhen:
+        break;
+    }
+  }
+}
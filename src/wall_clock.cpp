@@ -0,0 +1,196 @@
+#include "wall_clock.h"
+
+#include <M5Core2.h>
+#include <esp_sntp.h>
+
+#include <cstdlib>
+
+#include "i2c_bus.h"
+#include "snapshot.h"
+
+namespace {
+
+constexpr const char* kNtpServer1 = "pool.ntp.org";
+constexpr const char* kNtpServer2 = "time.google.com";
+
+// An RTC reading before this was never set by a sync (the BM8563 starts from zeroes).
+constexpr uint16_t kRtcPlausibleYear = 2024;
+// The base is moved forward at least this often, well inside millis()' 49.7-day wrap.
+constexpr uint32_t kRebaseMs = 86400000UL;
+
+struct ClockState {
+  uint32_t baseUnix;  // Unix seconds at baseMs
+  uint32_t baseMs;
+  WallClockStats stats;
+};
+
+// Written by setup(), loop() and the SNTP callback on the lwIP task, which take turns under
+// gWriteLock on gState and publish it; readers copy gShared without a lock.
+portMUX_TYPE gWriteLock = portMUX_INITIALIZER_UNLOCKED;
+ClockState gState = {};
+Snapshot<ClockState> gShared;
+
+const char* gTz = "UTC0";
+bool gSyncStarted = false;
+uint32_t gRtcWrittenSyncs = 0;  // loop()'s
+
+// Unix seconds as of `nowMs`, which must not be older than the base.
+uint32_t unixAt(const ClockState& st, uint32_t nowMs) {
+  return st.baseUnix + (nowMs - st.baseMs) / 1000;
+}
+
+// Callers hold gWriteLock.
+void setBase(uint32_t unixSec, uint32_t atMs, ClockSource source) {
+  gState.baseUnix = unixSec;
+  gState.baseMs = atMs;
+  gState.stats.source = source;
+}
+
+// lwIP task: SNTP has just set the system time to `tv`.
+void onSntpSync(timeval* tv) {
+  const uint32_t now = millis();
+  const uint32_t fracMs = static_cast<uint32_t>(tv->tv_usec / 1000);
+  portENTER_CRITICAL(&gWriteLock);
+  if (gState.stats.source != ClockSource::None) {
+    const int64_t wasMs = static_cast<int64_t>(gState.baseUnix) * 1000 + (now - gState.baseMs);
+    const int64_t isMs = static_cast<int64_t>(tv->tv_sec) * 1000 + fracMs;
+    gState.stats.lastStepMs = static_cast<int32_t>(isMs - wasMs);
+  }
+  setBase(static_cast<uint32_t>(tv->tv_sec), now - fracMs, ClockSource::Ntp);
+  gState.stats.syncs++;
+  gState.stats.lastSyncMs = now;
+  gShared.publish(gState);
+  portEXIT_CRITICAL(&gWriteLock);
+}
+
+struct RtcWrite {
+  RTC_TimeTypeDef time;
+  RTC_DateTypeDef date;
+};
+
+void rtcWrite(void* arg) {
+  RtcWrite* w = static_cast<RtcWrite*>(arg);
+  M5.Rtc.SetTime(&w->time);
+  M5.Rtc.SetDate(&w->date);
+}
+
+}  // namespace
+
+// Howard Hinnant's days_from_civil.
+int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+  y -= m <= 2;
+  const int32_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yoe = static_cast<uint32_t>(y - era * 400);
+  const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int32_t>(doe) - 719468;
+}
+
+uint32_t rtcUnixSec(const RtcReading& rtc) {
+  const int32_t days = daysFromCivil(rtc.year, rtc.month, rtc.date);
+  return static_cast<uint32_t>(days) * 86400UL + rtc.hours * 3600UL + rtc.minutes * 60UL +
+         rtc.seconds;
+}
+
+void wallClockBegin(const char* tz) {
+  gTz = tz;
+  setenv("TZ", tz, 1);
+  tzset();
+
+  RtcReading rtc;
+  if (!i2cRtc(rtc) || !rtc.valid || rtc.year < kRtcPlausibleYear || rtc.year > 2099) {
+    Serial.println("[Clock] RTC not set; waiting for SNTP");
+    return;
+  }
+  portENTER_CRITICAL(&gWriteLock);
+  if (gState.stats.source == ClockSource::None) {
+    setBase(rtcUnixSec(rtc), rtc.ms, ClockSource::Rtc);
+    gShared.publish(gState);
+  }
+  portEXIT_CRITICAL(&gWriteLock);
+  Serial.printf("[Clock] From RTC: %04u-%02u-%02u %02u:%02u:%02u UTC\n",
+                static_cast<unsigned>(rtc.year),
+                static_cast<unsigned>(rtc.month),
+                static_cast<unsigned>(rtc.date),
+                static_cast<unsigned>(rtc.hours),
+                static_cast<unsigned>(rtc.minutes),
+                static_cast<unsigned>(rtc.seconds));
+}
+
+void wallClockStartSync() {
+  if (gSyncStarted) return;
+  gSyncStarted = true;
+  sntp_set_time_sync_notification_cb(onSntpSync);
+  configTzTime(gTz, kNtpServer1, kNtpServer2);
+}
+
+void wallClockTick() {
+  const uint32_t now = millis();
+  portENTER_CRITICAL(&gWriteLock);
+  if (gState.stats.source != ClockSource::None && now - gState.baseMs >= kRebaseMs) {
+    const uint32_t sec = (now - gState.baseMs) / 1000;
+    gState.baseUnix += sec;
+    gState.baseMs += sec * 1000;
+    gShared.publish(gState);
+  }
+  const WallClockStats st = gState.stats;
+  const uint32_t unixSec = unixAt(gState, now);
+  portEXIT_CRITICAL(&gWriteLock);
+
+  if (st.syncs == gRtcWrittenSyncs) return;
+  gRtcWrittenSyncs = st.syncs;
+
+  const time_t t = unixSec;
+  tm utc;
+  gmtime_r(&t, &utc);
+  RtcWrite w;
+  w.time.Hours = static_cast<uint8_t>(utc.tm_hour);
+  w.time.Minutes = static_cast<uint8_t>(utc.tm_min);
+  w.time.Seconds = static_cast<uint8_t>(utc.tm_sec);
+  w.date.WeekDay = static_cast<uint8_t>(utc.tm_wday);
+  w.date.Month = static_cast<uint8_t>(utc.tm_mon + 1);
+  w.date.Date = static_cast<uint8_t>(utc.tm_mday);
+  w.date.Year = static_cast<uint16_t>(utc.tm_year + 1900);
+  i2cBusRun(I2cClass::Rtc, rtcWrite, &w);
+
+  portENTER_CRITICAL(&gWriteLock);
+  gState.stats.rtcWrites++;
+  gShared.publish(gState);
+  portEXIT_CRITICAL(&gWriteLock);
+  Serial.printf("[Clock] SNTP sync %u, step %d ms; RTC set\n",
+                static_cast<unsigned>(st.syncs),
+                static_cast<int>(st.lastStepMs));
+}
+
+bool wallClockNow(uint32_t& unixSec) {
+  ClockState st;
+  gShared.read(st);
+  unixSec = unixAt(st, millis());  // read after the base, so never before it
+  return st.stats.source != ClockSource::None;
+}
+
+bool wallClockLocal(tm& out) {
+  uint32_t unixSec;
+  if (!wallClockNow(unixSec)) return false;
+  const time_t t = unixSec;
+  localtime_r(&t, &out);
+  return true;
+}
+
+WallClockStats wallClockStats() {
+  ClockState st;
+  gShared.read(st);
+  return st.stats;
+}
+
+const char* clockSourceName(ClockSource source) {
+  switch (source) {
+    case ClockSource::None:
+      return "none";
+    case ClockSource::Rtc:
+      return "rtc";
+    case ClockSource::Ntp:
+      return "ntp";
+  }
+  return "";
+}
@@ -0,0 +1,82 @@
+#include "weather_cache.h"
+
+#include <Preferences.h>
+
+#include <cstddef>
+#include <cstdio>
+
+namespace {
+
+constexpr const char* kNvsNamespace = "wxcache";
+constexpr uint16_t kMagic = 0x5758;  // "WX"
+constexpr uint8_t kVersion = 3;
+
+struct Record {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t reserved;
+  uint32_t savedAtSec;
+  int32_t latE4;
+  int32_t lonE4;
+  ForecastStore forecast;
+  uint32_t crc;  // CRC32 over all preceding bytes
+};
+static_assert(sizeof(ForecastStore) == 236, "ForecastStore layout changed; bump kVersion");
+
+// "s0", "s1", ...; version 2 kept its single entry under "last".
+void slotKey(uint8_t slot, char (&key)[6]) {
+  snprintf(key, sizeof(key), "s%u", static_cast<unsigned>(slot));
+}
+
+}  // namespace
+
+uint32_t crc32Update(uint32_t crc, const void* data, size_t len) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+
+bool weatherCacheSave(uint8_t slot, const WeatherCacheEntry& entry) {
+  Record rec{};
+  rec.magic = kMagic;
+  rec.version = kVersion;
+  rec.savedAtSec = entry.savedAtSec;
+  rec.latE4 = entry.latE4;
+  rec.lonE4 = entry.lonE4;
+  rec.forecast = entry.forecast;
+  rec.crc = crc32Update(0, &rec, offsetof(Record, crc));
+
+  char key[6];
+  slotKey(slot, key);
+  Preferences prefs;
+  if (!prefs.begin(kNvsNamespace, false)) return false;
+  const size_t written = prefs.putBytes(key, &rec, sizeof(rec));
+  if (slot == 0 && prefs.isKey("last")) prefs.remove("last");
+  prefs.end();
+  return written == sizeof(rec);
+}
+
+bool weatherCacheLoad(uint8_t slot, WeatherCacheEntry& entry) {
+  char key[6];
+  slotKey(slot, key);
+  Record rec{};
+  Preferences prefs;
+  if (!prefs.begin(kNvsNamespace, true)) return false;
+  const size_t len = prefs.getBytesLength(key);
+  const size_t read = (len == sizeof(rec)) ? prefs.getBytes(key, &rec, sizeof(rec)) : 0;
+  prefs.end();
+
+  if (read != sizeof(rec)) return false;
+  if (rec.magic != kMagic || rec.version != kVersion) return false;
+  if (rec.crc != crc32Update(0, &rec, offsetof(Record, crc))) return false;
+
+  entry.savedAtSec = rec.savedAtSec;
+  entry.latE4 = rec.latE4;
+  entry.lonE4 = rec.lonE4;
+  entry.forecast = rec.forecast;
+  return true;
+}
@@ -0,0 +1,229 @@
+#include "weather_locations.h"
+
+#include <Preferences.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "weather_cache.h"
+
+namespace {
+
+constexpr const char* kNvsNamespace = "wxloc";
+constexpr const char* kNvsKey = "list";
+constexpr uint16_t kMagic = 0x4C57;  // "WL"
+constexpr uint8_t kVersion = 1;
+
+struct Record {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t count;
+  WeatherLocation at[kWeatherLocationsMax];
+  uint32_t crc;  // CRC32 over all preceding bytes
+};
+
+constexpr int32_t kLatMaxE4 = 900000;
+constexpr int32_t kLonMaxE4 = 1800000;
+
+// snprintf() that keeps appending to one buffer and returns the total length it wanted.
+struct TextOut {
+  char* out;
+  size_t len;
+  int total = 0;
+
+  __attribute__((format(printf, 2, 3))) void printf(const char* fmt, ...) {
+    const size_t used = static_cast<size_t>(total) < len ? total : len;
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(out + used, len - used, fmt, ap);
+    va_end(ap);
+    if (n > 0) total += n;
+  }
+};
+
+// Labels end up in the ticker, the serial log and JSON: keep them to plain characters.
+bool labelChar(char c) {
+  return isalnum(static_cast<unsigned char>(c)) || c == ' ' || c == '-' || c == '_' || c == '.';
+}
+
+const char* skipSpace(const char* p) {
+  while (*p == ' ') p++;
+  return p;
+}
+
+// Degrees to 1e-4 degree units, within +-limit.
+bool parseE4(const char*& p, int32_t limit, int32_t& out) {
+  char* end = nullptr;
+  const double v = strtod(p, &end);
+  if (end == p || !std::isfinite(v)) return false;
+  const long e4 = lround(v * 10000.0);
+  if (e4 < -limit || e4 > limit) return false;
+  out = static_cast<int32_t>(e4);
+  p = end;
+  return true;
+}
+
+bool parseEntry(const char*& p, WeatherLocation& loc, const char*& error) {
+  p = skipSpace(p);
+  const char* colon = strchr(p, ':');
+  size_t n = colon ? static_cast<size_t>(colon - p) : 0;
+  while (n > 0 && p[n - 1] == ' ') n--;
+  if (n == 0) {
+    error = "expected LABEL:lat,lon";
+    return false;
+  }
+  if (n >= sizeof(loc.label)) {
+    error = "label longer than 7 characters";
+    return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (!labelChar(p[i])) {
+      error = "label may only use letters, digits, space and -_.";
+      return false;
+    }
+  }
+  memcpy(loc.label, p, n);
+  loc.label[n] = '\0';
+
+  p = colon + 1;
+  if (!parseE4(p, kLatMaxE4, loc.latE4)) {
+    error = "bad latitude";
+    return false;
+  }
+  p = skipSpace(p);
+  if (*p++ != ',') {
+    error = "expected ',' between latitude and longitude";
+    return false;
+  }
+  if (!parseE4(p, kLonMaxE4, loc.lonE4)) {
+    error = "bad longitude";
+    return false;
+  }
+  p = skipSpace(p);
+  if (*p != '\0' && *p != ';') {
+    error = "expected ';' between sites";
+    return false;
+  }
+  return true;
+}
+
+int findLabel(const WeatherLocations& list, const char* label) {
+  for (uint8_t i = 0; i < list.count; i++) {
+    if (strcasecmp(list.at[i].label, label) == 0) return i;
+  }
+  return -1;
+}
+
+void printE4(TextOut& out, int32_t v) {
+  const uint32_t a = v < 0 ? 0u - static_cast<uint32_t>(v) : static_cast<uint32_t>(v);
+  out.printf("%s%u.%04u",
+             v < 0 ? "-" : "",
+             static_cast<unsigned>(a / 10000),
+             static_cast<unsigned>(a % 10000));
+}
+
+}  // namespace
+
+bool weatherLocationsParse(const char* text, WeatherLocations& list, const char*& error) {
+  WeatherLocations next = list;
+  const char* p = text;
+  do {
+    WeatherLocation loc;
+    if (!parseEntry(p, loc, error)) return false;
+    // A known label moves that site instead of adding a second one.
+    const int i = findLabel(next, loc.label);
+    if (i >= 0) {
+      next.at[i] = loc;
+    } else if (next.count < kWeatherLocationsMax) {
+      next.at[next.count++] = loc;
+    } else {
+      error = "list is full";
+      return false;
+    }
+    if (*p == ';') p++;
+  } while (*skipSpace(p) != '\0');
+  list = next;
+  return true;
+}
+
+bool weatherLocationsRemove(WeatherLocations& list, const char* label) {
+  const int i = findLabel(list, label);
+  if (i < 0) return false;
+  memmove(&list.at[i], &list.at[i + 1], (list.count - i - 1) * sizeof(WeatherLocation));
+  list.count--;
+  return true;
+}
+
+int weatherLocationsFormat(const WeatherLocations& list, char* out, size_t len) {
+  TextOut w{out, len};
+  if (len > 0) out[0] = '\0';
+  for (uint8_t i = 0; i < list.count; i++) {
+    w.printf("%s%s:", i ? ";" : "", list.at[i].label);
+    printE4(w, list.at[i].latE4);
+    w.printf(",");
+    printE4(w, list.at[i].lonE4);
+  }
+  return w.total;
+}
+
+int weatherLocationsQuery(const WeatherLocations& list, char* out, size_t len) {
+  TextOut w{out, len};
+  if (len > 0) out[0] = '\0';
+  w.printf("&latitude=");
+  for (uint8_t i = 0; i < list.count; i++) {
+    if (i) w.printf(",");
+    printE4(w, list.at[i].latE4);
+  }
+  w.printf("&longitude=");
+  for (uint8_t i = 0; i < list.count; i++) {
+    if (i) w.printf(",");
+    printE4(w, list.at[i].lonE4);
+  }
+  return w.total;
+}
+
+bool weatherLocationsSave(const WeatherLocations& list) {
+  Record rec{};
+  rec.magic = kMagic;
+  rec.version = kVersion;
+  rec.count = list.count;
+  memcpy(rec.at, list.at, sizeof(rec.at));
+  rec.crc = crc32Update(0, &rec, offsetof(Record, crc));
+
+  Preferences prefs;
+  if (!prefs.begin(kNvsNamespace, false)) return false;
+  const size_t written = prefs.putBytes(kNvsKey, &rec, sizeof(rec));
+  prefs.end();
+  return written == sizeof(rec);
+}
+
+bool weatherLocationsLoad(WeatherLocations& list) {
+  Record rec{};
+  Preferences prefs;
+  if (!prefs.begin(kNvsNamespace, true)) return false;
+  const size_t len = prefs.getBytesLength(kNvsKey);
+  const size_t read = (len == sizeof(rec)) ? prefs.getBytes(kNvsKey, &rec, sizeof(rec)) : 0;
+  prefs.end();
+
+  if (read != sizeof(rec)) return false;
+  if (rec.magic != kMagic || rec.version != kVersion) return false;
+  if (rec.crc != crc32Update(0, &rec, offsetof(Record, crc))) return false;
+  if (rec.count == 0 || rec.count > kWeatherLocationsMax) return false;
+
+  list.count = rec.count;
+  memcpy(list.at, rec.at, sizeof(list.at));
+  return true;
+}
+
+bool weatherLocationsClear() {
+  Preferences prefs;
+  if (!prefs.begin(kNvsNamespace, false)) return false;
+  const bool ok = !prefs.isKey(kNvsKey) || prefs.remove(kNvsKey);
+  prefs.end();
+  return ok;
+}
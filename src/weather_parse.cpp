@@ -0,0 +1,337 @@
+#include "weather_parse.h"
+
+#include <ArduinoJson.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Heap allocator for the JsonDocument that remembers its own high-water mark.
+// Each block carries a small size header so deallocate() can keep `live_` exact.
+class PeakAllocator : public ArduinoJson::Allocator {
+ public:
+  void* allocate(size_t size) override {
+    uint8_t* raw = static_cast<uint8_t*>(malloc(size + kHeader));
+    if (!raw) return nullptr;
+    memcpy(raw, &size, sizeof(size));
+    noteAlloc(size);
+    return raw + kHeader;
+  }
+
+  void deallocate(void* ptr) override {
+    if (!ptr) return;
+    uint8_t* raw = static_cast<uint8_t*>(ptr) - kHeader;
+    size_t size = 0;
+    memcpy(&size, raw, sizeof(size));
+    live_ -= size;
+    free(raw);
+  }
+
+  void* reallocate(void* ptr, size_t newSize) override {
+    if (!ptr) return allocate(newSize);
+    uint8_t* raw = static_cast<uint8_t*>(ptr) - kHeader;
+    size_t oldSize = 0;
+    memcpy(&oldSize, raw, sizeof(oldSize));
+    uint8_t* grown = static_cast<uint8_t*>(realloc(raw, newSize + kHeader));
+    if (!grown) return nullptr;
+    memcpy(grown, &newSize, sizeof(newSize));
+    live_ -= oldSize;
+    noteAlloc(newSize);
+    return grown + kHeader;
+  }
+
+  size_t peak() const { return peak_; }
+
+ private:
+  static constexpr size_t kHeader = alignof(max_align_t);
+
+  void noteAlloc(size_t size) {
+    live_ += size;
+    if (live_ > peak_) peak_ = live_;
+  }
+
+  size_t live_ = 0;
+  size_t peak_ = 0;
+};
+
+// Small read-ahead buffer in front of the TLS stream. ArduinoJson reads one byte at
+// a time; batching what is already available avoids a TLS record lookup per byte.
+// It never asks for more than `available()` (or one byte when idle), so it cannot
+// block past the end of the body.
+class BufferedReader {
+ public:
+  explicit BufferedReader(Stream& in) : in_(in) {}
+
+  int read() {
+    if (pos_ == len_ && !fill()) return -1;
+    return static_cast<uint8_t>(buf_[pos_++]);
+  }
+
+  int peek() {
+    if (pos_ == len_ && !fill()) return -1;
+    return static_cast<uint8_t>(buf_[pos_]);
+  }
+
+  // Skips JSON whitespace and returns the next byte without consuming it.
+  int peekToken() {
+    int c = peek();
+    while (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      pos_++;
+      c = peek();
+    }
+    return c;
+  }
+
+  size_t readBytes(char* dst, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+      if (pos_ == len_ && !fill()) break;
+      const size_t chunk = std::min(n - done, len_ - pos_);
+      memcpy(dst + done, buf_ + pos_, chunk);
+      pos_ += chunk;
+      done += chunk;
+    }
+    return done;
+  }
+
+  size_t consumed() const { return total_; }
+
+ private:
+  bool fill() {
+    const int avail = in_.available();
+    const size_t want = (avail > 0) ? std::min(static_cast<size_t>(avail), sizeof(buf_)) : 1;
+    len_ = in_.readBytes(buf_, want);  // timed read when nothing is buffered yet
+    pos_ = 0;
+    total_ += len_;
+    return len_ > 0;
+  }
+
+  Stream& in_;
+  char buf_[128];
+  size_t pos_ = 0;
+  size_t len_ = 0;
+  size_t total_ = 0;
+};
+
+// Sits between the buffered stream and ArduinoJson and cuts each "daily" and "hourly"
+// series short once it holds as many elements as the store keeps: the rest of the array
+// is read and dropped here, so the document never sees it. The filter alone would keep
+// every element and let the document grow with forecast_days and forecast_hours.
+//
+// Depth counts from the site object (1), through the section object (2), to the series
+// array (3). The last string read at depth 1 names the section an object opened there.
+class SeriesCapReader {
+ public:
+  explicit SeriesCapReader(BufferedReader& in) : in_(in) {}
+
+  int read() {
+    const int c = in_.read();
+    if (c < 0) return c;
+    if (inString_) {
+      noteStringByte(c);
+      return c;
+    }
+    switch (c) {
+      case '"':
+        inString_ = true;
+        if (depth_ == 1) keyLen_ = 0;
+        break;
+      case '{':
+        if (++depth_ == 2) sectionCap_ = capFor();
+        break;
+      case '[':
+        if (++depth_ == 3) kept_ = 1;
+        break;
+      case '}':
+      case ']':
+        depth_--;
+        break;
+      case ',':
+        if (depth_ == 3 && sectionCap_ != 0 && kept_++ == sectionCap_) {
+          skipRest();
+          depth_--;
+          return ']';
+        }
+        break;
+    }
+    return c;
+  }
+
+  size_t readBytes(char* dst, size_t n) {
+    size_t done = 0;
+    for (int c; done < n && (c = read()) >= 0; done++) dst[done] = static_cast<char>(c);
+    return done;
+  }
+
+  size_t skipped() const { return skipped_; }
+
+ private:
+  uint16_t capFor() const {
+    if (strcmp(key_, "daily") == 0) return kForecastDays;
+    if (strcmp(key_, "hourly") == 0) return kForecastHours;
+    return 0;  // not a section the store keeps; left to the filter
+  }
+
+  void noteStringByte(int c) {
+    if (escaped_) {
+      escaped_ = false;
+    } else if (c == '\\') {
+      escaped_ = true;
+    } else if (c == '"') {
+      inString_ = false;
+      if (depth_ == 1) key_[keyLen_] = '\0';
+      return;
+    }
+    if (depth_ == 1 && keyLen_ < sizeof(key_) - 1) key_[keyLen_++] = static_cast<char>(c);
+  }
+
+  // Reads up to and including the array's closing bracket.
+  void skipRest() {
+    uint8_t nested = 0;
+    for (int c; (c = in_.read()) >= 0;) {
+      skipped_++;
+      if (inString_) {
+        noteStringByte(c);
+      } else if (c == '"') {
+        inString_ = true;
+      } else if (c == '[' || c == '{') {
+        nested++;
+      } else if (c == ']' || c == '}') {
+        if (nested-- == 0) return;
+      }
+    }
+  }
+
+  BufferedReader& in_;
+  char key_[8] = "";
+  uint8_t keyLen_ = 0;
+  uint8_t depth_ = 0;
+  bool inString_ = false;
+  bool escaped_ = false;
+  uint16_t sectionCap_ = 0;
+  uint16_t kept_ = 0;
+  size_t skipped_ = 0;
+};
+
+void buildFilter(JsonDocument& filter) {
+  filter["location_id"] = true;  // only present in multi-site responses
+  filter["utc_offset_seconds"] = true;
+  filter["current"]["time"] = true;
+  filter["current"]["temperature_2m"] = true;
+  filter["current"]["weather_code"] = true;
+  filter["daily"]["time"] = true;
+  filter["daily"]["temperature_2m_max"] = true;
+  filter["daily"]["temperature_2m_min"] = true;
+  filter["daily"]["weather_code"] = true;
+  filter["daily"]["precipitation_probability_max"] = true;
+  filter["hourly"]["time"] = true;
+  filter["hourly"]["temperature_2m"] = true;
+  filter["hourly"]["weather_code"] = true;
+  filter["hourly"]["precipitation_probability"] = true;
+}
+
+uint8_t toPrecipPct(JsonVariantConst v) {
+  const int pct = v | -1;
+  return (pct >= 0 && pct <= 100) ? static_cast<uint8_t>(pct) : kPrecipUnknown;
+}
+
+uint8_t seriesLen(JsonArrayConst a, uint8_t cap) {
+  return static_cast<uint8_t>(std::min<size_t>(a.size(), cap));
+}
+
+void decodeDaily(JsonObjectConst daily, ForecastStore& out) {
+  JsonArrayConst tmax = daily["temperature_2m_max"];
+  JsonArrayConst tmin = daily["temperature_2m_min"];
+  JsonArrayConst code = daily["weather_code"];
+  JsonArrayConst precip = daily["precipitation_probability_max"];
+
+  out.dailyStart = daily["time"][0].as<uint32_t>();
+  out.dayCount = seriesLen(tmax, kForecastDays);
+  for (uint8_t i = 0; i < out.dayCount; i++) {
+    out.dailyMaxC10[i] = tempToC10(tmax[i] | NAN);
+    out.dailyMinC10[i] = tempToC10(tmin[i] | NAN);
+    out.setDailyCond(i, wmoToCond(code[i] | -1));
+    out.dailyPrecipPct[i] = toPrecipPct(precip[i]);
+  }
+}
+
+void decodeHourly(JsonObjectConst hourly, ForecastStore& out) {
+  JsonArrayConst temp = hourly["temperature_2m"];
+  JsonArrayConst code = hourly["weather_code"];
+  JsonArrayConst precip = hourly["precipitation_probability"];
+
+  out.hourlyStart = hourly["time"][0].as<uint32_t>();
+  out.hourCount = seriesLen(temp, kForecastHours);
+  for (uint8_t i = 0; i < out.hourCount; i++) {
+    out.hourlyTempC10[i] = tempToC10(temp[i] | NAN);
+    out.setHourlyCond(i, wmoToCond(code[i] | -1));
+    out.hourlyPrecipPct[i] = toPrecipPct(precip[i]);
+  }
+}
+
+bool decodeSite(JsonDocument& doc, ForecastStore& out) {
+  forecastClear(out);
+  out.utcOffsetSec = doc["utc_offset_seconds"] | 0;
+  out.currentTime = doc["current"]["time"].as<uint32_t>();
+  out.currentTempC10 = tempToC10(doc["current"]["temperature_2m"] | NAN);
+  out.currentCond = wmoToCond(doc["current"]["weather_code"] | -1);
+  decodeDaily(doc["daily"], out);
+  decodeHourly(doc["hourly"], out);
+  return out.hasData();
+}
+
+}  // namespace
+
+bool weatherParseStream(Stream& in,
+                        uint8_t expected,
+                        WeatherForecastSink sink,
+                        WeatherParseStats& stats) {
+  const uint32_t t0 = millis();
+  stats.locations = 0;
+  stats.error = "";
+
+  PeakAllocator alloc;
+  {
+    JsonDocument filter(&alloc);
+    buildFilter(filter);
+
+    JsonDocument doc(&alloc);
+    ForecastStore fc;
+    BufferedReader reader(in);
+    SeriesCapReader series(reader);
+    // One site is a bare object; several are an array of them, which is walked here so that
+    // ArduinoJson only ever holds one element. deserializeJson() stops right after the
+    // element's closing brace.
+    const bool array = reader.peekToken() == '[';
+    if (array) reader.read();
+    for (uint8_t i = 0;; i++) {
+      const DeserializationError err =
+          deserializeJson(doc, series, DeserializationOption::Filter(filter));
+      if (err) {
+        stats.error = err.c_str();
+        break;
+      }
+      if (!decodeSite(doc, fc)) {
+        stats.error = "no current data";
+        break;
+      }
+      const uint8_t index = doc["location_id"] | i;
+      if (index < expected) {
+        sink(index, fc);
+        stats.locations++;
+      }
+      if (!array || reader.peekToken() != ',') break;
+      reader.read();
+    }
+    stats.bytesRead = reader.consumed();
+    stats.bytesSkipped = series.skipped();
+  }
+
+  if (stats.error[0] == '\0' && stats.locations < expected) stats.error = "missing sites";
+  stats.docPeakBytes = alloc.peak();
+  stats.parseMs = millis() - t0;
+  return stats.locations == expected && stats.error[0] == '\0';
+}
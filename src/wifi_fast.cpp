@@ -0,0 +1,110 @@
+#include "wifi_fast.h"
+
+#include <Preferences.h>
+
+#include <cstddef>
+#include <cstring>
+
+#include "weather_cache.h"  // crc32Update
+
+namespace {
+
+constexpr const char* kNvsNamespace = "wififast";
+constexpr const char* kNvsKey = "last";
+constexpr uint16_t kMagic = 0x5746;  // "WF"
+constexpr uint8_t kVersion = 1;
+
+struct Record {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t channel;
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t reserved;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t leaseUnix;
+  uint32_t crc;  // CRC32 over all preceding bytes
+};
+
+// Not cleared at boot; the CRC tells a kept record from power-on garbage.
+RTC_NOINIT_ATTR Record gRtcRecord;
+
+bool valid(const Record& rec) {
+  return rec.magic == kMagic && rec.version == kVersion &&
+         rec.crc == crc32Update(0, &rec, offsetof(Record, crc));
+}
+
+void seal(Record& rec) {
+  rec.magic = kMagic;
+  rec.version = kVersion;
+  rec.crc = crc32Update(0, &rec, offsetof(Record, crc));
+}
+
+bool nvsLoad(Record& rec) {
+  Preferences prefs;
+  if (!prefs.begin(kNvsNamespace, true)) return false;
+  const size_t len = prefs.getBytesLength(kNvsKey);
+  const size_t read = (len == sizeof(rec)) ? prefs.getBytes(kNvsKey, &rec, sizeof(rec)) : 0;
+  prefs.end();
+  return read == sizeof(rec) && valid(rec);
+}
+
+// Same access point and address; the lease time alone does not justify a flash write.
+bool sameLink(const Record& a, const Record& b) {
+  return a.channel == b.channel && strcmp(a.ssid, b.ssid) == 0 &&
+         memcmp(a.bssid, b.bssid, sizeof(a.bssid)) == 0 && a.ip == b.ip &&
+         a.gateway == b.gateway && a.subnet == b.subnet && a.dns == b.dns;
+}
+
+}  // namespace
+
+bool wifiFastLoad(WifiFastRecord& out) {
+  Record rec = gRtcRecord;
+  if (!valid(rec)) {
+    if (!nvsLoad(rec)) return false;
+    gRtcRecord = rec;
+  }
+  memcpy(out.ssid, rec.ssid, sizeof(out.ssid));
+  out.ssid[sizeof(out.ssid) - 1] = '\0';
+  memcpy(out.bssid, rec.bssid, sizeof(out.bssid));
+  out.channel = rec.channel;
+  out.ip = rec.ip;
+  out.gateway = rec.gateway;
+  out.subnet = rec.subnet;
+  out.dns = rec.dns;
+  out.leaseUnix = rec.leaseUnix;
+  return true;
+}
+
+void wifiFastSave(const WifiFastRecord& in) {
+  Record rec{};
+  memcpy(rec.ssid, in.ssid, sizeof(rec.ssid));
+  rec.ssid[sizeof(rec.ssid) - 1] = '\0';
+  memcpy(rec.bssid, in.bssid, sizeof(rec.bssid));
+  rec.channel = in.channel;
+  rec.ip = in.ip;
+  rec.gateway = in.gateway;
+  rec.subnet = in.subnet;
+  rec.dns = in.dns;
+  rec.leaseUnix = in.leaseUnix;
+  seal(rec);
+  gRtcRecord = rec;
+
+  Record stored;
+  if (nvsLoad(stored) && sameLink(stored, rec)) return;
+  Preferences prefs;
+  if (!prefs.begin(kNvsNamespace, false)) return;
+  prefs.putBytes(kNvsKey, &rec, sizeof(rec));
+  prefs.end();
+}
+
+void wifiFastForget() {
+  gRtcRecord.magic = 0;
+  Preferences prefs;
+  if (!prefs.begin(kNvsNamespace, false)) return;
+  prefs.remove(kNvsKey);
+  prefs.end();
+}
@@ -0,0 +1,255 @@
+// FetchPolicy on its own: backoff, jitter, Retry-After and the outcome stats. Then the
+// weather worker's use of it against the HTTP stub in native/hal: a 304 keeps the validators
+// and the regular schedule, and a new site list drops them. Host only (pio test -e native);
+// main.cpp is included, as the benchmarks do, for the worker's functions.
+
+#include "../../src/main.cpp"
+
+#include <hal.h>
+#include <unity.h>
+
+#include "../../native/bench/open_meteo_payload.h"
+
+namespace {
+
+// The weather worker's policy.
+constexpr uint32_t kRefreshMs = kWeatherRefreshMs;
+constexpr uint32_t kRetryMinMs = kWeatherRetryMinMs;
+constexpr uint32_t kRetryAfterMaxMs = 6UL * 3600UL * 1000UL;
+constexpr uint32_t kSeeds = 500;
+
+// The un-jittered delay after `streak` failures in a row.
+uint32_t backoffCeilingMs(uint16_t streak) {
+  uint64_t d = kRetryMinMs;
+  for (uint16_t i = 1; i < streak; i++) d *= 2;
+  return static_cast<uint32_t>(min<uint64_t>(d, kRefreshMs));
+}
+
+uint32_t failTimes(FetchPolicy& p, uint16_t n, uint32_t retryAfterMs = 0) {
+  uint32_t delay = 0;
+  for (uint16_t i = 0; i < n; i++) delay = p.record(FetchOutcome::Failed, 1000, retryAfterMs);
+  return delay;
+}
+
+WiFiClientSecure gClient;
+HTTPClient gHttps;
+char gUrl[kWeatherUrlMax] = "";
+
+// The parts of setup() the weather worker needs.
+void workerSetup() {
+  static bool done = false;
+  if (done) return;
+  done = true;
+  M5.begin();
+  gLoopEvents = xEventGroupCreate();
+  wallClockBegin(TIME_ZONE);
+  uiInit();
+  weatherSitesBegin();
+  weatherPolicyBegin();
+  weatherShowSite(0);
+  weatherWorkerSync(gUrl, sizeof(gUrl));
+  WiFi.onEvent(wifiOnEvent);
+  hal::wifiScript(1200, WL_CONNECTED);
+  wifiStartConnecting();
+  hal::clockAdvance(1200);
+  wifiTick();
+}
+
+// A full download that leaves the worker holding the stub's validators, whatever earlier
+// tests did.
+void workerFetchWithValidators() {
+  workerSetup();
+  gWeatherPolicy.clearValidators();
+  hal::httpRespond(200, kOpenMeteoPayload);
+  hal::httpValidators("\"om-1\"", "Tue, 14 Oct 2025 09:00:00 GMT");
+  weatherHandleRequest(gClient, gHttps, gUrl);
+  TEST_ASSERT_EQUAL_STRING("\"om-1\"", gWeatherPolicy.etag());
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_backoff_doubles_from_the_minimum_up_to_the_refresh_period() {
+  TEST_ASSERT_EQUAL_UINT32(20000, kRetryMinMs);
+  for (uint16_t streak = 1; streak <= 12; streak++) {
+    const uint32_t ceiling = backoffCeilingMs(streak);
+    uint32_t lo = UINT32_MAX;
+    uint32_t hi = 0;
+    for (uint32_t seed = 1; seed <= kSeeds; seed++) {
+      FetchPolicy p(kRefreshMs, kRetryMinMs);
+      p.seed(seed * 2654435761u);
+      const uint32_t d = failTimes(p, streak);
+      TEST_ASSERT_EQUAL_UINT16(streak, p.stats().failStreak);
+      TEST_ASSERT_EQUAL_UINT32(d, p.stats().retryMs);
+      lo = min(lo, d);
+      hi = max(hi, d);
+    }
+    // Equal jitter: never outside [d/2, d], and spread over the whole range.
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(ceiling / 2, lo);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(ceiling, hi);
+    TEST_ASSERT_LESS_THAN_UINT32(ceiling / 2 + ceiling / 16, lo);
+    TEST_ASSERT_GREATER_THAN_UINT32(ceiling - ceiling / 16, hi);
+  }
+  TEST_ASSERT_EQUAL_UINT32(kRefreshMs, backoffCeilingMs(8));
+}
+
+void test_success_resets_the_backoff() {
+  FetchPolicy p(kRefreshMs, kRetryMinMs);
+  p.seed(7);
+  failTimes(p, 5);
+  TEST_ASSERT_EQUAL_UINT32(kRefreshMs, p.record(FetchOutcome::Updated, 5000));
+  TEST_ASSERT_EQUAL_UINT16(0, p.stats().failStreak);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kRetryMinMs, failTimes(p, 1));
+}
+
+void test_retry_after_is_honoured_up_to_six_hours() {
+  FetchPolicy p(kRefreshMs, kRetryMinMs);
+  p.seed(11);
+  // Longer than the backoff: the server wins.
+  TEST_ASSERT_EQUAL_UINT32(120000, failTimes(p, 1, 120000));
+  // Shorter: the backoff stands.
+  const uint32_t d = failTimes(p, 1, 5000);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(backoffCeilingMs(2) / 2, d);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(backoffCeilingMs(2), d);
+  // Days: capped.
+  TEST_ASSERT_EQUAL_UINT32(kRetryAfterMaxMs, failTimes(p, 1, 2 * 86400UL * 1000UL));
+  // Also after a good fetch, beyond the refresh period.
+  TEST_ASSERT_EQUAL_UINT32(3600000, p.record(FetchOutcome::Updated, 1000, 3600000));
+  TEST_ASSERT_EQUAL_UINT32(kRetryAfterMaxMs, p.record(FetchOutcome::NotModified, 1000, UINT32_MAX));
+
+  TEST_ASSERT_EQUAL_UINT32(120000, fetchParseRetryAfterMs("120"));
+  TEST_ASSERT_EQUAL_UINT32(30000, fetchParseRetryAfterMs(" 30 "));
+  TEST_ASSERT_EQUAL_UINT32(0, fetchParseRetryAfterMs("0"));
+  TEST_ASSERT_EQUAL_UINT32(kRetryAfterMaxMs, fetchParseRetryAfterMs("99999999999"));
+  TEST_ASSERT_EQUAL_UINT32(0, fetchParseRetryAfterMs("Wed, 21 Oct 2015 07:28:00 GMT"));
+  TEST_ASSERT_EQUAL_UINT32(0, fetchParseRetryAfterMs("-5"));
+  TEST_ASSERT_EQUAL_UINT32(0, fetchParseRetryAfterMs("12s"));
+  TEST_ASSERT_EQUAL_UINT32(0, fetchParseRetryAfterMs(""));
+  TEST_ASSERT_EQUAL_UINT32(0, fetchParseRetryAfterMs(nullptr));
+}
+
+void test_not_modified_keeps_the_slot_schedule() {
+  // Slots every 30 min at :05 and :35 past, no spread; 10:00:00 UTC is 5 min before one.
+  constexpr uint32_t kUnix = 1760608800;
+  FetchPolicy updated(kRefreshMs, kRetryMinMs);
+  FetchPolicy notModified(kRefreshMs, kRetryMinMs);
+  updated.setSlots(1800, 300, 0);
+  notModified.setSlots(1800, 300, 0);
+  notModified.setValidators("\"om-1\"", "Tue, 14 Oct 2025 09:00:00 GMT");
+  failTimes(notModified, 3);
+
+  TEST_ASSERT_EQUAL_UINT32(300000, updated.record(FetchOutcome::Updated, 1000, 0, kUnix));
+  TEST_ASSERT_EQUAL_UINT32(300000, notModified.record(FetchOutcome::NotModified, 1000, 0, kUnix));
+  // Under kFetchSlotMinGapSec before a slot, both skip to the one after.
+  TEST_ASSERT_EQUAL_UINT32(1860000, updated.record(FetchOutcome::Updated, 1000, 0, kUnix + 240));
+  TEST_ASSERT_EQUAL_UINT32(1860000,
+                           notModified.record(FetchOutcome::NotModified, 1000, 0, kUnix + 240));
+  TEST_ASSERT_EQUAL_STRING("\"om-1\"", notModified.etag());
+  TEST_ASSERT_EQUAL_STRING("Tue, 14 Oct 2025 09:00:00 GMT", notModified.lastModified());
+}
+
+void test_validators_too_long_are_dropped() {
+  FetchPolicy p(kRefreshMs, kRetryMinMs);
+  char longEtag[kFetchEtagMax + 1];
+  memset(longEtag, 'e', kFetchEtagMax);
+  longEtag[kFetchEtagMax] = '\0';
+  p.setValidators(longEtag, "Tue, 14 Oct 2025 09:00:00 GMT");
+  TEST_ASSERT_EQUAL_STRING("", p.etag());
+  TEST_ASSERT_EQUAL_STRING("Tue, 14 Oct 2025 09:00:00 GMT", p.lastModified());
+  p.clearValidators();
+  TEST_ASSERT_EQUAL_STRING("", p.lastModified());
+}
+
+void test_stats_track_outcomes_over_the_window() {
+  FetchPolicy p(kRefreshMs, kRetryMinMs);
+  p.seed(3);
+  TEST_ASSERT_FALSE(p.stats().hasGood);
+
+  p.record(FetchOutcome::Failed, 1000);
+  TEST_ASSERT_EQUAL_UINT16(0, p.stats().successPermille);
+  p.record(FetchOutcome::Updated, 2000);
+  TEST_ASSERT_EQUAL_UINT16(500, p.stats().successPermille);
+  TEST_ASSERT_TRUE(p.stats().hasGood);
+  TEST_ASSERT_EQUAL_UINT32(2000, p.stats().lastGoodMs);
+
+  // Fill the window with good outcomes, then fail a quarter of it.
+  for (uint8_t i = 0; i < kFetchHistory; i++) p.record(FetchOutcome::NotModified, 3000 + i);
+  TEST_ASSERT_EQUAL_UINT16(1000, p.stats().successPermille);
+  failTimes(p, kFetchHistory / 4);
+  TEST_ASSERT_EQUAL_UINT16(750, p.stats().successPermille);
+  TEST_ASSERT_EQUAL_UINT16(kFetchHistory / 4, p.stats().failStreak);
+  TEST_ASSERT_EQUAL_UINT32(3000 + kFetchHistory - 1, p.stats().lastGoodMs);
+
+  // A good outcome ends the streak and replaces the oldest (good) one in the window.
+  p.record(FetchOutcome::Updated, 9000);
+  TEST_ASSERT_EQUAL_UINT16(750, p.stats().successPermille);
+  TEST_ASSERT_EQUAL_UINT16(0, p.stats().failStreak);
+  TEST_ASSERT_EQUAL_UINT32(9000, p.stats().lastGoodMs);
+
+  const FetchPolicyStats& st = p.stats();
+  TEST_ASSERT_EQUAL_UINT32(2 + kFetchHistory + kFetchHistory / 4 + 1, st.attempts);
+  TEST_ASSERT_EQUAL_UINT32(2, st.updated);
+  TEST_ASSERT_EQUAL_UINT32(kFetchHistory, st.notModified);
+  TEST_ASSERT_EQUAL_UINT32(1 + kFetchHistory / 4, st.failures);
+}
+
+void test_worker_304_keeps_validators_and_schedule() {
+  workerFetchWithValidators();
+  const uint32_t fullMs = gWeatherNextFetchMs - millis();
+
+  // A failure backs off; the 304 after it is back on the regular schedule.
+  hal::httpFailNext(1, 503);
+  weatherHandleRequest(gClient, gHttps, gUrl);
+  TEST_ASSERT_EQUAL_UINT16(1, gWeatherPolicy.stats().failStreak);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kRetryMinMs, gWeatherNextFetchMs - millis());
+
+  const uint32_t notModified0 = hal::httpNotModified();
+  weatherHandleRequest(gClient, gHttps, gUrl);
+  TEST_ASSERT_EQUAL_UINT32(notModified0 + 1, hal::httpNotModified());
+  TEST_ASSERT_EQUAL_UINT16(0, gWeatherPolicy.stats().failStreak);
+  TEST_ASSERT_UINT32_WITHIN(1000, fullMs, gWeatherNextFetchMs - millis());
+  TEST_ASSERT_EQUAL_STRING("\"om-1\"", gWeatherPolicy.etag());
+  TEST_ASSERT_EQUAL_STRING("Tue, 14 Oct 2025 09:00:00 GMT", gWeatherPolicy.lastModified());
+}
+
+void test_worker_new_site_list_clears_validators() {
+  workerFetchWithValidators();
+
+  // The same list: nothing changes.
+  weatherWorkerSync(gUrl, sizeof(gUrl));
+  TEST_ASSERT_EQUAL_STRING("\"om-1\"", gWeatherPolicy.etag());
+
+  char oldUrl[kWeatherUrlMax];
+  snprintf(oldUrl, sizeof(oldUrl), "%s", gUrl);
+  WeatherLocations list = gSites;
+  list.at[0].latE4 += 100;
+  weatherSitesApply(list);
+  weatherWorkerSync(gUrl, sizeof(gUrl));
+  TEST_ASSERT_TRUE(strcmp(oldUrl, gUrl) != 0);
+  TEST_ASSERT_EQUAL_STRING("", gWeatherPolicy.etag());
+  TEST_ASSERT_EQUAL_STRING("", gWeatherPolicy.lastModified());
+
+  // So the next request downloads the new sites in full.
+  const uint32_t notModified0 = hal::httpNotModified();
+  weatherHandleRequest(gClient, gHttps, gUrl);
+  TEST_ASSERT_EQUAL_UINT32(notModified0, hal::httpNotModified());
+  TEST_ASSERT_EQUAL_STRING("\"om-1\"", gWeatherPolicy.etag());
+}
+
+static int runTests() {
+  hal::serialQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_backoff_doubles_from_the_minimum_up_to_the_refresh_period);
+  RUN_TEST(test_success_resets_the_backoff);
+  RUN_TEST(test_retry_after_is_honoured_up_to_six_hours);
+  RUN_TEST(test_not_modified_keeps_the_slot_schedule);
+  RUN_TEST(test_validators_too_long_are_dropped);
+  RUN_TEST(test_stats_track_outcomes_over_the_window);
+  RUN_TEST(test_worker_304_keeps_validators_and_schedule);
+  RUN_TEST(test_worker_new_site_list_clears_validators);
+  return UNITY_END();
+}
+
+int main() { return runTests(); }
@@ -0,0 +1,267 @@
+// The MQTT publisher against a scripted broker on the loopback interface: readings queued
+// while offline stay bounded, the backlog drains at MQTT_DRAIN_PER_S in bursts of kMqttBurst
+// after the connect, and every session announces the entities exactly once. Host only
+// (pio test -e native): the broker is a thread speaking just enough MQTT 3.1.1. The tests run
+// in order and share one publisher.
+
+#include <Arduino.h>
+#include <hal.h>
+#include <lwip/sockets.h>
+#include <unity.h>
+
+#include <atomic>
+#include <cerrno>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mqtt_publisher.h"
+
+namespace {
+
+constexpr const char* kNode = "core2test";
+constexpr uint32_t kOverflow = 20;    // readings queued beyond kMqttQueueLen
+constexpr uint32_t kBatchGapMs = 200;  // longer pauses between PUBLISH packets start a batch
+constexpr uint32_t kBatchEveryMs = kMqttBurst * 1000 / MQTT_DRAIN_PER_S;
+constexpr uint32_t kEntities = 9;  // five base entities and four for the room sensor
+
+struct Publish {
+  uint8_t session;
+  uint32_t ms;
+  std::string topic;
+  std::string payload;
+};
+
+std::mutex gLogLock;
+std::vector<Publish> gLog;
+std::atomic<uint8_t> gSessions{0};
+std::atomic<bool> gHangUp{false};
+int gListenFd = -1;
+uint16_t gPort = 0;
+
+// Takes one whole packet off the front of `in`.
+bool takePacket(std::string& in, uint8_t& type, std::string& body) {
+  size_t len = 0;
+  size_t pos = 1;
+  for (uint32_t mult = 1;; mult *= 128) {
+    if (pos >= in.size() || pos > 4) return false;
+    const uint8_t b = in[pos++];
+    len += (b & 0x7F) * mult;
+    if (!(b & 0x80)) break;
+  }
+  if (in.size() < pos + len) return false;
+  type = static_cast<uint8_t>(in[0]) >> 4;
+  body = in.substr(pos, len);
+  in.erase(0, pos + len);
+  return true;
+}
+
+// Answers CONNECT and PINGREQ and logs every PUBLISH until the client goes or the test hangs
+// up.
+void serveSession(int fd, uint8_t session) {
+  const timeval tv = {0, 50000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::string in;
+  while (!gHangUp.exchange(false)) {
+    char buf[1024];
+    const int n = recv(fd, buf, sizeof(buf), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) return;
+    if (n < 0) continue;
+    in.append(buf, n);
+    uint8_t type;
+    std::string body;
+    while (takePacket(in, type, body)) {
+      if (type == 1) {
+        static const uint8_t kConnAck[] = {0x20, 0x02, 0x00, 0x00};
+        send(fd, kConnAck, sizeof(kConnAck), 0);
+      } else if (type == 12) {
+        static const uint8_t kPingResp[] = {0xD0, 0x00};
+        send(fd, kPingResp, sizeof(kPingResp), 0);
+      } else if (type == 3 && body.size() >= 2) {
+        const size_t topicLen = static_cast<uint8_t>(body[0]) << 8 | static_cast<uint8_t>(body[1]);
+        std::lock_guard<std::mutex> lock(gLogLock);
+        gLog.push_back({session, millis(), body.substr(2, topicLen), body.substr(2 + topicLen)});
+      } else if (type == 14) {
+        return;
+      }
+    }
+  }
+}
+
+void brokerMain() {
+  for (;;) {
+    const int fd = accept(gListenFd, nullptr, nullptr);
+    if (fd < 0) continue;
+    serveSession(fd, ++gSessions);
+    close(fd);
+  }
+}
+
+void startBroker() {
+  gListenFd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = 0;  // any free port
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrLen = sizeof(addr);
+  TEST_ASSERT_EQUAL_INT(0, bind(gListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+  TEST_ASSERT_EQUAL_INT(0, listen(gListenFd, 1));
+  getsockname(gListenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+  gPort = ntohs(addr.sin_port);
+  std::thread(brokerMain).detach();
+}
+
+// Reading `i` carries i + 1 as its gas resistance, so the broker can tell which one it got.
+MqttReading reading(uint32_t i) {
+  MqttReading r;
+  r.ms = millis();
+  r.outdoorC10 = 125;
+  r.condition = "Cloudy";
+  r.batteryPct = 80;
+  r.rssi = -60;
+  r.room = true;
+  r.roomC100 = 2150;
+  r.roomPermille = 455;
+  r.roomPa = 101325;
+  r.roomGasOhm = i + 1;
+  return r;
+}
+
+std::vector<Publish> session(uint8_t s) {
+  std::lock_guard<std::mutex> lock(gLogLock);
+  std::vector<Publish> out;
+  for (const Publish& p : gLog) {
+    if (p.session == s) out.push_back(p);
+  }
+  return out;
+}
+
+std::vector<Publish> states(const std::vector<Publish>& log) {
+  std::vector<Publish> out;
+  for (const Publish& p : log) {
+    if (p.topic == std::string(kNode) + "/state") out.push_back(p);
+  }
+  return out;
+}
+
+// Waits (real time) until session `s` has delivered `n` state messages, then a little longer
+// so a batch in flight is complete.
+void waitForStates(uint8_t s, size_t n, uint32_t timeoutMs) {
+  const uint32_t startMs = millis();
+  while (states(session(s)).size() < n && millis() - startMs < timeoutMs) delay(10);
+  delay(kBatchGapMs / 2);
+}
+
+uint32_t readingId(const Publish& p) {
+  const size_t at = p.payload.find("\"room_gas\":");
+  return at == std::string::npos ? 0 : strtoul(p.payload.c_str() + at + 11, nullptr, 10);
+}
+
+// Each topic other than the state is sent once per session: the status and one retained
+// config per entity.
+void assertAnnouncedOnce(const std::vector<Publish>& log) {
+  std::map<std::string, uint32_t> counts;
+  uint32_t configs = 0;
+  for (const Publish& p : log) {
+    if (p.topic == std::string(kNode) + "/state") continue;
+    counts[p.topic]++;
+    if (p.topic.rfind("homeassistant/", 0) == 0) configs++;
+  }
+  for (const auto& c : counts) TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, c.second, c.first.c_str());
+  TEST_ASSERT_EQUAL_UINT32(kEntities, configs);
+  TEST_ASSERT_EQUAL_UINT32(kEntities + 1, counts.size());
+  TEST_ASSERT_EQUAL_UINT32(1, counts[std::string(kNode) + "/status"]);
+}
+
+// Splits state messages into the bursts they arrived in.
+std::vector<std::vector<Publish>> batches(const std::vector<Publish>& st) {
+  std::vector<std::vector<Publish>> out;
+  for (const Publish& p : st) {
+    if (out.empty() || p.ms - out.back().back().ms > kBatchGapMs) out.emplace_back();
+    out.back().push_back(p);
+  }
+  return out;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_offline_queue_is_bounded() {
+  startBroker();
+  static const MqttConfig cfg = {"127.0.0.1", gPort, "", "", kNode};
+  TEST_ASSERT_TRUE(mqttStart(cfg));
+  for (uint32_t i = 0; i < kMqttQueueLen + kOverflow; i++) TEST_ASSERT_TRUE(mqttQueue(reading(i)));
+
+  const MqttStats st = mqttStats();
+  TEST_ASSERT_EQUAL_UINT32(kMqttQueueLen, st.queued);
+  TEST_ASSERT_EQUAL_UINT32(kMqttQueueLen, st.queueMax);
+  TEST_ASSERT_EQUAL_UINT32(kOverflow, st.dropped);
+  TEST_ASSERT_EQUAL_UINT32(0, st.connects);
+  TEST_ASSERT_EQUAL_UINT32(0, st.published);
+}
+
+void test_backlog_drains_in_bursts_at_the_rate() {
+  const uint32_t onlineMs = millis();
+  mqttSetOnline(true);
+  waitForStates(1, 3 * kMqttBurst, 3 * kBatchEveryMs + 2000);
+
+  const std::vector<Publish> log = session(1);
+  assertAnnouncedOnce(log);
+
+  // Oldest first, starting after the dropped ones.
+  const std::vector<Publish> st = states(log);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(3 * kMqttBurst, st.size());
+  for (size_t i = 0; i < st.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT32(kOverflow + 1 + i, readingId(st[i]));
+  }
+
+  // A full burst right after the connect, then one every kBatchEveryMs.
+  const std::vector<std::vector<Publish>> b = batches(st);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(3, b.size());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kBatchGapMs, b[0].front().ms - onlineMs);
+  for (size_t k = 0; k < 3; k++) {
+    TEST_ASSERT_EQUAL_UINT32(kMqttBurst, b[k].size());
+    if (k > 0) TEST_ASSERT_GREATER_OR_EQUAL_UINT32(kBatchEveryMs - 50, b[k][0].ms - b[k - 1][0].ms);
+  }
+
+  const MqttStats ms = mqttStats();
+  TEST_ASSERT_TRUE(ms.connected);
+  TEST_ASSERT_EQUAL_UINT32(1, ms.connects);
+  TEST_ASSERT_EQUAL_UINT32(kOverflow, ms.dropped);
+  TEST_ASSERT_EQUAL_UINT32(kMqttQueueLen - st.size(), ms.queued);
+}
+
+void test_reconnect_announces_again_once() {
+  gHangUp = true;
+  const uint32_t startMs = millis();
+  while (mqttStats().connected && millis() - startMs < 3 * kBatchEveryMs) delay(10);
+  TEST_ASSERT_FALSE(mqttStats().connected);
+
+  // Skips the reconnect delay, and the new reading wakes the task.
+  delay(50);
+  hal::clockAdvance(120000);
+  TEST_ASSERT_TRUE(mqttQueue(reading(kMqttQueueLen + kOverflow)));
+  waitForStates(2, kMqttBurst, 2000);
+
+  const std::vector<Publish> log = session(2);
+  assertAnnouncedOnce(log);
+  const std::vector<std::vector<Publish>> b = batches(states(log));
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, b.size());
+  TEST_ASSERT_EQUAL_UINT32(kMqttBurst, b[0].size());
+  TEST_ASSERT_EQUAL_UINT32(2, mqttStats().connects);
+}
+
+static int runTests() {
+  hal::serialQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_offline_queue_is_bounded);
+  RUN_TEST(test_backlog_drains_in_bursts_at_the_rate);
+  RUN_TEST(test_reconnect_announces_again_once);
+  return UNITY_END();
+}
+
+int main() { return runTests(); }
@@ -0,0 +1,171 @@
+// Snapshot<T> under load: a writer publishing as fast as it can on one core and a reader
+// copying on the other. Every word of a payload holds its sequence number, so a copy mixing
+// two publishes shows up as unequal words. Runs on the device (pio test -e m5stack-core2)
+// and on the host (pio test -e native), where the tasks are threads.
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <atomic>
+#ifndef ARDUINO
+#include <thread>
+#endif
+
+#include "snapshot.h"
+
+namespace {
+
+// Large enough that copying it takes many cycles, so an unprotected copy would tear often.
+struct Payload {
+  uint32_t words[64];
+};
+
+// Distinct versions the reader copies before both stop.
+constexpr uint32_t kReads = 100000;
+
+// Both tasks spin. On the device they give the idle task (and its watchdog) a tick now and
+// then; on a host with fewer cores than threads, yielding often is what interleaves them.
+void yieldSometimes(uint32_t count) {
+#ifdef ARDUINO
+  if (count % 4096 == 0) vTaskDelay(1);
+#else
+  if (count % 64 == 0) std::this_thread::yield();
+#endif
+}
+
+Snapshot<Payload> gSnap;
+std::atomic<uint8_t> gReady{0};
+std::atomic<bool> gWriterDone{false};
+std::atomic<bool> gReaderDone{false};
+uint32_t gPublished = 0;
+
+struct ReaderResult {
+  uint32_t reads = 0;       // copies actually made
+  uint32_t torn = 0;        // copies whose words disagree
+  uint32_t mislabeled = 0;  // copies whose words are not the version read() returned
+  uint32_t backwards = 0;   // versions lower than the one before
+};
+ReaderResult gResult;
+
+// Holds each task until both run, so the writer does not finish before the reader starts.
+void startTogether() {
+  gReady++;
+  while (gReady.load() < 2) {
+  }
+}
+
+// Parks a task that has finished: task functions must not return on the device.
+void park() {
+  for (;;) vTaskDelay(portMAX_DELAY);
+}
+
+void writerTask(void*) {
+  Payload p;
+  startTogether();
+  uint32_t seq = 0;
+  while (!gReaderDone) {
+    seq++;
+    for (uint32_t& w : p.words) w = seq;
+    gSnap.publish(p);
+    yieldSometimes(seq);
+  }
+  gPublished = seq;
+  gWriterDone = true;
+  park();
+}
+
+void readerTask(void*) {
+  Payload p;
+  ReaderResult r;
+  uint32_t known = 0;
+  uint32_t spins = 0;
+  startTogether();
+  while (r.reads < kReads) {
+    const uint32_t v = gSnap.read(p, known);
+    if (v < known) r.backwards++;
+    if (v != known) {
+      r.reads++;
+      for (uint32_t w : p.words) {
+        if (w != p.words[0]) {
+          r.torn++;
+          break;
+        }
+      }
+      if (p.words[0] != v) r.mislabeled++;
+      known = v;
+    }
+    yieldSometimes(++spins);
+  }
+  gResult = r;
+  gReaderDone = true;
+  park();
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_unpublished_reads_version_zero() {
+  Snapshot<Payload> snap;
+  Payload p;
+  p.words[0] = 7;
+  TEST_ASSERT_EQUAL_UINT32(0, snap.version());
+  TEST_ASSERT_EQUAL_UINT32(0, snap.read(p));
+  TEST_ASSERT_EQUAL_UINT32(0, p.words[0]);  // the zeroed slot
+}
+
+void test_known_version_skips_the_copy() {
+  Snapshot<Payload> snap;
+  Payload in = {};
+  in.words[0] = 42;
+  snap.publish(in);
+  Payload out = {};
+  TEST_ASSERT_EQUAL_UINT32(1, snap.read(out, 1));
+  TEST_ASSERT_EQUAL_UINT32(0, out.words[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, snap.read(out, 0));
+  TEST_ASSERT_EQUAL_UINT32(42, out.words[0]);
+}
+
+void test_writer_and_reader_on_two_cores() {
+  xTaskCreatePinnedToCore(writerTask, "snap-writer", 4096, nullptr, 1, nullptr, 0);
+  xTaskCreatePinnedToCore(readerTask, "snap-reader", 4096, nullptr, 1, nullptr, 1);
+  while (!gWriterDone) delay(10);
+
+  const ReaderResult& r = gResult;
+  char msg[96];
+  snprintf(msg,
+           sizeof(msg),
+           "%u reads, %u retries",
+           static_cast<unsigned>(r.reads),
+           static_cast<unsigned>(gSnap.retries()));
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, r.torn, "torn copies");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, r.mislabeled, "copies not matching their version");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, r.backwards, "version moved backwards");
+  // Every copy was a new version, so the writer ran throughout.
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(kReads, gPublished);
+
+  Payload p;
+  TEST_ASSERT_EQUAL_UINT32(gPublished, gSnap.read(p));
+  TEST_ASSERT_EQUAL_UINT32(gPublished, p.words[63]);
+}
+
+static int runTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_unpublished_reads_version_zero);
+  RUN_TEST(test_known_version_skips_the_copy);
+  RUN_TEST(test_writer_and_reader_on_two_cores);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);  // lets the test runner's serial monitor attach
+  runTests();
+}
+
+void loop() {}
+#else
+int main() { return runTests(); }
+#endif
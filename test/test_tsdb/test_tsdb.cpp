@@ -0,0 +1,170 @@
+// The history store's files across restarts: raw points sealed into segments until the data
+// file rotates, restored after a reboot, and what survives a torn checkpoint tail or a torn
+// last segment. Runs on the host (pio test -e native) against the in-memory LittleFS; the
+// tests run in order and share one store.
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include "ts_codec.h"
+#include "tsdb.h"
+
+namespace {
+
+constexpr TsSeries kSeries = TsSeries::RoomTemp;
+constexpr uint32_t kT0 = 820000000;  // 2025-12-27, RTC seconds since 2000
+constexpr uint32_t kStepSec = 10;
+constexpr uint32_t kFlushEvery = 16;  // well inside the store's queue
+
+constexpr const char* kDataPath = "/ts/rt-r.dat";
+constexpr const char* kOldDataPath = "/ts/rt-r.odt";
+constexpr const char* kTailPath = "/ts/rt-r.tail";
+
+uint32_t tsAt(uint32_t i) { return kT0 + i * kStepSec; }
+
+// A slowly drifting room temperature, so segments hold a realistic number of points.
+int32_t valueAt(uint32_t i) { return 2000 + static_cast<int32_t>((i / 30) % 40); }
+
+uint32_t indexOf(uint32_t ts) { return (ts - kT0) / kStepSec; }
+
+// Appends points [from, to) and stores them.
+void appendRange(uint32_t from, uint32_t to) {
+  for (uint32_t i = from; i < to; i++) {
+    TEST_ASSERT_TRUE(tsAppend(kSeries, tsAt(i), valueAt(i)));
+    if ((i + 1) % kFlushEvery == 0) tsFlush();
+  }
+  tsFlush();
+}
+
+struct Check {
+  uint32_t next;  // index of the point expected next
+  uint32_t count;
+  uint32_t wrong;
+};
+
+void checkVisit(const TsPoint& p, void* ctx) {
+  Check& c = *static_cast<Check*>(ctx);
+  if (p.ts != tsAt(c.next) || p.mean != valueAt(c.next)) c.wrong++;
+  c.next = indexOf(p.ts) + 1;
+  c.count++;
+}
+
+// Asserts the raw tier holds exactly points [from, to), in order and with their values.
+void assertStored(uint32_t from, uint32_t to) {
+  Check c = {from, 0, 0};
+  const int visited = tsQuery(kSeries, TsTier::Raw, tsAt(0), tsAt(to + 1000), checkVisit, &c);
+  TEST_ASSERT_EQUAL_INT(c.count, visited);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(to - from, c.count, "points stored");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, c.wrong, "points out of place or changed");
+  TEST_ASSERT_EQUAL_UINT32(to, c.next);
+}
+
+bool readFile(const char* path, TsSegment& seg) {
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f) return false;
+  const size_t n = f.read(reinterpret_cast<uint8_t*>(&seg), sizeof(seg));
+  f.close();
+  return n >= sizeof(seg.hdr);
+}
+
+uint32_t gEnd = 0;  // points [0, gEnd) have been stored
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_seal_until_the_data_file_rotates() {
+  TEST_ASSERT_TRUE(tsStart());
+  // Until the first generation is full and the second has a sealed segment.
+  while (!LittleFS.exists(kOldDataPath) || !LittleFS.exists(kDataPath)) {
+    appendRange(gEnd, gEnd + 500);
+    gEnd += 500;
+  }
+
+  const TsStats st = tsStats();
+  TEST_ASSERT_GREATER_THAN_UINT32(64, st.segments);
+  TEST_ASSERT_EQUAL_UINT32(0, st.dropped);
+  TEST_ASSERT_EQUAL_UINT32(0, st.rejected);
+  assertStored(0, gEnd);
+}
+
+void test_restart_restores_every_point() {
+  tsRestart();
+  assertStored(0, gEnd);
+
+  // The restored series continues where it stopped and still refuses older points.
+  const uint32_t rejected = tsStats().rejected;
+  tsAppend(kSeries, tsAt(gEnd - 1), 0);
+  tsFlush();
+  TEST_ASSERT_EQUAL_UINT32(rejected + 1, tsStats().rejected);
+  appendRange(gEnd, gEnd + 10);
+  gEnd += 10;
+  assertStored(0, gEnd);
+}
+
+void test_torn_tail_loses_only_the_open_segment() {
+  TsSegment tail;
+  TEST_ASSERT_TRUE(readFile(kTailPath, tail));
+  TEST_ASSERT_GREATER_THAN_UINT32(0, tail.hdr.count);
+  const uint32_t openFrom = indexOf(tail.hdr.firstTs);
+  TEST_ASSERT_EQUAL_UINT32(gEnd, openFrom + tail.hdr.count);
+
+  // Power lost halfway through rewriting the tail.
+  File f = LittleFS.open(kTailPath, FILE_WRITE);
+  f.write(reinterpret_cast<const uint8_t*>(&tail), tail.usedBytes() / 2);
+  f.close();
+  tsRestart();
+  assertStored(0, openFrom);
+
+  // The lost points are accepted again: the series resumes after the last sealed one.
+  const uint32_t rejected = tsStats().rejected;
+  appendRange(openFrom, gEnd);
+  TEST_ASSERT_EQUAL_UINT32(rejected, tsStats().rejected);
+  assertStored(0, gEnd);
+}
+
+void test_torn_segment_starts_a_new_generation() {
+  TsSegment first;
+  TEST_ASSERT_TRUE(readFile(kDataPath, first));
+  const uint32_t genFrom = indexOf(first.hdr.firstTs);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, genFrom);
+
+  // Power lost halfway through sealing a segment.
+  static const uint8_t kHalf[kTsSegmentBytes / 2] = {};
+  File f = LittleFS.open(kDataPath, FILE_APPEND);
+  f.write(kHalf, sizeof(kHalf));
+  f.close();
+  tsRestart();
+
+  // The torn file became the previous generation, replacing the oldest one, and the open
+  // segment resumed from its tail.
+  TEST_ASSERT_FALSE(LittleFS.exists(kDataPath));
+  assertStored(genFrom, gEnd);
+  while (!LittleFS.exists(kDataPath)) {
+    appendRange(gEnd, gEnd + 500);
+    gEnd += 500;
+  }
+  assertStored(genFrom, gEnd);
+}
+
+static int runTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_seal_until_the_data_file_rotates);
+  RUN_TEST(test_restart_restores_every_point);
+  RUN_TEST(test_torn_tail_loses_only_the_open_segment);
+  RUN_TEST(test_torn_segment_starts_a_new_generation);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);  // lets the test runner's serial monitor attach
+  runTests();
+}
+
+void loop() {}
+#else
+int main() { return runTests(); }
+#endif
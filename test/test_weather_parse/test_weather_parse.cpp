@@ -0,0 +1,88 @@
+// The Open-Meteo parser against generated responses from one day to the API's longest
+// forecast: the store keeps its first kForecastDays and kForecastHours entries whatever the
+// payload carries, and the JSON document stops growing once the series outgrow the store.
+// Host only (pio test -e native), reading the body from the HTTP stub's client.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <unity.h>
+
+#include <memory>
+#include <string>
+
+#include "../../native/bench/open_meteo_payload.h"
+#include "weather_parse.h"
+
+namespace {
+
+ForecastStore gSite;
+uint8_t gSites = 0;
+
+void keepSite(uint8_t, const ForecastStore& fc) {
+  gSite = fc;
+  gSites++;
+}
+
+WeatherParseStats parse(const std::string& raw, uint8_t sites = 1) {
+  WiFiClient in;
+  in.setResponse(std::make_shared<const std::string>(raw));
+  WeatherParseStats stats;
+  gSites = 0;
+  TEST_ASSERT_TRUE_MESSAGE(weatherParseStream(in, sites, keepSite, stats), stats.error);
+  TEST_ASSERT_EQUAL_UINT8(sites, gSites);
+  return stats;
+}
+
+// The generator's values, as the store holds them.
+void assertLongestForecast(const ForecastStore& fc) {
+  TEST_ASSERT_EQUAL_UINT8(kForecastDays, fc.dayCount);
+  TEST_ASSERT_EQUAL_UINT8(kForecastHours, fc.hourCount);
+  TEST_ASSERT_EQUAL_UINT32(1760565600, fc.dailyStart);
+  TEST_ASSERT_EQUAL_UINT32(1760608800, fc.hourlyStart);
+  TEST_ASSERT_EQUAL_INT16(110 + (kForecastDays - 1) % 5 * 10, fc.dailyMaxC10[kForecastDays - 1]);
+  TEST_ASSERT_EQUAL_INT16(70 + (kForecastHours - 1) * 7 % 70, fc.hourlyTempC10[kForecastHours - 1]);
+  TEST_ASSERT_EQUAL_INT16(126, fc.currentTempC10);
+  TEST_ASSERT_EQUAL_INT32(7200, fc.utcOffsetSec);
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_short_forecast_is_kept_whole() {
+  const WeatherParseStats st = parse(openMeteoPayload(1, 24));
+  TEST_ASSERT_EQUAL_UINT8(1, gSite.dayCount);
+  TEST_ASSERT_EQUAL_UINT8(24, gSite.hourCount);
+  TEST_ASSERT_EQUAL_size_t(0, st.bytesSkipped);
+}
+
+void test_series_past_the_store_never_reach_the_document() {
+  const WeatherParseStats atCapacity = parse(openMeteoPayload(kForecastDays, kForecastHours));
+  assertLongestForecast(gSite);
+  TEST_ASSERT_EQUAL_size_t(0, atCapacity.bytesSkipped);
+
+  const WeatherParseStats longest = parse(openMeteoPayload(16, 384));
+  assertLongestForecast(gSite);
+  TEST_ASSERT_GREATER_THAN(0, longest.bytesSkipped);
+  TEST_ASSERT_EQUAL_size_t(atCapacity.docPeakBytes, longest.docPeakBytes);
+}
+
+void test_each_site_of_a_batch_is_capped() {
+  const std::string one = openMeteoPayload(16, 384);
+  const WeatherParseStats single = parse(one);
+  const WeatherParseStats batch = parse("[" + one + "," + one + "," + one + "]", 3);
+  assertLongestForecast(gSite);
+  TEST_ASSERT_EQUAL_size_t(3 * single.bytesSkipped, batch.bytesSkipped);
+  TEST_ASSERT_EQUAL_size_t(single.docPeakBytes, batch.docPeakBytes);
+}
+
+static int runTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_short_forecast_is_kept_whole);
+  RUN_TEST(test_series_past_the_store_never_reach_the_document);
+  RUN_TEST(test_each_site_of_a_batch_is_capped);
+  return UNITY_END();
+}
+
+int main() { return runTests(); }